@@ -5,7 +5,14 @@ import argparse  # 引入命令行参数解析库
 import zmq
 import json
 import shutil
+import signal
+import sys
+import time
 import logging
+import multiprocessing
+import tempfile
+import zlib
+from collections import deque
 from llama_index.core import (
     VectorStoreIndex, Document, StorageContext,
     load_index_from_storage, Settings
@@ -37,17 +44,48 @@ logging.info(f"Hugging Face endpoint set to: {os.getenv('HF_ENDPOINT')}")
 # --- 全局模型配置 ---
 # 配置 LlamaIndex 使用本地嵌入模型而不是依赖 OpenAI。
 # 第一次运行时，LlamaIndex 会通过上面设置的镜像下载并缓存这个模型。
-try:
-    logging.info("Initializing embedding model (BAAI/bge-small-en-v1.5)...")
-    # 这会从 Hugging Face Hub 下载模型（如果本地没有缓存的话）
-    embed_model = HuggingFaceEmbedding(model_name="BAAI/bge-small-en-v1.5")
-    Settings.embed_model = embed_model
-    Settings.llm = None
-    logging.info("Embedding model initialized successfully.")
-except Exception as e:
-    logging.error(f"Failed to initialize embedding model: {e}", exc_info=True)
-    logging.error("Please ensure you have an internet connection to download the model on first run, and that 'pip install torch sentence-transformers' is complete.")
-    exit(1)
+# 每个工作进程各自加载一份模型，代理进程不需要它。
+def init_embedding_model(torch_threads: int):
+    try:
+        import torch
+        # 多个工作进程共享 CPU，每个进程只用自己那一份核心
+        torch.set_num_threads(torch_threads)
+
+        logging.info(
+            "Initializing embedding model (BAAI/bge-small-en-v1.5)...")
+        # 这会从 Hugging Face Hub 下载模型（如果本地没有缓存的话）
+        embed_model = HuggingFaceEmbedding(
+            model_name="BAAI/bge-small-en-v1.5",
+            embed_batch_size=INGEST_BATCH_SIZE)
+        Settings.embed_model = embed_model
+        Settings.llm = None
+        logging.info("Embedding model initialized successfully.")
+    except Exception as e:
+        logging.error(
+            f"Failed to initialize embedding model: {e}", exc_info=True)
+        logging.error("Please ensure you have an internet connection to download the model on first run, and that 'pip install torch sentence-transformers' is complete.")
+        exit(1)
+
+
+# 会修改索引的操作。同一索引的写操作由它的"归属"工作进程串行执行；
+# 每完成一次写操作，该索引的版本号加一，其他进程据此丢弃过期的缓存。
+WRITE_OPS = {"create_index", "delete_index",
+             "add_document", "remove_document"}
+# 不修改索引内容、但必须由归属进程在之前的写操作之后执行的操作：
+# flush 保存的是归属进程中排队的修改，不改变版本号
+HOME_OPS = {"flush"}
+
+# --- 批量写入 ---
+# add_document / remove_document 只是把修改排进该索引的队列并立即回复。
+# 队列攒够 INGEST_BATCH_SIZE 个文档，或最早的修改已等待 INGEST_DELAY 秒，
+# 或有查询需要看到这些修改时，一次性计算嵌入并写入内存中的索引；
+# 写入后的索引最多 PERSIST_INTERVAL 秒保存一次到磁盘。
+# 需要确认修改已落盘的调用者发送 flush。
+INGEST_BATCH_SIZE = 64
+INGEST_DELAY = 0.2
+PERSIST_INTERVAL = 2.0
+# 写入失败的修改留在队列中重试，同一修改失败这么多次后放弃
+INGEST_ATTEMPTS = 3
 
 
 class SemanticSearchService:
@@ -55,40 +93,45 @@ class SemanticSearchService:
     A ZeroMQ-based service providing semantic search capabilities using LlamaIndex.
     """
 
-    def __init__(self, endpoint: str, persist_dir: str):
+    def __init__(self, persist_dir: str):
         """
-        Initializes the service, ZMQ socket, and storage directory.
+        Initializes the service and storage directory.
 
         Args:
-            endpoint: The ZMQ endpoint string to bind to.
             persist_dir: The base directory to store all search indexes.
         """
         self.persist_dir = persist_dir
         if not os.path.exists(self.persist_dir):
-            os.makedirs(self.persist_dir)
+            os.makedirs(self.persist_dir, exist_ok=True)
             logging.info(f"Created storage directory: {self.persist_dir}")
 
         # In-memory cache for loaded indexes and query engines to improve performance
         self._index_cache: dict[str, VectorStoreIndex] = {}
         self._query_engine_cache: dict[str, BaseQueryEngine] = {}
-
-        # --- ZMQ Socket 初始化与清理 ---
-        self.context = zmq.Context(io_threads=4)
-
-        # 如果使用 IPC，在绑定前检查并清理旧的 socket 文件，防止启动失败
-        if endpoint.startswith("ipc://"):
-            ipc_path = endpoint.replace("ipc://", "")
-            if os.path.exists(ipc_path):
-                logging.warning(f"Removing stale IPC socket file: {ipc_path}")
-                try:
-                    os.remove(ipc_path)
-                except OSError as e:
-                    logging.error(
-                        f"Error removing socket file {ipc_path}: {e}")
-                    exit(1)
-
-        self.socket = self.context.socket(zmq.REP)
-        self.socket.bind(endpoint)
+        # 缓存内容对应的索引版本号，由代理随每个请求下发
+        self._index_versions: dict[str, int] = {}
+
+        # 每个索引排队中的修改：document_id -> 文本，None 表示删除
+        self._pending: dict[str, dict[str, str | None]] = {}
+        self._pending_since: dict[str, float] = {}
+        # 已写入内存索引但尚未保存到磁盘的索引，及其第一次修改的时间
+        self._unsaved_since: dict[str, float] = {}
+        # 上次 flush 以来写入失败的原因：index -> document_id -> 原因，
+        # 保存失败记在 None 下。重试成功的文档不再报告
+        self._ingest_errors: dict[str, dict[str | None, str]] = {}
+        # 写入失败、正在重试的修改已经失败的次数：index -> document_id -> 次数
+        self._ingest_attempts: dict[str, dict[str, int]] = {}
+
+        self.op_map = {
+            "create_index": self.handle_create_index,
+            "delete_index": self.handle_delete_index,
+            "list_indexes": self.handle_list_indexes,
+            "add_document": self.handle_add_document,
+            "remove_document": self.handle_remove_document,
+            "list_documents": self.handle_list_documents,
+            "query": self.handle_query,
+            "flush": self.handle_flush,
+        }
 
     def _get_index_path(self, index_name: str) -> str:
         """Constructs the full path for a given index name."""
@@ -147,6 +190,160 @@ class SemanticSearchService:
         self._query_engine_cache.pop(index_name, None)
         logging.debug(f"Cleared cache for index '{index_name}'.")
 
+    def _sync_index(self, index_name: str, version: int):
+        """Drops the cached index if another worker has modified it since."""
+        # 有未保存修改的索引只在本进程（它的归属进程）中被修改过
+        if self._index_versions.get(index_name) != version and not self.is_dirty(index_name):
+            self._clear_cache(index_name)
+            self._index_versions[index_name] = version
+
+    def _enqueue(self, index_name: str, doc_id: str, text: str | None):
+        """Queues an add (text) or a remove (None) of one document."""
+        changes = self._pending.setdefault(index_name, {})
+        changes.pop(doc_id, None)  # 同一文档只保留最后一次修改
+        changes[doc_id] = text
+        self._ingest_attempts.get(index_name, {}).pop(doc_id, None)
+        self._pending_since.setdefault(index_name, time.monotonic())
+        if len(changes) >= INGEST_BATCH_SIZE:
+            self._apply_pending(index_name)
+
+    def _apply_pending(self, index_name: str):
+        """Applies the queued changes of an index with one batched embedding."""
+        changes = self._pending.pop(index_name, None)
+        self._pending_since.pop(index_name, None)
+        if not changes:
+            return
+
+        try:
+            added, removed = self._apply_changes(index_name, changes)
+        except Exception as e:
+            # 一个出错的文档不应拖累整批：逐个重试，失败的留在队列中
+            logging.error(
+                f"Failed to apply {len(changes)} changes to index '{index_name}' "
+                f"in one batch: {e}; applying them one at a time.", exc_info=True)
+            added = removed = 0
+            for doc_id, text in changes.items():
+                try:
+                    a, r = self._apply_changes(index_name, {doc_id: text})
+                    added += a
+                    removed += r
+                except Exception as err:
+                    self._retry_later(index_name, doc_id, text, err)
+        finally:
+            self._query_engine_cache.pop(index_name, None)
+
+        # 即使部分失败，内存中的索引也可能已被修改
+        self._unsaved_since.setdefault(index_name, time.monotonic())
+        logging.info(
+            f"Applied {added} added and {removed} removed documents to index '{index_name}'.")
+
+    def _apply_changes(self, index_name: str,
+                       changes: dict[str, str | None]) -> tuple[int, int]:
+        """Writes changes into the in-memory index; returns (added, removed)."""
+        index = self._load_or_create_index(index_name)
+        for doc_id in changes:
+            index.delete_ref_doc(doc_id, delete_from_docstore=True)
+        removed = [doc_id for doc_id, text in changes.items()
+                   if text is None]
+        if removed:
+            index.delete_nodes(removed, delete_from_docstore=True)
+        documents = [Document(text=text, doc_id=doc_id)
+                     for doc_id, text in changes.items() if text is not None]
+        if documents:
+            # 一次插入所有文档，嵌入模型按 embed_batch_size 成批计算
+            index.insert_nodes(documents)
+
+        attempts = self._ingest_attempts.get(index_name, {})
+        errors = self._ingest_errors.get(index_name, {})
+        for doc_id in changes:
+            attempts.pop(doc_id, None)
+            errors.pop(doc_id, None)
+        return len(documents), len(removed)
+
+    def _retry_later(self, index_name: str, doc_id: str, text: str | None,
+                     error: Exception):
+        """Puts a change that failed back in the queue, up to INGEST_ATTEMPTS times."""
+        action = "removal" if text is None else "addition"
+        self._ingest_errors.setdefault(index_name, {})[doc_id] = (
+            f"{action} of document '{doc_id}': {error}")
+        attempts = self._ingest_attempts.setdefault(index_name, {})
+        count = attempts.get(doc_id, 0) + 1
+        if count >= INGEST_ATTEMPTS:
+            attempts.pop(doc_id, None)
+            logging.error(
+                f"Giving up on the {action} of document '{doc_id}' in index "
+                f"'{index_name}' after {count} attempts: {error}")
+            return
+        attempts[doc_id] = count
+        logging.error(
+            f"Failed to apply the {action} of document '{doc_id}' to index "
+            f"'{index_name}' (attempt {count} of {INGEST_ATTEMPTS}): {error}")
+        # 排队期间的新修改优先于重试的旧修改
+        self._pending.setdefault(index_name, {}).setdefault(doc_id, text)
+        self._pending_since.setdefault(index_name, time.monotonic())
+
+    def _persist(self, index_name: str):
+        """Saves an index to disk if it has unsaved changes."""
+        if self._unsaved_since.pop(index_name, None) is None:
+            return
+        index = self._index_cache.get(index_name)
+        if index is None:
+            return
+        try:
+            index.storage_context.persist(
+                persist_dir=self._get_index_path(index_name))
+            logging.info(f"Persisted index '{index_name}'.")
+        except Exception as e:
+            logging.error(
+                f"Failed to persist index '{index_name}': {e}", exc_info=True)
+            self._ingest_errors.setdefault(index_name, {})[None] = str(e)
+            # 修改仍在内存中，下次再保存
+            self._unsaved_since.setdefault(index_name, time.monotonic())
+
+    def _discard_pending(self, index_name: str):
+        self._pending.pop(index_name, None)
+        self._pending_since.pop(index_name, None)
+        self._unsaved_since.pop(index_name, None)
+        self._ingest_errors.pop(index_name, None)
+        self._ingest_attempts.pop(index_name, None)
+
+    def is_dirty(self, index_name: str) -> bool:
+        """Whether the index has changes that are not on disk yet."""
+        return index_name in self._pending or index_name in self._unsaved_since
+
+    def run_due_batches(self) -> list[str]:
+        """
+        Applies and persists batches whose delay has expired.
+        Returns the indexes that became clean, i.e. fully saved to disk.
+        """
+        now = time.monotonic()
+        for index_name, since in list(self._pending_since.items()):
+            if now - since >= INGEST_DELAY:
+                self._apply_pending(index_name)
+        saved = []
+        for index_name, since in list(self._unsaved_since.items()):
+            if now - since >= PERSIST_INTERVAL and index_name not in self._pending:
+                self._persist(index_name)
+                saved.append(index_name)
+        return saved
+
+    def next_batch_timeout(self) -> float | None:
+        """Seconds until run_due_batches() has work to do; None if idle."""
+        deadlines = [since + INGEST_DELAY
+                     for since in self._pending_since.values()]
+        deadlines += [since + PERSIST_INTERVAL
+                      for since in self._unsaved_since.values()]
+        if not deadlines:
+            return None
+        return max(0.0, min(deadlines) - time.monotonic())
+
+    def flush_all(self):
+        """Applies and persists everything; called before the worker exits."""
+        for index_name in list(self._pending):
+            self._apply_pending(index_name)
+        for index_name in list(self._unsaved_since):
+            self._persist(index_name)
+
     # --- Handler Methods (此部分逻辑与原来保持一致，无需修改) ---
 
     def handle_create_index(self, payload: dict) -> dict:
@@ -155,7 +352,7 @@ class SemanticSearchService:
             return {"error": "Missing 'index_name' in payload."}
 
         index_path = self._get_index_path(index_name)
-        if os.path.exists(index_path):
+        if os.path.exists(index_path) or self.is_dirty(index_name):
             return {"error": f"Index '{index_name}' already exists."}
 
         empty_index = VectorStoreIndex.from_documents([])
@@ -170,6 +367,7 @@ class SemanticSearchService:
             return {"error": "Missing 'index_name' in payload."}
 
         self._clear_cache(index_name)
+        self._discard_pending(index_name)
         index_path = self._get_index_path(index_name)
 
         if os.path.exists(index_path):
@@ -197,18 +395,10 @@ class SemanticSearchService:
         if not all([index_name, doc_id, text is not None]):
             return {"error": "Missing 'index_name', 'document_id', or 'text' in payload."}
 
-        self._clear_cache(index_name)
-        index = self._load_or_create_index(index_name)
-
-        index.delete_ref_doc(doc_id, delete_from_docstore=True)
-        llama_doc = Document(text=text, doc_id=doc_id)
-        # insert_nodes 在新版 llama-index 中被推荐
-        index.insert_nodes([llama_doc])
-
-        index.storage_context.persist(
-            persist_dir=self._get_index_path(index_name))
-        logging.info(
-            f"Added/updated document '{doc_id}' in index '{index_name}'.")
+        self._get_index_path(index_name)  # 尽早拒绝非法的索引名
+        self._enqueue(index_name, doc_id, text)
+        logging.debug(
+            f"Queued document '{doc_id}' for index '{index_name}'.")
         return {"status": "ok"}
 
     def handle_remove_document(self, payload: dict) -> dict:
@@ -218,16 +408,25 @@ class SemanticSearchService:
         if not all([index_name, doc_id]):
             return {"error": "Missing 'index_name' or 'document_id' in payload."}
 
-        self._clear_cache(index_name)
-        index = self._load_or_create_index(index_name)
-        index.delete_ref_doc(doc_id, delete_from_docstore=True)
-        index.delete_nodes([doc_id], delete_from_docstore=True)
+        self._get_index_path(index_name)
+        self._enqueue(index_name, doc_id, None)
+        logging.debug(
+            f"Queued removal of document '{doc_id}' from index '{index_name}'.")
+        return {"status": "ok"}
 
-        index.storage_context.persist(
-            persist_dir=self._get_index_path(index_name))
+    def handle_flush(self, payload: dict) -> dict:
+        """
+        持久化屏障：之前的所有修改都写入索引并保存到磁盘后才回复
+        """
+        index_name = payload.get("index_name")
+        if not index_name:
+            return {"error": "Missing 'index_name' in payload."}
 
-        logging.info(
-            f"Removed document/node '{doc_id}' from index '{index_name}'.")
+        self._apply_pending(index_name)
+        self._persist(index_name)
+        errors = self._ingest_errors.pop(index_name, None)
+        if errors:
+            return {"error": f"Some changes to index '{index_name}' were not saved: {'; '.join(errors.values())}"}
         return {"status": "ok"}
 
     def handle_list_documents(self, payload: dict) -> dict | list:
@@ -235,6 +434,7 @@ class SemanticSearchService:
         if not index_name:
             return {"error": "Missing 'index_name' in payload."}
 
+        self._apply_pending(index_name)
         index = self._load_or_create_index(index_name)
         if not hasattr(index, 'docstore'):
             return {"error": f"Index '{index_name}' does not have a document store."}
@@ -253,6 +453,8 @@ class SemanticSearchService:
             return json.dumps({"error": "Missing 'index_name' or 'query' in payload."})
 
         try:
+            # 查询要能看到之前已确认的写入
+            self._apply_pending(index_name)
             query_engine = self._get_query_engine(index_name)
             # 使用查询引擎执行查询，由于配置了response_mode="no_text"，只返回相似节点
             response = query_engine.query(query_text)
@@ -288,55 +490,404 @@ class SemanticSearchService:
                 f"Vector search failed for index '{index_name}': {e}", exc_info=True)
             return json.dumps({"error": f"An error occurred during vector similarity search: {e}"})
 
+    def handle(self, op_code: str, payload_str: str, version: int) -> str:
+        """
+        Dispatches one request to its handler and returns the response string.
+        """
+        try:
+            logging.debug(
+                f"Received request -> OP: {op_code}, Payload: {payload_str}")
+            payload = json.loads(payload_str)
+            handler_func = self.op_map.get(op_code)
+
+            index_name = payload.get("index_name") if isinstance(
+                payload, dict) else None
+            if handler_func:
+                if isinstance(index_name, str):
+                    self._sync_index(index_name, version)
+                result = handler_func(payload)
+                if op_code in WRITE_OPS and isinstance(index_name, str):
+                    # 本进程的缓存已包含这次修改，与代理递增后的版本一致
+                    self._index_versions[index_name] = version + 1
+            else:
+                result = {"error": f"Unknown operation code: {op_code}"}
+
+        except json.JSONDecodeError as e:
+            logging.error(f"Invalid JSON payload received: {e}")
+            result = {"error": "Malformed JSON payload."}
+        except Exception as e:
+            logging.error(
+                f"An unhandled exception occurred: {e}", exc_info=True)
+            result = {"error": f"An internal server error occurred: {e}"}
+
+        return result if isinstance(result, str) else json.dumps(result)
+
+    def index_of(self, payload_str: str) -> str | None:
+        try:
+            payload = json.loads(payload_str)
+        except json.JSONDecodeError:
+            return None
+        index_name = payload.get("index_name") if isinstance(
+            payload, dict) else None
+        return index_name if isinstance(index_name, str) else None
+
+    def serve(self, backend: str, identity: bytes):
+        """
+        The worker loop: receives tasks from the broker one at a time.
+        """
+        context = zmq.Context()
+        socket = context.socket(zmq.DEALER)
+        socket.setsockopt(zmq.IDENTITY, identity)
+        socket.setsockopt(zmq.LINGER, 0)
+        socket.connect(backend)
+        # 告诉代理本进程可以接收任务了
+        socket.send(b"READY")
+        broker_pid = os.getppid()
+
+        try:
+            while True:
+                timeout = self.next_batch_timeout()
+                timeout_ms = 1000 if timeout is None else min(
+                    1000, int(timeout * 1000) + 1)
+                if socket.poll(timeout_ms):
+                    # [任务 ID, 操作码, 载荷, 索引版本]
+                    task_id, op_code, payload, version = socket.recv_multipart()
+                    payload_str = payload.decode('utf-8')
+                    result = self.handle(op_code.decode('utf-8'),
+                                         payload_str, int(version))
+                    # 第三帧告诉代理该索引是否还有未落盘的修改；
+                    # 有的话，代理不会把它的读请求派给其他进程
+                    index_name = self.index_of(payload_str)
+                    dirty = index_name is not None and self.is_dirty(index_name)
+                    socket.send_multipart(
+                        [task_id, result.encode('utf-8'), b"1" if dirty else b"0"])
+                elif os.getppid() != broker_pid:
+                    logging.warning("Broker exited; worker shutting down.")
+                    return
+
+                for index_name in self.run_due_batches():
+                    if not self.is_dirty(index_name):
+                        socket.send_multipart(
+                            [b"SAVED", index_name.encode('utf-8')])
+        finally:
+            self.flush_all()
+            socket.close()
+            context.term()
+
+
+def run_worker(persist_dir: str, backend: str, identity: bytes,
+               torch_threads: int):
+    """Entry point of a worker process."""
+    # 代理停止时会终止工作进程；先保存尚未落盘的修改再退出
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    init_embedding_model(torch_threads)
+    service = SemanticSearchService(persist_dir=persist_dir)
+    try:
+        service.serve(backend, identity)
+    except KeyboardInterrupt:
+        pass
+
+
+class Task:
+    """A request waiting for, or being handled by, a worker."""
+
+    def __init__(self, envelope: list, op_code: str, payload: bytes,
+                 index_name: str | None):
+        self.envelope = envelope      # 客户端信封，回复时原样带回
+        self.op_code = op_code
+        self.payload = payload
+        self.index_name = index_name
+        self.write = op_code in WRITE_OPS and index_name is not None
+        self.home_only = op_code in HOME_OPS and index_name is not None
+        self.worker: bytes | None = None
+        self.remote = False           # 读请求被分派到了非归属进程
+
+
+class Broker:
+    """
+    Fans client requests out to a pool of worker processes.
+
+    Clients talk to a ROUTER socket with the same envelope as before
+    ([client identity, correlation id, "", op, payload]), so REQ and DEALER
+    clients both work. Workers connect to a second ROUTER socket and handle
+    one task at a time.
+
+    Each index has a home worker chosen by hashing its name. Writes always
+    run on the home worker, one at a time per index, so that worker's cache
+    stays warm. Reads prefer the home worker and spill over to any idle
+    worker when it is busy; those workers reload the index from disk when
+    its version has moved on. A write waits for spilled reads of its index
+    to finish, and no read spills while a write to the index is running or
+    queued, so a worker never loads an index that is being persisted.
+
+    Adds and removes are batched on the home worker and saved to disk later,
+    so an index stays "dirty" from the first unsaved change until the home
+    worker reports it saved. Reads of a dirty index never spill: only the
+    home worker sees its unsaved changes.
+    A flush saves those changes, so it also runs on the home worker after
+    the writes queued before it, but it does not change the index version.
+    """
+
+    def __init__(self, endpoint: str, persist_dir: str, num_workers: int):
+        self.persist_dir = persist_dir
+        self.backend_endpoint = "ipc://" + os.path.join(
+            tempfile.gettempdir(), f"fusellm-workers-{os.getpid()}.ipc")
+        self.torch_threads = max(1, (os.cpu_count() or 1) // num_workers)
+
+        self.workers = [f"worker-{i}".encode() for i in range(num_workers)]
+        self.processes: dict[bytes, multiprocessing.Process] = {}
+        self.idle: set[bytes] = set()
+        # 每个进程缓存中各索引的版本，用于把读请求优先派给缓存有效的进程
+        self.warm: dict[bytes, dict[str, int]] = {
+            w: {} for w in self.workers}
+
+        self.queue: deque[Task] = deque()
+        self.inflight: dict[bytes, Task] = {}
+        self.next_task_id = 0
+        self.versions: dict[str, int] = {}
+        self.writing: set[str] = set()
+        self.remote_reads: dict[str, int] = {}
+        # 归属进程中有未落盘修改的索引
+        self.dirty: set[str] = set()
+
+        # 用 spawn 启动工作进程：每个进程各自加载模型和创建 ZeroMQ 上下文，
+        # 不继承代理的套接字
+        self.mp = multiprocessing.get_context("spawn")
+        for worker in self.workers:
+            self._start_worker(worker)
+
+        self.context = zmq.Context(io_threads=4)
+
+        # 如果使用 IPC，在绑定前检查并清理旧的 socket 文件，防止启动失败
+        if endpoint.startswith("ipc://"):
+            ipc_path = endpoint.replace("ipc://", "")
+            if os.path.exists(ipc_path):
+                logging.warning(f"Removing stale IPC socket file: {ipc_path}")
+                try:
+                    os.remove(ipc_path)
+                except OSError as e:
+                    logging.error(
+                        f"Error removing socket file {ipc_path}: {e}")
+                    exit(1)
+
+        self.frontend = self.context.socket(zmq.ROUTER)
+        self.frontend.bind(endpoint)
+        self.backend = self.context.socket(zmq.ROUTER)
+        # 重启的工作进程沿用原来的身份
+        self.backend.setsockopt(zmq.ROUTER_HANDOVER, 1)
+        self.backend.bind(self.backend_endpoint)
+
+    def _start_worker(self, worker: bytes):
+        process = self.mp.Process(
+            target=run_worker, name=worker.decode(), daemon=True,
+            args=(self.persist_dir, self.backend_endpoint, worker,
+                  self.torch_threads))
+        process.start()
+        self.processes[worker] = process
+
+    def _home(self, index_name: str) -> bytes:
+        return self.workers[zlib.crc32(index_name.encode()) % len(self.workers)]
+
+    def _reply(self, envelope: list, result: bytes | str):
+        if isinstance(result, str):
+            result = result.encode('utf-8')
+        self.frontend.send_multipart(envelope + [result])
+
+    def _on_client(self):
+        frames = self.frontend.recv_multipart()
+        # 信封以第一个空帧结束
+        try:
+            delimiter = frames.index(b"", 1)
+        except ValueError:
+            logging.error("Dropping request without an envelope delimiter.")
+            return
+        envelope, body = frames[:delimiter + 1], frames[delimiter + 1:]
+        if len(body) != 2:
+            self._reply(envelope, json.dumps(
+                {"error": "Expected [op, payload] frames."}))
+            return
+
+        op_code = body[0].decode('utf-8', errors='replace')
+        if op_code == "ping":
+            # 心跳由代理直接回答，不占用工作进程
+            self._reply(envelope, json.dumps({"status": "ok"}))
+            return
+
+        try:
+            payload = json.loads(body[1])
+        except (json.JSONDecodeError, UnicodeDecodeError) as e:
+            logging.error(f"Invalid JSON payload received: {e}")
+            self._reply(envelope, json.dumps(
+                {"error": "Malformed JSON payload."}))
+            return
+        index_name = payload.get("index_name") if isinstance(
+            payload, dict) else None
+        if not isinstance(index_name, str):
+            index_name = None
+
+        self.queue.append(Task(envelope, op_code, body[1], index_name))
+
+    def _pick_worker(self, task: Task, blocked: set[str]) -> bytes | None:
+        if not self.idle:
+            return None
+        index_name = task.index_name
+        if index_name is None:
+            return next(iter(self.idle))
+
+        home = self._home(index_name)
+        if task.write:
+            if (home in self.idle and index_name not in blocked
+                    and index_name not in self.writing
+                    and not self.remote_reads.get(index_name)):
+                return home
+            return None
+
+        if task.home_only:
+            # 排在前面的写请求之后执行
+            if home in self.idle and index_name not in blocked:
+                return home
+            return None
+
+        if home in self.idle:
+            return home
+        if (index_name in self.writing or index_name in blocked
+                or index_name in self.dirty):
+            return None
+        version = self.versions.get(index_name, 0)
+        for worker in self.idle:
+            if self.warm[worker].get(index_name) == version:
+                return worker
+        return next(iter(self.idle))
+
+    def _dispatch(self):
+        # 写请求按到达顺序执行：排在前面的写请求未能派出时，
+        # 同一索引后面的请求都不能越过它
+        blocked: set[str] = set()
+        waiting: deque[Task] = deque()
+        for task in self.queue:
+            worker = self._pick_worker(task, blocked)
+            if worker is None:
+                if task.write:
+                    blocked.add(task.index_name)
+                waiting.append(task)
+            else:
+                self._send(worker, task)
+        self.queue = waiting
+
+    def _send(self, worker: bytes, task: Task):
+        index_name = task.index_name
+        version = self.versions.get(index_name, 0) if index_name else 0
+        task.worker = worker
+        if task.write:
+            self.writing.add(index_name)
+        elif index_name is not None and worker != self._home(index_name):
+            task.remote = True
+            self.remote_reads[index_name] = self.remote_reads.get(
+                index_name, 0) + 1
+        if index_name is not None:
+            self.warm[worker][index_name] = version
+
+        task_id = str(self.next_task_id).encode()
+        self.next_task_id += 1
+        self.inflight[task_id] = task
+        self.idle.discard(worker)
+        self.backend.send_multipart(
+            [worker, task_id, task.op_code.encode('utf-8'), task.payload,
+             str(version).encode()])
+
+    def _finish(self, task_id: bytes) -> Task:
+        task = self.inflight.pop(task_id)
+        index_name = task.index_name
+        if task.write:
+            self.writing.discard(index_name)
+            self.versions[index_name] = self.versions.get(index_name, 0) + 1
+        if task.remote:
+            self.remote_reads[index_name] -= 1
+        return task
+
+    def _on_worker(self):
+        frames = self.backend.recv_multipart()
+        worker = frames[0]
+        if frames[1:] == [b"READY"]:
+            logging.info(f"Worker '{worker.decode()}' is ready.")
+            self.idle.add(worker)
+            return
+        if frames[1] == b"SAVED":
+            self.dirty.discard(frames[2].decode('utf-8'))
+            return
+
+        task_id, result, dirty = frames[1], frames[2], frames[3]
+        self.idle.add(worker)
+        if task_id not in self.inflight:
+            return  # 任务已因进程崩溃而失败
+        task = self._finish(task_id)
+        if task.write:
+            self.warm[worker][task.index_name] = self.versions[task.index_name]
+        if task.index_name is not None and worker == self._home(task.index_name):
+            if dirty == b"1":
+                self.dirty.add(task.index_name)
+            else:
+                self.dirty.discard(task.index_name)
+        self._reply(task.envelope, result)
+
+    def _check_workers(self):
+        """Fails the task of a crashed worker and starts a replacement."""
+        for worker, process in self.processes.items():
+            if process.is_alive():
+                continue
+            logging.error(
+                f"Worker '{worker.decode()}' exited with code "
+                f"{process.exitcode}; restarting it.")
+            for task_id, task in list(self.inflight.items()):
+                if task.worker == worker:
+                    self._finish(task_id)
+                    self._reply(task.envelope, json.dumps(
+                        {"error": f"Worker crashed while handling '{task.op_code}'."}))
+            # 未落盘的修改随进程一起丢失了
+            for index_name in [i for i in self.dirty if self._home(i) == worker]:
+                logging.error(
+                    f"Unsaved changes to index '{index_name}' were lost.")
+                self.dirty.discard(index_name)
+                self.versions[index_name] = self.versions.get(
+                    index_name, 0) + 1
+            self.idle.discard(worker)
+            self.warm[worker] = {}
+            self._start_worker(worker)
+
     def run(self):
         """
-        The main service loop that listens for requests and dispatches them.
+        The main broker loop that forwards requests and replies.
         """
-        endpoint = self.socket.getsockopt_string(zmq.LAST_ENDPOINT)
+        endpoint = self.frontend.getsockopt_string(zmq.LAST_ENDPOINT)
         logging.info(
-            f"Semantic Search Service started. Listening on {endpoint}")
-        op_map = {
-            "create_index": self.handle_create_index,
-            "delete_index": self.handle_delete_index,
-            "list_indexes": self.handle_list_indexes,
-            "add_document": self.handle_add_document,
-            "remove_document": self.handle_remove_document,
-            "list_documents": self.handle_list_documents,
-            "query": self.handle_query,
-        }
+            f"Semantic Search Service started with {len(self.workers)} "
+            f"workers. Listening on {endpoint}")
 
-        while True:
+        poller = zmq.Poller()
+        poller.register(self.frontend, zmq.POLLIN)
+        poller.register(self.backend, zmq.POLLIN)
+
+        try:
+            while True:
+                events = dict(poller.poll(1000))
+                if events.get(self.backend) == zmq.POLLIN:
+                    self._on_worker()
+                if events.get(self.frontend) == zmq.POLLIN:
+                    self._on_client()
+                self._check_workers()
+                self._dispatch()
+        except zmq.ZMQError as e:
+            logging.error(f"ZMQ Error: {e}")
+        finally:
+            # 工作进程收到 SIGTERM 后会先保存未落盘的修改
+            for process in self.processes.values():
+                process.terminate()
+            for process in self.processes.values():
+                process.join(timeout=30)
             try:
-                op_code_bytes, payload_bytes = self.socket.recv_multipart()
-                op_code = op_code_bytes.decode('utf-8')
-                payload_str = payload_bytes.decode('utf-8')
-
-                logging.debug(
-                    f"Received request -> OP: {op_code}, Payload: {payload_str}")
-                payload = json.loads(payload_str)
-                handler_func = op_map.get(op_code)
-
-                if handler_func:
-                    result = handler_func(payload)
-                else:
-                    result = {"error": f"Unknown operation code: {op_code}"}
-
-                response_str = result if isinstance(
-                    result, str) else json.dumps(result)
-                self.socket.send_string(response_str)
-
-            except zmq.ZMQError as e:
-                logging.error(f"ZMQ Error: {e}")
-                break
-            except json.JSONDecodeError as e:
-                logging.error(f"Invalid JSON payload received: {e}")
-                self.socket.send_string(json.dumps(
-                    {"error": "Malformed JSON payload."}))
-            except Exception as e:
-                logging.error(
-                    f"An unhandled exception occurred: {e}", exc_info=True)
-                self.socket.send_string(json.dumps(
-                    {"error": f"An internal server error occurred: {e}"}))
+                os.remove(self.backend_endpoint.replace("ipc://", ""))
+            except OSError:
+                pass
 
 
 if __name__ == "__main__":
@@ -355,11 +906,19 @@ if __name__ == "__main__":
         default="./index_storage",
         help="The directory to persist semantic search indexes."
     )
+    parser.add_argument(
+        "--workers",
+        type=int,
+        default=os.cpu_count() or 1,
+        help="The number of worker processes (defaults to the number of CPU cores)."
+    )
     args = parser.parse_args()
 
-    service = SemanticSearchService(
-        endpoint=args.endpoint, persist_dir=args.storage_dir)
+    # 收到 SIGTERM 时同样走正常的退出流程，以便停止工作进程
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    broker = Broker(endpoint=args.endpoint, persist_dir=args.storage_dir,
+                    num_workers=max(1, args.workers))
     try:
-        service.run()
+        broker.run()
     except KeyboardInterrupt:
         logging.info("Service shutting down gracefully.")
@@ -0,0 +1,116 @@
+#include "BlobStore.h"
+
+namespace fusellm {
+
+namespace {
+
+const std::shared_ptr<const std::string> &empty_text() {
+    // Leaked on purpose, like BlobStore::shared().
+    static const auto *empty = new std::shared_ptr<const std::string>(
+        std::make_shared<const std::string>());
+    return *empty;
+}
+
+} // namespace
+
+struct BlobStore::Entry {
+    Entry(std::string_view text, uint64_t hash) : text(text), hash(hash) {}
+
+    const std::string text;
+    const uint64_t hash;
+    size_t references = 0; // Guarded by BlobStore::mtx_
+};
+
+Blob::Blob() : text_(empty_text()) {}
+
+Blob::Blob(std::string_view text) {
+    BlobStore &store = BlobStore::shared();
+    if (text.size() >= store.min_bytes()) {
+        *this = store.intern(text);
+    } else if (text.empty()) {
+        text_ = empty_text();
+    } else {
+        text_ = std::make_shared<const std::string>(text);
+    }
+}
+
+bool operator==(const Blob &a, const Blob &b) {
+    if (a.text_ == b.text_) {
+        return true;
+    }
+    if (a.interned() && b.interned()) {
+        // Each interned text is stored once.
+        return false;
+    }
+    return a.view() == b.view();
+}
+
+BlobStore::~BlobStore() = default;
+
+BlobStore &BlobStore::shared() {
+    static auto *store = new BlobStore();
+    return *store;
+}
+
+uint64_t BlobStore::hash(std::string_view text) {
+    uint64_t h = std::hash<std::string_view>{}(text);
+    return h ? h : 1; // 0 marks a Blob that is not interned
+}
+
+Blob BlobStore::intern(std::string_view text) {
+    const uint64_t h = hash(text);
+    Entry *entry = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto range = entries_.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second->text == text) {
+                entry = it->second;
+                break;
+            }
+        }
+        if (entry) {
+            stats_.hits++;
+        } else {
+            entry = new Entry(text, h);
+            entries_.emplace(h, entry);
+            stats_.misses++;
+            stats_.blobs++;
+            stats_.stored_bytes += text.size();
+        }
+        entry->references++;
+        stats_.references++;
+        stats_.logical_bytes += text.size();
+    }
+    // Each result gets its own control block, so the store can count the
+    // references it handed out (copies of a Blob share one).
+    std::shared_ptr<const std::string> ref(
+        &entry->text, [this, entry](const std::string *) { release(entry); });
+    return Blob(std::move(ref), h);
+}
+
+void BlobStore::release(Entry *entry) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.references--;
+    stats_.logical_bytes -= entry->text.size();
+    if (--entry->references > 0) {
+        return;
+    }
+    auto range = entries_.equal_range(entry->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == entry) {
+            entries_.erase(it);
+            break;
+        }
+    }
+    stats_.blobs--;
+    stats_.stored_bytes -= entry->text.size();
+    delete entry;
+}
+
+BlobStore::Stats BlobStore::stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+} // namespace fusellm
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace fusellm {
+
+class BlobStore;
+
+/**
+ * @class Blob
+ * @brief An immutable string shared by reference.
+ *
+ * Copying a Blob copies a pointer, never the text. Texts of at least
+ * BlobStore::min_bytes() are interned in the process-wide BlobStore, so
+ * equal payloads created independently (the same document pasted into many
+ * sessions, the same system prompt parsed for many models) are stored once,
+ * and comparing two interned Blobs costs a pointer or hash comparison.
+ */
+class Blob {
+  public:
+    Blob();
+    Blob(std::string_view text);
+    Blob(const std::string &text) : Blob(std::string_view(text)) {}
+    Blob(const char *text) : Blob(std::string_view(text)) {}
+
+    const std::string &str() const { return *text_; }
+    operator const std::string &() const { return *text_; }
+    std::string_view view() const { return *text_; }
+
+    const char *data() const { return text_->data(); }
+    size_t size() const { return text_->size(); }
+    bool empty() const { return text_->empty(); }
+
+    // Whether the text is shared through the BlobStore.
+    bool interned() const { return hash_ != 0; }
+
+    friend bool operator==(const Blob &a, const Blob &b);
+    friend bool operator!=(const Blob &a, const Blob &b) { return !(a == b); }
+    friend bool operator==(const Blob &a, std::string_view b) {
+        return a.view() == b;
+    }
+    friend bool operator==(const Blob &a, const std::string &b) {
+        return a.view() == b;
+    }
+    friend bool operator==(const Blob &a, const char *b) {
+        return a.view() == b;
+    }
+    friend std::ostream &operator<<(std::ostream &os, const Blob &blob) {
+        return os << blob.view();
+    }
+
+  private:
+    friend class BlobStore;
+
+    Blob(std::shared_ptr<const std::string> text, uint64_t hash)
+        : text_(std::move(text)), hash_(hash) {}
+
+    std::shared_ptr<const std::string> text_; // never null
+    uint64_t hash_ = 0;                       // 0 unless interned
+};
+
+/**
+ * @class BlobStore
+ * @brief Refcounted, content-addressed storage for large strings.
+ *
+ * Each distinct text is stored once, keyed by a 64-bit hash (collisions are
+ * resolved by comparing the text). Every intern() returns a new reference
+ * to the stored text and the text is freed with its last reference, so the
+ * store only ever holds what is in use. The number of live references is
+ * what the payloads would have cost without deduplication, which the stats
+ * report next to the bytes actually stored.
+ *
+ * This class is thread-safe. A store must outlive the Blobs it returns; the
+ * shared() one lives until the process exits.
+ */
+class BlobStore {
+  public:
+    struct Stats {
+        uint64_t blobs = 0;         // Distinct texts stored
+        uint64_t references = 0;    // Live intern() results
+        uint64_t stored_bytes = 0;  // Bytes of the distinct texts
+        uint64_t logical_bytes = 0; // Bytes of all references
+        uint64_t hits = 0;          // intern() calls that found the text
+        uint64_t misses = 0;
+
+        // Bytes without deduplication per byte stored; 1 = no sharing.
+        double dedupe_ratio() const {
+            return stored_bytes ? double(logical_bytes) / stored_bytes : 1.0;
+        }
+    };
+
+    explicit BlobStore(size_t min_bytes = 256) : min_bytes_(min_bytes) {}
+    ~BlobStore();
+
+    BlobStore(const BlobStore &) = delete;
+    BlobStore &operator=(const BlobStore &) = delete;
+
+    /**
+     * @brief The store Blob constructors use. Never destroyed, so Blobs
+     * held by static objects stay valid at exit.
+     */
+    static BlobStore &shared();
+
+    /**
+     * @brief Texts shorter than this are not worth a table entry; Blobs
+     * made from them are shared by copying only.
+     */
+    size_t min_bytes() const { return min_bytes_; }
+
+    /**
+     * @brief Returns a reference to the stored copy of `text`, storing it
+     * first if needed. Interns regardless of min_bytes().
+     */
+    Blob intern(std::string_view text);
+
+    Stats stats() const;
+
+  private:
+    struct Entry;
+
+    static uint64_t hash(std::string_view text);
+    void release(Entry *entry);
+
+    const size_t min_bytes_;
+
+    mutable std::mutex mtx_;
+    std::unordered_multimap<uint64_t, Entry *> entries_;
+    Stats stats_;
+};
+
+} // namespace fusellm
@@ -0,0 +1,107 @@
+// src/common/CancelToken.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+namespace fusellm {
+
+/**
+ * @class CancelToken
+ * @brief Cooperative cancellation handle for long-running LLM requests.
+ *
+ * A token is created by the FUSE handler that owns the request and passed
+ * down to the LLMClient, which polls it while the HTTP transfer is running.
+ * It trips when any of the following happens:
+ *  - cancel() is called explicitly;
+ *  - the interrupt probe reports that the calling process gave up (e.g. the
+ *    user hit Ctrl-C and FUSE flagged the request via fuse_interrupted());
+ *  - the deadline has passed.
+ *
+ * The first reason that trips the token is latched and can be read back
+ * with reason(), so callers can map it to an errno (EINTR, ETIMEDOUT, ...).
+ * is_cancelled() must be called from the thread that owns the request,
+ * because the interrupt probe is usually thread-local FUSE state.
+ */
+class CancelToken {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Reason { None, Cancelled, Interrupted, DeadlineExceeded };
+
+    CancelToken() = default;
+    CancelToken(const CancelToken &) = delete;
+    CancelToken &operator=(const CancelToken &) = delete;
+
+    /**
+     * @brief Installs a predicate that reports whether the request has been
+     * interrupted by its caller.
+     */
+    void set_interrupt_probe(std::function<bool()> probe) {
+        probe_ = std::move(probe);
+    }
+
+    /**
+     * @brief Sets an absolute deadline, keeping the earlier one if a
+     * deadline is already set.
+     */
+    void set_deadline(Clock::time_point deadline) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!deadline_ || deadline < *deadline_) {
+            deadline_ = deadline;
+        }
+    }
+
+    /**
+     * @brief Sets a relative deadline from now. See set_deadline().
+     */
+    void set_timeout(std::chrono::milliseconds timeout) {
+        set_deadline(Clock::now() + timeout);
+    }
+
+    std::optional<Clock::time_point> deadline() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return deadline_;
+    }
+
+    /**
+     * @brief Trips the token explicitly. Safe to call from any thread.
+     */
+    void cancel(Reason reason = Reason::Cancelled) {
+        Reason expected = Reason::None;
+        reason_.compare_exchange_strong(expected, reason);
+    }
+
+    /**
+     * @brief Evaluates the token, latching the first reason that applies.
+     * @return True if the request should be aborted.
+     */
+    bool is_cancelled() {
+        if (reason_.load() != Reason::None) {
+            return true;
+        }
+        if (probe_ && probe_()) {
+            cancel(Reason::Interrupted);
+            return true;
+        }
+        auto dl = deadline();
+        if (dl && Clock::now() >= *dl) {
+            cancel(Reason::DeadlineExceeded);
+            return true;
+        }
+        return false;
+    }
+
+    Reason reason() const { return reason_.load(); }
+
+  private:
+    std::function<bool()> probe_;
+    std::optional<Clock::time_point> deadline_;
+    std::atomic<Reason> reason_{Reason::None};
+    mutable std::mutex mtx_; // 保护 deadline_
+};
+
+} // namespace fusellm
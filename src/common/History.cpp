@@ -0,0 +1,384 @@
+#include "History.h"
+#include "HistoryCompressor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace fusellm {
+
+namespace {
+
+// 索引块容量依次为 8, 8, 16, 32, ...：块 b 覆盖 [4 << b, 8 << b)（b >= 1）
+constexpr size_t FIRST_BLOCK = 8;
+// 消息正文所在块的大小：从 256 字节翻倍增长到 64 KiB
+constexpr size_t MIN_CHUNK = 256;
+constexpr size_t MAX_CHUNK = 64 << 10;
+// 超过此大小的正文不拷入块中，而是放进 BlobStore，相同的正文只存一份
+constexpr size_t LARGE_BODY = MAX_CHUNK / 2;
+constexpr size_t NO_CHUNK = static_cast<size_t>(-1);
+// 分叉层数的上限；超过后分叉时把历史拷贝进新的存储，使读取的层数有界
+constexpr size_t MAX_DEPTH = 8;
+
+size_t block_of(size_t index) {
+    if (index < FIRST_BLOCK) {
+        return 0;
+    }
+    size_t width = 64 - static_cast<size_t>(__builtin_clzll(index));
+    return width - 3;
+}
+
+size_t block_start(size_t block) { return block == 0 ? 0 : size_t(4) << block; }
+
+size_t block_capacity(size_t block) {
+    return block == 0 ? FIRST_BLOCK : size_t(4) << block;
+}
+
+} // namespace
+
+// Struct-of-arrays index of one block of messages. Slots beyond the tip are
+// written in place; slots any version can see are never touched again.
+struct History::Block {
+    explicit Block(size_t capacity)
+        : timestamp(new int64_t[capacity]), chunk(new uint32_t[capacity]),
+          offset(new uint32_t[capacity]), length(new uint32_t[capacity]),
+          tokens(new uint32_t[capacity]), role(new uint8_t[capacity]) {}
+
+    static size_t bytes(size_t capacity) {
+        return sizeof(Block) + capacity * (sizeof(int64_t) +
+                                           4 * sizeof(uint32_t) +
+                                           sizeof(uint8_t));
+    }
+
+    std::unique_ptr<int64_t[]> timestamp; // system_clock ticks
+    std::unique_ptr<uint32_t[]> chunk;
+    std::unique_ptr<uint32_t[]> offset;
+    std::unique_ptr<uint32_t[]> length;
+    std::unique_ptr<uint32_t[]> tokens;
+    std::unique_ptr<uint8_t[]> role;
+};
+
+// Append-only bytes holding message bodies back to back, or, once frozen by
+// compact(), the same bytes compressed. A large body is an interned Blob of
+// its own instead, shared with every history holding the same text.
+struct History::Chunk {
+    explicit Chunk(size_t capacity)
+        : data(new char[capacity]), begin(data.get()), capacity(capacity) {}
+    Chunk(std::shared_ptr<const HistoryCompressor::Frame> frozen, size_t last)
+        : frame(std::move(frozen)), capacity(frame->raw_size()),
+          used(capacity), last(last) {}
+    Chunk(Blob body, size_t last)
+        : blob(std::move(body)), begin(blob.data()), capacity(blob.size()),
+          used(capacity), last(last) {}
+
+    size_t bytes() const {
+        return frame ? frame->stored_bytes() : capacity;
+    }
+
+    std::unique_ptr<char[]> data; // Only for bodies packed here
+    std::shared_ptr<const HistoryCompressor::Frame> frame;
+    Blob blob;
+    const char *begin = nullptr; // Null once frozen
+    const size_t capacity;
+    size_t used = 0; // Guarded by Tip::mtx
+    size_t last = 0; // Index of the newest message stored here; ditto
+    // compact() found it not worth compressing.
+    mutable std::atomic<bool> incompressible{false};
+};
+
+// Shared by every version of one storage: how many slots are taken.
+struct History::Tip {
+    std::mutex mtx;
+    size_t size = 0;
+};
+
+// The blocks and chunks of a storage. A spine is never modified once
+// published; adding a block or chunk publishes a copy.
+//
+// A storage branched off an older version holds only the messages from the
+// branch point on; the ones before it are read from the base storage.
+struct History::Spine {
+    std::vector<std::shared_ptr<Block>> blocks;
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    size_t fill_chunk = NO_CHUNK; // The chunk small bodies go to
+    size_t settled = 0; // Chunks before this one are frozen or incompressible
+    size_t bytes = sizeof(Spine);
+    std::shared_ptr<Tip> tip;
+    std::shared_ptr<const Spine> base;
+    size_t base_size = 0; // Messages read from `base`
+    size_t depth = 0;     // Number of bases below this storage
+};
+
+History History::from_messages(const std::vector<Message> &messages) {
+    History history;
+    for (const auto &msg : messages) {
+        history = history.append(msg);
+    }
+    return history;
+}
+
+History::Entry History::at(size_t index, Pinned *pinned) const {
+    const Spine *spine = spine_.get();
+    while (index < spine->base_size) {
+        spine = spine->base.get();
+    }
+    const size_t local = index - spine->base_size;
+    const size_t b = block_of(local);
+    const Block &block = *spine->blocks[b];
+    const size_t slot = local - block_start(b);
+    Entry entry;
+    entry.role = static_cast<Message::Role>(block.role[slot]);
+    if (block.length[slot] > 0) {
+        const Chunk &chunk = *spine->chunks[block.chunk[slot]];
+        const char *base = chunk.begin;
+        if (!base) {
+            if (pinned && pinned->chunk == &chunk) {
+                entry.pin = pinned->body;
+            } else {
+                entry.pin = chunk.frame->load();
+                if (pinned) {
+                    *pinned = Pinned{&chunk, entry.pin};
+                }
+            }
+            base = entry.pin->data();
+        }
+        entry.content =
+            std::string_view(base + block.offset[slot], block.length[slot]);
+    }
+    entry.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::system_clock::duration(block.timestamp[slot]));
+    entry.tokens = block.tokens[slot];
+    return entry;
+}
+
+History History::append(Message::Role role, std::string_view content,
+                        std::chrono::system_clock::time_point timestamp) const {
+    if (!spine_) {
+        auto spine = std::make_shared<Spine>();
+        spine->tip = std::make_shared<Tip>();
+        return History(std::move(spine), 0).append(role, content, timestamp);
+    }
+
+    std::unique_lock<std::mutex> lock(spine_->tip->mtx);
+    if (spine_->tip->size != size_) {
+        // A newer version owns the next slot; branch off.
+        lock.unlock();
+        return branch().append(role, content, timestamp);
+    }
+
+    std::shared_ptr<Spine> grown; // Copy of the spine, once something is added
+    const Spine *spine = spine_.get();
+    auto grow = [&]() -> Spine & {
+        if (!grown) {
+            grown = std::make_shared<Spine>(*spine_);
+            spine = grown.get();
+        }
+        return *grown;
+    };
+
+    const size_t local = size_ - spine_->base_size;
+    const size_t b = block_of(local);
+    if (b >= spine->blocks.size()) {
+        Spine &s = grow();
+        s.blocks.push_back(std::make_shared<Block>(block_capacity(b)));
+        s.bytes += Block::bytes(block_capacity(b)) + sizeof(s.blocks[0]);
+    }
+
+    uint32_t chunk_index = 0;
+    uint32_t offset = 0;
+    if (!content.empty()) {
+        if (content.size() > LARGE_BODY) {
+            Spine &s = grow();
+            s.chunks.push_back(std::make_shared<Chunk>(
+                BlobStore::shared().intern(content), size_));
+            s.bytes += content.size() + sizeof(s.chunks[0]);
+            chunk_index = static_cast<uint32_t>(s.chunks.size() - 1);
+        } else {
+            size_t target = spine->fill_chunk;
+            if (target == NO_CHUNK || spine->chunks[target]->capacity -
+                                              spine->chunks[target]->used <
+                                          content.size()) {
+                size_t capacity =
+                    target == NO_CHUNK
+                        ? MIN_CHUNK
+                        : std::min(spine->chunks[target]->capacity * 2,
+                                   MAX_CHUNK);
+                capacity = std::max(capacity, content.size());
+                Spine &s = grow();
+                s.chunks.push_back(std::make_shared<Chunk>(capacity));
+                s.bytes += capacity + sizeof(s.chunks[0]);
+                s.fill_chunk = target = s.chunks.size() - 1;
+            }
+            Chunk &chunk = *spine->chunks[target];
+            chunk_index = static_cast<uint32_t>(target);
+            offset = static_cast<uint32_t>(chunk.used);
+            std::memcpy(chunk.data.get() + chunk.used, content.data(),
+                        content.size());
+            chunk.used += content.size();
+            chunk.last = size_;
+        }
+    }
+
+    Block &block = *spine->blocks[b];
+    const size_t slot = local - block_start(b);
+    block.timestamp[slot] = timestamp.time_since_epoch().count();
+    block.chunk[slot] = chunk_index;
+    block.offset[slot] = offset;
+    block.length[slot] = static_cast<uint32_t>(content.size());
+    block.tokens[slot] = estimate_tokens(content);
+    block.role[slot] = static_cast<uint8_t>(role);
+    spine->tip->size = size_ + 1;
+
+    if (grown) {
+        return History(std::move(grown), size_ + 1);
+    }
+    return History(spine_, size_ + 1);
+}
+
+History History::truncate(size_t count) const {
+    if (count >= size_) {
+        return *this;
+    }
+    if (count == 0) {
+        return History();
+    }
+    // Drop storages branched off after the first `count` messages.
+    std::shared_ptr<const Spine> spine = spine_;
+    while (count <= spine->base_size) {
+        spine = spine->base;
+    }
+    return History(std::move(spine), count);
+}
+
+History History::erase(size_t index) const {
+    if (index >= size_) {
+        return *this;
+    }
+    History result = truncate(index);
+    Pinned pinned;
+    for (size_t i = index + 1; i < size_; i++) {
+        Entry e = at(i, &pinned);
+        result = result.append(e.role, e.content, e.timestamp);
+    }
+    return result;
+}
+
+History History::insert(size_t index, const Message &msg) const {
+    History result = truncate(index).append(msg);
+    Pinned pinned;
+    for (size_t i = index; i < size_; i++) {
+        Entry e = at(i, &pinned);
+        result = result.append(e.role, e.content, e.timestamp);
+    }
+    return result;
+}
+
+History History::branch() const {
+    if (spine_->depth >= MAX_DEPTH) {
+        return rebuild();
+    }
+    auto spine = std::make_shared<Spine>();
+    spine->tip = std::make_shared<Tip>();
+    spine->tip->size = size_;
+    spine->base = spine_;
+    spine->base_size = size_;
+    spine->depth = spine_->depth + 1;
+    return History(std::move(spine), size_);
+}
+
+History History::rebuild() const {
+    History fresh;
+    Pinned pinned;
+    for (size_t i = 0; i < size_; i++) {
+        Entry e = at(i, &pinned);
+        fresh = fresh.append(e.role, e.content, e.timestamp);
+    }
+    return fresh;
+}
+
+History History::compact(HistoryCompressor &compressor) const {
+    if (!spine_ || size_ <= compressor.keep_messages()) {
+        return *this;
+    }
+    const size_t cutoff = size_ - compressor.keep_messages();
+
+    // Chunks no message from the cutoff on lives in. The fill chunk is
+    // skipped even if it qualifies, as the next append may write to it.
+    std::vector<std::pair<size_t, size_t>> cold; // chunk, used bytes
+    size_t settled = spine_->settled;
+    {
+        std::lock_guard<std::mutex> lock(spine_->tip->mtx);
+        if (spine_->tip->size != size_) {
+            return *this;
+        }
+        bool prefix = true;
+        for (size_t c = spine_->settled; c < spine_->chunks.size(); c++) {
+            const Chunk &chunk = *spine_->chunks[c];
+            // Frozen, or an interned Blob that is cheaper shared than
+            // compressed once per history.
+            const bool done = !chunk.data || chunk.incompressible;
+            if (!done && c != spine_->fill_chunk && chunk.last < cutoff) {
+                cold.emplace_back(c, chunk.used);
+            } else if (!done) {
+                prefix = false;
+            }
+            if (prefix) {
+                settled = c + 1;
+            }
+        }
+    }
+    if (cold.empty()) {
+        return *this;
+    }
+
+    // Chunks other than the fill chunk are never written again, so they can
+    // be read without the lock.
+    auto spine = std::make_shared<Spine>(*spine_);
+    for (auto [c, used] : cold) {
+        const Chunk &chunk = *spine->chunks[c];
+        auto frame =
+            compressor.compress(std::string_view(chunk.data.get(), used));
+        if (!frame) {
+            chunk.incompressible = true;
+            continue;
+        }
+        spine->bytes -= chunk.bytes();
+        auto frozen = std::make_shared<Chunk>(std::move(frame), chunk.last);
+        spine->bytes += frozen->bytes();
+        spine->chunks[c] = std::move(frozen);
+    }
+    spine->settled = settled;
+    return History(std::move(spine), size_);
+}
+
+std::vector<Message> History::to_messages() const {
+    std::vector<Message> messages;
+    messages.reserve(size_);
+    for (const auto &e : *this) {
+        messages.push_back(Message{e.role, std::string(e.content), e.timestamp});
+    }
+    return messages;
+}
+
+size_t History::memory_bytes() const {
+    size_t bytes = 0;
+    for (const Spine *spine = spine_.get(); spine; spine = spine->base.get()) {
+        bytes += spine->bytes;
+    }
+    return bytes;
+}
+
+uint32_t History::estimate_tokens(std::string_view text) {
+    size_t ascii = 0;
+    size_t other = 0;
+    for (unsigned char c : text) {
+        if (c < 0x80) {
+            ascii++;
+        } else if ((c & 0xC0) != 0x80) {
+            other++; // Lead byte of a multi-byte character
+        }
+    }
+    return static_cast<uint32_t>((ascii + 3) / 4 + other);
+}
+
+} // namespace fusellm
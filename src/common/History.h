@@ -0,0 +1,200 @@
+#pragma once
+
+#include "BlobStore.h"
+#include "Rope.h"
+#include "data.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fusellm {
+
+class HistoryCompressor;
+
+/**
+ * @class History
+ * @brief An immutable, cheaply copyable sequence of messages.
+ *
+ * Message bodies are packed back to back into append-only byte chunks, and
+ * each message is described by a compact struct-of-arrays index (role,
+ * chunk, offset, length, timestamp, estimated token count; 25 bytes per
+ * message). Index blocks double in size, so neither the bodies nor the
+ * index ever move once written, and iterating a history walks a few
+ * contiguous arrays instead of chasing one heap allocation per message.
+ *
+ * A History is a (storage, length) pair, and versions derived from one
+ * another share storage: append() on the newest version writes past the
+ * end of every existing version and is O(1) amortized. Appending to an
+ * older version (e.g. after a rollback, or in a forked conversation)
+ * branches off: the new storage holds only the messages appended from then
+ * on and reads older ones from the shared prefix, so diverging costs O(1)
+ * and no version ever observes a change. After a few nested branches the
+ * messages are copied into fresh storage instead, which keeps reads within
+ * a bounded number of hops. Reads are lock-free; concurrent appends to
+ * versions of the same storage are serialized internally.
+ *
+ * Bodies larger than 32 KiB are not copied into a chunk but interned in
+ * the BlobStore, so a document pasted into many conversations is stored
+ * once.
+ *
+ * compact() swaps byte chunks that only hold old messages for compressed
+ * frames (see HistoryCompressor); reading such a message decompresses its
+ * chunk through the compressor's cache.
+ */
+class History {
+  public:
+    /**
+     * @brief One message, viewed in place. `content` stays valid for as long
+     * as the Entry exists (and, unless the message is compressed, as long as
+     * any History sharing the storage exists).
+     */
+    struct Entry {
+        Message::Role role;
+        std::string_view content;
+        std::chrono::system_clock::time_point timestamp;
+        uint32_t tokens; // Estimated, see estimate_tokens()
+        // Keeps the decompressed chunk alive; null for uncompressed messages.
+        std::shared_ptr<const std::string> pin;
+    };
+
+  private:
+    struct Chunk;
+
+    // The decompressed chunk an iterator read last, so a scan decompresses
+    // (or looks up) each compressed chunk once, not once per message.
+    struct Pinned {
+        const Chunk *chunk = nullptr;
+        std::shared_ptr<const std::string> body;
+    };
+
+  public:
+
+    class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Entry;
+
+        Iterator(const History *history, size_t index)
+            : history_(history), index_(index) {}
+        Entry operator*() const { return history_->at(index_, &pinned_); }
+        Iterator &operator++() {
+            ++index_;
+            return *this;
+        }
+        bool operator==(const Iterator &other) const {
+            return index_ == other.index_;
+        }
+        bool operator!=(const Iterator &other) const {
+            return index_ != other.index_;
+        }
+
+      private:
+        const History *history_;
+        size_t index_;
+        mutable Pinned pinned_;
+    };
+
+    History() = default;
+
+    static History from_messages(const std::vector<Message> &messages);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    Entry operator[](size_t index) const { return at(index, nullptr); }
+    Entry back() const { return (*this)[size_ - 1]; }
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, size_); }
+
+    /**
+     * @brief Returns this history with one more message; this version is
+     * unchanged.
+     */
+    History append(Message::Role role, std::string_view content,
+                   std::chrono::system_clock::time_point timestamp) const;
+    History append(const Message &msg) const {
+        return append(msg.role, msg.content, msg.timestamp);
+    }
+
+    /**
+     * @brief The first `count` messages. O(1); shares storage.
+     */
+    History truncate(size_t count) const;
+
+    /**
+     * @brief Returns this history without the message at `index`.
+     */
+    History erase(size_t index) const;
+
+    /**
+     * @brief Returns this history with a message inserted before `index`.
+     */
+    History insert(size_t index, const Message &msg) const;
+
+    /**
+     * @brief Returns an equal history whose chunks holding only messages
+     * older than the compressor's last keep_messages() are compressed.
+     * Returns this version if there is nothing to compress or it is not the
+     * newest version of its storage.
+     */
+    History compact(HistoryCompressor &compressor) const;
+
+    std::vector<Message> to_messages() const;
+
+    /**
+     * @brief Bytes of the storage this history uses, including capacity not
+     * filled yet, messages beyond size() appended by newer versions and the
+     * prefix shared with the version it branched off. Compressed chunks
+     * count with their compressed size.
+     */
+    size_t memory_bytes() const;
+
+    /**
+     * @brief Whether both are the same version of the same storage, i.e.
+     * equal without comparing any message.
+     */
+    bool same_as(const History &other) const {
+        return spine_ == other.spine_ && size_ == other.size_;
+    }
+
+    /**
+     * @brief Rough token count of a text: ~4 ASCII bytes, or one non-ASCII
+     * character (e.g. CJK), per token.
+     */
+    static uint32_t estimate_tokens(std::string_view text);
+
+  private:
+    struct Block;
+    struct Tip;
+    struct Spine;
+
+    History(std::shared_ptr<const Spine> spine, size_t size)
+        : spine_(std::move(spine)), size_(size) {}
+
+    Entry at(size_t index, Pinned *pinned) const;
+
+    // A storage for appending to this version that shares its messages.
+    History branch() const;
+
+    // Copies the messages of this version into fresh storage.
+    History rebuild() const;
+
+    std::shared_ptr<const Spine> spine_;
+    size_t size_ = 0;
+};
+
+// 代表一次完整的会话
+struct Conversation {
+    History history;     // 问答历史
+    Rope context;        // 临时上下文
+    // 会话特定的配置将通过 ConfigManager 获取
+};
+
+} // namespace fusellm
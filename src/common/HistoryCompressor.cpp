@@ -0,0 +1,226 @@
+#include "HistoryCompressor.h"
+#include "spdlog/spdlog.h"
+#include <stdexcept>
+#include <zdict.h>
+#include <zstd.h>
+
+namespace fusellm {
+
+namespace {
+
+// 训练样本按此大小切分；ZDICT 要求每个样本远小于字典
+constexpr size_t SAMPLE_PIECE = 4 << 10;
+
+// 压缩后至少省下 1/8 才值得，否则块保持原样
+bool worth_it(size_t stored, size_t raw) { return stored <= raw - raw / 8; }
+
+// 每个线程复用一个 zstd 上下文，避免每个块都重新分配
+struct Contexts {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    ~Contexts() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+Contexts &contexts() {
+    thread_local Contexts ctx;
+    return ctx;
+}
+
+} // namespace
+
+class HistoryCompressor::Dictionary {
+  public:
+    Dictionary(const std::string &content, int level)
+        : cdict(ZSTD_createCDict(content.data(), content.size(), level)),
+          ddict(ZSTD_createDDict(content.data(), content.size())),
+          bytes(content.size()) {}
+    ~Dictionary() {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+    }
+
+    ZSTD_CDict *const cdict;
+    ZSTD_DDict *const ddict;
+    const size_t bytes;
+};
+
+HistoryCompressor::Frame::Frame(std::shared_ptr<HistoryCompressor> owner,
+                                std::string data, size_t raw_size,
+                                std::shared_ptr<const Dictionary> dictionary)
+    : owner_(std::move(owner)), id_(owner_->next_id_.fetch_add(1)),
+      data_(std::move(data)), raw_size_(raw_size),
+      dictionary_(std::move(dictionary)) {
+    owner_->frames_.fetch_add(1, std::memory_order_relaxed);
+    owner_->raw_bytes_.fetch_add(raw_size_, std::memory_order_relaxed);
+    owner_->compressed_bytes_.fetch_add(data_.size(),
+                                        std::memory_order_relaxed);
+}
+
+HistoryCompressor::Frame::~Frame() { owner_->release(*this); }
+
+std::shared_ptr<const std::string> HistoryCompressor::Frame::load() const {
+    return owner_->load(*this);
+}
+
+HistoryCompressor::HistoryCompressor(Options options) : options_(options) {}
+
+HistoryCompressor::~HistoryCompressor() { wait_for_training(); }
+
+std::shared_ptr<const HistoryCompressor::Frame>
+HistoryCompressor::compress(std::string_view raw) {
+    if (raw.empty()) {
+        return nullptr;
+    }
+    auto dictionary = std::atomic_load(&dictionary_);
+    if (!dictionary) {
+        sample(raw);
+        dictionary = std::atomic_load(&dictionary_);
+    }
+
+    std::string out(ZSTD_compressBound(raw.size()), '\0');
+    Contexts &ctx = contexts();
+    size_t n = dictionary
+                   ? ZSTD_compress_usingCDict(ctx.cctx, out.data(), out.size(),
+                                              raw.data(), raw.size(),
+                                              dictionary->cdict)
+                   : ZSTD_compressCCtx(ctx.cctx, out.data(), out.size(),
+                                       raw.data(), raw.size(), options_.level);
+    if (ZSTD_isError(n) || !worth_it(n, raw.size())) {
+        return nullptr;
+    }
+    out.resize(n);
+    out.shrink_to_fit();
+    return std::make_shared<const Frame>(shared_from_this(), std::move(out),
+                                         raw.size(), std::move(dictionary));
+}
+
+std::shared_ptr<const std::string>
+HistoryCompressor::load(const Frame &frame) {
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        auto it = cache_.find(frame.id_);
+        if (it != cache_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            cache_hits_++;
+            return it->second->body;
+        }
+        cache_misses_++;
+    }
+
+    auto body = std::make_shared<std::string>(frame.raw_size_, '\0');
+    Contexts &ctx = contexts();
+    size_t n = frame.dictionary_
+                   ? ZSTD_decompress_usingDDict(
+                         ctx.dctx, body->data(), body->size(),
+                         frame.data_.data(), frame.data_.size(),
+                         frame.dictionary_->ddict)
+                   : ZSTD_decompressDCtx(ctx.dctx, body->data(), body->size(),
+                                         frame.data_.data(),
+                                         frame.data_.size());
+    if (ZSTD_isError(n) || n != frame.raw_size_) {
+        throw std::runtime_error("Corrupt compressed history block");
+    }
+
+    std::shared_ptr<const std::string> result = std::move(body);
+    if (frame.raw_size_ > options_.cache_bytes) {
+        return result;
+    }
+    std::lock_guard<std::mutex> lock(cache_mtx_);
+    if (cache_.count(frame.id_)) {
+        return result; // Another reader got here first
+    }
+    lru_.push_front(Cached{frame.id_, result});
+    cache_.emplace(frame.id_, lru_.begin());
+    cache_bytes_ += frame.raw_size_;
+    while (cache_bytes_ > options_.cache_bytes) {
+        cache_bytes_ -= lru_.back().body->size();
+        cache_.erase(lru_.back().id);
+        lru_.pop_back();
+    }
+    return result;
+}
+
+void HistoryCompressor::release(const Frame &frame) {
+    frames_.fetch_sub(1, std::memory_order_relaxed);
+    raw_bytes_.fetch_sub(frame.raw_size_, std::memory_order_relaxed);
+    compressed_bytes_.fetch_sub(frame.data_.size(), std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(cache_mtx_);
+    auto it = cache_.find(frame.id_);
+    if (it != cache_.end()) {
+        cache_bytes_ -= it->second->body->size();
+        lru_.erase(it->second);
+        cache_.erase(it);
+    }
+}
+
+void HistoryCompressor::sample(std::string_view raw) {
+    std::lock_guard<std::mutex> lock(training_mtx_);
+    if (trained_) {
+        return;
+    }
+    for (size_t pos = 0; pos < raw.size() &&
+                         samples_.size() < options_.training_bytes;
+         pos += SAMPLE_PIECE) {
+        auto piece = raw.substr(pos, SAMPLE_PIECE);
+        samples_.append(piece);
+        sample_sizes_.push_back(piece.size());
+    }
+    if (samples_.size() < options_.training_bytes) {
+        return;
+    }
+
+    // Runs once per process. ZDICT takes a while on a full sample set, so
+    // it runs on its own thread instead of the writer that completed it;
+    // blocks compressed meanwhile simply go without the dictionary.
+    trained_ = true;
+    trainer_ = std::thread(&HistoryCompressor::train, this, std::move(samples_),
+                           std::move(sample_sizes_));
+    samples_ = std::string();
+    sample_sizes_ = std::vector<size_t>();
+}
+
+void HistoryCompressor::train(std::string samples, std::vector<size_t> sizes) {
+    std::string content(options_.dictionary_bytes, '\0');
+    size_t n = ZDICT_trainFromBuffer(content.data(), content.size(),
+                                     samples.data(), sizes.data(),
+                                     static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(n)) {
+        SPDLOG_WARN("Could not train a history dictionary ({}); compressing "
+                    "without one.",
+                    ZDICT_getErrorName(n));
+        return;
+    }
+    content.resize(n);
+    std::atomic_store(&dictionary_, std::shared_ptr<const Dictionary>(
+                                        std::make_shared<const Dictionary>(
+                                            content, options_.level)));
+    SPDLOG_INFO("Trained a {} byte dictionary for compressing history.", n);
+}
+
+void HistoryCompressor::wait_for_training() {
+    std::lock_guard<std::mutex> lock(training_mtx_);
+    if (trainer_.joinable()) {
+        trainer_.join();
+    }
+}
+
+HistoryCompressor::Stats HistoryCompressor::stats() const {
+    Stats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+    stats.compressed_bytes = compressed_bytes_.load(std::memory_order_relaxed);
+    if (auto dictionary = std::atomic_load(&dictionary_)) {
+        stats.dictionary_bytes = dictionary->bytes;
+    }
+    std::lock_guard<std::mutex> lock(cache_mtx_);
+    stats.cache_bytes = cache_bytes_;
+    stats.cache_hits = cache_hits_;
+    stats.cache_misses = cache_misses_;
+    return stats;
+}
+
+} // namespace fusellm
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class HistoryCompressor
+ * @brief Compresses cold message bodies of History objects with zstd and
+ * decompresses them on demand.
+ *
+ * One compressor is shared by all sessions. The bodies it compresses first
+ * are kept as training samples; once enough have been collected, a zstd
+ * dictionary is trained from them on a background thread and used for every
+ * block compressed after it is ready, which is what makes small blocks of
+ * chat text compress well. Blocks compressed before that keep working
+ * without it.
+ *
+ * Decompressed blocks are kept in a small LRU cache, since a conversation's
+ * whole history is read again on every turn. Cache entries are shared
+ * pointers, so evicting one never invalidates a body that is still in use.
+ *
+ * This class is thread-safe. Create it with std::make_shared; frames keep
+ * their compressor alive.
+ */
+class HistoryCompressor
+    : public std::enable_shared_from_this<HistoryCompressor> {
+  public:
+    struct Options {
+        // Messages of the most recent turns (user + AI) stay uncompressed.
+        size_t keep_turns = 16;
+        int level = 3;
+        size_t dictionary_bytes = 16 << 10;
+        // Sample bytes collected before the dictionary is trained.
+        size_t training_bytes = 1 << 20;
+        // Upper bound of the decompressed-block cache.
+        size_t cache_bytes = 8 << 20;
+    };
+
+    struct Stats {
+        uint64_t frames = 0;           // Live compressed blocks
+        uint64_t raw_bytes = 0;        // Their size before compression
+        uint64_t compressed_bytes = 0; // Their size now
+        uint64_t dictionary_bytes = 0; // 0 until the dictionary is trained
+        uint64_t cache_bytes = 0;      // Decompressed blocks cached
+        uint64_t cache_hits = 0;
+        uint64_t cache_misses = 0;
+    };
+
+    class Dictionary;
+
+    /**
+     * @brief One compressed block. Immutable; releases its accounting when
+     * destroyed.
+     */
+    class Frame {
+      public:
+        Frame(std::shared_ptr<HistoryCompressor> owner, std::string data,
+              size_t raw_size, std::shared_ptr<const Dictionary> dictionary);
+        ~Frame();
+
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+
+        size_t raw_size() const { return raw_size_; }
+        size_t stored_bytes() const { return sizeof(Frame) + data_.size(); }
+
+        /**
+         * @brief The decompressed block, from the cache if possible. Never
+         * null; throws std::runtime_error if the block is corrupt.
+         */
+        std::shared_ptr<const std::string> load() const;
+
+      private:
+        friend class HistoryCompressor;
+
+        const std::shared_ptr<HistoryCompressor> owner_;
+        const uint64_t id_;
+        const std::string data_;
+        const size_t raw_size_;
+        const std::shared_ptr<const Dictionary> dictionary_;
+    };
+
+    explicit HistoryCompressor(Options options);
+    ~HistoryCompressor();
+
+    HistoryCompressor(const HistoryCompressor &) = delete;
+    HistoryCompressor &operator=(const HistoryCompressor &) = delete;
+
+    /**
+     * @brief Number of most recent messages never compressed.
+     */
+    size_t keep_messages() const { return options_.keep_turns * 2; }
+
+    /**
+     * @brief Compresses one block of message bodies.
+     * @return Null if compression does not pay off (or fails); the block
+     * should then stay as it is.
+     */
+    std::shared_ptr<const Frame> compress(std::string_view raw);
+
+    Stats stats() const;
+
+    /**
+     * @brief Waits for a dictionary being trained in the background. Used
+     * by tests; the destructor also waits.
+     */
+    void wait_for_training();
+
+  private:
+    std::shared_ptr<const std::string> load(const Frame &frame);
+    void release(const Frame &frame);
+
+    // Keeps `raw` as training samples and starts training the dictionary
+    // once there are enough of them.
+    void sample(std::string_view raw);
+
+    // Trains the dictionary from `samples` and publishes it. Runs on
+    // trainer_.
+    void train(std::string samples, std::vector<size_t> sizes);
+
+    const Options options_;
+
+    std::atomic<uint64_t> next_id_{1};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> raw_bytes_{0};
+    std::atomic<uint64_t> compressed_bytes_{0};
+
+    // Null until trained. Accessed only through std::atomic_load/store.
+    std::shared_ptr<const Dictionary> dictionary_;
+
+    std::mutex training_mtx_; // Guards the samples and trainer_
+    std::string samples_;
+    std::vector<size_t> sample_sizes_;
+    bool trained_ = false; // Training started, or given up on
+    std::thread trainer_;
+
+    // LRU cache of decompressed blocks, most recently used first.
+    struct Cached {
+        uint64_t id;
+        std::shared_ptr<const std::string> body;
+    };
+    mutable std::mutex cache_mtx_;
+    std::list<Cached> lru_;
+    std::unordered_map<uint64_t, std::list<Cached>::iterator> cache_;
+    size_t cache_bytes_ = 0;
+    uint64_t cache_hits_ = 0;
+    uint64_t cache_misses_ = 0;
+};
+
+} // namespace fusellm
@@ -0,0 +1,334 @@
+#include "Rope.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace fusellm {
+
+namespace {
+
+// 追加写入的缓冲区从 4 KiB 翻倍增长到 256 KiB；更大的单次写入独占一个缓冲区
+constexpr size_t MIN_BUFFER = 4 << 10;
+constexpr size_t MAX_BUFFER = 256 << 10;
+// 每个叶子最多容纳的片段数；追加只复制最后一个叶子和叶子索引
+constexpr size_t MAX_LEAF = 64;
+// 文件空洞按块补零
+constexpr size_t ZERO_BLOCK = 64 << 10;
+
+} // namespace
+
+// Bytes shared by the pieces of many versions. Appends claim the spare
+// room at the end; claimed bytes are never written again.
+struct Rope::Buffer {
+    explicit Buffer(size_t capacity)
+        : data(new char[capacity]), begin(data.get()), capacity(capacity),
+          used(0) {}
+    explicit Buffer(Blob text)
+        : blob(std::move(text)), begin(blob.data()), capacity(blob.size()),
+          used(capacity) {}
+
+    std::unique_ptr<char[]> data; // Only for buffers appends go to
+    Blob blob;
+    const char *begin;
+    const size_t capacity;
+    std::atomic<size_t> used; // Bytes claimed by some version
+};
+
+struct Rope::Piece {
+    std::string_view view() const {
+        return std::string_view(buffer->begin + offset, length);
+    }
+
+    std::shared_ptr<Buffer> buffer;
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+// A run of pieces; ends[i] is the byte offset, within the leaf, just past
+// piece i.
+struct Rope::Leaf {
+    std::vector<Piece> pieces;
+    std::vector<size_t> ends;
+};
+
+// Never modified once published; every change builds a new tree that
+// shares the untouched leaves.
+struct Rope::Tree {
+    std::vector<std::shared_ptr<const Leaf>> leaves;
+    std::vector<size_t> ends; // Byte offset just past each leaf
+};
+
+namespace {
+
+// Where a byte offset falls: leaf, piece within the leaf, byte within the
+// piece. `offset` must be less than the size of the tree.
+template <typename Tree> struct Position {
+    Position(const Tree &tree, size_t offset) {
+        leaf = static_cast<size_t>(
+            std::upper_bound(tree.ends.begin(), tree.ends.end(), offset) -
+            tree.ends.begin());
+        offset -= leaf ? tree.ends[leaf - 1] : 0;
+        const auto &ends = tree.leaves[leaf]->ends;
+        piece = static_cast<size_t>(
+            std::upper_bound(ends.begin(), ends.end(), offset) - ends.begin());
+        byte = offset - (piece ? ends[piece - 1] : 0);
+    }
+
+    size_t leaf;
+    size_t piece;
+    size_t byte;
+};
+
+} // namespace
+
+Rope::Rope(Blob text) {
+    if (text.empty()) {
+        return;
+    }
+    size_ = text.size();
+    auto leaf = std::make_shared<Leaf>();
+    leaf->pieces.push_back(
+        Piece{std::make_shared<Buffer>(std::move(text)), 0, size_});
+    leaf->ends.push_back(size_);
+    auto tree = std::make_shared<Tree>();
+    tree->leaves.push_back(std::move(leaf));
+    tree->ends.push_back(size_);
+    tree_ = std::move(tree);
+}
+
+Rope Rope::from_pieces(std::vector<Piece> pieces) {
+    auto tree = std::make_shared<Tree>();
+    std::shared_ptr<Leaf> leaf;
+    size_t size = 0;
+    auto seal = [&] {
+        if (leaf) {
+            tree->ends.push_back(size);
+            tree->leaves.push_back(std::move(leaf));
+        }
+    };
+    for (auto &piece : pieces) {
+        if (piece.length == 0) {
+            continue;
+        }
+        size += piece.length;
+        if (leaf) {
+            // Neighbours that were split by an overwrite join up again.
+            Piece &prev = leaf->pieces.back();
+            if (prev.buffer == piece.buffer &&
+                prev.offset + prev.length == piece.offset) {
+                prev.length += piece.length;
+                leaf->ends.back() += piece.length;
+                continue;
+            }
+            if (leaf->pieces.size() == MAX_LEAF) {
+                seal();
+            }
+        }
+        if (!leaf) {
+            leaf = std::make_shared<Leaf>();
+            leaf->pieces.reserve(MAX_LEAF);
+        }
+        const size_t start = leaf->ends.empty() ? 0 : leaf->ends.back();
+        leaf->ends.push_back(start + piece.length);
+        leaf->pieces.push_back(std::move(piece));
+    }
+    seal();
+    if (size == 0) {
+        return Rope();
+    }
+    return Rope(std::move(tree), size);
+}
+
+Rope Rope::append_bytes(std::string_view data) const {
+    if (data.empty()) {
+        return *this;
+    }
+    const size_t n = data.size();
+    auto tree = tree_ ? std::make_shared<Tree>(*tree_) : std::make_shared<Tree>();
+
+    size_t capacity = MIN_BUFFER;
+    if (!tree->leaves.empty()) {
+        const Leaf &last = *tree->leaves.back();
+        const Piece &tail = last.pieces.back();
+        Buffer &buffer = *tail.buffer;
+        size_t end = tail.offset + tail.length;
+        // Only the version that owns the end of the buffer may extend it.
+        if (buffer.data && buffer.capacity - end >= n &&
+            buffer.used.compare_exchange_strong(end, end + n)) {
+            std::memcpy(buffer.data.get() + end, data.data(), n);
+            auto leaf = std::make_shared<Leaf>(last);
+            leaf->pieces.back().length += n;
+            leaf->ends.back() += n;
+            tree->leaves.back() = std::move(leaf);
+            tree->ends.back() += n;
+            return Rope(std::move(tree), size_ + n);
+        }
+        if (buffer.data) {
+            capacity = std::min(buffer.capacity * 2, MAX_BUFFER);
+        }
+    }
+
+    auto buffer = std::make_shared<Buffer>(std::max(capacity, n));
+    std::memcpy(buffer->data.get(), data.data(), n);
+    buffer->used = n;
+    Piece piece{std::move(buffer), 0, n};
+
+    if (tree->leaves.empty() || tree->leaves.back()->pieces.size() >= MAX_LEAF) {
+        auto leaf = std::make_shared<Leaf>();
+        leaf->pieces.reserve(MAX_LEAF);
+        leaf->pieces.push_back(std::move(piece));
+        leaf->ends.push_back(n);
+        tree->leaves.push_back(std::move(leaf));
+        tree->ends.push_back(size_ + n);
+    } else {
+        auto leaf = std::make_shared<Leaf>(*tree->leaves.back());
+        leaf->pieces.push_back(std::move(piece));
+        leaf->ends.push_back(leaf->ends.back() + n);
+        tree->leaves.back() = std::move(leaf);
+        tree->ends.back() += n;
+    }
+    return Rope(std::move(tree), size_ + n);
+}
+
+Rope Rope::append_zeros(size_t count) const {
+    static const char zeros[ZERO_BLOCK] = {};
+    Rope result = *this;
+    while (count > 0) {
+        const size_t n = std::min(count, ZERO_BLOCK);
+        result = result.append_bytes(std::string_view(zeros, n));
+        count -= n;
+    }
+    return result;
+}
+
+Rope Rope::write(size_t offset, std::string_view data) const {
+    if (data.empty()) {
+        return *this;
+    }
+    if (offset > size_) {
+        return append_zeros(offset - size_).append_bytes(data);
+    }
+    if (offset == size_) {
+        return append_bytes(data);
+    }
+    // Overwrite: the new bytes get a buffer of their own, and the pieces
+    // around them are reused as they are.
+    std::vector<Piece> pieces;
+    collect(0, offset, pieces);
+    Rope().append_bytes(data).collect(0, data.size(), pieces);
+    collect(std::min(offset + data.size(), size_), size_, pieces);
+    return from_pieces(std::move(pieces));
+}
+
+Rope Rope::truncate(size_t size) const {
+    if (size >= size_) {
+        return append_zeros(size - size_);
+    }
+    if (size == 0) {
+        return Rope();
+    }
+    const Position<Tree> end(*tree_, size - 1);
+    auto tree = std::make_shared<Tree>();
+    tree->leaves.assign(tree_->leaves.begin(), tree_->leaves.begin() + end.leaf);
+    tree->ends.assign(tree_->ends.begin(), tree_->ends.begin() + end.leaf);
+
+    const Leaf &old = *tree_->leaves[end.leaf];
+    auto leaf = std::make_shared<Leaf>();
+    leaf->pieces.assign(old.pieces.begin(), old.pieces.begin() + end.piece + 1);
+    leaf->ends.assign(old.ends.begin(), old.ends.begin() + end.piece + 1);
+    leaf->pieces.back().length = end.byte + 1;
+    leaf->ends.back() =
+        (end.piece ? old.ends[end.piece - 1] : 0) + end.byte + 1;
+    tree->ends.push_back(size);
+    tree->leaves.push_back(std::move(leaf));
+    return Rope(std::move(tree), size);
+}
+
+void Rope::collect(size_t begin, size_t end, std::vector<Piece> &out) const {
+    if (begin >= end) {
+        return;
+    }
+    const Position<Tree> pos(*tree_, begin);
+    size_t remaining = end - begin;
+    size_t skip = pos.byte;
+    for (size_t l = pos.leaf; remaining > 0; l++) {
+        const Leaf &leaf = *tree_->leaves[l];
+        for (size_t p = l == pos.leaf ? pos.piece : 0;
+             p < leaf.pieces.size() && remaining > 0; p++) {
+            Piece piece = leaf.pieces[p];
+            piece.offset += skip;
+            piece.length = std::min(piece.length - skip, remaining);
+            remaining -= piece.length;
+            skip = 0;
+            out.push_back(std::move(piece));
+        }
+    }
+}
+
+size_t Rope::read(size_t offset, char *out, size_t count) const {
+    if (offset >= size_ || count == 0) {
+        return 0;
+    }
+    count = std::min(count, size_ - offset);
+    const Position<Tree> pos(*tree_, offset);
+    size_t copied = 0;
+    size_t skip = pos.byte;
+    for (size_t l = pos.leaf; copied < count; l++) {
+        const Leaf &leaf = *tree_->leaves[l];
+        for (size_t p = l == pos.leaf ? pos.piece : 0;
+             p < leaf.pieces.size() && copied < count; p++) {
+            std::string_view bytes = leaf.pieces[p].view().substr(skip);
+            const size_t n = std::min(bytes.size(), count - copied);
+            std::memcpy(out + copied, bytes.data(), n);
+            copied += n;
+            skip = 0;
+        }
+    }
+    return copied;
+}
+
+std::string Rope::str() const {
+    std::string text(size_, '\0');
+    read(0, text.data(), size_);
+    return text;
+}
+
+size_t Rope::pieces() const {
+    size_t count = 0;
+    if (tree_) {
+        for (const auto &leaf : tree_->leaves) {
+            count += leaf->pieces.size();
+        }
+    }
+    return count;
+}
+
+size_t Rope::memory_bytes() const {
+    if (!tree_) {
+        return 0;
+    }
+    return sizeof(Tree) + size_ +
+           tree_->leaves.size() * (sizeof(Leaf) + 2 * sizeof(size_t)) +
+           pieces() * (sizeof(Piece) + sizeof(size_t) + sizeof(Buffer));
+}
+
+bool Rope::equals(std::string_view text) const {
+    if (text.size() != size_) {
+        return false;
+    }
+    if (!tree_) {
+        return true;
+    }
+    size_t at = 0;
+    for (const auto &leaf : tree_->leaves) {
+        for (const auto &piece : leaf->pieces) {
+            if (text.substr(at, piece.length) != piece.view()) {
+                return false;
+            }
+            at += piece.length;
+        }
+    }
+    return true;
+}
+
+} // namespace fusellm
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "BlobStore.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class Rope
+ * @brief An immutable, cheaply copyable byte string built for file-style
+ * writes: appends, overwrites at an offset and truncation.
+ *
+ * The bytes live in a list of pieces, each a slice of a shared buffer, and
+ * the pieces are grouped into leaves of bounded size. Like History, versions
+ * derived from one another share storage: appending to a version copies
+ * only the leaf it ends in and the leaf index, and small appends are packed
+ * into the spare room of the last buffer when no other version has claimed
+ * it. Appending a large document in page-sized writes is therefore linear
+ * in its size. Overwriting inside the text keeps the bytes of every
+ * untouched piece and only rebuilds the piece list.
+ *
+ * A Rope made from a Blob shares it, so a context set in one write is still
+ * stored once across sessions (see BlobStore).
+ *
+ * Reads are lock-free. Deriving versions concurrently from one Rope is safe.
+ */
+class Rope {
+  public:
+    Rope() = default;
+    explicit Rope(Blob text);
+    explicit Rope(std::string_view text) : Rope(Blob(text)) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * @brief Returns a copy with `data` written at `offset`, as pwrite(2)
+     * would: bytes past the end are appended, and a gap between the end and
+     * `offset` reads as zeros. Writing nothing changes nothing.
+     */
+    Rope write(size_t offset, std::string_view data) const;
+
+    Rope append(std::string_view data) const { return write(size_, data); }
+
+    /**
+     * @brief Returns a copy cut or zero-extended to `size` bytes.
+     */
+    Rope truncate(size_t size) const;
+
+    /**
+     * @brief Copies up to `count` bytes starting at `offset` into `out`.
+     * @return The number of bytes copied; 0 at or past the end.
+     */
+    size_t read(size_t offset, char *out, size_t count) const;
+
+    // The whole text as one string.
+    std::string str() const;
+
+    // Pieces the text is split into.
+    size_t pieces() const;
+
+    // Heap bytes referenced by this version, counting shared bytes in full.
+    size_t memory_bytes() const;
+
+    // Whether both are the same version of the same storage.
+    bool same_as(const Rope &other) const {
+        return tree_ == other.tree_ && size_ == other.size_;
+    }
+
+    friend bool operator==(const Rope &a, std::string_view b) {
+        return a.equals(b);
+    }
+
+  private:
+    struct Buffer;
+    struct Piece;
+    struct Leaf;
+    struct Tree;
+
+    Rope(std::shared_ptr<const Tree> tree, size_t size)
+        : tree_(std::move(tree)), size_(size) {}
+
+    static Rope from_pieces(std::vector<Piece> pieces);
+    Rope append_bytes(std::string_view data) const;
+    Rope append_zeros(size_t count) const;
+    void collect(size_t begin, size_t end, std::vector<Piece> &out) const;
+    bool equals(std::string_view text) const;
+
+    std::shared_ptr<const Tree> tree_;
+    size_t size_ = 0;
+};
+
+} // namespace fusellm
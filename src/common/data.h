@@ -20,14 +20,6 @@ struct Message {
     std::chrono::system_clock::time_point timestamp;
 };
 
-// 代表一次完整的会话
-struct Conversation {
-    // std::string id;
-    std::vector<Message> history; // 问答历史
-    std::string context;          // 临时上下文
-    // 会话特定的配置将通过 ConfigManager 获取
-};
-
 // 代表语义搜索的结果
 struct SearchResult {
     float score;
@@ -1,32 +1,82 @@
 #include "ConfigManager.h"
 #include "spdlog/spdlog.h"
 #include "src/common/utils.hpp"
+#include <algorithm>
+#include <cstdlib>
 
 namespace fusellm {
 
-// --- ModelParameters Implementation ---
+namespace {
 
-void ModelParameters::merge(const toml::table &tbl) {
-    if (auto temp_node = tbl["temperature"];
-        temp_node && temp_node.is_number()) {
-        temperature = temp_node.value<double>();
+// $XDG_CACHE_HOME/fusellm/models.json, falling back to ~/.cache and /tmp.
+std::string default_model_cache_path() {
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::string(xdg) + "/fusellm/models.json";
     }
-    if (auto prompt_node = tbl["system_prompt"];
-        prompt_node && prompt_node.is_string()) {
-        system_prompt = prompt_node.value<std::string>();
+    if (const char *home = std::getenv("HOME"); home && *home) {
+        return std::string(home) + "/.cache/fusellm/models.json";
     }
-    // Add merging for other parameters here.
+    return "/tmp/fusellm-models.json";
 }
 
-void ModelParameters::merge(const ModelParameters &other) {
-    // Only override if the other parameter has a value
-    if (other.temperature) {
-        temperature = other.temperature;
+// $XDG_STATE_HOME/fusellm/sessions, falling back to ~/.local/state.
+std::string default_state_dir() {
+    if (const char *xdg = std::getenv("XDG_STATE_HOME"); xdg && *xdg) {
+        return std::string(xdg) + "/fusellm/sessions";
     }
-    if (other.system_prompt) {
-        system_prompt = other.system_prompt;
+    if (const char *home = std::getenv("HOME"); home && *home) {
+        return std::string(home) + "/.local/state/fusellm/sessions";
     }
-    // Add merging for other parameters here as they are added
+    return "/tmp/fusellm-sessions";
+}
+
+// An optional parameter as shown in the reload log.
+template <typename T> std::string describe(const std::optional<T> &value) {
+    return value ? strutil::to_string(*value) : std::string("unset");
+}
+
+std::string describe(const std::optional<Blob> &value) {
+    return value ? std::to_string(value->size()) + " bytes"
+                 : std::string("unset");
+}
+
+std::string describe(const std::optional<StopList> &value) {
+    if (!value) {
+        return "unset";
+    }
+    std::vector<std::string> quoted;
+    for (const auto &s : *value) {
+        quoted.push_back("'" + s + "'");
+    }
+    return "[" + strutil::join(quoted, ", ") + "]";
+}
+
+// Appends "key: before -> after" to `changes` if the values differ.
+template <typename T>
+void note_change(std::vector<std::string> &changes, std::string_view key,
+                 const T &before, const T &after) {
+    if (!(before == after)) {
+        changes.push_back(std::string(key) + ": " + describe(before) + " -> " +
+                          describe(after));
+    }
+}
+
+void note_change(std::vector<std::string> &changes, std::string_view key,
+                 const std::string &before, const std::string &after) {
+    if (before != after) {
+        changes.push_back(std::string(key) + ": '" + before + "' -> '" +
+                          after + "'");
+    }
+}
+
+} // namespace
+
+// --- ConfigSnapshot Implementation ---
+
+const ModelParameters &
+ConfigSnapshot::params_for(std::string_view model_name) const {
+    auto it = model_params.find(model_name);
+    return it != model_params.end() ? it->second : global_params;
 }
 
 // --- ConfigManager Implementation ---
@@ -34,10 +84,42 @@ void ModelParameters::merge(const ModelParameters &other) {
 ConfigManager::ConfigManager()
     // Initialize with hardcoded defaults, which will be overridden by the
     // config file.
-    : default_model_("deepseek-v3"),
-      semantic_search_service_url_("ipc:///tmp/fusellm-semantic.ipc") {
+    : semantic_search_service_url_("ipc:///tmp/fusellm-semantic.ipc"),
+      model_cache_path_(default_model_cache_path()),
+      state_dir_(default_state_dir()), default_model_("deepseek-v3") {
     // The global_params_ starts with all its std::optional members as
     // std::nullopt.
+    std::lock_guard<std::mutex> lock(mtx_);
+    publish_locked();
+}
+
+void ConfigManager::publish_locked() {
+    auto next = std::make_shared<ConfigSnapshot>();
+    next->epoch = epoch_.load(std::memory_order_relaxed) + 1;
+    next->default_model = default_model_;
+    next->api_key = api_key_;
+    next->base_url = base_url_;
+    next->global_params = global_params_;
+    for (const auto &[model, params] : model_specific_params_) {
+        ModelParameters effective = global_params_;
+        effective.merge(params);
+        next->model_params.emplace(model, std::move(effective));
+    }
+    const uint64_t epoch = next->epoch;
+    std::atomic_store(&snapshot_,
+                      std::shared_ptr<const ConfigSnapshot>(std::move(next)));
+    // Published after the snapshot: whoever sees the new epoch finds a
+    // snapshot at least that new.
+    epoch_.store(epoch, std::memory_order_release);
+}
+
+void ConfigManager::set_default_model(std::string_view model_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (default_model_ == model_name) {
+        return;
+    }
+    default_model_ = model_name;
+    publish_locked();
 }
 
 bool ConfigManager::load_from_file(std::string_view path) {
@@ -51,12 +133,107 @@ bool ConfigManager::load_from_file(std::string_view path) {
         return false;
     }
 
+    load_table(tbl, path);
+    config_path_ = path;
+
+    SPDLOG_INFO("Successfully loaded configuration from '{}'.", path);
+    return true;
+}
+
+void ConfigManager::load_table(const toml::table &tbl, std::string_view path) {
     // Load top-level settings
-    default_model_ = tbl["default_model"].value_or("deepseek-v3");
-    api_key_ = tbl["api_key"].value_or("");
-    base_url_ = tbl["base_url"].value_or("");
-    if (not strutil::ends_with(base_url_, "/")) {
-        base_url_ += "/";
+    std::string default_model = tbl["default_model"].value_or("deepseek-v3");
+    std::string api_key = tbl["api_key"].value_or("");
+    std::string base_url = tbl["base_url"].value_or("");
+    if (not strutil::ends_with(base_url, "/")) {
+        base_url += "/";
+    }
+
+    // Load model discovery settings
+    if (auto *models_arr = tbl["models"].as_array()) {
+        static_models_.clear();
+        for (const auto &model : *models_arr) {
+            if (auto name = model.value<std::string>()) {
+                static_models_.push_back(*name);
+            }
+        }
+    }
+    model_cache_path_ = tbl["model_cache"].value_or(model_cache_path_);
+    model_refresh_interval_s_ =
+        tbl["model_refresh_interval_s"].value_or(model_refresh_interval_s_);
+    if (model_refresh_interval_s_ < 60) {
+        SPDLOG_WARN("'model_refresh_interval_s' must be at least 60, using 60.");
+        model_refresh_interval_s_ = 60;
+    }
+
+    // Load session persistence settings
+    if (auto *persistence_tbl = tbl["persistence"].as_table()) {
+        state_dir_ = (*persistence_tbl)["state_dir"].value_or(state_dir_);
+        snapshot_interval_s_ = (*persistence_tbl)["snapshot_interval_s"].value_or(
+            snapshot_interval_s_);
+        if (snapshot_interval_s_ < 10) {
+            SPDLOG_WARN("'snapshot_interval_s' must be at least 10, using 10.");
+            snapshot_interval_s_ = 10;
+        }
+        int64_t segment_mb = (*persistence_tbl)["wal_segment_mb"].value_or(
+            wal_segment_bytes_ >> 20);
+        wal_segment_bytes_ = std::max<int64_t>(segment_mb, 1) << 20;
+
+        session_backend_ =
+            (*persistence_tbl)["backend"].value_or(session_backend_);
+        if (session_backend_ != "wal" && session_backend_ != "redis") {
+            SPDLOG_WARN("Unknown persistence backend '{}', using 'wal'.",
+                        session_backend_);
+            session_backend_ = "wal";
+        }
+        redis_url_ = (*persistence_tbl)["redis_url"].value_or(redis_url_);
+        redis_prefix_ =
+            (*persistence_tbl)["redis_prefix"].value_or(redis_prefix_);
+        session_cache_capacity_ = std::max<int64_t>(
+            (*persistence_tbl)["cache_sessions"].value_or(
+                session_cache_capacity_),
+            0);
+        int64_t budget_mb = (*persistence_tbl)["memory_budget_mb"].value_or(
+            session_memory_budget_bytes_ >> 20);
+        session_memory_budget_bytes_ = std::max<int64_t>(budget_mb, 0) << 20;
+        spill_dir_ = (*persistence_tbl)["spill_dir"].value_or(spill_dir_);
+    }
+
+    // Load settings for compressing old turns in memory
+    if (auto *history_tbl = tbl["history"].as_table()) {
+        history_compress_after_turns_ = std::max<int64_t>(
+            (*history_tbl)["compress_after_turns"].value_or(
+                history_compress_after_turns_),
+            0);
+        int64_t dictionary_kb = (*history_tbl)["dictionary_kb"].value_or(
+            history_dictionary_bytes_ >> 10);
+        history_dictionary_bytes_ = std::clamp<int64_t>(dictionary_kb, 1, 1024)
+                                    << 10;
+        int64_t cache_mb =
+            (*history_tbl)["cache_mb"].value_or(history_cache_bytes_ >> 20);
+        history_cache_bytes_ = std::max<int64_t>(cache_mb, 0) << 20;
+    }
+
+    // Load settings for the derived views of /conversations
+    if (auto *views_tbl = tbl["views"].as_table()) {
+        recent_sessions_ = std::max<int64_t>(
+            (*views_tbl)["recent"].value_or(recent_sessions_), 0);
+    }
+
+    // Load retention settings for archived /models queries
+    if (auto *archive_tbl = tbl["archive"].as_table()) {
+        archive_enabled_ =
+            (*archive_tbl)["enabled"].value_or(archive_enabled_);
+        archive_max_sessions_ = std::max<int64_t>(
+            (*archive_tbl)["max_sessions"].value_or(archive_max_sessions_), 0);
+        archive_max_age_s_ = std::max<int64_t>(
+            (*archive_tbl)["max_age_s"].value_or(archive_max_age_s_), 0);
+        int64_t max_mb = (*archive_tbl)["max_mb"].value_or(
+            archive_max_bytes_ >> 20);
+        archive_max_bytes_ = std::max<int64_t>(max_mb, 0) << 20;
+        archive_gc_interval_s_ = std::max<int64_t>(
+            (*archive_tbl)["gc_interval_s"].value_or(archive_gc_interval_s_),
+            1);
     }
 
     // Load semantic search settings from its own table
@@ -67,6 +244,10 @@ bool ConfigManager::load_from_file(std::string_view path) {
     }
 
     // Load global default parameters from the [default_config] table
+    std::lock_guard<std::mutex> lock(mtx_);
+    default_model_ = std::move(default_model);
+    api_key_ = std::move(api_key);
+    base_url_ = std::move(base_url);
     if (auto *default_config_tbl = tbl["default_config"].as_table()) {
         if (ModelParameters::validate_model_params_table(*default_config_tbl)) {
             global_params_.merge(*default_config_tbl);
@@ -81,41 +262,146 @@ bool ConfigManager::load_from_file(std::string_view path) {
                 path);
         }
     }
-
-    SPDLOG_INFO("Successfully loaded configuration from '{}'.", path);
-    return true;
+    publish_locked();
 }
 
-bool ModelParameters::validate_model_params_table(const toml::table &tbl) {
-    if (auto temp_node = tbl.get("temperature")) {
-        if (!temp_node->is_number()) {
-            SPDLOG_WARN("Validation failed: 'temperature' must be a number.");
+bool ConfigManager::validate_config_table(const toml::table &tbl) {
+    for (const char *key : {"default_model", "api_key", "base_url"}) {
+        if (auto node = tbl.get(key); node && !node->is_string()) {
+            SPDLOG_WARN("Validation failed: '{}' must be a string.", key);
             return false;
         }
-        auto temp = temp_node->value<double>();
-        if (not temp.has_value() || temp < 0.0 || temp > 2.0) {
-            SPDLOG_WARN("Validation failed: 'temperature' must be between 0.0 "
-                        "and 2.0.");
+    }
+    if (tbl["default_model"].value_or(std::string("x")).empty()) {
+        SPDLOG_WARN("Validation failed: 'default_model' must not be empty.");
+        return false;
+    }
+    if (auto node = tbl.get("models")) {
+        const auto *models = node->as_array();
+        bool valid = models != nullptr;
+        if (valid) {
+            for (const auto &model : *models) {
+                valid = valid && model.is_string();
+            }
+        }
+        if (!valid) {
+            SPDLOG_WARN(
+                "Validation failed: 'models' must be an array of strings.");
             return false;
         }
     }
-
-    if (auto prompt_node = tbl.get("system_prompt")) {
-        if (!prompt_node->is_string()) {
-            SPDLOG_WARN("Validation failed: 'system_prompt' must be a string.");
+    for (const char *key : {"persistence", "history", "views", "archive",
+                            "semantic_search", "default_config"}) {
+        if (auto node = tbl.get(key); node && !node->is_table()) {
+            SPDLOG_WARN("Validation failed: '{}' must be a table.", key);
             return false;
         }
     }
+    if (auto *default_config_tbl = tbl["default_config"].as_table()) {
+        return ModelParameters::validate_model_params_table(
+            *default_config_tbl);
+    }
+    return true;
+}
 
-    for (const auto &[key, _] : tbl) {
-        const auto key_str = std::string(key.str());
-        if (key_str != "temperature" && key_str != "system_prompt") {
-            SPDLOG_WARN(
-                "Validation warning: Unknown configuration key '{}' found.",
-                key_str);
-        }
+bool ConfigManager::reload_from_file(std::string_view path) {
+    toml::table tbl;
+    try {
+        tbl = toml::parse_file(path);
+    } catch (const toml::parse_error &err) {
+        SPDLOG_ERROR("Config file '{}' changed but cannot be parsed, keeping "
+                     "the current configuration:\n{}",
+                     path, err.description());
+        return false;
+    }
+    if (!validate_config_table(tbl)) {
+        SPDLOG_ERROR("Config file '{}' changed but is invalid, keeping the "
+                     "current configuration.",
+                     path);
+        return false;
     }
 
+    // Parse everything aside first; only the model configuration is applied.
+    ConfigManager next;
+    next.load_table(tbl, path);
+
+    auto restart_only = [&](std::string_view key, const auto &before,
+                            const auto &after) {
+        if (!(before == after)) {
+            SPDLOG_WARN("'{}' changed in '{}'; it takes effect after a "
+                        "restart.",
+                        key, path);
+        }
+    };
+    restart_only("models", static_models_, next.static_models_);
+    restart_only("model_cache", model_cache_path_, next.model_cache_path_);
+    restart_only("model_refresh_interval_s", model_refresh_interval_s_,
+                 next.model_refresh_interval_s_);
+    restart_only("persistence.backend", session_backend_,
+                 next.session_backend_);
+    restart_only("persistence.state_dir", state_dir_, next.state_dir_);
+    restart_only("persistence.snapshot_interval_s", snapshot_interval_s_,
+                 next.snapshot_interval_s_);
+    restart_only("persistence.wal_segment_mb", wal_segment_bytes_,
+                 next.wal_segment_bytes_);
+    restart_only("persistence.redis_url", redis_url_, next.redis_url_);
+    restart_only("persistence.redis_prefix", redis_prefix_,
+                 next.redis_prefix_);
+    restart_only("persistence.cache_sessions", session_cache_capacity_,
+                 next.session_cache_capacity_);
+    restart_only("persistence.memory_budget_mb", session_memory_budget_bytes_,
+                 next.session_memory_budget_bytes_);
+    restart_only("persistence.spill_dir", spill_dir_, next.spill_dir_);
+    restart_only("history.compress_after_turns", history_compress_after_turns_,
+                 next.history_compress_after_turns_);
+    restart_only("history.dictionary_kb", history_dictionary_bytes_,
+                 next.history_dictionary_bytes_);
+    restart_only("history.cache_mb", history_cache_bytes_,
+                 next.history_cache_bytes_);
+    restart_only("views.recent", recent_sessions_, next.recent_sessions_);
+    restart_only("archive.enabled", archive_enabled_, next.archive_enabled_);
+    restart_only("archive.max_sessions", archive_max_sessions_,
+                 next.archive_max_sessions_);
+    restart_only("archive.max_age_s", archive_max_age_s_,
+                 next.archive_max_age_s_);
+    restart_only("archive.max_mb", archive_max_bytes_,
+                 next.archive_max_bytes_);
+    restart_only("archive.gc_interval_s", archive_gc_interval_s_,
+                 next.archive_gc_interval_s_);
+    restart_only("semantic_search.service_url", semantic_search_service_url_,
+                 next.semantic_search_service_url_);
+
+    std::vector<std::string> changes;
+    uint64_t epoch = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        note_change(changes, "default_model", default_model_,
+                    next.default_model_);
+        note_change(changes, "base_url", base_url_, next.base_url_);
+        if (api_key_ != next.api_key_) {
+            changes.push_back("api_key: changed"); // Never logged
+        }
+        params::for_each([&](const auto &field) {
+            note_change(changes, "default_config." + std::string(field.name),
+                        global_params_.*field.member,
+                        next.global_params_.*field.member);
+        });
+        if (changes.empty()) {
+            SPDLOG_INFO("Config file '{}' changed; the model configuration "
+                        "is the same.",
+                        path);
+            return true;
+        }
+        // Parameters written to /config/<model>/settings.toml are kept.
+        default_model_ = std::move(next.default_model_);
+        api_key_ = std::move(next.api_key_);
+        base_url_ = std::move(next.base_url_);
+        global_params_ = std::move(next.global_params_);
+        publish_locked();
+        epoch = epoch_.load(std::memory_order_relaxed);
+    }
+    SPDLOG_INFO("Reloaded configuration from '{}' (epoch {}): {}.", path,
+                epoch, strutil::join(changes, ", "));
     return true;
 }
 
@@ -128,6 +414,7 @@ bool ConfigManager::update_model_params(std::string_view model_name,
     std::lock_guard<std::mutex> lock(mtx_);
     // 获取或创建该模型的参数对象，然后合并新设置
     model_specific_params_[std::string(model_name)].merge(tbl);
+    publish_locked();
 
     SPDLOG_INFO("Updated configuration for model '{}'.", model_name);
     return true;
@@ -135,16 +422,8 @@ bool ConfigManager::update_model_params(std::string_view model_name,
 
 ModelParameters
 ConfigManager::get_model_params(std::string_view model_name) const {
-    // 从全局参数开始
-    ModelParameters final_params = global_params_;
-
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = model_specific_params_.find(std::string(model_name));
-    if (it != model_specific_params_.end()) {
-        // 如果有模型专属配置，合并它们（专属配置覆盖全局配置）
-        final_params.merge(it->second);
-    }
-    return final_params;
+    // 快照中已合并好全局参数和模型专属参数
+    return snapshot()->params_for(model_name);
 }
 
 } // namespace fusellm
\ No newline at end of file
@@ -1,49 +1,58 @@
 #pragma once
 
+#include "ModelParameters.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <toml++/toml.hpp>
 #include <unordered_map>
+#include <vector>
 
 namespace fusellm {
 
 /**
- * @struct ModelParameters
- * @brief Represents a set of configurable parameters for an LLM.
- * This structure can be layered (global, model-specific, session-specific).
+ * @struct ConfigSnapshot
+ * @brief One immutable version of the effective model configuration.
+ *
+ * Snapshots are never modified after ConfigManager publishes them, so a
+ * reader holding one sees a consistent configuration without any lock.
  */
-struct ModelParameters {
-    /**
-     * @brief Merges parameters from a TOML table into this object.
-     * @param tbl The TOML table to load settings from.
-     */
-    void merge(const toml::table &tbl);
-    
-    /**
-     * @brief Merges parameters from another ModelParameters object into this one.
-     * Only non-nullopt values from 'other' will override current values.
-     * @param other The other ModelParameters to merge from.
-     */
-    void merge(const ModelParameters &other);
+struct ConfigSnapshot {
+    uint64_t epoch = 0; // Grows by one with every published change
+    std::string default_model;
+    std::string api_key;  // Empty: $OPENAI_API_KEY
+    std::string base_url; // Empty or "/": the OpenAI API
+    ModelParameters global_params;
+    // Effective parameters (global merged with model-specific ones) of the
+    // models that have settings of their own.
+    std::map<std::string, ModelParameters, std::less<>> model_params;
 
     /**
-     * @brief Validates the structure and values of a TOML table containing
-     * model parameters.
-     * @param tbl The TOML table to validate.
-     * @return True if the table is valid, false otherwise.
+     * @brief The effective parameters of `model_name`: its own merged over
+     * the global ones, or just the global ones.
      */
-    static bool validate_model_params_table(const toml::table &tbl);
-
-    std::optional<double> temperature;
-    std::optional<std::string> system_prompt;
-    // Other potential LLM parameters like top_p, max_tokens can be added here.
+    const ModelParameters &params_for(std::string_view model_name) const;
 };
 
 /**
  * @class ConfigManager
  * @brief Manages the overall application and model configurations.
+ *
+ * The model configuration (default model, API endpoint, global and
+ * per-model parameters) is published as an immutable ConfigSnapshot through an atomic shared
+ * pointer. Writers rebuild and republish it under a mutex and bump the
+ * epoch; readers load the current snapshot, or just compare the epoch to
+ * know whether what they resolved from it is still current.
+ *
+ * The other settings are plain fields, set by load_from_file() before the
+ * filesystem is mounted and read-only afterwards; reload_from_file() only
+ * replaces the model configuration.
+ *
  * This class is thread-safe.
  */
 class ConfigManager {
@@ -58,14 +67,86 @@ class ConfigManager {
      */
     bool load_from_file(std::string_view path);
 
+    /**
+     * @brief Re-reads the configuration file after it changed and applies
+     * the model configuration (default model, API key, base URL and
+     * [default_config]) as one new epoch, keeping parameters written to
+     * /config since. Logs what changed; settings that are only read at
+     * startup are reported as needing a restart and left as they are.
+     * @return False, with the current configuration kept, if the file cannot
+     * be parsed or has invalid values.
+     */
+    bool reload_from_file(std::string_view path);
+
+    /**
+     * @brief The current configuration. Never blocks.
+     */
+    std::shared_ptr<const ConfigSnapshot> snapshot() const {
+        return std::atomic_load(&snapshot_);
+    }
+
+    /**
+     * @brief The epoch of the current snapshot. A single atomic load, for
+     * readers that cache what they derive from a snapshot.
+     */
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+    std::string default_model() const { return snapshot()->default_model; }
+    void set_default_model(std::string_view model_name);
+
     // Top-level settings from the global config file.
-    std::string default_model_;
-    std::string api_key_;
-    std::string base_url_;
+    // The file given to load_from_file(), watched for changes; empty if none.
+    std::string config_path_;
     std::string semantic_search_service_url_;
 
-    // Parsed configuration objects.
-    ModelParameters global_params_;
+    // Model discovery settings.
+    // Models to expose before (or without) a successful fetch from the API.
+    std::vector<std::string> static_models_;
+    // Where the last successfully fetched model list is persisted.
+    std::string model_cache_path_;
+    // Seconds between background refreshes of the model list.
+    int64_t model_refresh_interval_s_ = 600;
+
+    // Session persistence settings ([persistence] table).
+    // Where sessions are kept: "wal" (local files) or "redis" (shared).
+    std::string session_backend_ = "wal";
+    // Directory holding the session WAL and snapshots; empty disables
+    // persistence.
+    std::string state_dir_;
+    // Seconds between snapshots (taken only if something changed).
+    int64_t snapshot_interval_s_ = 300;
+    // Size at which a WAL segment is closed and a new one started.
+    int64_t wal_segment_bytes_ = 64ll << 20;
+    // Redis backend: server URL and key prefix shared by cooperating mounts.
+    std::string redis_url_ = "redis://127.0.0.1:6379";
+    std::string redis_prefix_ = "fusellm";
+    // Redis backend: sessions kept in memory (LRU); 0 = unlimited.
+    int64_t session_cache_capacity_ = 1024;
+    // Memory budget for resident sessions in bytes; 0 = unlimited. Cold
+    // sessions beyond it are compressed into a spill file in `spill_dir_`
+    // (default: the system temp directory).
+    int64_t session_memory_budget_bytes_ = 0;
+    std::string spill_dir_;
+
+    // Compression of old turns in memory ([history] table). Turns older
+    // than the most recent `history_compress_after_turns_` are kept
+    // zstd-compressed (with a dictionary trained on them) and decompressed
+    // on demand through a cache; 0 disables.
+    int64_t history_compress_after_turns_ = 0;
+    int64_t history_dictionary_bytes_ = 16 << 10;
+    int64_t history_cache_bytes_ = 8 << 20;
+
+    // Derived views of /conversations ([views] table): sessions listed in
+    // recent/, most recently written first.
+    int64_t recent_sessions_ = 50;
+
+    // Archiving of stateless /models queries ([archive] table). Limits of 0
+    // mean unlimited; the oldest archives are removed first.
+    bool archive_enabled_ = true;
+    int64_t archive_max_sessions_ = 1000;
+    int64_t archive_max_age_s_ = 0;
+    int64_t archive_max_bytes_ = 0;
+    int64_t archive_gc_interval_s_ = 60;
 
     /**
      * @brief 更新特定模型的配置参数。
@@ -77,15 +158,33 @@ class ConfigManager {
 
     /**
      * @brief 获取指定模型最终生效的参数。
-     * 该方法会合并全局参数和模型专属参数。
+     * 该方法会合并全局参数和模型专属参数。热路径请直接使用
+     * snapshot()->params_for()，以免复制。
      * @param model_name 模型名称。
      * @return 合并后的 ModelParameters 对象。
      */
     ModelParameters get_model_params(std::string_view model_name) const;
 
   protected:
+    // 从已解析的配置表加载全部设置；不做严格校验
+    void load_table(const toml::table &tbl, std::string_view path);
+
+    // 重新加载前的严格校验：类型错误或取值非法时拒绝整个文件
+    static bool validate_config_table(const toml::table &tbl);
+
+    // 根据下面的可写状态生成新快照并发布，调用者须持有 mtx_
+    void publish_locked();
+
+    // 可写状态，受 mtx_ 保护；读者只看已发布的快照
+    std::string default_model_;
+    std::string api_key_;
+    std::string base_url_;
+    ModelParameters global_params_;
     std::unordered_map<std::string, ModelParameters> model_specific_params_;
-    mutable std::mutex mtx_; // 用于保护 model_specific_params_
+    mutable std::mutex mtx_;
+
+    std::shared_ptr<const ConfigSnapshot> snapshot_; // atomic_load/store only
+    std::atomic<uint64_t> epoch_{0};
 };
 
 } // namespace fusellm
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "ConfigWatcher.h"
+#include "spdlog/spdlog.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fusellm {
+
+namespace {
+
+// Editors write a file in several steps; reload once it has been quiet this
+// long.
+constexpr int SETTLE_MS = 200;
+
+} // namespace
+
+ConfigWatcher::ConfigWatcher(ConfigManager &config, Callback on_reload)
+    : config_(config), on_reload_(std::move(on_reload)) {}
+
+ConfigWatcher::~ConfigWatcher() { stop(); }
+
+bool ConfigWatcher::start(const std::string &path) {
+    stop();
+    const std::filesystem::path file =
+        std::filesystem::absolute(std::filesystem::path(path));
+    path_ = file.string();
+    name_ = file.filename().string();
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd_ < 0 || wake_fd_ < 0 ||
+        inotify_add_watch(inotify_fd_, file.parent_path().c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        SPDLOG_WARN("Cannot watch config file '{}' for changes: {}", path_,
+                    std::strerror(errno));
+        stop();
+        return false;
+    }
+    watcher_ = std::thread(&ConfigWatcher::watch_loop, this);
+    SPDLOG_INFO("Watching config file '{}' for changes.", path_);
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (watcher_.joinable()) {
+        const uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+            SPDLOG_WARN("Cannot wake the config watcher: {}",
+                        std::strerror(errno));
+        }
+        watcher_.join();
+    }
+    for (int *fd : {&inotify_fd_, &wake_fd_}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool ConfigWatcher::drain_events() {
+    alignas(struct inotify_event) char buf[4096];
+    bool changed = false;
+    while (true) {
+        const ssize_t n = ::read(inotify_fd_, buf, sizeof(buf));
+        if (n <= 0) {
+            return changed; // EAGAIN: nothing left
+        }
+        for (char *p = buf; p < buf + n;) {
+            const auto *event = reinterpret_cast<struct inotify_event *>(p);
+            if ((event->mask & IN_Q_OVERFLOW) ||
+                (event->len > 0 && name_ == event->name)) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+void ConfigWatcher::watch_loop() {
+    bool pending = false;
+    while (true) {
+        struct pollfd fds[2] = {{inotify_fd_, POLLIN, 0},
+                                {wake_fd_, POLLIN, 0}};
+        // While a change is pending, wait only until the writes settle.
+        const int ready = ::poll(fds, 2, pending ? SETTLE_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            SPDLOG_ERROR("Config watcher stopped: {}", std::strerror(errno));
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return; // stop()
+        }
+        if (ready == 0) {
+            pending = false;
+            if (config_.reload_from_file(path_) && on_reload_) {
+                on_reload_();
+            }
+            continue;
+        }
+        if (drain_events()) {
+            pending = true;
+        }
+    }
+}
+
+} // namespace fusellm
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ConfigManager.h"
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace fusellm {
+
+/**
+ * @class ConfigWatcher
+ * @brief Reloads the configuration file whenever it changes on disk.
+ *
+ * The file's directory is watched with inotify, so both in-place writes and
+ * editors that save by renaming a new file over the old one are seen. A
+ * burst of events is coalesced into one reload once the file has been quiet
+ * for a moment. Each reload goes through ConfigManager::reload_from_file(),
+ * which keeps the current configuration if the new file is invalid; after
+ * a successful one `on_reload` runs on the watcher thread.
+ */
+class ConfigWatcher {
+  public:
+    using Callback = std::function<void()>;
+
+    ConfigWatcher(ConfigManager &config, Callback on_reload);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher &) = delete;
+    ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+    /**
+     * @brief Starts watching `path`.
+     * @return False if inotify is unavailable; the file is then not watched.
+     */
+    bool start(const std::string &path);
+
+    /**
+     * @brief Stops the watcher thread, if running. Idempotent.
+     */
+    void stop();
+
+  private:
+    void watch_loop();
+
+    // Reads the pending inotify events; true if one concerns the file.
+    bool drain_events();
+
+    ConfigManager &config_;
+    Callback on_reload_;
+    std::string path_;
+    std::string name_; // File name within the watched directory
+
+    int inotify_fd_ = -1;
+    int wake_fd_ = -1; // eventfd signalled by stop()
+    std::thread watcher_;
+};
+
+} // namespace fusellm
@@ -0,0 +1,130 @@
+#include "ModelParameters.h"
+#include "spdlog/spdlog.h"
+#include <sstream>
+
+namespace fusellm {
+
+namespace {
+
+// Reads a TOML value of the parameter's type; nullopt if the type differs.
+// Numbers are accepted for floating-point parameters.
+std::optional<double> read(const toml::node &node, const double *) {
+    return node.is_number() ? node.value<double>() : std::nullopt;
+}
+
+std::optional<int64_t> read(const toml::node &node, const int64_t *) {
+    return node.is_integer() ? node.value<int64_t>() : std::nullopt;
+}
+
+std::optional<Blob> read(const toml::node &node, const Blob *) {
+    if (!node.is_string()) {
+        return std::nullopt;
+    }
+    return Blob(node.value<std::string>().value_or(""));
+}
+
+std::optional<StopList> read(const toml::node &node, const StopList *) {
+    if (node.is_string()) {
+        return StopList{node.value<std::string>().value_or("")};
+    }
+    const toml::array *arr = node.as_array();
+    if (!arr) {
+        return std::nullopt;
+    }
+    StopList list;
+    for (const auto &item : *arr) {
+        if (!item.is_string()) {
+            return std::nullopt;
+        }
+        list.push_back(item.value<std::string>().value_or(""));
+    }
+    return list;
+}
+
+void render(std::ostream &os, double v) { os << toml::value<double>(v); }
+
+void render(std::ostream &os, int64_t v) { os << v; }
+
+void render(std::ostream &os, const Blob &v) {
+    os << toml::value<std::string>(v.str());
+}
+
+void render(std::ostream &os, const StopList &v) {
+    toml::array arr;
+    for (const auto &s : v) {
+        arr.push_back(s);
+    }
+    os << arr;
+}
+
+} // namespace
+
+bool params::known(std::string_view name) {
+    bool found = false;
+    for_each([&](const auto &field) { found = found || field.name == name; });
+    return found;
+}
+
+void ModelParameters::merge(const toml::table &tbl) {
+    params::for_each([&](const auto &field) {
+        using T = typename std::decay_t<decltype(field)>::Type;
+        if (const toml::node *node = tbl.get(field.name)) {
+            if (auto value = read(*node, static_cast<const T *>(nullptr))) {
+                this->*field.member = std::move(value);
+            }
+        }
+    });
+}
+
+void ModelParameters::merge(const ModelParameters &other) {
+    // Only override if the other parameter has a value
+    params::for_each([&](const auto &field) {
+        if (other.*field.member) {
+            this->*field.member = other.*field.member;
+        }
+    });
+}
+
+bool ModelParameters::validate_model_params_table(const toml::table &tbl) {
+    bool valid = true;
+    params::for_each([&](const auto &field) {
+        using T = typename std::decay_t<decltype(field)>::Type;
+        const toml::node *node = tbl.get(field.name);
+        if (!valid || !node) {
+            return;
+        }
+        auto value = read(*node, static_cast<const T *>(nullptr));
+        if (!value || !field.valid(*value)) {
+            SPDLOG_WARN("Validation failed: '{}' must be {}.", field.name,
+                        field.expected);
+            valid = false;
+        }
+    });
+    if (!valid) {
+        return false;
+    }
+
+    for (const auto &[key, _] : tbl) {
+        if (!params::known(key.str())) {
+            SPDLOG_WARN(
+                "Validation warning: Unknown configuration key '{}' found.",
+                key.str());
+        }
+    }
+
+    return true;
+}
+
+std::string ModelParameters::to_toml() const {
+    std::ostringstream ss;
+    params::for_each([&](const auto &field) {
+        if (const auto &value = this->*field.member) {
+            ss << field.name << " = ";
+            render(ss, *value);
+            ss << "\n";
+        }
+    });
+    return ss.str();
+}
+
+} // namespace fusellm
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../common/BlobStore.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <toml++/toml.hpp>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace fusellm {
+
+// Stop sequences: TOML accepts a single string or an array of strings.
+using StopList = std::vector<std::string>;
+
+/**
+ * @struct ModelParameters
+ * @brief Represents a set of configurable parameters for an LLM.
+ * This structure can be layered (global, model-specific, session-specific).
+ *
+ * Every parameter is described once in MODEL_PARAMS below; parsing,
+ * validation, merging, rendering and the request body all iterate that
+ * table, so a new parameter is a new member plus one line there.
+ */
+struct ModelParameters {
+    /**
+     * @brief Merges parameters from a TOML table into this object.
+     * Values of the wrong type are ignored.
+     * @param tbl The TOML table to load settings from.
+     */
+    void merge(const toml::table &tbl);
+
+    /**
+     * @brief Merges parameters from another ModelParameters object into this one.
+     * Only non-nullopt values from 'other' will override current values.
+     * @param other The other ModelParameters to merge from.
+     */
+    void merge(const ModelParameters &other);
+
+    /**
+     * @brief Validates the structure and values of a TOML table containing
+     * model parameters.
+     * @param tbl The TOML table to validate.
+     * @return True if the table is valid, false otherwise.
+     */
+    static bool validate_model_params_table(const toml::table &tbl);
+
+    /**
+     * @brief Renders the set parameters as TOML, one `key = value` line
+     * each, in schema order. The output parses back to the same values.
+     */
+    std::string to_toml() const;
+
+    std::optional<double> temperature;
+    std::optional<Blob> system_prompt; // Interned; copies share the text
+    // Per-request deadline in milliseconds. A request that runs longer is
+    // aborted and rolled back, exactly like an interrupted one.
+    std::optional<int64_t> timeout_ms;
+    // Upper bound on the generated tokens, and so on the response latency.
+    std::optional<int64_t> max_tokens;
+    std::optional<StopList> stop;
+    // Makes sampling repeatable, so equal requests can share a response.
+    std::optional<int64_t> seed;
+    std::optional<double> top_p;
+    // Choices to generate; only the first one is used as the reply.
+    std::optional<int64_t> n;
+};
+
+namespace params {
+
+enum Flags : unsigned {
+    LOCAL = 0,       // Used by fusellm itself
+    REQUEST = 1 << 0 // Sent as a field of the chat completion request
+};
+
+/**
+ * @struct Field
+ * @brief One entry of the parameter schema.
+ */
+template <typename T> struct Field {
+    using Type = T;
+
+    std::string_view name; // TOML key, JSON field and storage name
+    std::optional<T> ModelParameters::*member;
+    unsigned flags;
+    // Allowed values beyond the type, for validation messages.
+    std::string_view expected;
+    bool (*check)(const T &); // nullptr: any value of the type
+
+    bool valid(const T &value) const { return !check || check(value); }
+};
+
+constexpr bool is_temperature(const double &v) { return v >= 0.0 && v <= 2.0; }
+constexpr bool is_probability(const double &v) { return v >= 0.0 && v <= 1.0; }
+constexpr bool is_positive(const int64_t &v) { return v > 0; }
+constexpr bool is_choice_count(const int64_t &v) { return v >= 1 && v <= 128; }
+inline bool is_stop_list(const StopList &v) { return v.size() <= 4; }
+
+/**
+ * @brief The parameter schema. The order is part of the session record
+ * format (see RecordCodec): append new parameters, never reorder.
+ */
+inline const auto MODEL_PARAMS = std::make_tuple(
+    Field<double>{"temperature", &ModelParameters::temperature, REQUEST,
+                  "a number between 0.0 and 2.0", is_temperature},
+    Field<Blob>{"system_prompt", &ModelParameters::system_prompt, LOCAL,
+                "a string", nullptr},
+    Field<int64_t>{"timeout_ms", &ModelParameters::timeout_ms, LOCAL,
+                   "a positive integer", is_positive},
+    Field<int64_t>{"max_tokens", &ModelParameters::max_tokens, REQUEST,
+                   "a positive integer", is_positive},
+    Field<StopList>{"stop", &ModelParameters::stop, REQUEST,
+                    "a string or an array of at most 4 strings",
+                    is_stop_list},
+    Field<int64_t>{"seed", &ModelParameters::seed, REQUEST, "an integer",
+                   nullptr},
+    Field<double>{"top_p", &ModelParameters::top_p, REQUEST,
+                  "a number between 0.0 and 1.0", is_probability},
+    Field<int64_t>{"n", &ModelParameters::n, REQUEST,
+                   "an integer between 1 and 128", is_choice_count});
+
+constexpr size_t COUNT = std::tuple_size_v<std::decay_t<decltype(MODEL_PARAMS)>>;
+
+/**
+ * @brief Calls `f(field)` for every schema entry, in schema order.
+ */
+template <typename F> void for_each(F &&f) {
+    std::apply([&](const auto &...field) { (f(field), ...); }, MODEL_PARAMS);
+}
+
+/**
+ * @brief Whether `name` is a known parameter.
+ */
+bool known(std::string_view name);
+
+} // namespace params
+
+} // namespace fusellm
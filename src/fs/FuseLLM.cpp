@@ -7,11 +7,27 @@
 #include "../handlers/SemanticSearchHandler.h"
 #include "PathParser.h"
 #include <cerrno> // For error codes like ENOENT
+#include <filesystem>
 #include <spdlog/spdlog.h>
 
 namespace fusellm {
 
 std::unordered_map<PathType, std::unique_ptr<BaseHandler>> FuseLLM::handlers;
+std::atomic<struct fuse *> FuseLLM::fuse_handle{nullptr};
+
+namespace {
+
+ArchivePolicy archive_policy(const ConfigManager &config) {
+    ArchivePolicy policy;
+    policy.enabled = config.archive_enabled_;
+    policy.max_sessions = static_cast<size_t>(config.archive_max_sessions_);
+    policy.max_age = std::chrono::seconds(config.archive_max_age_s_);
+    policy.max_bytes = static_cast<size_t>(config.archive_max_bytes_);
+    policy.gc_interval = std::chrono::seconds(config.archive_gc_interval_s_);
+    return policy;
+}
+
+} // namespace
 
 FuseLLM &FuseLLM::getInstance(ConfigManager &config) {
     static FuseLLM instance(config);
@@ -19,17 +35,109 @@ FuseLLM &FuseLLM::getInstance(ConfigManager &config) {
 }
 
 FuseLLM::FuseLLM(ConfigManager &config)
-    : global_config(config), session_manager(config), llm_client(config),
-      zmq_client() {
+    : global_config(config), llm_client(config),
+      config_watcher(config, [this] { llm_client.apply_config(); }),
+      session_manager(config),
+      query_archiver(session_manager, archive_policy(config)), zmq_client() {
     SPDLOG_INFO("Initializing FuseLLM filesystem components...");
 
+    // The model list is served from cache/config right away and refreshed
+    // in the background, so mounting never waits on the provider.
+    llm_client.start_model_refresh();
+
+    // Edits to the -c config file apply without a restart (and without
+    // dropping sessions); sessions pick up the new epoch on their next use.
+    if (!config.config_path_.empty()) {
+        config_watcher.start(config.config_path_);
+    }
+
+    // Sessions changed by other mounts sharing the store must not be served
+    // from the kernel's caches either.
+    session_manager.on_remote_change(
+        [this](const std::string &id) { invalidate_kernel_cache(id); });
+
+    // Old turns are kept compressed, with a dictionary shared by all
+    // sessions; set up before any session is restored.
+    if (config.history_compress_after_turns_ > 0) {
+        HistoryCompressor::Options options;
+        options.keep_turns =
+            static_cast<size_t>(config.history_compress_after_turns_);
+        options.dictionary_bytes =
+            static_cast<size_t>(config.history_dictionary_bytes_);
+        options.training_bytes = options.dictionary_bytes * 64;
+        options.cache_bytes = static_cast<size_t>(config.history_cache_bytes_);
+        session_manager.set_history_compressor(
+            std::make_shared<HistoryCompressor>(options));
+    }
+
+    // Restore persisted sessions before the filesystem becomes visible.
+    if (config.session_backend_ == "redis") {
+        try {
+            session_store = std::make_unique<RedisSessionStore>(
+                config.redis_url_, config.redis_prefix_);
+            session_manager.set_store(
+                session_store.get(),
+                static_cast<size_t>(config.session_cache_capacity_));
+        } catch (const std::exception &e) {
+            SPDLOG_ERROR("Session persistence disabled: {}", e.what());
+            session_store.reset();
+        }
+    } else if (!config.state_dir_.empty()) {
+        std::unique_ptr<WalSessionStore> wal;
+        std::vector<SessionImage> images;
+        try {
+            wal = std::make_unique<WalSessionStore>(
+                config.state_dir_,
+                static_cast<uint64_t>(config.wal_segment_bytes_));
+            images = wal->load_all();
+        } catch (const std::exception &e) {
+            SPDLOG_ERROR("Session persistence disabled: {}", e.what());
+            wal.reset();
+        }
+        if (wal) {
+            session_manager.set_store(wal.get());
+            for (auto &image : images) {
+                session_manager.restore_session(std::move(image));
+            }
+            wal->start_checkpointing(
+                session_manager,
+                std::chrono::seconds(config.snapshot_interval_s_));
+            session_store = std::move(wal);
+        }
+    }
+
+    // Cap session memory; cold sessions beyond the budget are spilled to a
+    // local file (or, with Redis, dropped and reloaded on demand).
+    if (config.session_memory_budget_bytes_ > 0) {
+        std::unique_ptr<SpillFile> spill;
+        if (!(session_store && session_store->lazy())) {
+            std::string dir = config.spill_dir_;
+            if (dir.empty()) {
+                std::error_code ec;
+                dir = (std::filesystem::temp_directory_path(ec) / "fusellm")
+                          .string();
+            }
+            try {
+                spill = std::make_unique<SpillFile>(dir);
+            } catch (const std::exception &e) {
+                SPDLOG_ERROR("Session memory budget disabled: {}", e.what());
+            }
+        }
+        session_manager.set_memory_budget(
+            static_cast<size_t>(config.session_memory_budget_bytes_),
+            std::move(spill));
+    }
+
+    // Archives left by earlier runs are picked up once sessions are restored.
+    query_archiver.start();
+
     // TODO: Connect zmq client
     zmq_client.connect(config.semantic_search_service_url_);
 
     // Map path types to their corresponding handlers.
     handlers[PathType::Root] = std::make_unique<RootHandler>();
     handlers[PathType::Models] = std::make_unique<ModelsHandler>(
-        llm_client, global_config, session_manager);
+        llm_client, global_config, query_archiver);
 
     handlers[PathType::Config] =
         std::make_unique<ConfigHandler>(global_config, llm_client);
@@ -43,6 +151,56 @@ FuseLLM::FuseLLM(ConfigManager &config)
     SPDLOG_INFO("All handlers initialized and mapped.");
 }
 
+FuseLLM::~FuseLLM() {
+    // Archive queued queries before the final checkpoint.
+    query_archiver.stop();
+    if (auto *wal = dynamic_cast<WalSessionStore *>(session_store.get())) {
+        // A final snapshot keeps the next startup's WAL replay short.
+        wal->stop_checkpointing();
+        wal->checkpoint(session_manager);
+    }
+}
+
+void FuseLLM::invalidate_kernel_cache(const std::string &id) {
+    struct fuse *f = fuse_handle.load();
+    if (!f) {
+        return; // Not mounted yet; nothing is cached
+    }
+    // The high-level API has no inode numbers; fuse_invalidate_path()
+    // resolves the path and issues fuse_lowlevel_notify_inval_inode().
+    // -ENOENT just means the kernel has nothing cached for the path.
+    if (id.empty()) {
+        // Sessions may have been created or removed; the affected sessions
+        // are invalidated one by one.
+        fuse_invalidate_path(f, "/conversations");
+        return;
+    }
+    static const char *const files[] = {
+        "",         "/llm",   "/history",      "/context",
+        "/queue",   "/config", "/config/model", "/config/settings.toml"};
+    std::vector<std::string> dirs = {"/conversations/" + id};
+    if (session_manager.get_latest_session_id() == id) {
+        dirs.push_back("/conversations/latest");
+    }
+    for (const auto &dir : dirs) {
+        for (const char *file : files) {
+            fuse_invalidate_path(f, (dir + file).c_str());
+        }
+    }
+}
+
+void *FuseLLM::init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+    struct fuse_context *ctx = fuse_get_context();
+    fuse_handle.store(ctx->fuse);
+    // /conversations lists attributes with its entries; use them on every
+    // page rather than letting the kernel guess whether they are wanted.
+    if (conn->capable & FUSE_CAP_READDIRPLUS) {
+        conn->want |= FUSE_CAP_READDIRPLUS;
+        conn->want &= ~FUSE_CAP_READDIRPLUS_AUTO;
+    }
+    return ctx->private_data;
+}
+
 BaseHandler *FuseLLM::get_handler(std::string_view path) {
     PathType parsed_path = PathParser::parse(path);
     auto it = handlers.find(parsed_path);
@@ -97,6 +255,14 @@ int FuseLLM::write(const char *path, const char *buf, size_t size, off_t offset,
     return handler->write(path, buf, size, offset, fi);
 }
 
+int FuseLLM::truncate(const char *path, off_t size,
+                      struct fuse_file_info *fi) {
+    BaseHandler *handler = get_handler(path);
+    if (!handler)
+        return -ENOENT;
+    return handler->truncate(path, size, fi);
+}
+
 int FuseLLM::mkdir(const char *path, mode_t mode) {
     BaseHandler *handler = get_handler(path);
     if (!handler)
@@ -118,4 +284,18 @@ int FuseLLM::unlink(const char *path) {
     return handler->unlink(path);
 }
 
+int FuseLLM::fsync(const char *path, int datasync, struct fuse_file_info *fi) {
+    BaseHandler *handler = get_handler(path);
+    if (!handler)
+        return -ENOENT;
+    return handler->fsync(path, datasync, fi);
+}
+
+int FuseLLM::release(const char *path, struct fuse_file_info *fi) {
+    BaseHandler *handler = get_handler(path);
+    if (!handler)
+        return 0;
+    return handler->release(path, fi);
+}
+
 } // namespace fusellm
\ No newline at end of file
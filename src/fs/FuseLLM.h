@@ -3,12 +3,18 @@
 
 #include "../../external/Fusepp/Fuse.h"
 #include "../config/ConfigManager.h"
+#include "../config/ConfigWatcher.h"
 #include "../handlers/BaseHandler.h"
 #include "../services/LLMClient.h"
 #include "../services/ZmqClient.h"
+#include "../state/QueryArchiver.h"
 #include "../state/SessionManager.h"
+#include "../storage/RedisSessionStore.h"
+#include "../storage/WalSessionStore.h"
 #include "PathParser.h"
+#include <atomic>
 #include <memory>
+#include <string>
 #include <unordered_map>
 
 namespace fusellm {
@@ -24,6 +30,7 @@ class FuseLLM : public Fusepp::Fuse<FuseLLM> {
     FuseLLM(FuseLLM &&) = delete;
     FuseLLM &operator=(const FuseLLM &) = delete;
     FuseLLM &operator=(FuseLLM &&) = delete;
+    ~FuseLLM();
 
     // FUSE 回调函数，将作为 FUSE 操作的入口点
     // fusepp 通过 CRTP (Curiously Recurring Template Pattern) 调用这些静态方法
@@ -37,9 +44,14 @@ class FuseLLM : public Fusepp::Fuse<FuseLLM> {
                     struct fuse_file_info *fi);
     static int write(const char *path, const char *buf, size_t size,
                      off_t offset, struct fuse_file_info *fi);
+    static int truncate(const char *path, off_t size,
+                        struct fuse_file_info *fi);
     static int mkdir(const char *path, mode_t mode);
     static int rmdir(const char *path);
     static int unlink(const char *path);
+    static int fsync(const char *path, int datasync, struct fuse_file_info *fi);
+    static int release(const char *path, struct fuse_file_info *fi);
+    static void *init(struct fuse_conn_info *conn, struct fuse_config *cfg);
     // ... 其他 FUSE 操作
 
   private:
@@ -49,12 +61,28 @@ class FuseLLM : public Fusepp::Fuse<FuseLLM> {
     // 根据路径将请求分派给正确的 Handler
     static BaseHandler *get_handler(std::string_view path);
 
-    SessionManager session_manager;
+    // 其他实例修改了会话后，让内核丢弃该会话目录下文件的页缓存和属性。
+    // id 为空时只让会话列表目录失效。
+    void invalidate_kernel_cache(const std::string &id);
+
+    // llm_client 必须声明在 session_manager 之前：会话的提示队列线程
+    // 在 SessionManager 析构时才停止，期间仍会使用 LLMClient。
     LLMClient llm_client;
+    // 配置文件变化时重新加载；回调会用到 llm_client，因此声明在它之后
+    ConfigWatcher config_watcher;
+    // 会话持久化存储（本地 WAL + 快照，或 Redis）；禁用持久化时为空。
+    // 同样必须比 session_manager 活得更久。
+    std::unique_ptr<SessionStore> session_store;
+    SessionManager session_manager;
+    // 在后台把 /models 查询归档为会话，并按保留策略回收
+    QueryArchiver query_archiver;
     ZmqClient zmq_client;
 
     // 存储不同路径类型的处理器
     static std::unordered_map<PathType, std::unique_ptr<BaseHandler>> handlers;
+
+    // init 回调中记录的 FUSE 句柄，供后台线程发送缓存失效通知
+    static std::atomic<struct fuse *> fuse_handle;
 };
 
 } // namespace fusellm
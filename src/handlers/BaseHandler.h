@@ -2,6 +2,7 @@
 #pragma once
 
 #include "../../external/Fusepp/Fuse.h"
+#include "../common/CancelToken.h"
 #include <cerrno>
 
 namespace fusellm {
@@ -60,6 +61,14 @@ class BaseHandler {
         return -ENOSYS;
     }
 
+    virtual int truncate(const char *path, off_t size,
+                         struct fuse_file_info *fi) {
+        (void)path;
+        (void)size;
+        (void)fi;
+        return -ENOSYS;
+    }
+
     virtual int mkdir(const char *path, mode_t mode) {
         (void)path;
         (void)mode;
@@ -80,7 +89,46 @@ class BaseHandler {
         (void)rdev;
         return -ENOSYS;
     }
+    virtual int fsync(const char *path, int datasync,
+                      struct fuse_file_info *fi) {
+        (void)path;
+        (void)datasync;
+        (void)fi;
+        return -ENOSYS;
+    }
+    // 文件的最后一个描述符关闭时调用，返回值会被 FUSE 忽略
+    virtual int release(const char *path, struct fuse_file_info *fi) {
+        (void)path;
+        (void)fi;
+        return 0;
+    }
     // ... 其他 FUSE 操作也可以提供默认实现
+
+  protected:
+    /**
+     * @brief Ties a CancelToken to the FUSE request being served by the
+     * calling thread, so that interrupting the client process (e.g. Ctrl-C)
+     * aborts the work done on its behalf.
+     */
+    static void bind_to_request(CancelToken &cancel) {
+        cancel.set_interrupt_probe([] { return fuse_interrupted() != 0; });
+    }
+
+    /**
+     * @brief Maps the outcome of a failed, possibly cancelled, operation to
+     * the errno returned to the kernel.
+     */
+    static int cancel_errno(const CancelToken &cancel) {
+        switch (cancel.reason()) {
+        case CancelToken::Reason::Interrupted:
+        case CancelToken::Reason::Cancelled:
+            return -EINTR;
+        case CancelToken::Reason::DeadlineExceeded:
+            return -ETIMEDOUT;
+        default:
+            return -EIO;
+        }
+    }
 };
 
 } // namespace fusellm
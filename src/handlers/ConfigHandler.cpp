@@ -6,7 +6,7 @@
 namespace fusellm {
 
 ConfigHandler::ConfigHandler(ConfigManager &config, const LLMClient &client)
-    : default_config(config), model_list_(client.model_list) {}
+    : default_config(config), llm_client_(client) {}
 
 int ConfigHandler::getattr(const char *path, struct stat *stbuf,
                            struct fuse_file_info *fi) {
@@ -35,8 +35,7 @@ int ConfigHandler::getattr(const char *path, struct stat *stbuf,
     // Case 2: "/config/<model_name>/"
     if (components.size() == 2 && components[0] == config_dir) {
         std::string_view model_name = components[1];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model) {
@@ -51,8 +50,7 @@ int ConfigHandler::getattr(const char *path, struct stat *stbuf,
     if (components.size() == 3 && components[0] == config_dir) {
         std::string_view model_name = components[1];
         std::string_view file_name = components[2];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model && file_name == "settings.toml") {
@@ -84,7 +82,8 @@ int ConfigHandler::readdir(const char *path, void *buf, fuse_fill_dir_t filler,
         filler(buf, ".", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "..", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "default", NULL, 0, (fuse_fill_dir_flags)0);
-        for (const auto &model : model_list_) {
+        auto models = llm_client_.models();
+        for (const auto &model : models->names) {
             filler(buf, model.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
         }
         return 0;
@@ -93,8 +92,7 @@ int ConfigHandler::readdir(const char *path, void *buf, fuse_fill_dir_t filler,
     // Case 2: "/config/<model_name>"
     if (components.size() == 2 && components[0] == config_dir) {
         std::string_view model_name = components[1];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model) {
@@ -123,8 +121,7 @@ int ConfigHandler::open(const char *path, struct fuse_file_info *fi) {
     // Case 2: "/config/<model_name>"
     if (components.size() == 2 && components[0] == config_dir) {
         std::string_view model_name = components[1];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model) {
@@ -136,8 +133,7 @@ int ConfigHandler::open(const char *path, struct fuse_file_info *fi) {
     if (components.size() == 3 && components[0] == config_dir) {
         std::string_view model_name = components[1];
         std::string_view file_name = components[2];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model && file_name == "settings.toml") {
@@ -164,8 +160,7 @@ int ConfigHandler::read(const char *path, char *buf, size_t size, off_t offset,
     // Case 2: "/config/<model_name>"
     if (components.size() == 2 && components[0] == config_dir) {
         std::string_view model_name = components[1];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model) {
@@ -177,31 +172,21 @@ int ConfigHandler::read(const char *path, char *buf, size_t size, off_t offset,
     if (components.size() == 3 && components[0] == config_dir) {
         std::string_view model_name = components[1];
         std::string_view file_name = components[2];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model && file_name == "settings.toml") {
+            // 持有快照，model_name 可能指向其中的默认模型名
+            const auto config = default_config.snapshot();
             if (model_name == default_model) {
-                model_name = default_config.default_model_;
+                model_name = config->default_model;
             }
 
-            // 1. Get the actual model parameters from ConfigManager
-            ModelParameters params =
-                default_config.get_model_params(model_name);
+            // 1. Get the actual model parameters from the same snapshot
+            const ModelParameters &params = config->params_for(model_name);
 
             // 2. Serialize the parameters to TOML format
-            std::stringstream ss;
-            if (params.temperature) {
-                ss << "temperature = " << *params.temperature << "\n";
-            }
-            if (params.system_prompt) {
-                // Escape special characters in the string for TOML
-                ss << "system_prompt = " << toml::value(*params.system_prompt)
-                   << "\n";
-            }
-
-            std::string content = ss.str();
+            std::string content = params.to_toml();
 
             if (offset >= content.length()) {
                 return 0;
@@ -229,8 +214,7 @@ int ConfigHandler::write(const char *path, const char *buf, size_t size,
     // Case 2: "/config/<model_name>"
     if (components.size() == 2 && components[0] == config_dir) {
         std::string_view model_name = components[1];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model) {
@@ -242,13 +226,14 @@ int ConfigHandler::write(const char *path, const char *buf, size_t size,
     if (components.size() == 3 && components[0] == config_dir) {
         std::string_view model_name = components[1];
         std::string_view file_name = components[2];
-        bool is_valid_model = std::find(model_list_.begin(), model_list_.end(),
-                                        model_name) != model_list_.end() ||
+        bool is_valid_model = llm_client_.has_model(model_name) ||
                               model_name == default_model;
 
         if (is_valid_model && file_name == "settings.toml") {
+            // 持有快照，model_name 可能指向其中的默认模型名
+            const auto config = default_config.snapshot();
             if (model_name == default_model) {
-                model_name = default_config.default_model_;
+                model_name = config->default_model;
             }
 
             // 不支持部分写入或追加，必须一次性写入整个文件
@@ -2,7 +2,6 @@
 #include "../config/ConfigManager.h"
 #include "../services/LLMClient.h"
 #include "BaseHandler.h"
-#include <vector>
 
 namespace fusellm {
 /**
@@ -33,6 +32,7 @@ class ConfigHandler : public BaseHandler {
 
   private:
     ConfigManager &default_config;
-    std::vector<std::string> model_list_;
+    // 模型列表通过 LLMClient 的快照读取，随后台刷新自动更新
+    const LLMClient &llm_client_;
 };
 } // namespace fusellm
\ No newline at end of file
@@ -2,10 +2,15 @@
 #include "../common/utils.hpp"
 #include "../state/Session.h"
 #include "src/config/ConfigManager.h"
+#include <algorithm>
+#include <cctype>
 #include <cerrno>
+#include <chrono>
+#include <iterator>
 #include <spdlog/spdlog.h>
 #include <string.h>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace fusellm {
@@ -16,20 +21,44 @@ namespace { // Anonymous namespace for internal logic
 enum class ConvPathType {
     Unknown,
     Root,        // /conversations
+    ViewDir,     // /conversations/by-date, /conversations/by-model
+    BucketDir,   // /conversations/by-date/<day>, .../by-model/<model>, recent
+    SearchDir,   // /conversations/_search
+    SearchFile,  // /conversations/_search/query
+    StatsFile,   // /conversations/_stats
     LatestDir,   // /conversations/latest (acts as a directory)
     SessionDir,  // /conversations/<session_id>
     LLMFile,     // /conversations/<session_id>/llm
     HistoryFile, // /conversations/<session_id>/history
     ContextFile, // /conversations/<session_id>/context
+    QueueFile,   // /conversations/<session_id>/queue
     ConfigDir,   // /conversations/<session_id>/config
     ModelFile,   // /conversations/<session_id>/config/model
     SettingsFile // /conversations/<session_id>/config/settings.toml
 };
 
+// Derived views of the sessions (see SessionViews). A session listed in a
+// view appears there as a directory, just like 'latest'.
+constexpr std::string_view BY_DATE = "by-date";
+constexpr std::string_view BY_MODEL = "by-model";
+constexpr std::string_view RECENT = "recent";
+constexpr std::string_view SEARCH = "_search";
+constexpr std::string_view STATS = "_stats";
+
+// Names in /conversations that are not sessions.
+bool is_reserved(std::string_view name) {
+    return name == "latest" || name == BY_DATE || name == BY_MODEL ||
+           name == RECENT || name == SEARCH || name == STATS;
+}
+
 // A struct to hold the parsed path information.
 struct ParsedConvPath {
     ConvPathType type = ConvPathType::Unknown;
     std::string session_id;
+    // For paths inside a view: the view and, for by-date and by-model, the
+    // day or model.
+    std::string view;
+    std::string bucket;
 };
 
 // Parses a path string (e.g., "/conversations/123/llm") into a structured
@@ -48,28 +77,69 @@ ParsedConvPath parse_conv_path(std::string_view path) {
         return p;
     }
 
-    if (components.size() == 1) { // "/conversations"
+    if (components.size() >= 2 && components[1] == SEARCH) {
+        if (components.size() == 2) { // "/conversations/_search"
+            p.type = ConvPathType::SearchDir;
+        } else if (components.size() == 3 && components[2] == "query") {
+            p.type = ConvPathType::SearchFile;
+        }
+        return p;
+    }
+    if (components.size() == 2 && components[1] == STATS) {
+        p.type = ConvPathType::StatsFile;
+        return p;
+    }
+
+    // Index of the session ID: views add one or two components before it.
+    size_t base = 1;
+    if (components.size() >= 2 &&
+        (components[1] == BY_DATE || components[1] == BY_MODEL)) {
+        p.view = components[1];
+        if (components.size() == 2) { // "/conversations/by-date"
+            p.type = ConvPathType::ViewDir;
+            return p;
+        }
+        p.bucket = components[2];
+        if (components.size() == 3) { // "/conversations/by-date/<day>"
+            p.type = ConvPathType::BucketDir;
+            return p;
+        }
+        base = 3;
+    } else if (components.size() >= 2 && components[1] == RECENT) {
+        p.view = components[1];
+        if (components.size() == 2) { // "/conversations/recent"
+            p.type = ConvPathType::BucketDir;
+            return p;
+        }
+        base = 2;
+    }
+    const size_t depth = components.size() - base;
+
+    if (depth == 0) { // "/conversations"
         p.type = ConvPathType::Root;
-    } else if (components.size() == 2) { // "/conversations/<id>"
-        p.session_id = components[1];
-        p.type = (p.session_id == "latest") ? ConvPathType::LatestDir
-                                            : ConvPathType::SessionDir;
-    } else if (components.size() == 3) { // "/conversations/<id>/<file>"
-        p.session_id = components[1];
-        const auto &file = components[2];
+    } else if (depth == 1) { // "/conversations/<id>"
+        p.session_id = components[base];
+        p.type = (p.session_id == "latest" && p.view.empty())
+                     ? ConvPathType::LatestDir
+                     : ConvPathType::SessionDir;
+    } else if (depth == 2) { // "/conversations/<id>/<file>"
+        p.session_id = components[base];
+        const auto &file = components[base + 1];
         if (file == "llm")
             p.type = ConvPathType::LLMFile;
         else if (file == "history")
             p.type = ConvPathType::HistoryFile;
         else if (file == "context")
             p.type = ConvPathType::ContextFile;
+        else if (file == "queue")
+            p.type = ConvPathType::QueueFile;
         else if (file == "config")
             p.type = ConvPathType::ConfigDir;
-    } else if (components.size() == 4 &&
-               components[2] ==
+    } else if (depth == 3 &&
+               components[base + 1] ==
                    "config") { // "/conversations/<id>/config/<file>"
-        p.session_id = components[1];
-        const auto &file = components[3];
+        p.session_id = components[base];
+        const auto &file = components[base + 2];
         if (file == "model")
             p.type = ConvPathType::ModelFile;
         else if (file == "settings.toml")
@@ -79,17 +149,174 @@ ParsedConvPath parse_conv_path(std::string_view path) {
     return p;
 }
 
-// Helper to get a session, resolving "latest" if necessary.
+// Whether the view `p` points into lists its session.
+bool in_view(const SessionManager &sm, const ParsedConvPath &p) {
+    const SessionViews &views = sm.views();
+    if (p.view == BY_DATE) {
+        return views.in_date(p.bucket, p.session_id);
+    }
+    if (p.view == BY_MODEL) {
+        return views.in_model(p.bucket, p.session_id);
+    }
+    return views.in_recent(p.session_id);
+}
+
+// Whether a view directory, or a day or model within one, exists.
+bool view_exists(const SessionManager &sm, const ParsedConvPath &p) {
+    if (p.type == ConvPathType::ViewDir || p.view == RECENT) {
+        return true;
+    }
+    if (p.view == BY_DATE) {
+        return sm.views().has_date(p.bucket);
+    }
+    return sm.views().has_model(p.bucket);
+}
+
+// The (negative) errno for a failed session lookup, creation or removal.
+int session_errno(SessionManager::Error error) {
+    switch (error) {
+    case SessionManager::Error::Exists:
+        return -EEXIST;
+    case SessionManager::Error::Unavailable:
+        return -EIO; // The session store is unreachable
+    default:
+        return -ENOENT;
+    }
+}
+
+// Helper to get a session, resolving "latest" and views if necessary.
+// If nothing is found, `err` receives the error to return.
 std::shared_ptr<Session> get_session(SessionManager &sm,
-                                     const std::string &id) {
-    if (id == "latest") {
-        auto latest_id = sm.get_latest_session_id();
-        if (latest_id.empty()) {
-            return nullptr;
+                                     const ParsedConvPath &p,
+                                     int *err = nullptr) {
+    const std::string &id = p.session_id;
+    auto error = SessionManager::Error::NotFound;
+    std::shared_ptr<Session> session;
+    if (!p.view.empty()) {
+        session = in_view(sm, p) ? sm.find_session(id, &error) : nullptr;
+    } else if (id == "latest") {
+        session = sm.find_latest_session(&error);
+    } else {
+        session = sm.find_session(id, &error);
+    }
+    if (!session && err) {
+        *err = session_errno(error);
+    }
+    return session;
+}
+
+// Splits a multi-prompt script into individual prompts. Prompts are separated
+// by NUL bytes if the script contains any (so prompts may span lines),
+// otherwise by newlines. Blank prompts are dropped.
+std::vector<std::string> split_prompt_script(std::string_view script) {
+    const char delim =
+        script.find('\0') != std::string_view::npos ? '\0' : '\n';
+    std::vector<std::string> prompts;
+    for (auto &prompt : strutil::split(script, delim)) {
+        if (!strutil::trim_copy(prompt).empty()) {
+            prompts.push_back(std::move(prompt));
         }
-        return sm.find_session(latest_id);
     }
-    return sm.find_session(id);
+    return prompts;
+}
+
+// Entries of /conversations listed before the sessions. Entry i has
+// directory offset i + 1, and a session at listing position n has offset
+// FIRST_SESSION_OFFSET + n.
+constexpr const char *FIXED_ENTRIES[] = {".",        "..",     "latest",
+                                         "by-date",  "by-model", "recent",
+                                         "_search",  "_stats"};
+constexpr off_t FIRST_SESSION_OFFSET = std::size(FIXED_ENTRIES);
+
+// Sessions copied out of the listing per lock acquisition.
+constexpr size_t READDIR_BATCH = 256;
+
+// Renders the memory statistics of the sessions as TOML, for _stats.
+std::string render_stats(const SessionManager::MemoryStats &stats) {
+    std::string out;
+    auto line = [&out](std::string_view key, auto value) {
+        out += key;
+        out += " = ";
+        out += std::to_string(value);
+        out += '\n';
+    };
+    out += "[sessions]\n";
+    line("resident", stats.resident_sessions);
+    line("spilled", stats.spilled_sessions);
+    line("resident_bytes", stats.resident_bytes);
+    line("budget_bytes", stats.budget_bytes);
+    out += "\n[spill]\n";
+    line("raw_bytes", stats.spill.raw_bytes);
+    line("stored_bytes", stats.spill.stored_bytes);
+    line("file_bytes", stats.spill.file_bytes);
+    // Old turns kept compressed (see HistoryCompressor)
+    const auto &history = stats.history;
+    out += "\n[history]\n";
+    line("frames", history.frames);
+    line("raw_bytes", history.raw_bytes);
+    line("compressed_bytes", history.compressed_bytes);
+    line("ratio", history.compressed_bytes
+                      ? double(history.raw_bytes) / history.compressed_bytes
+                      : 1.0);
+    line("dictionary_bytes", history.dictionary_bytes);
+    line("cache_bytes", history.cache_bytes);
+    line("cache_hits", history.cache_hits);
+    line("cache_misses", history.cache_misses);
+    // Large texts shared across sessions (see BlobStore)
+    const auto &blobs = stats.blobs;
+    out += "\n[blobs]\n";
+    line("blobs", blobs.blobs);
+    line("references", blobs.references);
+    line("stored_bytes", blobs.stored_bytes);
+    line("logical_bytes", blobs.logical_bytes);
+    line("dedupe_ratio", blobs.dedupe_ratio());
+    line("hits", blobs.hits);
+    line("misses", blobs.misses);
+    return out;
+}
+
+// Matches returned by one full-text query.
+constexpr size_t SEARCH_LIMIT = 100;
+// Bytes of context around the first hit in a snippet.
+constexpr size_t SNIPPET_BEFORE = 40;
+constexpr size_t SNIPPET_AFTER = 80;
+
+// A one-line excerpt of `content` around the first occurrence of `term`
+// (already case folded), cut at UTF-8 character boundaries.
+std::string make_snippet(std::string_view content, std::string_view term) {
+    std::string folded(content);
+    for (auto &c : folded) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    size_t hit = folded.find(term);
+    if (hit == std::string::npos) {
+        hit = 0;
+    }
+    auto continuation = [&](size_t i) {
+        return i < content.size() &&
+               (static_cast<unsigned char>(content[i]) & 0xC0) == 0x80;
+    };
+    size_t begin = hit > SNIPPET_BEFORE ? hit - SNIPPET_BEFORE : 0;
+    while (continuation(begin)) {
+        begin++;
+    }
+    size_t end = std::min(content.size(), hit + term.size() + SNIPPET_AFTER);
+    while (continuation(end)) {
+        end--;
+    }
+    std::string snippet(content.substr(begin, end - begin));
+    for (auto &c : snippet) {
+        if (c == '\n' || c == '\r' || c == '\t') {
+            c = ' ';
+        }
+    }
+    if (begin > 0) {
+        snippet.insert(0, "...");
+    }
+    if (end < content.size()) {
+        snippet += "...";
+    }
+    return snippet;
 }
 
 } // namespace
@@ -106,13 +333,57 @@ int ConversationsHandler::getattr(const char *path_str, struct stat *stbuf,
     ParsedConvPath p = parse_conv_path(path_str);
 
     switch (p.type) {
+    case ConvPathType::ViewDir:
+    case ConvPathType::BucketDir:
+        if (!view_exists(session_manager_, p)) {
+            return -ENOENT;
+        }
+        stbuf->st_mode = S_IFDIR | 0755;
+        stbuf->st_nlink = 2;
+        stbuf->st_size = 4096;
+        return 0;
+
+    case ConvPathType::SearchFile: {
+        stbuf->st_mode = S_IFREG | 0644;
+        stbuf->st_nlink = 1;
+        // Only an open handle (fstat) has a result to report.
+        std::lock_guard<std::mutex> lock(search_mtx_);
+        if (fi) {
+            if (auto it = searches_.find(fi->fh); it != searches_.end()) {
+                stbuf->st_size = static_cast<off_t>(it->second.result.size());
+            }
+        }
+        return 0;
+    }
+
+    case ConvPathType::StatsFile:
+        stbuf->st_mode = S_IFREG | 0444;
+        stbuf->st_nlink = 1;
+        stbuf->st_size = static_cast<off_t>(
+            render_stats(session_manager_.memory_stats()).size());
+        return 0;
+
     case ConvPathType::Root:
+    case ConvPathType::SearchDir:
     case ConvPathType::SessionDir:
     case ConvPathType::LatestDir:
     case ConvPathType::ConfigDir:
-        if (p.type != ConvPathType::Root &&
-            !get_session(session_manager_, p.session_id)) {
-            return -ENOENT;
+        if (p.type == ConvPathType::SessionDir && p.view.empty() &&
+            p.session_id.find('@') != std::string::npos) {
+            // The kernel looks up `new@base` right after mkdir forked it
+            // into `new`. Only the directory itself answers to that name.
+            ParsedConvPath fork = p;
+            fork.session_id.resize(p.session_id.find('@'));
+            int err = 0;
+            if (!get_session(session_manager_, fork, &err)) {
+                return err;
+            }
+        } else if (p.type != ConvPathType::Root &&
+                   p.type != ConvPathType::SearchDir) {
+            int err = 0;
+            if (!get_session(session_manager_, p, &err)) {
+                return err;
+            }
         }
         stbuf->st_mode = S_IFDIR | 0755;
         stbuf->st_nlink = 2;
@@ -122,10 +393,13 @@ int ConversationsHandler::getattr(const char *path_str, struct stat *stbuf,
     case ConvPathType::LLMFile:
     case ConvPathType::HistoryFile:
     case ConvPathType::ContextFile:
+    case ConvPathType::QueueFile:
     case ConvPathType::ModelFile:
     case ConvPathType::SettingsFile: {
-        if (!get_session(session_manager_, p.session_id)) {
-            return -ENOENT;
+        int err = 0;
+        auto session = get_session(session_manager_, p, &err);
+        if (!session) {
+            return err;
         }
         stbuf->st_mode = S_IFREG | 0644; // rw-r--r--
         if (p.type == ConvPathType::HistoryFile) {
@@ -133,6 +407,10 @@ int ConversationsHandler::getattr(const char *path_str, struct stat *stbuf,
         }
         stbuf->st_nlink = 1;
         stbuf->st_size = 4096; // Report a non-zero size
+        if (p.type == ConvPathType::ContextFile) {
+            // The real size: the kernel appends (O_APPEND) at this offset.
+            stbuf->st_size = static_cast<off_t>(session->get_context_size());
+        }
         return 0;
     }
 
@@ -145,30 +423,105 @@ int ConversationsHandler::readdir(const char *path, void *buf,
                                   fuse_fill_dir_t filler, off_t offset,
                                   struct fuse_file_info *fi,
                                   enum fuse_readdir_flags flags) {
-    filler(buf, ".", NULL, 0, (fuse_fill_dir_flags)0);
-    filler(buf, "..", NULL, 0, (fuse_fill_dir_flags)0);
-
     ParsedConvPath p = parse_conv_path(path);
 
     if (p.type == ConvPathType::Root) {
-        // Only list 'latest' if a latest session ID actually exists
-        if (!session_manager_.get_latest_session_id().empty()) {
-            filler(buf, "latest", NULL, 0, (fuse_fill_dir_flags)0);
+        // Entries carry offsets, so the kernel reads the directory a buffer
+        // at a time and resumes where the previous one stopped. With
+        // readdirplus they also carry their attributes, which are the same
+        // for every session directory, so `ls -l` needs no getattr (and no
+        // session lookup) per entry.
+        const bool plus = flags & FUSE_READDIR_PLUS;
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+        st.st_mode = S_IFDIR | 0755;
+        st.st_nlink = 2;
+        st.st_size = 4096;
+        // Adds an entry; true once the kernel's buffer is full.
+        auto full = [&](const char *name, off_t next,
+                        const struct stat *attr = nullptr) {
+            return filler(buf, name, plus ? (attr ? attr : &st) : NULL, next,
+                          plus ? FUSE_FILL_DIR_PLUS
+                               : (fuse_fill_dir_flags)0) != 0;
+        };
+        struct stat stats_st;
+        if (plus && offset < FIRST_SESSION_OFFSET) {
+            getattr(("/conversations/" + std::string(STATS)).c_str(),
+                    &stats_st, nullptr);
         }
-        for (const auto &id : session_manager_.list_sessions()) {
-            filler(buf, id.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
+        for (off_t i = offset; i < FIRST_SESSION_OFFSET; i++) {
+            // Only list 'latest' if a latest session ID actually exists
+            if (FIXED_ENTRIES[i] == std::string_view("latest") &&
+                !session_manager_.has_latest_session()) {
+                continue;
+            }
+            const bool stats = FIXED_ENTRIES[i] == STATS;
+            if (full(FIXED_ENTRIES[i], i + 1,
+                     stats && plus ? &stats_st : nullptr)) {
+                return 0;
+            }
         }
-    } else if (p.type == ConvPathType::SessionDir ||
-               p.type == ConvPathType::LatestDir) {
-        if (!get_session(session_manager_, p.session_id))
+        uint64_t cursor = 0;
+        if (offset > FIRST_SESSION_OFFSET) {
+            cursor = static_cast<uint64_t>(offset - FIRST_SESSION_OFFSET);
+        }
+        while (true) {
+            auto page =
+                session_manager_.list_sessions_page(cursor, READDIR_BATCH);
+            for (const auto &entry : page) {
+                if (full(entry.id.c_str(),
+                         FIRST_SESSION_OFFSET +
+                             static_cast<off_t>(entry.position))) {
+                    return 0; // The kernel asks for the rest later
+                }
+                cursor = entry.position;
+            }
+            if (page.size() < READDIR_BATCH) {
+                return 0;
+            }
+        }
+    }
+
+    filler(buf, ".", NULL, 0, (fuse_fill_dir_flags)0);
+    filler(buf, "..", NULL, 0, (fuse_fill_dir_flags)0);
+
+    if (p.type == ConvPathType::SearchDir) {
+        filler(buf, "query", NULL, 0, (fuse_fill_dir_flags)0);
+    } else if (p.type == ConvPathType::ViewDir ||
+               p.type == ConvPathType::BucketDir) {
+        // Each view is listed from its own index, in time proportional to
+        // its size.
+        const SessionViews &views = session_manager_.views();
+        std::vector<std::string> names;
+        if (p.type == ConvPathType::ViewDir) {
+            names = p.view == BY_DATE ? views.dates() : views.models();
+        } else if (p.view == BY_DATE) {
+            names = views.by_date(p.bucket);
+        } else if (p.view == BY_MODEL) {
+            names = views.by_model(p.bucket);
+        } else {
+            names = views.recent();
+        }
+        if (names.empty() && !view_exists(session_manager_, p)) {
             return -ENOENT;
+        }
+        for (const auto &name : names) {
+            filler(buf, name.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
+        }
+    } else if (p.type == ConvPathType::SessionDir ||
+        p.type == ConvPathType::LatestDir) {
+        int err = 0;
+        if (!get_session(session_manager_, p, &err))
+            return err;
         filler(buf, "llm", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "history", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "context", NULL, 0, (fuse_fill_dir_flags)0);
+        filler(buf, "queue", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "config", NULL, 0, (fuse_fill_dir_flags)0);
     } else if (p.type == ConvPathType::ConfigDir) {
-        if (!get_session(session_manager_, p.session_id))
-            return -ENOENT;
+        int err = 0;
+        if (!get_session(session_manager_, p, &err))
+            return err;
         filler(buf, "model", NULL, 0, (fuse_fill_dir_flags)0);
         filler(buf, "settings.toml", NULL, 0, (fuse_fill_dir_flags)0);
     } else {
@@ -180,16 +533,36 @@ int ConversationsHandler::readdir(const char *path, void *buf,
 
 int ConversationsHandler::mkdir(const char *path, mode_t mode) {
     ParsedConvPath p = parse_conv_path(path);
-    if (p.type != ConvPathType::SessionDir) {
+    if (p.type != ConvPathType::SessionDir || !p.view.empty()) {
         return -EPERM;
     }
 
-    if (session_manager_.create_session(p.session_id)) {
+    // `mkdir new@base` forks `base` (or `latest`) into `new`.
+    size_t at = p.session_id.find('@');
+    if (at != std::string::npos) {
+        std::string id = p.session_id.substr(0, at);
+        std::string base = p.session_id.substr(at + 1);
+        if (id.empty() || is_reserved(id) || base.empty()) {
+            return -EINVAL;
+        }
+        if (base == "latest") {
+            base = session_manager_.get_latest_session_id();
+        }
+        auto error = SessionManager::Error::Exists;
+        if (session_manager_.fork_session(id, base, &error)) {
+            SPDLOG_INFO("Forked conversation session '{}' from '{}'", id, base);
+            return 0;
+        }
+        return session_errno(error);
+    }
+
+    auto error = SessionManager::Error::Exists;
+    if (session_manager_.create_session(p.session_id, &error)) {
         SPDLOG_INFO("Created new conversation session: {}", p.session_id);
         return 0;
     }
 
-    return -EEXIST;
+    return session_errno(error);
 }
 
 int ConversationsHandler::rmdir(const char *path) {
@@ -197,12 +570,25 @@ int ConversationsHandler::rmdir(const char *path) {
     if (p.type != ConvPathType::SessionDir) {
         return -ENOTDIR;
     }
+    if (!p.view.empty()) {
+        return -EPERM; // Removed through its own directory only
+    }
 
-    if (session_manager_.remove_session(p.session_id)) {
+    auto error = SessionManager::Error::NotFound;
+    if (session_manager_.remove_session(p.session_id, &error)) {
         SPDLOG_INFO("Removed conversation session: {}", p.session_id);
         return 0;
     }
-    return -ENOENT;
+    return session_errno(error);
+}
+
+int ConversationsHandler::release(const char *path,
+                                  struct fuse_file_info *fi) {
+    if (parse_conv_path(path).type == ConvPathType::SearchFile) {
+        std::lock_guard<std::mutex> lock(search_mtx_);
+        searches_.erase(fi->fh);
+    }
+    return 0;
 }
 
 int ConversationsHandler::open(const char *path, struct fuse_file_info *fi) {
@@ -212,9 +598,31 @@ int ConversationsHandler::open(const char *path, struct fuse_file_info *fi) {
     }
 
     // Check if underlying session exists for file operations
-    if (p.type >= ConvPathType::LLMFile &&
-        !get_session(session_manager_, p.session_id)) {
-        return -ENOENT;
+    std::shared_ptr<Session> session;
+    if (p.type >= ConvPathType::LLMFile) {
+        int err = 0;
+        session = get_session(session_manager_, p, &err);
+        if (!session) {
+            return err;
+        }
+    }
+
+    if (p.type == ConvPathType::SearchFile) {
+        // Results are per handle and change with every query, so reads
+        // bypass the page cache and the size the kernel has seen.
+        std::lock_guard<std::mutex> lock(search_mtx_);
+        fi->fh = next_search_handle_++;
+        fi->direct_io = 1;
+        searches_.emplace(fi->fh, SearchHandle{});
+        return 0;
+    }
+
+    if (p.type == ConvPathType::StatsFile) {
+        if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+            return -EACCES;
+        }
+        fi->direct_io = 1; // Rendered anew by every read
+        return 0;
     }
 
     if (p.type == ConvPathType::HistoryFile &&
@@ -222,15 +630,59 @@ int ConversationsHandler::open(const char *path, struct fuse_file_info *fi) {
         return -EACCES; // History is read-only
     }
 
+    if (p.type == ConvPathType::ContextFile && (fi->flags & O_TRUNC)) {
+        session->truncate_context(0);
+    }
+
     return 0;
 }
 
 int ConversationsHandler::read(const char *path, char *buf, size_t size,
                                off_t offset, struct fuse_file_info *fi) {
     ParsedConvPath p = parse_conv_path(path);
-    auto session = get_session(session_manager_, p.session_id);
+    if (p.type == ConvPathType::SearchFile) {
+        std::lock_guard<std::mutex> lock(search_mtx_);
+        auto it = fi ? searches_.find(fi->fh) : searches_.end();
+        if (it == searches_.end()) {
+            return -EBADF;
+        }
+        const SearchHandle &handle = it->second;
+        // `cat <&3` after the query continues at the end of it; an explicit
+        // pread from 0 reads the result from the start as well.
+        const off_t pos = offset >= handle.base ? offset - handle.base : offset;
+        if (pos < 0 || static_cast<size_t>(pos) >= handle.result.size()) {
+            return 0;
+        }
+        size_t len = std::min(size, handle.result.size() -
+                                        static_cast<size_t>(pos));
+        memcpy(buf, handle.result.data() + pos, len);
+        return static_cast<int>(len);
+    }
+    if (p.type == ConvPathType::StatsFile) {
+        const std::string content =
+            render_stats(session_manager_.memory_stats());
+        if (offset < 0 || static_cast<size_t>(offset) >= content.size()) {
+            return 0;
+        }
+        size_t len = std::min(size, content.size() -
+                                        static_cast<size_t>(offset));
+        memcpy(buf, content.data() + offset, len);
+        return static_cast<int>(len);
+    }
+
+    int err = 0;
+    auto session = get_session(session_manager_, p, &err);
     if (!session) {
-        return -ENOENT;
+        return err;
+    }
+
+    if (p.type == ConvPathType::ContextFile) {
+        // Served straight from the context's pieces, however large it is.
+        if (offset < 0) {
+            return -EINVAL;
+        }
+        return static_cast<int>(session->read_context(
+            static_cast<size_t>(offset), buf, size));
     }
 
     std::string content;
@@ -241,26 +693,14 @@ int ConversationsHandler::read(const char *path, char *buf, size_t size,
     case ConvPathType::HistoryFile:
         content = session->get_formatted_history();
         break;
-    case ConvPathType::ContextFile:
-        content = session->get_context();
+    case ConvPathType::QueueFile:
+        content = session->get_formatted_queue();
         break;
     case ConvPathType::ModelFile:
         content = session->get_model();
         break;
     case ConvPathType::SettingsFile:
-        content = "";
-        {
-            ModelParameters params = session->get_settings();
-            if (params.system_prompt) {
-                content +=
-                    "system_prompt = \"" + *params.system_prompt + "\"\n";
-            }
-            if (params.temperature) {
-                content +=
-                    "temperature = " + std::to_string(*params.temperature) +
-                    "\n";
-            }
-        }
+        content = session->settings()->to_toml();
         break;
     default:
         return -EISDIR; // Cannot read a directory
@@ -275,17 +715,39 @@ int ConversationsHandler::read(const char *path, char *buf, size_t size,
 
 int ConversationsHandler::write(const char *path, const char *buf, size_t size,
                                 off_t offset, struct fuse_file_info *fi) {
+    ParsedConvPath p = parse_conv_path(path);
+
+    if (offset < 0) {
+        return -EINVAL;
+    }
+    if (p.type == ConvPathType::StatsFile) {
+        return -EACCES; // Read-only
+    }
+    if (p.type == ConvPathType::SearchFile) {
+        // Every write is a new query, wherever the descriptor stands.
+        std::string result = run_search(std::string_view(buf, size));
+        std::lock_guard<std::mutex> lock(search_mtx_);
+        auto it = fi ? searches_.find(fi->fh) : searches_.end();
+        if (it == searches_.end()) {
+            return -EBADF;
+        }
+        it->second.result = std::move(result);
+        it->second.base = offset + static_cast<off_t>(size);
+        return size;
+    }
+
     // We assume that writes are atomic and overwrite the file's content.
-    // This is typical for `echo "..." > file` shell commands.
-    if (offset != 0) {
-        // Appending (`>>`) is not supported for most files in this model.
+    // This is typical for `echo "..." > file` shell commands. The context
+    // is the exception: it is a regular file that can be appended to.
+    if (offset != 0 && p.type != ConvPathType::ContextFile) {
+        // Appending (`>>`) is not supported for the other files.
         return -EPERM;
     }
 
-    ParsedConvPath p = parse_conv_path(path);
-    auto session = get_session(session_manager_, p.session_id);
+    int err = 0;
+    auto session = get_session(session_manager_, p, &err);
     if (!session) {
-        return -ENOENT;
+        return err;
     }
 
     // Update the 'latest' pointer to this session since it's being interacted
@@ -294,20 +756,41 @@ int ConversationsHandler::write(const char *path, const char *buf, size_t size,
         session_manager_.set_latest_session_id(p.session_id);
     }
 
+    if (p.type == ConvPathType::ContextFile) {
+        session->write_context(static_cast<size_t>(offset),
+                               std::string_view(buf, size));
+        return size;
+    }
+
     std::string data(buf, size);
 
     switch (p.type) {
     case ConvPathType::LLMFile: {
         SPDLOG_INFO("Session '{}' received prompt.", session->get_id());
-        std::string response = session->add_prompt(data, llm_client_);
+        if (fi && (fi->flags & O_NONBLOCK)) {
+            // Non-blocking writers only enqueue; the answer shows up in
+            // llm/history once the prompt's turn has been served.
+            session->enqueue_prompts({data}, llm_client_);
+            break;
+        }
+        CancelToken cancel;
+        bind_to_request(cancel);
+        std::string response = session->add_prompt(data, llm_client_, &cancel);
         if (response.empty()) {
-            return -EIO; // Input/Output Error on failed LLM call
+            // EINTR/ETIMEDOUT if cancelled, EIO on a failed LLM call
+            return cancel_errno(cancel);
         }
         break;
     }
-    case ConvPathType::ContextFile:
-        session->set_context(data);
+    case ConvPathType::QueueFile: {
+        // A whole script of turns in one write, enqueued without waiting.
+        auto prompts = split_prompt_script(data);
+        if (prompts.empty()) {
+            return -EINVAL;
+        }
+        session->enqueue_prompts(std::move(prompts), llm_client_);
         break;
+    }
     case ConvPathType::ModelFile:
         strutil::trim(data);
         session->set_model(data);
@@ -333,4 +816,98 @@ int ConversationsHandler::write(const char *path, const char *buf, size_t size,
     return size;
 }
 
-} // namespace fusellm
\ No newline at end of file
+int ConversationsHandler::truncate(const char *path, off_t size,
+                                   struct fuse_file_info *fi) {
+    ParsedConvPath p = parse_conv_path(path);
+    switch (p.type) {
+    case ConvPathType::ContextFile:
+    case ConvPathType::LLMFile:
+    case ConvPathType::QueueFile:
+    case ConvPathType::ModelFile:
+    case ConvPathType::SettingsFile:
+        break;
+    case ConvPathType::HistoryFile:
+    case ConvPathType::StatsFile:
+        return -EACCES; // Read-only
+    case ConvPathType::SearchFile:
+        return size == 0 ? 0 : -EPERM; // Replaced by the next query
+    case ConvPathType::Unknown:
+        return -ENOENT;
+    default:
+        return -EISDIR;
+    }
+    if (size < 0) {
+        return -EINVAL;
+    }
+
+    int err = 0;
+    auto session = get_session(session_manager_, p, &err);
+    if (!session) {
+        return err;
+    }
+    if (p.type == ConvPathType::ContextFile) {
+        session->truncate_context(static_cast<size_t>(size));
+        return 0;
+    }
+    // The other files are replaced wholesale by their next write, so
+    // emptying them (`: > model`) is accepted and changes nothing.
+    return size == 0 ? 0 : -EPERM;
+}
+
+std::string ConversationsHandler::run_search(std::string_view query) {
+    const auto started = std::chrono::steady_clock::now();
+    const auto terms = SearchIndex::terms(query);
+
+    // Matches of sessions changed or removed since the query ran are
+    // skipped; fetch more if that leaves fewer than the limit. Snippets are
+    // cut from peeked snapshots, so searching neither faults sessions in nor
+    // caches them, and each session is read once per query.
+    std::string result;
+    size_t found = 0;
+    std::vector<SearchIndex::Match> matches;
+    std::unordered_map<std::string, std::shared_ptr<const SessionSnapshot>>
+        snapshots;
+    for (size_t fetch = SEARCH_LIMIT;; fetch *= 2) {
+        matches = session_manager_.search_index().search(query, fetch);
+        result.clear();
+        found = 0;
+        for (const auto &match : matches) {
+            if (found == SEARCH_LIMIT) {
+                break;
+            }
+            auto [it, inserted] = snapshots.try_emplace(match.session_id);
+            if (inserted) {
+                it->second = session_manager_.peek_snapshot(match.session_id);
+            }
+            const auto &snap = it->second;
+            if (!snap || match.message >= snap->history.size()) {
+                continue; // Changed since the query ran
+            }
+            auto entry = snap->history[match.message];
+            if (entry.role != Message::Role::User &&
+                entry.role != Message::Role::AI) {
+                continue; // Replaced since the query ran
+            }
+            const char *role =
+                entry.role == Message::Role::User ? "USER" : "AI";
+            result += match.session_id + "\t" +
+                      std::to_string(match.message) + "\t" + role + "\t" +
+                      make_snippet(entry.content, terms.front()) + "\n";
+            found++;
+        }
+        if (found == SEARCH_LIMIT || matches.size() < fetch) {
+            break;
+        }
+    }
+
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started);
+    SPDLOG_DEBUG("Full-text query '{}' matched {} message(s), listed {}, in "
+                 "{} us.",
+                 strutil::trim_copy(std::string(query)), matches.size(), found,
+                 elapsed.count());
+    return result;
+}
+
+} // namespace fusellm
@@ -3,6 +3,11 @@
 #include "../services/LLMClient.h"
 #include "../state/SessionManager.h"
 #include "BaseHandler.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace fusellm {
 
@@ -12,7 +17,17 @@ namespace fusellm {
  *
  * This is the most complex handler, responsible for creating/deleting sessions
  * (directories), handling the core chat loop via the 'prompt' file, and
- * managing session-specific context and configuration.
+ * managing session-specific context and configuration. The context file
+ * behaves like a regular file: it can be appended to, written at any offset
+ * and truncated.
+ *
+ * by-date/, by-model/ and recent/ are read-only views of the sessions (see
+ * SessionViews); each session listed there is an alias of its directory,
+ * like 'latest'. Writing terms to _search/query runs them against the
+ * full-text index of all messages (see SearchIndex); reading it returns
+ * the matches. Each open file description has its own result, so the
+ * query is written and read back through the same descriptor. _stats is a
+ * read-only file with the memory statistics of the sessions.
  */
 class ConversationsHandler : public BaseHandler {
   public:
@@ -29,12 +44,34 @@ class ConversationsHandler : public BaseHandler {
              struct fuse_file_info *fi) override;
     int write(const char *path, const char *buf, size_t size, off_t offset,
               struct fuse_file_info *fi) override;
+    int truncate(const char *path, off_t size,
+                 struct fuse_file_info *fi) override;
     int mkdir(const char *path, mode_t mode) override;
     int rmdir(const char *path) override;
+    int release(const char *path, struct fuse_file_info *fi) override;
 
   private:
+    /**
+     * @brief Runs a full-text query and renders the matches, one per line:
+     * `<session>\t<message index>\t<USER|AI>\t<snippet>`.
+     */
+    std::string run_search(std::string_view query);
+
     SessionManager &session_manager_;
     LLMClient &llm_client_;
     ConfigManager &config_manager_;
+
+    // Result of the last query written through one open _search/query.
+    struct SearchHandle {
+        std::string result;
+        // File offset right after that query; reads from there on start
+        // at the beginning of the result.
+        off_t base = 0;
+    };
+
+    // Open _search/query handles, by fuse_file_info::fh.
+    std::unordered_map<uint64_t, SearchHandle> searches_;
+    uint64_t next_search_handle_ = 1;
+    mutable std::mutex search_mtx_;
 };
 } // namespace fusellm
\ No newline at end of file
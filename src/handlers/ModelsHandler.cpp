@@ -1,6 +1,5 @@
 #include "ModelsHandler.h"
 #include "../common/utils.hpp"
-#include "../state/SessionManager.h"
 #include <spdlog/spdlog.h>
 #include <string.h>
 #include <string_view>
@@ -8,15 +7,15 @@
 namespace fusellm {
 
 ModelsHandler::ModelsHandler(LLMClient &client, ConfigManager &config,
-                             SessionManager &sessions)
-    : llm_client_(client), config_manager_(config), session_manager_(sessions) {
-    auto &default_model = config_manager_.default_model_;
-    if (std::find(llm_client_.model_list.begin(), llm_client_.model_list.end(),
-                  default_model) == llm_client_.model_list.end()) {
+                             QueryArchiver &archiver)
+    : llm_client_(client), config_manager_(config), archiver_(archiver) {
+    const auto default_model = config_manager_.default_model();
+    auto models = llm_client_.models();
+    if (!models->contains(default_model) && !models->names.empty()) {
         SPDLOG_WARN("Default model '{}' not found in the model list.",
                     default_model);
-        default_model = llm_client_.model_list.front();
-        SPDLOG_WARN("Using default model '{}'.", default_model);
+        config_manager_.set_default_model(models->names.front());
+        SPDLOG_WARN("Using default model '{}'.", models->names.front());
     }
 }
 
@@ -48,9 +47,7 @@ int ModelsHandler::getattr(const char *path, struct stat *stbuf,
     if (components.size() == 2 && components[0] == models_dir) {
         std::string_view model_name = components[1];
         bool is_valid_model =
-            std::find(llm_client_.model_list.begin(),
-                      llm_client_.model_list.end(),
-                      model_name) != llm_client_.model_list.end() ||
+            llm_client_.has_model(model_name) ||
             model_name == default_model;
 
         if (is_valid_model) {
@@ -77,9 +74,10 @@ int ModelsHandler::readdir(const char *path, void *buf, fuse_fill_dir_t filler,
     filler(buf, "..", NULL, 0, (fuse_fill_dir_flags)0);
     filler(buf, "default", NULL, 0, (fuse_fill_dir_flags)0);
 
-    // In a real implementation, you would get this list from the config
-    // For now, hardcoding some examples
-    for (const auto &model : llm_client_.model_list) {
+    // Hold one snapshot for the whole listing so it stays consistent even if
+    // the background refresh publishes a new list meanwhile.
+    auto models = llm_client_.models();
+    for (const auto &model : models->names) {
         filler(buf, model.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
     }
 
@@ -99,9 +97,7 @@ int ModelsHandler::open(const char *path, struct fuse_file_info *fi) {
     if (components.size() == 2 && components[0] == models_dir) {
         std::string_view model_name = components[1];
         bool is_valid_model =
-            std::find(llm_client_.model_list.begin(),
-                      llm_client_.model_list.end(),
-                      model_name) != llm_client_.model_list.end() ||
+            llm_client_.has_model(model_name) ||
             model_name == default_model;
 
         if (is_valid_model) {
@@ -129,16 +125,17 @@ int ModelsHandler::read(const char *path, char *buf, size_t size, off_t offset,
     }
     std::string_view model_name = components[1];
     bool is_valid_model =
-        std::find(llm_client_.model_list.begin(), llm_client_.model_list.end(),
-                  model_name) != llm_client_.model_list.end() ||
+        llm_client_.has_model(model_name) ||
         model_name == default_model;
 
     if (not is_valid_model) {
         return -ENOENT;
     }
 
+    // 持有快照，model_name 可能指向其中的默认模型名
+    const auto config = config_manager_.snapshot();
     if (model_name == default_model) {
-        model_name = config_manager_.default_model_;
+        model_name = config->default_model;
     }
 
     SPDLOG_DEBUG("Read from model '{}'", model_name);
@@ -177,8 +174,7 @@ int ModelsHandler::write(const char *path, const char *buf, size_t size,
     }
     std::string_view model_name = components[1];
     bool is_valid_model =
-        std::find(llm_client_.model_list.begin(), llm_client_.model_list.end(),
-                  model_name) != llm_client_.model_list.end() ||
+        llm_client_.has_model(model_name) ||
         model_name == default_model;
 
     if (not is_valid_model) {
@@ -188,48 +184,29 @@ int ModelsHandler::write(const char *path, const char *buf, size_t size,
     std::string prompt(buf, size);
     SPDLOG_INFO("Send query to model '{}': {}", model_name, prompt);
 
+    // 持有快照，model_name 可能指向其中的默认模型名
+    const auto config = config_manager_.snapshot();
     if (model_name == default_model) {
-        model_name = config_manager_.default_model_;
+        model_name = config->default_model;
     }
 
-    // 使用 ConfigManager 获取合并后的模型参数
-    std::string response = llm_client_.simple_query(model_name, prompt, config_manager_);
+    // 同一快照中合并好的模型参数，无需加锁或复制
+    CancelToken cancel;
+    bind_to_request(cancel);
+    std::string response = llm_client_.simple_query(
+        model_name, prompt, config->params_for(model_name), &cancel);
 
     SPDLOG_DEBUG("Response from model '{}': {}", model_name, response);
 
     if (response.empty()) {
         SPDLOG_ERROR("LLM query failed for model '{}'", model_name);
-        return -EIO; // Input/output error
-    }
-
-    // Create a new conversation to archive this stateless interaction.
-    try {
-        // Create a new session with an auto-generated, PID-like ID.
-        // The creation logic, including retries, is now encapsulated in the
-        // SessionManager.
-        auto session = session_manager_.create_session_with_auto_id();
-
-        if (session) {
-            // Manually populate the new session with the prompt and response.
-            session->populate(prompt, response);
-            // This interaction also makes it the 'latest' session.
-            session_manager_.set_latest_session_id(session->get_id());
-            SPDLOG_INFO(
-                "Archived stateless query as new conversation with ID: {}",
-                session->get_id());
-        } else {
-            // This block should theoretically be unreachable now, but is kept
-            // for robustness.
-            SPDLOG_ERROR(
-                "Failed to create a new session to archive the query.");
-        }
-    } catch (const std::exception &e) {
-        SPDLOG_ERROR("An exception occurred while creating archive session: {}",
-                     e.what());
-        // We don't return an error here, as the primary goal (getting a
-        // response) succeeded. Archiving is a secondary concern.
+        return cancel_errno(cancel); // EINTR/ETIMEDOUT/EIO
     }
 
+    // Archive this stateless interaction as a new conversation. That happens
+    // in the background, so the write only pays for the LLM call.
+    archiver_.submit(std::string(model_name), std::move(prompt), response);
+
     {
         std::lock_guard<std::mutex> lock(mtx_);
         last_responses_[model_name.data()] = std::move(response);
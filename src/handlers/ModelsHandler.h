@@ -1,7 +1,7 @@
 #pragma once
 #include "../config/ConfigManager.h"
 #include "../services/LLMClient.h"
-#include "../state/SessionManager.h"
+#include "../state/QueryArchiver.h"
 #include "BaseHandler.h"
 #include <mutex>
 #include <unordered_map>
@@ -14,10 +14,13 @@ namespace fusellm {
  *
  * This includes listing available models, performing stateless queries via
  * read/write operations on model files, and managing the 'default' symlink.
+ * Each successful query is handed to the QueryArchiver, which saves it as a
+ * conversation in the background.
  */
 class ModelsHandler : public BaseHandler {
   public:
-    explicit ModelsHandler(LLMClient &client, ConfigManager &config, SessionManager &sessions);
+    explicit ModelsHandler(LLMClient &client, ConfigManager &config,
+                           QueryArchiver &archiver);
 
     int getattr(const char *path, struct stat *stbuf,
                 struct fuse_file_info *fi) override;
@@ -37,7 +40,7 @@ class ModelsHandler : public BaseHandler {
   private:
     LLMClient &llm_client_;
     ConfigManager &config_manager_;
-    SessionManager &session_manager_;
+    QueryArchiver &archiver_;
 
     // Thread-safe cache for the last response of each model
     std::unordered_map<std::string, std::string> last_responses_;
@@ -120,6 +120,9 @@ int SemanticSearchHandler::getattr(const char *path, struct stat *stbuf,
         return 0;
 
     case SearchPathType::IndexDir: {
+        if (!zmq_client_.available()) {
+            return -EHOSTDOWN;
+        }
         // Check if the index actually exists
         auto indexes = list_indexes();
         if (std::find(indexes.begin(), indexes.end(), p.index_name) ==
@@ -160,6 +163,13 @@ int SemanticSearchHandler::readdir(const char *path, void *buf,
 
     ParsedSearchPath p = parse_search_path(path);
 
+    // 后端失联时立即失败，而不是让 ls 等待请求超时
+    if ((p.type == SearchPathType::Root ||
+         p.type == SearchPathType::CorpusDir) &&
+        !zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
+
     if (p.type == SearchPathType::Root) {
         auto indexes = list_indexes();
         for (const auto &index_name : indexes) {
@@ -193,6 +203,10 @@ int SemanticSearchHandler::mkdir(const char *path, mode_t mode) {
         return -EPERM; // Operation not permitted
     }
 
+    if (!zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
+
     json payload = {{"index_name", p.index_name}};
     std::string response_str =
         zmq_client_.send_request("create_index", payload.dump());
@@ -213,6 +227,10 @@ int SemanticSearchHandler::rmdir(const char *path) {
         return -ENOTDIR;
     }
 
+    if (!zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
+
     json payload = {{"index_name", p.index_name}};
     std::string response_str =
         zmq_client_.send_request("delete_index", payload.dump());
@@ -243,6 +261,9 @@ int SemanticSearchHandler::unlink(const char *path) {
     if (p.type != SearchPathType::CorpusFile) {
         return -EPERM;
     }
+    if (!zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
 
     SPDLOG_INFO("Removing document '{}' from index '{}'", p.file_name,
                 p.index_name);
@@ -306,6 +327,12 @@ int SemanticSearchHandler::write(const char *path, const char *buf, size_t size,
     // The offset parameter is ignored for simplicity.
     ParsedSearchPath p = parse_search_path(path);
 
+    if ((p.type == SearchPathType::QueryFile ||
+         p.type == SearchPathType::CorpusFile) &&
+        !zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
+
     if (p.type == SearchPathType::QueryFile) {
         std::string query_text(buf, size);
         strutil::trim(
@@ -336,6 +363,7 @@ int SemanticSearchHandler::write(const char *path, const char *buf, size_t size,
                         {"document_id", p.file_name},
                         {"text", content}};
 
+        // 后端只是把文档排进批量写入队列；需要确认落盘时调用 fsync
         std::string response_str =
             zmq_client_.send_request("add_document", payload.dump());
 
@@ -350,4 +378,25 @@ int SemanticSearchHandler::write(const char *path, const char *buf, size_t size,
     return -EINVAL; // Invalid path for writing
 }
 
+int SemanticSearchHandler::fsync(const char *path, int datasync,
+                                 struct fuse_file_info *fi) {
+    ParsedSearchPath p = parse_search_path(path);
+    if (p.type != SearchPathType::CorpusFile) {
+        return 0; // 其他文件没有需要落盘的内容
+    }
+    if (!zmq_client_.available()) {
+        return -EHOSTDOWN;
+    }
+
+    json payload = {{"index_name", p.index_name}};
+    std::string response_str =
+        zmq_client_.send_request("flush", payload.dump());
+
+    if (!is_response_ok(response_str, "flush")) {
+        SPDLOG_ERROR("Failed to flush search index '{}'", p.index_name);
+        return -EIO;
+    }
+    return 0;
+}
+
 } // namespace fusellm
\ No newline at end of file
@@ -49,6 +49,16 @@ class SemanticSearchHandler : public BaseHandler {
 
     int mknod(const char *path, mode_t mode, dev_t rdev) override;
 
+    /**
+     * @brief Waits until all earlier writes to the file's index are embedded
+     * and saved by the backend.
+     *
+     * The backend batches corpus writes and saves them later, so write()
+     * returning only means the document was queued.
+     */
+    int fsync(const char *path, int datasync,
+              struct fuse_file_info *fi) override;
+
   private:
     ZmqClient &zmq_client_;
 
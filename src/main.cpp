@@ -63,6 +63,10 @@ int main(int argc, char *argv[]) {
     fuse_args.push_back(const_cast<char *>(mountpoint.c_str()));
     // 可以添加 -f (foreground), -d (debug) 等FUSE标准参数
     fuse_args.push_back((char *)"-f");
+    // 允许中断请求：用户 Ctrl-C 时 fuse_interrupted() 返回真，
+    // 正在进行的 LLM 调用会被取消并回滚。
+    fuse_args.push_back((char *)"-o");
+    fuse_args.push_back((char *)"intr");
 
     // 5. 启动 FUSE 主循环
     SPDLOG_INFO("Mounting filesystem at {}", mountpoint);
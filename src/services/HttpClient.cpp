@@ -0,0 +1,158 @@
+#include "HttpClient.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstdlib>
+#include <curl/curl.h>
+#include <stdexcept>
+
+namespace fusellm {
+
+namespace {
+
+// 空闲句柄池的容量上限，超过的句柄直接释放
+constexpr size_t MAX_IDLE_HANDLES = 16;
+
+size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    auto *out = static_cast<std::string *>(userdata);
+    out->append(ptr, size * nmemb);
+    return size * nmemb;
+}
+
+// Called by libcurl roughly once per second while idle and more often while
+// data is flowing. Returning non-zero aborts the transfer with
+// CURLE_ABORTED_BY_CALLBACK.
+int progress_callback(void *clientp, curl_off_t, curl_off_t, curl_off_t,
+                      curl_off_t) {
+    auto *cancel = static_cast<CancelToken *>(clientp);
+    return cancel->is_cancelled() ? 1 : 0;
+}
+
+void ensure_curl_global_init() {
+    static std::once_flag flag;
+    std::call_once(flag, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+} // namespace
+
+HttpClient::HttpClient(std::string base_url, std::string api_key)
+    : base_url_(std::move(base_url)) {
+    ensure_curl_global_init();
+
+    if (base_url_.empty() || base_url_ == "/") {
+        base_url_ = "https://api.openai.com/v1/";
+    } else if (base_url_.back() != '/') {
+        base_url_ += '/';
+    }
+
+    if (api_key.empty()) {
+        if (const char *env_key = std::getenv("OPENAI_API_KEY")) {
+            api_key = env_key;
+        }
+    }
+    auth_header_ = "Authorization: Bearer " + api_key;
+}
+
+HttpClient::~HttpClient() {
+    std::lock_guard<std::mutex> lock(pool_mtx_);
+    for (CURL *handle : idle_handles_) {
+        curl_easy_cleanup(handle);
+    }
+    idle_handles_.clear();
+}
+
+HttpResponse HttpClient::post_json(std::string_view endpoint,
+                                   const std::string &body,
+                                   CancelToken &cancel) {
+    return perform(endpoint, &body, cancel);
+}
+
+HttpResponse HttpClient::get(std::string_view endpoint, CancelToken &cancel) {
+    return perform(endpoint, nullptr, cancel);
+}
+
+CURL *HttpClient::acquire_handle() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx_);
+        if (!idle_handles_.empty()) {
+            CURL *handle = idle_handles_.back();
+            idle_handles_.pop_back();
+            return handle;
+        }
+    }
+    CURL *handle = curl_easy_init();
+    if (!handle) {
+        throw std::runtime_error("curl_easy_init() failed");
+    }
+    return handle;
+}
+
+void HttpClient::release_handle(CURL *handle) {
+    curl_easy_reset(handle); // 清除选项，但保留连接缓存
+    std::lock_guard<std::mutex> lock(pool_mtx_);
+    if (idle_handles_.size() < MAX_IDLE_HANDLES) {
+        idle_handles_.push_back(handle);
+    } else {
+        curl_easy_cleanup(handle);
+    }
+}
+
+HttpResponse HttpClient::perform(std::string_view endpoint,
+                                 const std::string *body,
+                                 CancelToken &cancel) {
+    if (cancel.is_cancelled()) {
+        throw std::runtime_error("request cancelled before it was sent");
+    }
+
+    CURL *handle = acquire_handle();
+    HttpResponse response;
+    std::string url = base_url_ + std::string(endpoint);
+
+    struct curl_slist *headers = nullptr;
+    headers = curl_slist_append(headers, auth_header_.c_str());
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
+    // FUSE worker threads must not receive SIGALRM from curl's resolver.
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response.body);
+    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, progress_callback);
+    curl_easy_setopt(handle, CURLOPT_XFERINFODATA, &cancel);
+    if (body) {
+        curl_easy_setopt(handle, CURLOPT_POST, 1L);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, body->c_str());
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE,
+                         static_cast<curl_off_t>(body->size()));
+    } else {
+        curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+    }
+    // The progress callback enforces the deadline precisely; the curl timeout
+    // is only a backstop in case the callback is not invoked.
+    if (auto deadline = cancel.deadline()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            *deadline - CancelToken::Clock::now());
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS,
+                         static_cast<long>(std::max<long long>(
+                             remaining.count() + 1000, 1)));
+    }
+
+    CURLcode rc = curl_easy_perform(handle);
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status);
+    curl_slist_free_all(headers);
+    release_handle(handle);
+
+    if (rc == CURLE_OPERATION_TIMEDOUT) {
+        cancel.cancel(CancelToken::Reason::DeadlineExceeded);
+    }
+    if (rc != CURLE_OK) {
+        SPDLOG_WARN("HTTP request to '{}' failed: {}", url,
+                    curl_easy_strerror(rc));
+        throw std::runtime_error(std::string("HTTP request failed: ") +
+                                 curl_easy_strerror(rc));
+    }
+    return response;
+}
+
+} // namespace fusellm
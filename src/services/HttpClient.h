@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../common/CancelToken.h"
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef void CURL;
+
+namespace fusellm {
+
+/**
+ * @struct HttpResponse
+ * @brief The status code and raw body of a completed HTTP request.
+ */
+struct HttpResponse {
+    long status = 0;
+    std::string body;
+};
+
+/**
+ * @class HttpClient
+ * @brief A minimal libcurl wrapper for OpenAI-compatible REST endpoints.
+ *
+ * Every request runs on its own curl easy handle, so concurrent callers never
+ * serialize on each other. Idle handles are kept in a small pool to reuse
+ * keep-alive connections. Transfers poll a CancelToken through curl's progress
+ * callback and are aborted as soon as the token trips.
+ *
+ * This class is thread-safe.
+ */
+class HttpClient {
+  public:
+    /**
+     * @brief Constructs a client for the given API root.
+     * @param base_url API root ending with '/', e.g. "https://api.openai.com/v1/".
+     * @param api_key Bearer token. Falls back to $OPENAI_API_KEY when empty.
+     */
+    HttpClient(std::string base_url, std::string api_key);
+    ~HttpClient();
+
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    /**
+     * @brief POSTs a JSON body to `base_url + endpoint`.
+     * @param endpoint Relative endpoint, e.g. "chat/completions".
+     * @param body Serialized JSON request body.
+     * @param cancel Token polled during the transfer.
+     * @return The response. Throws std::runtime_error on transport failure,
+     * including cancellation (check cancel.reason() to tell them apart).
+     */
+    HttpResponse post_json(std::string_view endpoint, const std::string &body,
+                           CancelToken &cancel);
+
+    /**
+     * @brief GETs `base_url + endpoint`. Same error contract as post_json().
+     */
+    HttpResponse get(std::string_view endpoint, CancelToken &cancel);
+
+    const std::string &base_url() const { return base_url_; }
+
+  private:
+    HttpResponse perform(std::string_view endpoint, const std::string *body,
+                         CancelToken &cancel);
+
+    CURL *acquire_handle();
+    void release_handle(CURL *handle);
+
+    std::string base_url_;
+    std::string auth_header_;
+
+    // 空闲的 curl 句柄池，用于复用 keep-alive 连接
+    std::vector<CURL *> idle_handles_;
+    std::mutex pool_mtx_;
+};
+
+} // namespace fusellm
@@ -1,5 +1,4 @@
 #include "LLMClient.h"
-#include "external/openai-cpp/include/openai/openai.hpp"
 #include "spdlog/spdlog.h"
 
 namespace fusellm {
@@ -7,10 +6,23 @@ namespace fusellm {
 // Use nlohmann::json for convenience
 using json = nlohmann::json;
 
+namespace {
+
+// A parameter value as a JSON request field.
+template <typename T> json request_value(const T &value) { return value; }
+
+json request_value(const Blob &value) { return value.str(); }
+
+} // namespace
+
 LLMClient::LLMClient(const ConfigManager &config_manager)
     : config_manager_(config_manager) {
-    const auto &api_key = config_manager.api_key_;
-    const auto &base_url = config_manager.base_url_;
+    const auto config = config_manager.snapshot();
+    const auto &api_key = config->api_key;
+    const auto &base_url = config->base_url;
+    api_key_ = api_key;
+    base_url_ = base_url;
+    http_ = std::make_shared<HttpClient>(base_url, api_key);
 
     if (api_key.empty()) {
         SPDLOG_WARN(
@@ -18,47 +30,98 @@ LLMClient::LLMClient(const ConfigManager &config_manager)
             "rely on the OPENAI_API_KEY environment variable if present.");
     }
 
+    if (!base_url.empty() && base_url != "/") {
+        SPDLOG_INFO("Using custom LLM base URL: {}", base_url);
+    }
+
+    // Seed the catalog without touching the network, so mounting never waits
+    // on the provider: last known list from the cache, else the configured
+    // list, else just the default model.
+    if (auto cached = ModelCatalog::load_cache(config_manager.model_cache_path_,
+                                               http_->base_url())) {
+        SPDLOG_INFO("Loaded {} models from cache '{}'.", cached->size(),
+                    config_manager.model_cache_path_);
+        catalog_.publish(std::move(*cached));
+    } else if (!config_manager.static_models_.empty()) {
+        catalog_.publish(config_manager.static_models_);
+    } else {
+        SPDLOG_WARN("No cached or configured models yet, exposing only the "
+                    "default model '{}' until the first refresh.",
+                    config_manager.default_model());
+        catalog_.publish({config_manager.default_model()});
+    }
+}
+
+void LLMClient::start_model_refresh() {
+    catalog_.start_refresh(
+        [this] { return fetch_models(); },
+        std::chrono::seconds(config_manager_.model_refresh_interval_s_),
+        config_manager_.model_cache_path_, http()->base_url());
+    std::lock_guard<std::mutex> lock(endpoint_mtx_);
+    refreshing_ = true;
+}
+
+void LLMClient::apply_config() {
+    const auto config = config_manager_.snapshot();
+    std::lock_guard<std::mutex> lock(endpoint_mtx_);
+    if (config->api_key == api_key_ && config->base_url == base_url_) {
+        return;
+    }
+    const bool new_provider = config->base_url != base_url_;
+    api_key_ = config->api_key;
+    base_url_ = config->base_url;
+    auto http = std::make_shared<HttpClient>(base_url_, api_key_);
+    const std::string api_root = http->base_url();
+    SPDLOG_INFO("LLM endpoint changed; new requests go to {}, requests in "
+                "flight finish on the previous connections.",
+                api_root);
+    std::atomic_store(&http_, std::move(http));
+    if (new_provider && refreshing_) {
+        // The refresher caches the list under the provider's URL, so it is
+        // restarted rather than just woken.
+        catalog_.start_refresh(
+            [this] { return fetch_models(); },
+            std::chrono::seconds(config_manager_.model_refresh_interval_s_),
+            config_manager_.model_cache_path_, api_root);
+    }
+}
+
+std::optional<std::vector<std::string>> LLMClient::fetch_models() {
     try {
-        // Initialize the openai-cpp library.
-        // It supports an empty key, in which case it checks the environment
-        // variable. If a base_url is provided, it configures it for custom
-        // endpoints (e.g., local LLMs).
-        if (base_url.empty()) {
-            openai::start(api_key);
-        } else {
-            SPDLOG_INFO("Using custom LLM base URL: {}", base_url);
-            // The library uses the third parameter for the base URL.
-            openai::start(api_key, "", true, base_url);
+        CancelToken cancel;
+        cancel.set_timeout(std::chrono::seconds(30));
+        HttpResponse response = http()->get("models", cancel);
+        json models = json::parse(response.body, nullptr, false);
+        if (models.is_discarded() || !models.contains("data") ||
+            !models["data"].is_array()) {
+            SPDLOG_WARN("Unexpected reply while listing models (HTTP {}).",
+                        response.status);
+            return std::nullopt;
         }
 
-        // Fetch the list of available models
-        auto models = openai::instance().model.list();
+        std::vector<std::string> names;
         for (const auto &model : models["data"]) {
-            std::string model_id = model["id"].get<std::string>();
-            model_list.push_back(model_id);
-            SPDLOG_INFO("Available model: {}", model_id);
+            if (model.contains("id") && model["id"].is_string()) {
+                names.push_back(model["id"].get<std::string>());
+            }
         }
+        SPDLOG_DEBUG("Fetched {} models from provider.", names.size());
+        return names;
     } catch (const std::exception &e) {
-        // The library constructor might not throw, but this is good practice
-        // for robustness.
-        SPDLOG_ERROR("Failed to initialize LLM client: {}", e.what());
-    }
-
-    if (model_list.empty()) {
-        SPDLOG_ERROR("No models found. Please check your configuration.");
-        throw std::runtime_error("No models found. Please check your configuration, api_key, api_base_url ... or network connection.");
+        SPDLOG_WARN("Failed to fetch model list: {}", e.what());
+        return std::nullopt;
     }
 }
 
 std::string LLMClient::simple_query(std::string_view model_name,
                                     std::string_view prompt,
-                                    const ConfigManager &config_manager) {
-    const auto ms = config_manager.get_model_params(std::string(model_name));
+                                    const ModelParameters &ms,
+                                    CancelToken *cancel) {
     // Construct a minimal message list for a simple, one-shot query.
     json messages;
     if (ms.system_prompt and not ms.system_prompt.value().empty()) {
         messages = json::array(
-            {{{"role", "system"}, {"content", ms.system_prompt.value()}},
+            {{{"role", "system"}, {"content", ms.system_prompt->str()}},
              {{"role", "user"}, {"content", prompt}}});
     } else {
         messages = json::array({{{"role", "user"}, {"content", prompt}}});
@@ -69,7 +132,7 @@ std::string LLMClient::simple_query(std::string_view model_name,
 
     try {
         SPDLOG_DEBUG("Sending simple query to model '{}'", model_name);
-        auto response = openai::chat().create(request_body);
+        auto response = send_chat_request(request_body, ms, cancel);
         return extract_content_from_response(response);
     } catch (const std::exception &e) {
         SPDLOG_ERROR("LLM simple query failed for model '{}': {}", model_name,
@@ -79,21 +142,22 @@ std::string LLMClient::simple_query(std::string_view model_name,
 }
 
 std::string LLMClient::conversation_query(std::string_view model_name,
-                                          const ConfigManager &config_manager,
-                                          const Conversation &conversation) {
-    const auto ms = config_manager.get_model_params(std::string(model_name));
+                                          const ModelParameters &ms,
+                                          const Conversation &conversation,
+                                          CancelToken *cancel) {
     json messages = json::array();
 
     // 1. Add system prompt and context.
     // We combine the static system prompt from config and the dynamic context
     // into a single system message for the API for better context management.
-    std::string final_system_prompt = ms.system_prompt.value_or("");
+    std::string final_system_prompt =
+        ms.system_prompt ? ms.system_prompt->str() : std::string();
     if (!conversation.context.empty()) {
         if (!final_system_prompt.empty()) {
             final_system_prompt += "\n\n";
         }
         final_system_prompt += "ADDITIONAL CONTEXT FOR THIS CONVERSATION:\n" +
-                               conversation.context;
+                               conversation.context.str();
     }
 
     if (!final_system_prompt.empty()) {
@@ -103,8 +167,8 @@ std::string LLMClient::conversation_query(std::string_view model_name,
 
     // 2. Add the entire conversation history.
     for (const auto &msg : conversation.history) {
-        messages.push_back(
-            {{"role", role_to_string(msg.role)}, {"content", msg.content}});
+        messages.push_back({{"role", role_to_string(msg.role)},
+                            {"content", std::string(msg.content)}});
     }
 
     // Build the full JSON request body.
@@ -114,7 +178,7 @@ std::string LLMClient::conversation_query(std::string_view model_name,
         SPDLOG_DEBUG(
             "Sending conversation query to model '{}' with {} messages.",
             model_name, messages.size());
-        auto response = openai::chat().create(request_body);
+        auto response = send_chat_request(request_body, ms, cancel);
         return extract_content_from_response(response);
     } catch (const std::exception &e) {
         SPDLOG_ERROR("LLM conversation query failed for model '{}': {}",
@@ -123,6 +187,28 @@ std::string LLMClient::conversation_query(std::string_view model_name,
     }
 }
 
+json LLMClient::send_chat_request(const json &request_body,
+                                  const ModelParameters &ms,
+                                  CancelToken *cancel) {
+    // Requests issued without a caller-supplied token still get a deadline.
+    CancelToken local_token;
+    CancelToken &token = cancel ? *cancel : local_token;
+    if (ms.timeout_ms) {
+        token.set_timeout(std::chrono::milliseconds(*ms.timeout_ms));
+    }
+
+    // Holds this client until the reply is in, even if the endpoint changes.
+    const auto http = this->http();
+    HttpResponse response =
+        http->post_json("chat/completions", request_body.dump(), token);
+    json reply = json::parse(response.body, nullptr, false);
+    if (reply.is_discarded()) {
+        throw std::runtime_error("Malformed JSON reply (HTTP " +
+                                 std::to_string(response.status) + ")");
+    }
+    return reply;
+}
+
 std::string LLMClient::role_to_string(Message::Role role) {
     switch (role) {
     case Message::Role::System:
@@ -144,13 +230,14 @@ json LLMClient::build_request_json(std::string_view model_name,
     request["model"] = model_name;
     request["messages"] = messages;
 
-    // Add optional parameters to the request if they are set in the config.
-    if (ms.temperature) {
-        request["temperature"] = ms.temperature.value();
-    }
-    // Other parameters like max_tokens, top_p, etc., would be added here in the
-    // same way. e.g., if (ms.max_tokens) { request["max_tokens"] =
-    // *ms.max_tokens; }
+    // Add the request parameters that are set in the config.
+    params::for_each([&](const auto &field) {
+        if (field.flags & params::REQUEST) {
+            if (const auto &value = ms.*field.member) {
+                request[std::string(field.name)] = request_value(*value);
+            }
+        }
+    });
 
     SPDLOG_INFO("Generated LLM request body: {}", request.dump(2));
     return request;
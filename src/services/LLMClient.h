@@ -1,9 +1,17 @@
 #pragma once
 
+#include "../common/CancelToken.h"
+#include "../common/History.h"
 #include "../common/data.h"
 #include "../config/ConfigManager.h"
+#include "HttpClient.h"
+#include "ModelCatalog.h"
 #include "nlohmann/json.hpp"
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace fusellm {
 
@@ -24,30 +32,71 @@ class LLMClient {
      * @param config_manager A reference to the application's configuration
      * manager.
      *
-     * The constructor initializes the underlying OpenAI C++ library with the
-     * API key and base URL provided by the ConfigManager.
+     * The constructor sets up the HTTP client with the API key and base URL
+     * provided by the ConfigManager and seeds the model catalog from the
+     * local cache or the configuration. It never blocks on the network.
      */
     explicit LLMClient(const ConfigManager &config_manager);
 
+    virtual ~LLMClient() = default;
+
     /**
      * @brief 获取配置管理器引用
      * @return 配置管理器的常量引用
      */
     const ConfigManager &get_config_manager() const { return config_manager_; }
 
-    std::vector<std::string> model_list;
+    /**
+     * @brief Returns the current model list snapshot. Never null.
+     */
+    std::shared_ptr<const ModelSnapshot> models() const {
+        return catalog_.snapshot();
+    }
+
+    /**
+     * @brief O(1) check whether a model is currently known.
+     */
+    bool has_model(std::string_view name) const {
+        return catalog_.contains(name);
+    }
+
+    /**
+     * @brief Replaces the model list, e.g. for a static configuration.
+     */
+    void set_models(std::vector<std::string> names) {
+        catalog_.publish(std::move(names));
+    }
+
+    /**
+     * @brief Starts refreshing the model list from the provider in the
+     * background, persisting each new list to the model cache.
+     */
+    void start_model_refresh();
+
+    /**
+     * @brief Picks up a changed API key or base URL from the current config.
+     *
+     * New requests go through a fresh HTTP client (and connection pool);
+     * requests in flight keep the client they started with, which is
+     * released once the last of them finishes. A new base URL also restarts
+     * the model list refresh against the new provider.
+     */
+    void apply_config();
 
     /**
      * @brief Sends a simple, stateless query to the LLM.
      * @param model_name The name of the model to use (e.g., "gpt-4").
      * @param prompt The user's question or prompt.
-     * @param config_manager Reference to the ConfigManager to get model
-     * parameters.
+     * @param params The effective parameters of the model, e.g.
+     * `config_manager.snapshot()->params_for(model_name)`.
+     * @param cancel Optional token that aborts the request when it trips.
+     * The model's `timeout_ms` is applied to it as a deadline.
      * @return The LLM's response as a string, or an empty string on failure.
      */
     std::string simple_query(std::string_view model_name,
                              std::string_view prompt,
-                             const ConfigManager &config_manager);
+                             const ModelParameters &params,
+                             CancelToken *cancel = nullptr);
 
     /**
      * @brief Sends a request based on a full conversation history.
@@ -57,11 +106,17 @@ class LLMClient {
      * @param conversation The conversation object, containing history and
      * context. The last message in the history is assumed to be the user's
      * latest prompt.
-     * @return The LLM's response as a string, or an empty string on failure.
+     * @param cancel Optional token that aborts the request when it trips.
+     * The model's `timeout_ms` is applied to it as a deadline.
+     * @return The LLM's response as a string, or an empty string on failure
+     * (including cancellation; inspect `cancel->reason()` to tell them apart).
+     *
+     * Virtual so that tests can substitute the model.
      */
-    std::string conversation_query(std::string_view model_name,
-                                   const ConfigManager &config_manager,
-                                   const Conversation &conversation);
+    virtual std::string conversation_query(std::string_view model_name,
+                                   const ModelParameters &params,
+                                   const Conversation &conversation,
+                                   CancelToken *cancel = nullptr);
 
   protected:
     /**
@@ -91,8 +146,41 @@ class LLMClient {
     static std::string
     extract_content_from_response(const nlohmann::json &response_json);
 
+    /**
+     * @brief Sends a chat completion request, honouring cancellation and the
+     * `timeout_ms` parameter.
+     * @return The parsed JSON reply. Throws on transport or parse failure.
+     */
+    nlohmann::json send_chat_request(const nlohmann::json &request_body,
+                                     const ModelParameters &ms,
+                                     CancelToken *cancel);
+
     // 存储对配置管理器的引用
     const ConfigManager &config_manager_;
+
+    /**
+     * @brief Fetches the model list from the provider's `models` endpoint.
+     * @return The model IDs, or nullopt on failure.
+     */
+    std::optional<std::vector<std::string>> fetch_models();
+
+    // The HTTP client for new requests. Each request holds its own reference
+    // for its whole duration, so replacing it never cuts one short.
+    std::shared_ptr<HttpClient> http() const { return std::atomic_load(&http_); }
+
+    // 直接基于 libcurl 的 HTTP 客户端，支持请求取消和超时；
+    // 只通过 std::atomic_load/std::atomic_store 访问
+    std::shared_ptr<HttpClient> http_;
+
+    // apply_config() 的状态：当前客户端使用的凭据和地址
+    std::mutex endpoint_mtx_;
+    std::string api_key_;
+    std::string base_url_;
+    bool refreshing_ = false; // start_model_refresh() was called
+
+    // 可用模型列表（写时复制快照，后台刷新）。
+    // 声明在 http_ 之后，保证刷新线程先于 HTTP 客户端停止。
+    ModelCatalog catalog_;
 };
 
 } // namespace fusellm
\ No newline at end of file
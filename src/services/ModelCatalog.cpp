@@ -0,0 +1,181 @@
+#include "ModelCatalog.h"
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fusellm {
+
+using json = nlohmann::json;
+
+namespace {
+
+// 刷新失败后的重试间隔上限
+constexpr std::chrono::seconds FAILURE_RETRY_INTERVAL{30};
+
+std::unordered_set<std::string_view>
+build_index(const std::vector<std::string> &names) {
+    std::unordered_set<std::string_view> index;
+    index.reserve(names.size());
+    for (const auto &name : names) {
+        index.insert(name);
+    }
+    return index;
+}
+
+} // namespace
+
+ModelSnapshot::ModelSnapshot(std::vector<std::string> model_names,
+                             uint64_t snapshot_version)
+    : names(std::move(model_names)), index(build_index(names)),
+      version(snapshot_version) {}
+
+ModelCatalog::ModelCatalog()
+    : current_(std::make_shared<const ModelSnapshot>(
+          std::vector<std::string>{}, 0)) {}
+
+ModelCatalog::~ModelCatalog() { stop(); }
+
+std::shared_ptr<const ModelSnapshot> ModelCatalog::snapshot() const {
+    return std::atomic_load(&current_);
+}
+
+bool ModelCatalog::contains(std::string_view name) const {
+    return snapshot()->contains(name);
+}
+
+void ModelCatalog::publish(std::vector<std::string> names) {
+    auto next =
+        std::make_shared<const ModelSnapshot>(std::move(names), next_version_++);
+    SPDLOG_INFO("Model catalog updated to version {} ({} models).",
+                next->version, next->names.size());
+    std::atomic_store(&current_,
+                      std::shared_ptr<const ModelSnapshot>(std::move(next)));
+}
+
+std::optional<std::vector<std::string>>
+ModelCatalog::load_cache(const std::string &path, std::string_view base_url) {
+    std::ifstream in(path);
+    if (!in) {
+        return std::nullopt;
+    }
+    json cache = json::parse(in, nullptr, false);
+    if (cache.is_discarded() || !cache.contains("models") ||
+        !cache["models"].is_array()) {
+        SPDLOG_WARN("Ignoring corrupt model cache '{}'.", path);
+        return std::nullopt;
+    }
+    if (cache.value("base_url", "") != base_url) {
+        SPDLOG_INFO("Model cache '{}' belongs to another provider, ignoring.",
+                    path);
+        return std::nullopt;
+    }
+
+    std::vector<std::string> names;
+    for (const auto &name : cache["models"]) {
+        if (name.is_string()) {
+            names.push_back(name.get<std::string>());
+        }
+    }
+    if (names.empty()) {
+        return std::nullopt;
+    }
+    return names;
+}
+
+bool ModelCatalog::save_cache(const std::string &path,
+                              std::string_view base_url,
+                              const std::vector<std::string> &names) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path target(path);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out) {
+            SPDLOG_WARN("Cannot write model cache '{}'.", tmp_path);
+            return false;
+        }
+        json cache = {{"base_url", base_url},
+                      {"fetched_at", std::chrono::duration_cast<std::chrono::seconds>(
+                                         std::chrono::system_clock::now()
+                                             .time_since_epoch())
+                                         .count()},
+                      {"models", names}};
+        out << cache.dump(2);
+        if (!out) {
+            return false;
+        }
+    }
+    fs::rename(tmp_path, target, ec);
+    if (ec) {
+        SPDLOG_WARN("Cannot replace model cache '{}': {}", path, ec.message());
+        return false;
+    }
+    return true;
+}
+
+void ModelCatalog::start_refresh(Fetcher fetch, std::chrono::seconds interval,
+                                 std::string cache_path, std::string base_url) {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+        wake_ = false;
+    }
+    refresher_ = std::thread(&ModelCatalog::refresh_loop, this,
+                             std::move(fetch), interval, std::move(cache_path),
+                             std::move(base_url));
+}
+
+void ModelCatalog::refresh_now() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        wake_ = true;
+    }
+    cv_.notify_all();
+}
+
+void ModelCatalog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (refresher_.joinable()) {
+        refresher_.join();
+    }
+}
+
+void ModelCatalog::refresh_loop(Fetcher fetch, std::chrono::seconds interval,
+                                std::string cache_path, std::string base_url) {
+    while (true) {
+        auto names = fetch();
+        std::chrono::seconds wait = interval;
+        if (names && !names->empty()) {
+            if (*names != snapshot()->names) {
+                if (!cache_path.empty()) {
+                    save_cache(cache_path, base_url, *names);
+                }
+                publish(std::move(*names));
+            }
+        } else {
+            SPDLOG_WARN("Model list refresh failed, keeping {} known models.",
+                        snapshot()->names.size());
+            wait = std::min(interval, FAILURE_RETRY_INTERVAL);
+        }
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, wait, [this] { return stop_ || wake_; });
+        if (stop_) {
+            return;
+        }
+        wake_ = false;
+    }
+}
+
+} // namespace fusellm
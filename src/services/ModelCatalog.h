@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @struct ModelSnapshot
+ * @brief An immutable view of the available models at one point in time.
+ *
+ * `names` keeps the provider's order for directory listings, while `index`
+ * provides O(1) membership checks without allocating a std::string for the
+ * lookup key. The index holds views into `names`, so snapshots are never
+ * copied, only shared.
+ */
+struct ModelSnapshot {
+    explicit ModelSnapshot(std::vector<std::string> model_names,
+                           uint64_t snapshot_version);
+    ModelSnapshot(const ModelSnapshot &) = delete;
+    ModelSnapshot &operator=(const ModelSnapshot &) = delete;
+
+    bool contains(std::string_view name) const {
+        return index.find(name) != index.end();
+    }
+
+    const std::vector<std::string> names;
+    const std::unordered_set<std::string_view> index;
+    const uint64_t version;
+};
+
+/**
+ * @class ModelCatalog
+ * @brief Holds the list of available models and keeps it fresh in the
+ * background.
+ *
+ * Readers (every getattr/open/read under /models and /config) load the
+ * current snapshot through an atomic shared pointer and never contend with
+ * the refresher. Updates build a new snapshot and publish it copy-on-write.
+ * The last successful list is persisted to a cache file so the filesystem can
+ * mount instantly, even while the provider is unreachable.
+ */
+class ModelCatalog {
+  public:
+    // Returns the provider's model list, or nullopt if the fetch failed.
+    using Fetcher = std::function<std::optional<std::vector<std::string>>()>;
+
+    ModelCatalog();
+    ~ModelCatalog();
+
+    ModelCatalog(const ModelCatalog &) = delete;
+    ModelCatalog &operator=(const ModelCatalog &) = delete;
+
+    /**
+     * @brief Returns the current snapshot. Never null.
+     */
+    std::shared_ptr<const ModelSnapshot> snapshot() const;
+
+    /**
+     * @brief O(1) membership check against the current snapshot.
+     */
+    bool contains(std::string_view name) const;
+
+    /**
+     * @brief Atomically replaces the current model list.
+     */
+    void publish(std::vector<std::string> names);
+
+    /**
+     * @brief Loads a model list previously written by save_cache().
+     * @param path The cache file.
+     * @param base_url The API root the list must have been fetched from;
+     * caches written for another provider are ignored.
+     * @return The cached list, or nullopt if missing, stale or corrupt.
+     */
+    static std::optional<std::vector<std::string>>
+    load_cache(const std::string &path, std::string_view base_url);
+
+    /**
+     * @brief Persists a model list atomically (write to temp file + rename).
+     * @return True on success.
+     */
+    static bool save_cache(const std::string &path, std::string_view base_url,
+                           const std::vector<std::string> &names);
+
+    /**
+     * @brief Starts the background refresher. The first fetch happens
+     * immediately; later ones every `interval`. Successful fetches are
+     * published and written to `cache_path` (if not empty).
+     */
+    void start_refresh(Fetcher fetch, std::chrono::seconds interval,
+                       std::string cache_path, std::string base_url);
+
+    /**
+     * @brief Wakes the refresher to fetch immediately.
+     */
+    void refresh_now();
+
+    /**
+     * @brief Stops the refresher thread, if running. Idempotent.
+     */
+    void stop();
+
+  private:
+    void refresh_loop(Fetcher fetch, std::chrono::seconds interval,
+                      std::string cache_path, std::string base_url);
+
+    std::shared_ptr<const ModelSnapshot> current_;
+    std::atomic<uint64_t> next_version_{1};
+
+    std::thread refresher_;
+    std::mutex mtx_; // 保护 stop_/wake_ 以及条件变量
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool wake_ = false;
+};
+
+} // namespace fusellm
@@ -1,36 +1,76 @@
 #include "ZmqClient.h"
 #include "spdlog/spdlog.h"
-#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 // 包含 zmq_addon.hpp 以使用高级封装，如 zmq::multipart_t。
 #include <zmq_addon.hpp>
 
 namespace fusellm {
 
-// 为通信设定一个超时时间（毫秒），以防止客户端在服务端无响应时永久阻塞。
-constexpr int ZMQ_REQUEST_TIMEOUT_MS = 5000;
+namespace {
 
-ZmqClient::ZmqClient()
-    // 初始化 ZeroMQ 上下文，使用8个I/O线程。
-    : context_(8),
-      // 使用上下文创建一个 REQ (请求) 类型的套接字。
-      socket_(context_, zmq::socket_type::req) {
-    // 设置套接字的接收超时选项。
-    socket_.set(zmq::sockopt::rcvtimeo, ZMQ_REQUEST_TIMEOUT_MS);
+// 心跳使用保留的关联 ID 0，普通请求从 1 开始编号。
+const std::string HEARTBEAT_ID = "0";
+
+} // namespace
+
+ZmqClient::ZmqClient(ZmqClientOptions options)
+    : options_(options),
+      // 初始化 ZeroMQ 上下文，使用8个I/O线程。
+      context_(8),
+      // 使用上下文创建一个 DEALER 类型的套接字。
+      socket_(context_, zmq::socket_type::dealer) {
+    // 关闭时丢弃未发出的请求，不等待服务端。
+    socket_.set(zmq::sockopt::linger, 0);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        SPDLOG_ERROR("ZmqClient cannot create its wake-up eventfd: {}",
+                     std::strerror(errno));
+    }
     SPDLOG_DEBUG("ZmqClient initialized.");
 }
 
-void ZmqClient::connect(const std::string &endpoint) {
-    // 使用锁确保连接操作的线程安全。
-    std::lock_guard<std::mutex> lock(mtx_);
+ZmqClient::~ZmqClient() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    if (io_thread_.joinable()) {
+        wake();
+        io_thread_.join();
+    }
+    // I/O 线程已退出，直接完成所有仍在等待的调用
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto &[id, call] : pending_) {
+            call->reply.set_value(R"({"error":"Client is shutting down."})");
+        }
+        pending_.clear();
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+}
 
+void ZmqClient::connect(const std::string &endpoint) {
     if (is_connected_) {
         SPDLOG_WARN("ZmqClient is already connected.");
         return;
     }
+    if (wake_fd_ < 0) {
+        return; // 构造时已记录错误
+    }
 
     try {
         socket_.connect(endpoint);
+        endpoint_ = endpoint;
+        // 从这里开始套接字只归 I/O 线程使用
+        io_thread_ = std::thread(&ZmqClient::io_loop, this);
         is_connected_ = true;
         SPDLOG_INFO("ZmqClient successfully connected to endpoint: {}",
                      endpoint);
@@ -39,63 +79,288 @@ void ZmqClient::connect(const std::string &endpoint) {
         SPDLOG_ERROR(
             "ZmqClient failed to connect to endpoint '{}': {} (errno: {})",
             endpoint, e.what(), e.num());
-        // 抛出异常或设置错误状态，让调用者知道失败。
         // 在这里我们仅记录错误，send_request 会检查 is_connected_ 状态。
     }
 }
 
+void ZmqClient::wake() {
+    const uint64_t one = 1;
+    if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+        SPDLOG_WARN("Cannot wake the ZMQ I/O thread: {}", std::strerror(errno));
+    }
+}
+
 std::string ZmqClient::send_request(const std::string &op,
                                     const std::string &payload) {
-    // 锁定互斥锁，以确保一次只有一个线程可以使用 REQ 套接字。
-    // lock_guard 会在作用域结束时自动释放锁。
-    std::lock_guard<std::mutex> lock(mtx_);
-
     if (!is_connected_) {
         SPDLOG_ERROR("Cannot send request: ZmqClient is not connected.");
         return R"({"error":"Client is not connected to the backend service."})";
     }
+    if (health() == Health::Down) {
+        // 快速失败：I/O 线程在后台重连，恢复后请求照常发送
+        SPDLOG_DEBUG("Backend is down; failing ZMQ request for op '{}'.", op);
+        return R"({"error":"Backend service is unavailable."})";
+    }
+
+    auto call = std::make_shared<Call>();
+    call->op = op;
+    call->payload = payload;
+    auto reply = call->reply.get_future();
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stop_) {
+            return R"({"error":"Client is shutting down."})";
+        }
+        id = next_id_++;
+        pending_.emplace(id, call);
+        outbox_.push_back(id);
+    }
+    wake();
+
+    SPDLOG_DEBUG("Queued ZMQ request #{}. Op: '{}', Payload size: {}", id, op,
+                 payload.length());
+
+    if (reply.wait_for(options_.request_timeout) == std::future_status::ready) {
+        return reply.get();
+    }
+
+    // 超时：撤回请求，之后迟到的回复会被丢弃。后端是否失联由心跳判断，
+    // 慢请求本身不会触发重连。
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (pending_.erase(id) == 0) {
+            // 回复恰好在撤回前到达
+            return reply.get();
+        }
+    }
+    SPDLOG_WARN("ZMQ request for op '{}' timed out after {} ms.", op,
+                options_.request_timeout.count());
+    return R"({"error":"Request to backend service timed out."})";
+}
 
+void ZmqClient::open_socket() {
+    socket_ = zmq::socket_t(context_, zmq::socket_type::dealer);
+    socket_.set(zmq::sockopt::linger, 0);
+    socket_.connect(endpoint_);
+}
+
+bool ZmqClient::send_frames(const std::string &id, const std::string &op,
+                            const std::string &payload) {
+    zmq::multipart_t request_msg;
+    request_msg.addstr(id);      // 关联 ID
+    request_msg.addstr("");      // 信封分隔帧
+    request_msg.addstr(op);      // 操作码
+    request_msg.addstr(payload); // 载荷
     try {
-        // 1. 构造一个多部分消息 (multipart message) 用于发送。
-        zmq::multipart_t request_msg;
-        request_msg.addstr(op);      // 第一部分：操作码
-        request_msg.addstr(payload); // 第二部分：载荷
+        if (request_msg.send(socket_, ZMQ_DONTWAIT)) {
+            return true;
+        }
+    } catch (const zmq::error_t &e) {
+        SPDLOG_ERROR("ZMQ communication failed during request for op '{}': "
+                     "{} (errno: {})",
+                     op, e.what(), e.num());
+    }
+    return false;
+}
 
-        SPDLOG_DEBUG("Sending ZMQ request. Op: '{}', Payload size: {}", op,
-                      payload.length());
+void ZmqClient::io_loop() {
+    // 启动后立即发送第一次心跳，尽快得知后端状态
+    ping_sent_ = Clock::now() - options_.heartbeat_interval;
+    while (true) {
+        check_liveness(Clock::now());
 
-        // 2. 发送请求。send() 方法会处理多部分消息的发送。
-        request_msg.send(socket_);
+        zmq::pollitem_t items[] = {{socket_.handle(), 0, ZMQ_POLLIN, 0},
+                                   {nullptr, wake_fd_, ZMQ_POLLIN, 0}};
+        try {
+            zmq::poll(items, 2,
+                      std::chrono::milliseconds(poll_timeout_ms(Clock::now())));
+        } catch (const zmq::error_t &e) {
+            if (e.num() == EINTR) {
+                continue;
+            }
+            SPDLOG_ERROR("ZMQ I/O thread stopped: {} (errno: {})", e.what(),
+                         e.num());
+            return;
+        }
 
-        // 3. 等待并接收回复。
-        zmq::multipart_t reply_msg;
-        // recv() 会在超时或成功接收后返回。返回值为 true 表示成功。
-        if (reply_msg.recv(socket_)) {
-            // 假设回复总是一个单部分消息，其中包含结果字符串。
-            if (reply_msg.size() == 1) {
-                std::string reply_str = reply_msg.popstr();
-                SPDLOG_DEBUG("Received ZMQ reply for op '{}'. Reply size: {}",
-                              op, reply_str.length());
-                return reply_str;
+        if (items[1].revents & ZMQ_POLLIN) {
+            uint64_t count;
+            if (::read(wake_fd_, &count, sizeof(count)) < 0 &&
+                errno != EAGAIN) {
+                SPDLOG_WARN("Cannot read the ZMQ wake-up eventfd: {}",
+                            std::strerror(errno));
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (stop_) {
+                    return;
+                }
+            }
+            flush_outbox();
+        }
+        if (items[0].revents & ZMQ_POLLIN) {
+            drain_replies();
+        }
+    }
+}
+
+std::chrono::milliseconds ZmqClient::silence_limit() const {
+    // 在线时心跳 request_timeout 没有回复即判定失联；失联后每次重连只等
+    // 一个退避间隔
+    return retry_delay_.count() > 0 ? retry_delay_ : options_.request_timeout;
+}
+
+int ZmqClient::poll_timeout_ms(Clock::time_point now) const {
+    const auto deadline = ping_in_flight_
+                              ? ping_sent_ + silence_limit()
+                              : ping_sent_ + options_.heartbeat_interval;
+    const auto ms =
+        std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+    return static_cast<int>(std::max<int64_t>(ms, 0));
+}
+
+void ZmqClient::check_liveness(Clock::time_point now) {
+    if (ping_in_flight_) {
+        if (now - ping_sent_ >= silence_limit()) {
+            reconnect(now);
+        }
+        return;
+    }
+    if (now - ping_sent_ >= options_.heartbeat_interval) {
+        send_heartbeat(now);
+    }
+}
+
+void ZmqClient::send_heartbeat(Clock::time_point now) {
+    // 发送失败（如队列已满）按没有回复处理
+    send_frames(HEARTBEAT_ID, "ping", "{}");
+    ping_in_flight_ = true;
+    ping_sent_ = now;
+}
+
+void ZmqClient::reconnect(Clock::time_point now) {
+    retry_delay_ = retry_delay_.count() == 0
+                       ? options_.retry_min
+                       : std::min(retry_delay_ * 2, options_.retry_max);
+    if (health_.exchange(Health::Down) != Health::Down) {
+        SPDLOG_WARN("Backend at '{}' is not responding; failing requests "
+                    "fast and reconnecting.",
+                    endpoint_);
+    } else {
+        SPDLOG_DEBUG("Backend at '{}' is still down; next retry in {} ms.",
+                     endpoint_, retry_delay_.count());
+    }
+
+    // 已发出的请求不会在新套接字上得到回复，立即让调用者失败
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->second->sent) {
+                it->second->reply.set_value(
+                    R"({"error":"Backend service stopped responding."})");
+                it = pending_.erase(it);
             } else {
-                SPDLOG_WARN("Received unexpected multipart reply ({} parts) "
-                             "for op '{}'. Discarding.",
-                             reply_msg.size(), op);
-                return R"({"error":"Received malformed multipart reply from service."})";
+                ++it;
             }
-        } else {
-            // recv() 返回 false 表示操作超时。
-            SPDLOG_WARN("ZMQ request for op '{}' timed out after {} ms.", op,
-                         ZMQ_REQUEST_TIMEOUT_MS);
-            return R"({"error":"Request to backend service timed out."})";
         }
+    }
+
+    // 关闭旧套接字会丢弃其中排队的请求和迟到的回复
+    try {
+        socket_.close();
+        open_socket();
     } catch (const zmq::error_t &e) {
-        // 捕获任何其他 ZMQ 相关的运行时错误。
-        SPDLOG_ERROR("ZMQ communication failed during request for op '{}': {} "
-                      "(errno: {})",
-                      op, e.what(), e.num());
-        return R"({"error":"A ZMQ communication error occurred."})";
+        SPDLOG_ERROR("Cannot recreate the ZMQ socket for '{}': {} (errno: {})",
+                     endpoint_, e.what(), e.num());
+    }
+    send_heartbeat(now);
+}
+
+void ZmqClient::heard_from_server() {
+    ping_in_flight_ = false;
+    const Health previous = health_.exchange(Health::Up);
+    if (previous == Health::Down) {
+        SPDLOG_INFO("Backend at '{}' is responding again.", endpoint_);
+    } else if (previous == Health::Connecting) {
+        SPDLOG_INFO("Backend at '{}' is up.", endpoint_);
+    }
+    retry_delay_ = std::chrono::milliseconds(0);
+}
+
+void ZmqClient::flush_outbox() {
+    while (true) {
+        uint64_t id;
+        std::shared_ptr<Call> call;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (outbox_.empty()) {
+                return;
+            }
+            id = outbox_.front();
+            outbox_.pop_front();
+            auto it = pending_.find(id);
+            if (it == pending_.end()) {
+                continue; // 调用者已超时放弃
+            }
+            call = it->second;
+            call->sent = true;
+        }
+
+        if (!send_frames(std::to_string(id), call->op, call->payload)) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (pending_.erase(id) > 0) {
+                call->reply.set_value(
+                    R"({"error":"A ZMQ communication error occurred."})");
+            }
+        }
+    }
+}
+
+void ZmqClient::drain_replies() {
+    while (true) {
+        zmq::multipart_t reply_msg;
+        try {
+            if (!reply_msg.recv(socket_, ZMQ_DONTWAIT)) {
+                break; // 没有更多回复
+            }
+        } catch (const zmq::error_t &e) {
+            SPDLOG_ERROR("ZMQ receive failed: {} (errno: {})", e.what(),
+                         e.num());
+            break;
+        }
+
+        // 期望 [关联 ID, 空帧, 结果]
+        if (reply_msg.size() != 3) {
+            SPDLOG_WARN("Received unexpected multipart reply ({} parts). "
+                        "Discarding.",
+                        reply_msg.size());
+            continue;
+        }
+        const std::string id_str = reply_msg.popstr();
+        reply_msg.popstr(); // 空帧
+        std::string reply_str = reply_msg.popstr();
+        if (id_str == HEARTBEAT_ID) {
+            heard_from_server();
+            continue;
+        }
+        const uint64_t id = std::strtoull(id_str.c_str(), nullptr, 10);
+
+        std::shared_ptr<Call> call;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = pending_.find(id);
+            if (it == pending_.end()) {
+                SPDLOG_DEBUG("Discarding late ZMQ reply #{}.", id_str);
+                continue;
+            }
+            call = std::move(it->second);
+            pending_.erase(it);
+        }
+        SPDLOG_DEBUG("Received ZMQ reply #{} for op '{}'. Reply size: {}", id,
+                     call->op, reply_str.length());
+        call->reply.set_value(std::move(reply_str));
     }
 }
 
-} // namespace fusellm
\ No newline at end of file
+} // namespace fusellm
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 // cppzmq 是一个头文件only的库，直接包含即可。
 // 它为 libzmq C API 提供了 RAII 封装和异常处理。
@@ -9,52 +17,96 @@
 
 namespace fusellm {
 
+/**
+ * @struct ZmqClientOptions
+ * @brief ZmqClient 的超时、心跳和重连退避参数。
+ */
+struct ZmqClientOptions {
+    // 调用者等待回复的最长时间；心跳这么久没有回复也被判定为失联。
+    std::chrono::milliseconds request_timeout{5000};
+    // 发送 ping 的间隔，有请求在途时也照常发送。
+    std::chrono::milliseconds heartbeat_interval{1000};
+    // 失联后重连的退避间隔，从 retry_min 开始每次翻倍，最多 retry_max。
+    std::chrono::milliseconds retry_min{250};
+    std::chrono::milliseconds retry_max{8000};
+};
+
 /**
  * @class ZmqClient
- * @brief 通过 ZeroMQ (REQ-REP模式) 与 Python 后端服务通信的客户端。
+ * @brief 通过 ZeroMQ 与 Python 后端服务通信的客户端。
+ *
+ * 此类封装了与 Python 语义搜索服务交互的细节。使用一个 DEALER 套接字，
+ * 每个请求带有关联 ID，因此多个 FUSE 回调线程可以同时有请求在途，
+ * 一个慢请求（如 add_document）不会挡住其他请求（如 getattr 发出的
+ * list_indexes）。
  *
- * 此类封装了与 Python 语义搜索服务交互的细节。
- * 它是线程安全的，允许多个 FUSE 回调线程通过它发送请求。
+ * 套接字只由内部的 I/O 线程使用：调用线程把请求放入发送队列，I/O 线程
+ * 负责发送，并按关联 ID 把回复交给等待中的调用者。
+ *
+ * 线上格式为 [关联 ID, 空帧, 操作码, 载荷]，回复为 [关联 ID, 空帧, 结果]。
+ * 关联 ID 位于空帧之前，是信封的一部分，REP 和 ROUTER 服务端都会原样带回。
+ *
+ * 可靠性采用 "lazy pirate" 模式：I/O 线程定期发送 ping 心跳，服务端
+ * 不占用工作进程直接回答。后端是否在线只看心跳：一次心跳长时间没有回复
+ * 时，判定后端失联，让在途请求立即失败，关闭并重建套接字，再以指数退避
+ * 的间隔重连。失联期间 send_request() 立即返回错误，而不是让每个调用者
+ * 各等 5 秒。一个慢请求只会让它自己超时，不影响对后端的判断。
  */
 class ZmqClient {
   public:
     /**
      * @brief 构造一个新的 ZmqClient 实例。
      *
-     * 初始化 ZeroMQ 上下文和 REQ 类型的套接字。
-     * 还为套接字设置了一个合理的接收超时时间，以防止无限期阻塞。
+     * 初始化 ZeroMQ 上下文和 DEALER 类型的套接字。I/O 线程在 connect()
+     * 成功后启动。
      */
-    ZmqClient();
+    explicit ZmqClient(ZmqClientOptions options = {});
 
     /**
-     * @brief 默认析构函数。
-     *
-     * 由于使用了 RAII 类型的 zmq::socket_t 和 zmq::context_t，
-     * 资源会自动被正确释放。
+     * @brief 停止 I/O 线程。仍在等待的请求立即以错误返回。
      */
-    ~ZmqClient() = default;
+    ~ZmqClient();
 
     // 删除拷贝构造和赋值操作，确保单例或受控的实例生命周期。
     ZmqClient(const ZmqClient &) = delete;
     ZmqClient &operator=(const ZmqClient &) = delete;
 
+    enum class Health {
+        Connecting, // 尚未收到服务端的任何回复
+        Up,         // 服务端在按时回复
+        Down,       // 服务端失联，正在退避重连；请求立即失败
+    };
+
     /**
-     * @brief 连接到 ZeroMQ 服务端点。
+     * @brief 后端当前的健康状态。
+     */
+    Health health() const { return health_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 请求是否有可能成功，即已连接且后端没有被判定为失联。
+     * 处理器据此快速失败。
+     */
+    bool available() const {
+        return is_connected_ && health() != Health::Down;
+    }
+
+    /**
+     * @brief 连接到 ZeroMQ 服务端点，并启动 I/O 线程。
      * @param endpoint ZeroMQ 端点地址 (例如 "ipc:///tmp/fusellm.ipc" 或
      * "tcp://localhost:5555")。
      *
-     * 此方法是线程安全的。
+     * 应在发送任何请求之前调用一次。
      */
     void connect(const std::string &endpoint);
 
     /**
      * @brief 向 Python 服务发送一个两部分的请求并等待回复。
      *
-     * 请求是一个多部分消息：
+     * 请求的有效部分是一个多部分消息：
      * - Part 1: 操作码 (op), e.g., "create_index", "add_document", "query"。
      * - Part 2: 载荷 (payload), 通常是一个 JSON 字符串，包含操作所需的数据。
      *
-     * 此方法是线程安全的，内部使用互斥锁来序列化对单个 REQ 套接字的访问。
+     * 此方法是线程安全的，且不会被其他线程的请求阻塞。
      *
      * @param op 要执行的操作的字符串标识符。
      * @param payload 与操作相关的数据，通常为 JSON 格式。
@@ -65,18 +117,81 @@ class ZmqClient {
     std::string send_request(const std::string &op, const std::string &payload);
 
   private:
+    using Clock = std::chrono::steady_clock;
+
+    // 一个在途请求
+    struct Call {
+        std::string op;
+        std::string payload;
+        std::promise<std::string> reply;
+        bool sent = false; // 已写入当前套接字
+    };
+
+    void io_loop();
+
+    // 创建 DEALER 套接字并连接 endpoint_
+    void open_socket();
+
+    // 发送一条 [关联 ID, 空帧, 操作码, 载荷] 消息；在 I/O 线程上调用
+    bool send_frames(const std::string &id, const std::string &op,
+                     const std::string &payload);
+
+    // 按间隔发送心跳，并在心跳过久没有回复时重连；在 I/O 线程上调用
+    void check_liveness(Clock::time_point now);
+
+    void send_heartbeat(Clock::time_point now);
+
+    // 等待心跳回复的最长时间
+    std::chrono::milliseconds silence_limit() const;
+
+    // 让已发出的请求失败，重建套接字并安排下一次重连；在 I/O 线程上调用
+    void reconnect(Clock::time_point now);
+
+    // 收到心跳回复后调用；在 I/O 线程上调用
+    void heard_from_server();
+
+    // 距离下一次 check_liveness() 需要处理的事件的毫秒数
+    int poll_timeout_ms(Clock::time_point now) const;
+
+    // 发送队列中的请求；在 I/O 线程上调用
+    void flush_outbox();
+
+    // 读取所有已到达的回复并交给对应的调用者；在 I/O 线程上调用
+    void drain_replies();
+
+    // 唤醒 I/O 线程
+    void wake();
+
+    const ZmqClientOptions options_;
+
     // ZeroMQ 上下文，是所有套接字的基础。
     zmq::context_t context_;
 
-    // ZeroMQ REQ (请求) 类型套接字。
+    // ZeroMQ DEALER 类型套接字，启动后只由 io_thread_ 使用。
     zmq::socket_t socket_;
+    std::string endpoint_;
 
-    // 用于保护对 socket_ 的并发访问的互斥锁，因为 REQ 套接字是有状态的，
-    // 不能被多个线程同时使用。
+    // 保护 outbox_、pending_ 和 stop_
     std::mutex mtx_;
+    // 等待 I/O 线程发送的请求的关联 ID
+    std::deque<uint64_t> outbox_;
+    // 已提交但尚未收到回复的请求，按关联 ID 索引
+    std::unordered_map<uint64_t, std::shared_ptr<Call>> pending_;
+    bool stop_ = false;
+    uint64_t next_id_ = 1;
+
+    int wake_fd_ = -1; // eventfd，有新请求或需要停止时写入
+    std::thread io_thread_;
+
+    // 以下状态只由 I/O 线程访问
+    Clock::time_point ping_sent_; // 上次发送心跳的时间
+    bool ping_in_flight_ = false; // 心跳是否在等待回复
+    std::chrono::milliseconds retry_delay_{0}; // 当前重连退避间隔；0 表示在线
+
+    std::atomic<Health> health_{Health::Connecting};
 
     // 标记连接状态，以避免重复连接。
-    bool is_connected_ = false;
+    std::atomic<bool> is_connected_{false};
 };
 
-} // namespace fusellm
\ No newline at end of file
+} // namespace fusellm
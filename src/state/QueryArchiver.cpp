@@ -0,0 +1,270 @@
+#include "QueryArchiver.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fusellm {
+
+namespace {
+
+// 待归档查询的上限；归档线程跟不上时丢弃新查询而不是无限占用内存
+constexpr size_t MAX_QUEUED = 4096;
+
+// The number of an archive ID ("query-1042"), or -1 for other sessions.
+long archive_number(const std::string &id) {
+    const std::string_view prefix = QueryArchiver::ARCHIVE_PREFIX;
+    if (id.size() <= prefix.size() || id.compare(0, prefix.size(), prefix)) {
+        return -1;
+    }
+    if (!std::all_of(id.begin() + prefix.size(), id.end(),
+                     [](char c) { return c >= '0' && c <= '9'; })) {
+        return -1;
+    }
+    return std::strtol(id.c_str() + prefix.size(), nullptr, 10);
+}
+
+} // namespace
+
+QueryArchiver::QueryArchiver(SessionManager &sessions, ArchivePolicy policy)
+    : sessions_(sessions), policy_(policy) {}
+
+QueryArchiver::~QueryArchiver() { stop(); }
+
+void QueryArchiver::start() {
+    if (!policy_.enabled) {
+        SPDLOG_INFO("Archiving of /models queries is disabled.");
+        return;
+    }
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+        running_ = true;
+    }
+    worker_ = std::thread(&QueryArchiver::run, this);
+}
+
+void QueryArchiver::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+bool QueryArchiver::submit(std::string model, std::string prompt,
+                           std::string response) {
+    if (!policy_.enabled) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (queue_.size() >= MAX_QUEUED) {
+            SPDLOG_WARN("Archive queue is full; query to '{}' not archived.",
+                        model);
+            return false;
+        }
+        queue_.push_back(
+            Query{std::move(model), std::move(prompt), std::move(response)});
+    }
+    work_cv_.notify_one();
+    return true;
+}
+
+void QueryArchiver::flush() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    idle_cv_.wait(lock, [&] {
+        return (queue_.empty() && !busy_) || !running_;
+    });
+}
+
+size_t QueryArchiver::archived() const {
+    std::lock_guard<std::mutex> lock(index_mtx_);
+    return index_.size();
+}
+
+void QueryArchiver::run() {
+    adopt_existing();
+    collect_garbage();
+
+    auto next_gc = std::chrono::steady_clock::now() + policy_.gc_interval;
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true) {
+        work_cv_.wait_until(lock, next_gc,
+                            [&] { return stop_ || !queue_.empty(); });
+        if (!queue_.empty()) {
+            Query query = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            archive(query);
+            collect_garbage();
+            lock.lock();
+            busy_ = false;
+            if (queue_.empty()) {
+                idle_cv_.notify_all();
+            }
+            continue;
+        }
+        if (stop_) {
+            break; // Only once everything queued has been archived
+        }
+        if (std::chrono::steady_clock::now() >= next_gc) {
+            lock.unlock();
+            collect_garbage(); // Ages out archives even when idle
+            lock.lock();
+            next_gc = std::chrono::steady_clock::now() + policy_.gc_interval;
+        }
+    }
+    running_ = false;
+    idle_cv_.notify_all();
+}
+
+void QueryArchiver::adopt_existing() {
+    // Recognised by their IDs alone; nothing is loaded.
+    std::vector<std::pair<long, std::string>> archives;
+    for (auto &id : sessions_.list_sessions()) {
+        long number = archive_number(id);
+        if (number >= 0) {
+            archives.emplace_back(number, std::move(id));
+        }
+    }
+    // Auto IDs increase with creation time.
+    std::sort(archives.begin(), archives.end());
+
+    if (archives.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(index_mtx_);
+    for (auto &archive : archives) {
+        index_.push_back(Archive{std::move(archive.second), std::nullopt, 0});
+    }
+    SPDLOG_INFO("Found {} archived queries from earlier runs.",
+                archives.size());
+}
+
+void QueryArchiver::archive(Query &query) {
+    try {
+        // Create a new session with an auto-generated, PID-like ID.
+        auto session = sessions_.create_session_with_auto_id(ARCHIVE_PREFIX);
+        if (!session) {
+            SPDLOG_ERROR("Session store unavailable; query to '{}' not "
+                         "archived.",
+                         query.model);
+            return;
+        }
+        session->populate(query.prompt, query.response);
+        session->set_model(query.model);
+        // This interaction also makes it the 'latest' session.
+        sessions_.set_latest_session_id(session->id());
+
+        std::lock_guard<std::mutex> lock(index_mtx_);
+        index_.push_back(Archive{session->id(),
+                                 std::chrono::system_clock::now(),
+                                 session->memory_bytes()});
+        index_bytes_ += index_.back().bytes;
+        SPDLOG_INFO("Archived stateless query as new conversation with ID: {}",
+                    session->id());
+    } catch (const std::exception &e) {
+        SPDLOG_ERROR("An exception occurred while creating archive session: {}",
+                     e.what());
+    }
+}
+
+bool QueryArchiver::over_limit_locked(
+    std::chrono::system_clock::time_point now) const {
+    if (index_.empty()) {
+        return false;
+    }
+    if (policy_.max_sessions && index_.size() > policy_.max_sessions) {
+        return true;
+    }
+    if (policy_.max_bytes && index_bytes_ > policy_.max_bytes) {
+        return true;
+    }
+    const auto &created = index_.front().created;
+    return policy_.max_age.count() > 0 && created &&
+           *created + policy_.max_age < now;
+}
+
+bool QueryArchiver::inspect_oldest(const std::string &id) {
+    auto error = SessionManager::Error::NotFound;
+    auto session = sessions_.find_session(id, &error);
+    if (!session && error == SessionManager::Error::Unavailable) {
+        return false;
+    }
+    auto snap = session ? session->snapshot() : nullptr;
+    session.reset();
+
+    std::lock_guard<std::mutex> lock(index_mtx_);
+    if (index_.empty() || index_.front().id != id) {
+        return true; // Reaped meanwhile
+    }
+    Archive &oldest = index_.front();
+    if (!snap) {
+        index_bytes_ -= oldest.bytes;
+        index_.pop_front(); // Removed by the user
+        return true;
+    }
+    oldest.created = snap->history.empty() ? std::chrono::system_clock::now()
+                                           : snap->history[0].timestamp;
+    index_bytes_ += snap->bytes - oldest.bytes;
+    oldest.bytes = snap->bytes;
+    return true;
+}
+
+size_t QueryArchiver::collect_garbage() {
+    const auto now = std::chrono::system_clock::now();
+    size_t removed = 0;
+    while (true) {
+        Archive victim;
+        std::string unknown;
+        {
+            std::lock_guard<std::mutex> lock(index_mtx_);
+            if (policy_.max_age.count() > 0 && !index_.empty() &&
+                !index_.front().created) {
+                unknown = index_.front().id;
+            } else if (!over_limit_locked(now)) {
+                break;
+            } else {
+                victim = std::move(index_.front());
+                index_.pop_front();
+                index_bytes_ -= victim.bytes;
+            }
+        }
+        if (!unknown.empty()) {
+            if (!inspect_oldest(unknown)) {
+                break; // Store unreachable; retried on the next pass
+            }
+            continue;
+        }
+        auto error = SessionManager::Error::NotFound;
+        auto session = sessions_.find_session(victim.id, &error);
+        if (!session && error == SessionManager::Error::Unavailable) {
+            std::lock_guard<std::mutex> lock(index_mtx_);
+            index_bytes_ += victim.bytes;
+            index_.push_front(std::move(victim));
+            break;
+        }
+        if (!session || session->snapshot()->history.size() != 2) {
+            continue; // Removed by the user, or continued as a conversation
+        }
+        session.reset();
+        if (sessions_.remove_session(victim.id)) {
+            removed++;
+        }
+    }
+    if (removed) {
+        SPDLOG_INFO("Removed {} archived queries per the retention policy.",
+                    removed);
+    }
+    return removed;
+}
+
+} // namespace fusellm
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "SessionManager.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace fusellm {
+
+/**
+ * @struct ArchivePolicy
+ * @brief How stateless /models queries are archived and how long they are
+ * kept. A limit of 0 means unlimited.
+ */
+struct ArchivePolicy {
+    bool enabled = true;
+    size_t max_sessions = 1000;
+    std::chrono::seconds max_age{0};
+    size_t max_bytes = 0; // Sum of Session::memory_bytes() at archive time
+    // How often the age limit is checked; count and size are checked after
+    // every archived query.
+    std::chrono::seconds gc_interval{60};
+};
+
+/**
+ * @class QueryArchiver
+ * @brief Archives stateless /models queries as conversations in the
+ * background and reaps old archives.
+ *
+ * submit() only queues the query; a worker thread creates the session
+ * (with a PID-like ID such as "query-1042"), so the write path pays for
+ * nothing but the LLM call. The same thread enforces the ArchivePolicy,
+ * removing the oldest archives first.
+ *
+ * Archives are marked by the ARCHIVE_PREFIX of their ID, and only marked
+ * sessions are ever reaped. At startup the archives of earlier runs are
+ * taken from the session listing without loading them; the oldest one is
+ * loaded only when the age limit needs its creation time, and their sizes
+ * count towards max_bytes once they have been loaded. An archive that was
+ * continued as a conversation (more than one exchange) is never reaped.
+ *
+ * This class is thread-safe.
+ */
+class QueryArchiver {
+  public:
+    // Start of the ID of every archived query.
+    static constexpr const char *ARCHIVE_PREFIX = "query-";
+
+    QueryArchiver(SessionManager &sessions, ArchivePolicy policy);
+
+    /**
+     * @brief Archives everything still queued, then stops the worker.
+     */
+    ~QueryArchiver();
+
+    QueryArchiver(const QueryArchiver &) = delete;
+    QueryArchiver &operator=(const QueryArchiver &) = delete;
+
+    /**
+     * @brief Starts the worker, which first picks up archives left by
+     * earlier runs. Call once sessions have been restored.
+     */
+    void start();
+
+    /**
+     * @brief Drains the queue and stops the worker. Idempotent.
+     */
+    void stop();
+
+    /**
+     * @brief Queues one query for archiving. Never blocks on I/O.
+     * @return False if archiving is disabled or the queue is full.
+     */
+    bool submit(std::string model, std::string prompt, std::string response);
+
+    /**
+     * @brief Waits until every query submitted so far has been archived.
+     */
+    void flush();
+
+    /**
+     * @brief Removes archives that violate the policy, oldest first.
+     * @return The number of sessions removed.
+     */
+    size_t collect_garbage();
+
+    /**
+     * @brief Number of archives currently known.
+     */
+    size_t archived() const;
+
+  private:
+    struct Query {
+        std::string model;
+        std::string prompt;
+        std::string response;
+    };
+
+    struct Archive {
+        std::string id;
+        // Unknown for archives of earlier runs until they are loaded.
+        std::optional<std::chrono::system_clock::time_point> created;
+        size_t bytes = 0;
+    };
+
+    void run();
+    void adopt_existing();
+    void archive(Query &query);
+    // Whether the oldest archive must go. Call with index_mtx_ held.
+    bool over_limit_locked(std::chrono::system_clock::time_point now) const;
+    // Loads the oldest archive to learn its creation time and size. Returns
+    // false if the store is unreachable.
+    bool inspect_oldest(const std::string &id);
+
+    SessionManager &sessions_;
+    const ArchivePolicy policy_;
+
+    std::mutex mtx_; // Guards the queue and the flags below
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Query> queue_;
+    bool busy_ = false; // The worker is archiving a dequeued query
+    bool stop_ = false;
+    bool running_ = false; // From start() until the worker exits
+    std::thread worker_;
+
+    // Archives in creation order. Guarded by index_mtx_, which is never
+    // held while calling into the SessionManager.
+    mutable std::mutex index_mtx_;
+    std::deque<Archive> index_;
+    size_t index_bytes_ = 0;
+};
+
+} // namespace fusellm
@@ -0,0 +1,291 @@
+#include "SearchIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <mutex>
+#include <unordered_set>
+
+namespace fusellm {
+
+namespace {
+
+// Longer words are cut; a query for the full word still finds them.
+constexpr size_t MAX_TERM_BYTES = 64;
+
+// Length of the UTF-8 sequence starting with `lead`; 1 for stray bytes.
+size_t utf8_length(unsigned char lead) {
+    if (lead >= 0xF0) {
+        return 4;
+    }
+    if (lead >= 0xE0) {
+        return 3;
+    }
+    if (lead >= 0xC0) {
+        return 2;
+    }
+    return 1;
+}
+
+uint32_t decode(std::string_view bytes) {
+    const auto b = [&](size_t i) {
+        return static_cast<uint32_t>(static_cast<unsigned char>(bytes[i]));
+    };
+    switch (bytes.size()) {
+    case 2:
+        return (b(0) & 0x1F) << 6 | (b(1) & 0x3F);
+    case 3:
+        return (b(0) & 0x0F) << 12 | (b(1) & 0x3F) << 6 | (b(2) & 0x3F);
+    case 4:
+        return (b(0) & 0x07) << 18 | (b(1) & 0x3F) << 12 |
+               (b(2) & 0x3F) << 6 | (b(3) & 0x3F);
+    default:
+        return b(0);
+    }
+}
+
+// General and CJK punctuation, which would only bloat the index.
+bool is_punctuation(uint32_t cp) {
+    return (cp >= 0x2000 && cp <= 0x206F) || (cp >= 0x3000 && cp <= 0x303F) ||
+           (cp >= 0xFF01 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20);
+}
+
+bool is_word_byte(unsigned char c) { return std::isalnum(c) || c == '_'; }
+
+} // namespace
+
+std::vector<std::string> SearchIndex::terms(std::string_view text) {
+    std::vector<std::string> result;
+    std::unordered_set<std::string> seen;
+    auto emit = [&](std::string term) {
+        if (!term.empty() && seen.insert(term).second) {
+            result.push_back(std::move(term));
+        }
+    };
+    std::string word;
+    size_t i = 0;
+    while (i < text.size()) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            if (is_word_byte(c)) {
+                if (word.size() < MAX_TERM_BYTES) {
+                    word.push_back(static_cast<char>(std::tolower(c)));
+                }
+            } else {
+                emit(std::move(word));
+                word.clear();
+            }
+            i++;
+            continue;
+        }
+        emit(std::move(word));
+        word.clear();
+        const size_t n = utf8_length(c);
+        if (n == 1 || i + n > text.size()) {
+            i++; // Not a character
+            continue;
+        }
+        std::string_view character = text.substr(i, n);
+        if (!is_punctuation(decode(character))) {
+            emit(std::string(character));
+        }
+        i += n;
+    }
+    emit(std::move(word));
+    return result;
+}
+
+SearchIndex::Batch SearchIndex::tokenize(const History &history, size_t from) {
+    Batch batch;
+    batch.from = from;
+    for (size_t i = from; i < history.size(); i++) {
+        // Other messages keep their position but are never matched.
+        const auto entry = history[i];
+        if (entry.role == Message::Role::User ||
+            entry.role == Message::Role::AI) {
+            batch.terms.push_back(terms(entry.content));
+        } else {
+            batch.terms.emplace_back();
+        }
+    }
+    return batch;
+}
+
+uint32_t SearchIndex::doc_locked(std::string_view id) {
+    auto it = doc_ids_.find(std::string(id));
+    if (it != doc_ids_.end()) {
+        return it->second;
+    }
+    uint32_t doc;
+    if (!free_docs_.empty()) {
+        doc = free_docs_.back();
+        free_docs_.pop_back();
+    } else {
+        doc = static_cast<uint32_t>(docs_.size());
+        docs_.emplace_back();
+    }
+    docs_[doc].id = id;
+    doc_ids_.emplace(docs_[doc].id, doc);
+    return doc;
+}
+
+void SearchIndex::insert_locked(uint32_t doc, const Batch &batch) {
+    Doc &d = docs_[doc];
+    for (size_t i = 0; i < batch.terms.size(); i++) {
+        const auto message = static_cast<uint32_t>(batch.from + i);
+        for (const auto &term : batch.terms[i]) {
+            auto [it, inserted] = term_ids_.try_emplace(
+                term, static_cast<uint32_t>(postings_.size()));
+            if (inserted) {
+                postings_.emplace_back();
+            }
+            Positions &positions = postings_[it->second][doc];
+            if (positions.empty()) {
+                d.terms.push_back(it->second);
+            }
+            positions.push_back(message);
+            postings_count_++;
+        }
+    }
+    d.messages = batch.from + batch.terms.size();
+    messages_ += batch.terms.size();
+}
+
+void SearchIndex::truncate_locked(uint32_t doc, size_t size) {
+    Doc &d = docs_[doc];
+    if (size >= d.messages) {
+        return;
+    }
+    std::vector<uint32_t> kept;
+    for (uint32_t term : d.terms) {
+        auto &by_doc = postings_[term];
+        auto it = by_doc.find(doc);
+        Positions &positions = it->second;
+        auto cut = std::lower_bound(positions.begin(), positions.end(), size);
+        postings_count_ -= static_cast<size_t>(positions.end() - cut);
+        positions.erase(cut, positions.end());
+        if (positions.empty()) {
+            by_doc.erase(it);
+        } else {
+            kept.push_back(term);
+        }
+    }
+    d.terms = std::move(kept);
+    messages_ -= d.messages - size;
+    d.messages = size;
+}
+
+void SearchIndex::add(std::string_view id, const History &history) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = doc_ids_.find(std::string(id));
+        if (it != doc_ids_.end() &&
+            docs_[it->second].messages == history.size()) {
+            return;
+        }
+    }
+    replace(id, history);
+}
+
+void SearchIndex::replace(std::string_view id, const History &history) {
+    const Batch batch = tokenize(history, 0);
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    const uint32_t doc = doc_locked(id);
+    truncate_locked(doc, 0);
+    insert_locked(doc, batch);
+}
+
+void SearchIndex::append(std::string_view id, const History &history,
+                         size_t from) {
+    const Batch batch = tokenize(history, from);
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        const uint32_t doc = doc_locked(id);
+        if (docs_[doc].messages == from) {
+            insert_locked(doc, batch);
+            return;
+        }
+    }
+    replace(id, history); // Out of step, e.g. an earlier change was missed
+}
+
+void SearchIndex::truncate(std::string_view id, size_t size) {
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    auto it = doc_ids_.find(std::string(id));
+    if (it != doc_ids_.end()) {
+        truncate_locked(it->second, size);
+    }
+}
+
+void SearchIndex::remove(std::string_view id) {
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    auto it = doc_ids_.find(std::string(id));
+    if (it == doc_ids_.end()) {
+        return;
+    }
+    const uint32_t doc = it->second;
+    truncate_locked(doc, 0);
+    doc_ids_.erase(it);
+    docs_[doc] = Doc();
+    free_docs_.push_back(doc);
+}
+
+std::vector<SearchIndex::Match> SearchIndex::search(std::string_view query,
+                                                    size_t limit) const {
+    const auto words = terms(query);
+    std::vector<Match> matches;
+    if (words.empty() || limit == 0) {
+        return matches;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    std::vector<const std::map<uint32_t, Positions> *> lists;
+    for (const auto &word : words) {
+        auto it = term_ids_.find(word);
+        if (it == term_ids_.end() || postings_[it->second].empty()) {
+            return matches; // Some term occurs nowhere
+        }
+        lists.push_back(&postings_[it->second]);
+    }
+    // Walk the rarest term and probe the others.
+    std::sort(lists.begin(), lists.end(),
+              [](const auto *a, const auto *b) { return a->size() < b->size(); });
+
+    Positions common;
+    Positions scratch;
+    for (const auto &[doc, positions] : *lists.front()) {
+        const Positions *found = &positions;
+        for (size_t k = 1; k < lists.size() && !found->empty(); k++) {
+            auto it = lists[k]->find(doc);
+            if (it == lists[k]->end()) {
+                found = &scratch;
+                scratch.clear();
+                break;
+            }
+            common.clear();
+            std::set_intersection(found->begin(), found->end(),
+                                  it->second.begin(), it->second.end(),
+                                  std::back_inserter(common));
+            scratch.swap(common);
+            found = &scratch;
+        }
+        for (uint32_t message : *found) {
+            matches.push_back({docs_[doc].id, message});
+            if (matches.size() == limit) {
+                return matches;
+            }
+        }
+    }
+    return matches;
+}
+
+SearchIndex::Stats SearchIndex::stats() const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    Stats stats;
+    stats.sessions = doc_ids_.size();
+    stats.messages = messages_;
+    stats.terms = term_ids_.size();
+    stats.postings = postings_count_;
+    return stats;
+}
+
+} // namespace fusellm
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "../common/History.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class SearchIndex
+ * @brief An in-memory inverted index over the user and AI messages of every
+ * session, behind /conversations/_search.
+ *
+ * Text is split into terms: runs of ASCII letters, digits and '_' (case
+ * folded), and single non-ASCII characters, so CJK text is matched
+ * character by character. For each term the index keeps, per session, the
+ * ascending positions of the messages that contain it. A query matches the
+ * messages containing all of its terms and is answered by intersecting the
+ * postings of its rarest term with the others, without touching any
+ * message.
+ *
+ * Sessions keep the index up to date as their history changes (see
+ * Session::track_search()): appended turns are tokenized on their own, a
+ * rolled-back turn only trims postings, and only a replaced history is
+ * indexed again from scratch.
+ *
+ * This class is thread-safe. Tokenizing happens outside the lock.
+ */
+class SearchIndex {
+  public:
+    struct Match {
+        std::string session_id;
+        size_t message; // Position in the session's history
+    };
+
+    struct Stats {
+        size_t sessions = 0;
+        size_t messages = 0;
+        size_t terms = 0;
+        size_t postings = 0; // (term, message) pairs
+    };
+
+    /**
+     * @brief Indexes `history` as session `id`, unless the same number of
+     * messages is indexed for it already (a session loaded back in).
+     */
+    void add(std::string_view id, const History &history);
+
+    /**
+     * @brief Indexes `history` as session `id`, dropping whatever was
+     * indexed for it before.
+     */
+    void replace(std::string_view id, const History &history);
+
+    /**
+     * @brief Indexes the messages of `history` from position `from` on,
+     * which were appended to the `from` messages indexed so far. Falls back
+     * to replace() if the index is at a different position.
+     */
+    void append(std::string_view id, const History &history, size_t from);
+
+    /**
+     * @brief Forgets the messages of session `id` from position `size` on.
+     */
+    void truncate(std::string_view id, size_t size);
+
+    void remove(std::string_view id);
+
+    /**
+     * @brief The first `limit` messages containing every term of `query`,
+     * grouped by session. An empty query matches nothing.
+     */
+    std::vector<Match> search(std::string_view query, size_t limit) const;
+
+    Stats stats() const;
+
+    /**
+     * @brief The distinct terms of `text`, in order of first occurrence.
+     */
+    static std::vector<std::string> terms(std::string_view text);
+
+  private:
+    // Messages of one session that contain a term, in ascending order.
+    using Positions = std::vector<uint32_t>;
+
+    struct Doc {
+        std::string id;
+        size_t messages = 0;         // Indexed so far
+        std::vector<uint32_t> terms; // Terms with postings for this doc
+    };
+
+    // Terms of messages [from, from + terms.size()).
+    struct Batch {
+        size_t from = 0;
+        std::vector<std::vector<std::string>> terms;
+    };
+
+    static Batch tokenize(const History &history, size_t from);
+
+    uint32_t doc_locked(std::string_view id);
+    void insert_locked(uint32_t doc, const Batch &batch);
+    void truncate_locked(uint32_t doc, size_t size);
+
+    mutable std::shared_mutex mtx_;
+    std::unordered_map<std::string, uint32_t> doc_ids_;
+    std::vector<Doc> docs_;
+    std::vector<uint32_t> free_docs_; // Slots of removed sessions
+    std::unordered_map<std::string, uint32_t> term_ids_;
+    // Per term, the positions of its messages in each doc, by doc.
+    std::vector<std::map<uint32_t, Positions>> postings_;
+    size_t messages_ = 0;
+    size_t postings_count_ = 0;
+};
+
+} // namespace fusellm
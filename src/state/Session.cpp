@@ -1,70 +1,379 @@
 #include "Session.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <sstream>
 
 namespace fusellm {
 
-Session::Session(std::string_view id, const ConfigManager &global_config)
-    : id_(id) {
-    // Initialize the session with default settings from the global config
-    model_name_ = global_config.default_model_;
-    session_params_ = global_config.global_params_;
+namespace {
+
+// 等待提示完成时检查调用方取消令牌的间隔（FUSE 中断只能轮询）
+constexpr std::chrono::milliseconds CANCEL_POLL_INTERVAL{100};
+
+// 字符串占用的堆内存；短字符串优化（SSO）时为 0
+size_t heap_bytes(const std::string &s) {
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+// Blob 的文本；与其他会话共享的文本也按全额计算
+size_t blob_bytes(const Blob &b) {
+    return b.empty() ? 0 : sizeof(std::string) + b.size() + 1;
+}
+
+// 一个快照版本占用的内存（含会话对象本身）
+size_t footprint(const SessionSnapshot &s) {
+    size_t bytes = sizeof(Session) + sizeof(SessionSnapshot) +
+                   s.history.memory_bytes();
+    bytes += s.context.memory_bytes() + heap_bytes(s.latest_response) +
+             heap_bytes(s.model_name);
+    if (s.overrides.system_prompt) {
+        bytes += blob_bytes(*s.overrides.system_prompt);
+    }
+    return bytes;
+}
+
+} // namespace
+
+Session::Session(std::string_view id, const ConfigManager &global_config,
+                 SessionStore *store)
+    : id_(id), config_(global_config), store_(store) {
+    // Initialize the session with the default model from the global config
+    auto initial = std::make_shared<SessionSnapshot>();
+    initial->model_name = global_config.default_model();
+    initial->bytes = footprint(*initial);
+    state_ = std::move(initial);
+}
+
+Session::Session(std::string_view id, Session &parent,
+                 const ConfigManager &global_config, SessionStore *store)
+    : id_(id), config_(global_config), store_(store) {
+    std::shared_ptr<const SessionSnapshot> base;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(parent.write_mtx_);
+        base = parent.snapshot();
+        if (store_) {
+            SessionRecord record;
+            record.type = SessionRecord::Type::Fork;
+            record.session_id = id_;
+            record.text = parent.id_;
+            lsn = store_->append(record);
+        }
+    }
+    // Shares the history, context and prompt storage of the parent.
+    auto initial = std::make_shared<SessionSnapshot>(*base);
+    initial->version = 0;
+    initial->lsn = lsn;
+    if (initial->prompt_pending) {
+        // Not logged yet, so not part of the logged fork either.
+        initial->history =
+            initial->history.truncate(initial->history.size() - 1);
+        initial->prompt_pending = false;
+    }
+    initial->bytes = footprint(*initial);
+    state_ = std::move(initial);
+}
+
+Session::Session(SessionImage image, const ConfigManager &global_config,
+                 SessionStore *store)
+    : id_(std::move(image.id)), config_(global_config), store_(store) {
+    auto initial = std::make_shared<SessionSnapshot>();
+    initial->lsn = image.lsn;
+    initial->model_overridden = !image.model_name.empty();
+    initial->model_name = image.model_name.empty()
+                              ? global_config.default_model()
+                              : image.model_name;
+    initial->overrides = std::move(image.overrides);
+    for (auto it = image.history.rbegin(); it != image.history.rend(); ++it) {
+        if (it->role == Message::Role::AI) {
+            initial->latest_response = it->content;
+            break;
+        }
+    }
+    initial->history = History::from_messages(image.history);
+    initial->context = Rope(Blob(image.context));
+    initial->bytes = footprint(*initial);
+    state_ = std::move(initial);
+}
+
+Session::~Session() {
+    std::deque<std::shared_ptr<QueuedPrompt>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        stopping_ = true;
+        for (auto &entry : queue_) {
+            if (entry->running) {
+                entry->cancel.cancel();
+            } else {
+                dropped.push_back(entry);
+            }
+        }
+    }
+    for (auto &entry : dropped) {
+        entry->promise.set_value(
+            PromptResult{"", CancelToken::Reason::Cancelled});
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    if (memory_counter_) {
+        memory_counter_->fetch_sub(static_cast<int64_t>(snapshot()->bytes),
+                                   std::memory_order_relaxed);
+    }
+}
+
+void Session::track_memory(std::atomic<int64_t> *counter) {
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    memory_counter_ = counter;
+    counter->fetch_add(static_cast<int64_t>(snapshot()->bytes),
+                       std::memory_order_relaxed);
+}
+
+void Session::track_views(SessionViews *views) {
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    views_ = views;
+    file_in_views(*snapshot());
+}
+
+void Session::file_in_views(const SessionSnapshot &s) {
+    std::optional<std::chrono::system_clock::time_point> last_active;
+    if (!s.history.empty()) {
+        last_active = s.history.back().timestamp;
+    }
+    views_->update(id_, s.model_name, last_active);
+}
+
+void Session::track_search(SearchIndex *index) {
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    search_ = index;
+    search_->add(id_, snapshot()->history);
+}
+
+void Session::index_history(const History &before, const History &after) {
+    const size_t n = before.size();
+    if (after.size() > n && after.truncate(n).same_as(before)) {
+        search_->append(id_, after, n); // New turns
+    } else if (after.size() < n &&
+               before.truncate(after.size()).same_as(after)) {
+        search_->truncate(id_, after.size()); // Rolled back
+    } else {
+        search_->replace(id_, after);
+    }
+}
+
+void Session::compress_history(std::shared_ptr<HistoryCompressor> compressor) {
+    {
+        std::lock_guard<std::mutex> lock(write_mtx_);
+        compressor_ = std::move(compressor);
+    }
+    // A history restored or faulted in starts out uncompressed.
+    compact_history();
+}
+
+void Session::compact_history() {
+    std::shared_ptr<HistoryCompressor> compressor;
+    std::shared_ptr<const SessionSnapshot> base;
+    {
+        std::lock_guard<std::mutex> lock(write_mtx_);
+        compressor = compressor_;
+        base = std::atomic_load(&state_);
+    }
+    if (!compressor) {
+        return;
+    }
+    // 压缩（以及首次压缩时收集字典样本）在写锁之外进行
+    History compacted = base->history.compact(*compressor);
+    if (compacted.same_as(base->history)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    auto current = std::atomic_load(&state_);
+    if (!current->history.same_as(base->history)) {
+        return; // 历史已被其他写者修改，由它压缩新的版本
+    }
+    // 内容不变，所以不递增版本，也不写入存储
+    auto next = std::make_shared<SessionSnapshot>(*current);
+    next->history = std::move(compacted);
+    next->bytes = footprint(*next);
+    if (memory_counter_) {
+        memory_counter_->fetch_add(static_cast<int64_t>(next->bytes) -
+                                       static_cast<int64_t>(current->bytes),
+                                   std::memory_order_relaxed);
+    }
+    std::atomic_store(&state_,
+                      std::shared_ptr<const SessionSnapshot>(std::move(next)));
 }
 
 std::string Session::get_id() const { return id_; }
 
-std::string Session::get_latest_response() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return latest_response_;
+std::shared_ptr<const SessionSnapshot> Session::snapshot() const {
+    return std::atomic_load(&state_);
+}
+
+std::shared_ptr<const SessionSnapshot> Session::stable_snapshot() {
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    return std::atomic_load(&state_);
+}
+
+template <typename Mutator>
+std::shared_ptr<const SessionSnapshot>
+Session::update(Mutator &&mutate, SessionRecord *record) {
+    std::shared_ptr<const SessionSnapshot> published;
+    uint64_t lsn = 0;
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> lock(write_mtx_);
+        auto current = std::atomic_load(&state_);
+        auto next = std::make_shared<SessionSnapshot>(*current);
+        mutate(*next);
+        if (search_ && !next->history.same_as(current->history)) {
+            index_history(current->history, next->history);
+        }
+        compact = compressor_ && !next->history.same_as(current->history);
+        next->version++;
+        const size_t previous_bytes = next->bytes;
+        next->bytes = footprint(*next);
+        if (memory_counter_) {
+            memory_counter_->fetch_add(static_cast<int64_t>(next->bytes) -
+                                           static_cast<int64_t>(previous_bytes),
+                                       std::memory_order_relaxed);
+        }
+        if (store_ && record && record->type != SessionRecord::Type::None) {
+            record->session_id = id_;
+            lsn = next->lsn = store_->append(*record);
+        }
+        if (views_ && (next->model_name != current->model_name ||
+                       !next->history.same_as(current->history))) {
+            file_in_views(*next);
+        }
+        published = std::move(next);
+        std::atomic_store(&state_, published);
+    }
+    // Compress the turns that went cold while the record is being flushed.
+    if (compact) {
+        compact_history();
+    }
+    // Wait for durability outside the lock so concurrent writers share a
+    // flush (group commit).
+    if (lsn && !store_->sync(lsn)) {
+        SPDLOG_ERROR("Session '{}': Change {} could not be persisted.", id_,
+                     lsn);
+    }
+    return published;
 }
 
-std::string Session::get_context() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return conversation_.context;
+std::string Session::get_latest_response() {
+    return snapshot()->latest_response;
 }
 
+std::string Session::get_context() { return snapshot()->context.str(); }
+
 void Session::set_context(std::string_view context) {
-    std::lock_guard<std::mutex> lock(mtx_);
     // Overwrite the previous context
-    conversation_.context = context;
+    Rope next_context{Blob(context)};
+    SessionRecord record;
+    record.type = SessionRecord::Type::SetContext;
+    record.text = context;
+    update([&](SessionSnapshot &s) { s.context = std::move(next_context); },
+           &record);
     SPDLOG_DEBUG("Context set for session '{}'", id_);
 }
 
-std::string Session::get_model() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return model_name_;
+void Session::write_context(size_t offset, std::string_view data) {
+    SessionRecord record;
+    record.type = SessionRecord::Type::WriteContext;
+    record.offset = offset;
+    record.text = data;
+    update(
+        [&](SessionSnapshot &s) { s.context = s.context.write(offset, data); },
+        &record);
+    SPDLOG_DEBUG("Wrote {} byte(s) at {} into the context of session '{}'",
+                 data.size(), offset, id_);
+}
+
+void Session::truncate_context(size_t size) {
+    if (snapshot()->context.size() == size) {
+        return; // Typically O_TRUNC on an empty context
+    }
+    SessionRecord record;
+    record.type = SessionRecord::Type::TruncateContext;
+    record.offset = size;
+    update(
+        [&](SessionSnapshot &s) { s.context = s.context.truncate(size); },
+        &record);
+    SPDLOG_DEBUG("Context of session '{}' truncated to {} byte(s)", id_, size);
+}
+
+size_t Session::read_context(size_t offset, char *buf, size_t size) {
+    return snapshot()->context.read(offset, buf, size);
 }
 
+size_t Session::get_context_size() { return snapshot()->context.size(); }
+
+std::string Session::get_model() { return snapshot()->model_name; }
+
 void Session::set_model(std::string_view model_name) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    model_name_ = model_name;
-    SPDLOG_DEBUG("Model for session '{}' set to '{}'", id_, model_name_);
+    SessionRecord record;
+    record.type = SessionRecord::Type::SetModel;
+    record.text = model_name;
+    update(
+        [&](SessionSnapshot &s) {
+            s.model_name = model_name;
+            s.model_overridden = true;
+            s.settings_version++;
+        },
+        &record);
+    SPDLOG_DEBUG("Model for session '{}' set to '{}'", id_, model_name);
 }
 
-ModelParameters Session::get_settings() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return session_params_;
+std::shared_ptr<const ModelParameters> Session::settings() {
+    return resolve_settings(*snapshot());
 }
 
-void Session::set_settings(ModelParameters params) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    if (params.system_prompt) {
-        session_params_.system_prompt = params.system_prompt;
-    }
-    if (params.temperature) {
-        session_params_.temperature = params.temperature;
+std::shared_ptr<const ModelParameters>
+Session::resolve_settings(const SessionSnapshot &s) {
+    // Fast path: one atomic load each for the epoch and the cache.
+    const uint64_t epoch = config_.epoch();
+    auto cached = std::atomic_load(&resolved_);
+    if (!cached || cached->config_epoch != epoch ||
+        cached->settings_version != s.settings_version) {
+        const auto config = config_.snapshot();
+        auto next = std::make_shared<ResolvedSettings>();
+        next->config_epoch = config->epoch;
+        next->settings_version = s.settings_version;
+        next->params = config->params_for(s.model_name);
+        next->params.merge(s.overrides);
+        cached = std::move(next);
+        std::atomic_store(&resolved_, cached);
     }
+    // Shares ownership with the cache entry, so it outlives a replacement.
+    return std::shared_ptr<const ModelParameters>(cached, &cached->params);
+}
+
+void Session::set_settings(ModelParameters params) {
+    SessionRecord record;
+    record.type = SessionRecord::Type::SetSettings;
+    record.params = params;
+    update(
+        [&](SessionSnapshot &s) {
+            s.overrides.merge(params);
+            s.settings_version++;
+        },
+        &record);
     SPDLOG_DEBUG("Settings for session '{}' updated", id_);
 }
 
 std::string Session::get_formatted_history() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    auto snap = snapshot();
+    const auto params = resolve_settings(*snap);
     std::stringstream ss;
 
-    if (session_params_.system_prompt) {
-        ss << "[SYSTEM]\n" << *session_params_.system_prompt << "\n\n";
+    if (params->system_prompt) {
+        ss << "[SYSTEM]\n" << *params->system_prompt << "\n\n";
     }
 
-    for (const auto &msg : conversation_.history) {
+    for (const auto &msg : snap->history) {
         switch (msg.role) {
         case Message::Role::User:
             ss << "[USER]\n" << msg.content << "\n\n";
@@ -79,59 +388,253 @@ std::string Session::get_formatted_history() {
     return ss.str();
 }
 
+std::shared_ptr<Session::QueuedPrompt>
+Session::enqueue_locked(std::string text, LLMClient &llm_client) {
+    auto entry = std::make_shared<QueuedPrompt>();
+    entry->ticket = next_ticket_++;
+    entry->text = std::move(text);
+    entry->enqueued_at = std::chrono::system_clock::now();
+    entry->llm_client = &llm_client;
+    queue_.push_back(entry);
+    return entry;
+}
+
+void Session::ensure_worker_locked() {
+    if (worker_active_) {
+        return;
+    }
+    // A previous worker has already left drain_queue(); joining is immediate.
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    worker_active_ = true;
+    worker_ = std::thread(&Session::drain_queue, this);
+}
+
+std::vector<uint64_t> Session::enqueue_prompts(std::vector<std::string> prompts,
+                                               LLMClient &llm_client) {
+    std::vector<uint64_t> tickets;
+    tickets.reserve(prompts.size());
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    if (stopping_) {
+        return tickets;
+    }
+    for (auto &prompt : prompts) {
+        tickets.push_back(enqueue_locked(std::move(prompt), llm_client)->ticket);
+    }
+    if (!tickets.empty()) {
+        ensure_worker_locked();
+        SPDLOG_INFO("Session '{}': Enqueued {} prompt(s), {} pending.", id_,
+                    tickets.size(), queue_.size());
+    }
+    return tickets;
+}
+
+void Session::cancel_prompt(uint64_t ticket, CancelToken::Reason reason) {
+    std::shared_ptr<QueuedPrompt> removed;
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        auto it = std::find_if(queue_.begin(), queue_.end(),
+                               [&](const auto &e) { return e->ticket == ticket; });
+        if (it == queue_.end()) {
+            return; // Already finished
+        }
+        if ((*it)->running) {
+            // The worker commits the rollback once the transfer aborts.
+            (*it)->cancel.cancel(reason);
+            return;
+        }
+        removed = *it;
+        queue_.erase(it);
+    }
+    removed->promise.set_value(PromptResult{"", reason});
+}
+
+void Session::drain_queue() {
+    while (true) {
+        std::shared_ptr<QueuedPrompt> next;
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            if (queue_.empty() || stopping_) {
+                worker_active_ = false;
+                return;
+            }
+            next = queue_.front();
+            next->running = true;
+        }
+
+        PromptResult result = execute(*next);
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            // Only the worker removes a running entry, so it is still first.
+            queue_.pop_front();
+        }
+        next->promise.set_value(std::move(result));
+    }
+}
+
+std::string Session::get_formatted_queue() {
+    auto now = std::chrono::system_clock::now();
+    std::stringstream ss;
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    for (const auto &entry : queue_) {
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - entry->enqueued_at);
+        std::string_view preview(entry->text);
+        preview = preview.substr(0, preview.find('\n'));
+        ss << entry->ticket << '\t' << (entry->running ? "running" : "queued")
+           << '\t' << age.count() << "ms\t" << preview << '\n';
+    }
+    return ss.str();
+}
+
+size_t Session::queue_length() {
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    return queue_.size();
+}
+
 std::string Session::add_prompt(std::string_view prompt,
-                                LLMClient &llm_client) {
-    std::lock_guard<std::mutex> lock(mtx_);
-
-    // 1. Add user message to history
-    conversation_.history.push_back(Message{Message::Role::User,
-                                            std::string(prompt),
-                                            std::chrono::system_clock::now()});
-    SPDLOG_INFO("Session '{}': Added user prompt.", id_);
-
-    // 2. Call the LLM
-    // The conversation_query method will handle the context and history
-    // 获取 ConfigManager 引用，而不是直接传递 ModelParameters
-    const ConfigManager& config = llm_client.get_config_manager();
+                                LLMClient &llm_client, CancelToken *cancel) {
+    CancelToken local_token;
+    CancelToken &token = cancel ? *cancel : local_token;
+    if (token.is_cancelled()) {
+        SPDLOG_WARN("Session '{}': Prompt cancelled before it was queued.",
+                    id_);
+        return "";
+    }
+
+    std::shared_future<PromptResult> result;
+    uint64_t ticket = 0;
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        if (stopping_) {
+            return "";
+        }
+        auto entry = enqueue_locked(std::string(prompt), llm_client);
+        ticket = entry->ticket;
+        result = entry->promise.get_future().share();
+        ensure_worker_locked();
+    }
+
+    // The caller's token may depend on the calling thread (FUSE interrupts),
+    // so it is polled here and forwarded to the queued prompt.
+    bool forwarded = false;
+    while (result.wait_for(CANCEL_POLL_INTERVAL) != std::future_status::ready) {
+        if (!forwarded && token.is_cancelled()) {
+            cancel_prompt(ticket, token.reason());
+            forwarded = true;
+        }
+    }
+
+    const PromptResult &outcome = result.get();
+    if (outcome.response.empty() &&
+        outcome.reason != CancelToken::Reason::None) {
+        token.cancel(outcome.reason);
+    }
+    return outcome.response;
+}
+
+PromptResult Session::execute(QueuedPrompt &prompt) {
+    CancelToken &token = prompt.cancel;
+
+    // 1. Publish the user message as a pending turn
+    Message user_msg{Message::Role::User, prompt.text,
+                     std::chrono::system_clock::now()};
+    auto pending = update([&](SessionSnapshot &s) {
+        s.history = s.history.append(user_msg);
+        s.prompt_pending = true;
+    });
+    SPDLOG_INFO("Session '{}': Added user prompt #{}.", id_, prompt.ticket);
+
+    // 2. Call the LLM on the pending version, without holding any lock
+    // The conversation_query method will handle the context and history;
+    // the parameters are the session's, resolved against the current config
+    // (cached until either changes).
+    LLMClient &llm_client = *prompt.llm_client;
+    const auto params = resolve_settings(*pending);
+    if (params->timeout_ms) {
+        token.set_timeout(std::chrono::milliseconds(*params->timeout_ms));
+    }
+    Conversation request{pending->history, pending->context};
     std::string response = llm_client.conversation_query(
-        model_name_, config, conversation_);
+        pending->model_name, *params, request, &token);
+
+    // 3. Commit the AI turn, or roll back the pending user turn, against the
+    // current version so concurrent context/model/settings changes survive.
+    const size_t pending_index = pending->history.size() - 1;
+    bool committed = false;
+    // Pending turns are never logged; a committed turn is logged as one
+    // record holding both messages.
+    Message ai_msg{Message::Role::AI, response,
+                   std::chrono::system_clock::now()};
+    SessionRecord record;
+    record.type = SessionRecord::Type::None;
+    update([&](SessionSnapshot &s) {
+        s.prompt_pending = false;
+        const History &current = s.history;
+        bool still_pending = current.size() > pending_index;
+        if (still_pending) {
+            auto entry = current[pending_index];
+            still_pending = entry.role == Message::Role::User &&
+                            entry.timestamp == user_msg.timestamp &&
+                            entry.content == user_msg.content;
+        }
+        if (!still_pending) {
+            return; // History was replaced (e.g. populate) meanwhile
+        }
+
+        if (response.empty()) {
+            s.history = current.erase(pending_index);
+        } else {
+            s.history = current.insert(pending_index + 1, ai_msg);
+            s.latest_response = response;
+            committed = true;
+            record.type = SessionRecord::Type::AppendTurn;
+            record.messages = {user_msg, ai_msg};
+        }
+    }, &record);
 
     if (response.empty()) {
-        SPDLOG_ERROR("Session '{}': Received empty response from LLMClient.",
-                      id_);
-        // Revert the history on failure
-        conversation_.history.pop_back();
-        return ""; // Indicate failure
+        if (token.reason() != CancelToken::Reason::None) {
+            SPDLOG_WARN("Session '{}': Prompt cancelled, rolling back.", id_);
+        } else {
+            SPDLOG_ERROR(
+                "Session '{}': Received empty response from LLMClient.", id_);
+        }
+        return {"", token.reason()}; // Indicate failure
+    }
+    if (!committed) {
+        SPDLOG_WARN("Session '{}': History was replaced while the prompt was "
+                    "in flight, discarding the response.",
+                    id_);
+        return {"", CancelToken::Reason::Cancelled};
     }
-
-    // 3. Store the AI's response
-    latest_response_ = response;
-    conversation_.history.push_back(
-        {Message::Role::AI, response, std::chrono::system_clock::now()});
     SPDLOG_INFO("Session '{}': Stored AI response.", id_);
 
-    return response;
+    return {response, CancelToken::Reason::None};
 }
 
+
 void Session::populate(std::string_view user_prompt,
                        std::string_view ai_response) {
-    std::lock_guard<std::mutex> lock(mtx_);
-
-    // This method is for new sessions, but clearing is safe just in case.
-    conversation_.history.clear();
-
-    // 1. Add user message
-    conversation_.history.push_back(
-        Message{Message::Role::User, std::string(user_prompt),
-                std::chrono::system_clock::now()});
-
-    // 2. Add AI response
-    conversation_.history.push_back(
-        Message{Message::Role::AI, std::string(ai_response),
-                std::chrono::system_clock::now()});
+    auto now = std::chrono::system_clock::now();
 
-    // 3. Set the latest response for this session
-    latest_response_ = ai_response;
+    // This method is for new sessions, so the history is replaced outright.
+    SessionRecord record;
+    record.type = SessionRecord::Type::ReplaceHistory;
+    record.messages = {
+        // 1. Add user message
+        Message{Message::Role::User, std::string(user_prompt), now},
+        // 2. Add AI response
+        Message{Message::Role::AI, std::string(ai_response), now}};
+    History history = History::from_messages(record.messages);
+    update([&](SessionSnapshot &s) {
+        s.history = std::move(history);
+        s.prompt_pending = false;
+        // 3. Set the latest response for this session
+        s.latest_response = ai_response;
+    }, &record);
 
     SPDLOG_INFO(
         "Session '{}' populated with a stateless user/AI interaction.", id_);
@@ -1,14 +1,71 @@
 #pragma once
 
+#include "../common/History.h"
+#include "../common/HistoryCompressor.h"
 #include "../common/data.h"
 #include "../config/ConfigManager.h"
 #include "../services/LLMClient.h"
+#include "../storage/SessionStore.h"
+#include "SearchIndex.h"
+#include "SessionViews.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 namespace fusellm {
 
+/**
+ * @struct SessionSnapshot
+ * @brief One immutable version of a session's state.
+ *
+ * Snapshots are never modified after they are published. Large members are
+ * held through shared pointers (or Blobs and Ropes) so a new version that only
+ * changes, say, the model shares the history and context of its
+ * predecessor.
+ */
+struct SessionSnapshot {
+    uint64_t version = 0;
+    // Store sequence number of the last logged change in this version.
+    uint64_t lsn = 0;
+    History history;                            // Shares storage across versions
+    Rope context;                               // Shares pieces across versions
+    std::string latest_response;
+    std::string model_name;
+    // True once a model was chosen for this session; otherwise `model_name`
+    // is the default model at creation and is not persisted.
+    bool model_overridden = false;
+    ModelParameters overrides; // Only what was written to this session
+    // Bumped whenever `model_name` or `overrides` change, so parameters
+    // resolved against the config stay valid across other changes.
+    uint64_t settings_version = 0;
+    // True while the last user turn in `history` is waiting for its answer.
+    bool prompt_pending = false;
+    // Heap bytes held by this version, counting shared members in full.
+    size_t bytes = 0;
+
+    // The model name to persist: empty unless the session chose one.
+    std::string_view persisted_model() const {
+        return model_overridden ? std::string_view(model_name)
+                                : std::string_view();
+    }
+};
+
+/**
+ * @struct PromptResult
+ * @brief The outcome of one queued prompt.
+ */
+struct PromptResult {
+    std::string response; // Empty on failure or cancellation
+    CancelToken::Reason reason = CancelToken::Reason::None;
+};
+
 /**
  * @class Session
  * @brief Manages the state of a single, stateful conversation.
@@ -16,6 +73,16 @@ namespace fusellm {
  * This class encapsulates the entire history, context, and configuration for a
  * chat session. It is responsible for interacting with the LLMClient to get new
  * responses. This class is thread-safe.
+ *
+ * State is kept as versioned immutable snapshots (MVCC). Readers load the
+ * current SessionSnapshot without taking any lock, so they are never blocked
+ * by a prompt in flight. Writers build the next version from the current one
+ * under a short-lived writer lock that is never held across the network.
+ *
+ * Prompts go through a per-session FIFO queue drained by a worker thread that
+ * only exists while the queue is non-empty. Each prompt is sent once its
+ * predecessor's answer has been committed to the history, so submitters can
+ * enqueue without blocking and still get a well-defined conversation order.
  */
 class Session {
   public:
@@ -23,20 +90,131 @@ class Session {
      * @brief Constructs a new Session with a unique identifier.
      * @param id The unique string identifier for this session.
      * @param global_config A reference to the application's ConfigManager to
-     * inherit base model parameters.
+     * inherit base model parameters. Must outlive the session.
+     * @param store Optional durable store every mutation is logged to. Must
+     * outlive the session.
+     */
+    explicit Session(std::string_view id, const ConfigManager &global_config,
+                     SessionStore *store = nullptr);
+
+    /**
+     * @brief Creates session `id` as a copy-on-write fork of `parent`.
+     *
+     * The fork starts with the parent's history, context, model and
+     * settings and shares their storage, so forking is O(1) whatever the
+     * length of the history; turns added to either side afterwards are
+     * stored once, for that side only. A prompt the parent is still waiting
+     * on is not part of the fork. With a store, the fork is logged in the
+     * same step as reading the parent, so replay copies exactly this
+     * version.
+     */
+    Session(std::string_view id, Session &parent,
+            const ConfigManager &global_config, SessionStore *store = nullptr);
+
+    /**
+     * @brief Restores a session from its persisted image.
+     */
+    Session(SessionImage image, const ConfigManager &global_config,
+            SessionStore *store = nullptr);
+
+    /**
+     * @brief Cancels the prompt in flight, drops queued prompts and waits for
+     * the queue worker to exit.
      */
-    explicit Session(std::string_view id, const ConfigManager &global_config);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
 
     // Getters for session properties
     std::string get_id() const;
+    // The ID is immutable, so a reference to it stays valid for the lifetime
+    // of the session (SessionManager uses it as a zero-copy map key).
+    const std::string &id() const { return id_; }
+    /**
+     * @brief Returns the current immutable state. Lock-free, never null.
+     */
+    std::shared_ptr<const SessionSnapshot> snapshot() const;
+
+    /**
+     * @brief Bytes of memory the session's current state occupies.
+     */
+    size_t memory_bytes() const { return snapshot()->bytes; }
+
+    /**
+     * @brief Keeps `counter` equal to the sum of memory_bytes() over all
+     * tracked sessions: adds this session's size now, every change later,
+     * and subtracts it on destruction. Call before the session is shared.
+     * The counter must outlive the session.
+     */
+    void track_memory(std::atomic<int64_t> *counter);
+
+    /**
+     * @brief Files the session in `views` by model and last activity, now
+     * and after every change to either. Call before the session is shared.
+     * The views must outlive the session.
+     */
+    void track_views(SessionViews *views);
+
+    /**
+     * @brief Indexes the session's messages in `index`, now and whenever
+     * the history changes. Call before the session is shared, after
+     * compress_history(). The index must outlive the session.
+     */
+    void track_search(SearchIndex *index);
+
+    /**
+     * @brief Compresses the messages of all but the most recent turns with
+     * `compressor`, now and after every change to the history. Reads of old
+     * messages then decompress them on demand.
+     */
+    void compress_history(std::shared_ptr<HistoryCompressor> compressor);
+
+    /**
+     * @brief Like snapshot(), but waits for an in-progress writer, so the
+     * result reflects every record already handed to the store. Used for
+     * checkpoints.
+     */
+    std::shared_ptr<const SessionSnapshot> stable_snapshot();
+
     std::string get_latest_response();
     std::string get_formatted_history();
     std::string get_context();
     std::string get_model();
-    ModelParameters get_settings();
+
+    /**
+     * @brief The effective parameters: those of the session's model in the
+     * current config, with the session's own settings merged over them.
+     *
+     * Resolved once per config epoch and settings change and cached; a call
+     * that hits the cache takes no lock and allocates nothing.
+     */
+    std::shared_ptr<const ModelParameters> settings();
+    ModelParameters get_settings() { return *settings(); }
 
     // Setters for session properties
     void set_context(std::string_view context);
+
+    /**
+     * @brief Writes `data` into the context at `offset`, as pwrite(2) would.
+     * Appending costs O(data) however large the context already is, so a
+     * document can be streamed in with `cat doc.txt >> context`.
+     */
+    void write_context(size_t offset, std::string_view data);
+
+    /**
+     * @brief Cuts or zero-extends the context to `size` bytes.
+     */
+    void truncate_context(size_t size);
+
+    /**
+     * @brief Copies up to `size` bytes of the context starting at `offset`
+     * into `buf`, without materializing the whole text.
+     * @return The number of bytes copied.
+     */
+    size_t read_context(size_t offset, char *buf, size_t size);
+
+    size_t get_context_size();
     void set_model(std::string_view model_name);
     void set_settings(ModelParameters params);
 
@@ -46,11 +224,23 @@ class Session {
      * Takes a user prompt, adds it to the history, sends the entire
      * conversation to the LLM via the client, and stores the response.
      *
+     * The prompt is appended to the session's queue and this call blocks
+     * until it has been answered. When its turn comes it is published as a
+     * pending user turn, the LLM is called without holding any lock, and the
+     * AI turn is committed atomically as a new version. Changes made
+     * meanwhile (context, model, settings) are preserved.
+     *
+     * If the call fails or is cancelled through `cancel` (interrupt or
+     * deadline, also while still queued), the pending user message is rolled
+     * back and the failure reason is latched into `cancel`.
+     *
      * @param prompt The user's new message.
      * @param llm_client The client to use for the API call.
-     * @return The AI's response as a string.
+     * @param cancel Optional cancellation token for the LLM call.
+     * @return The AI's response as a string, or an empty string on failure.
      */
-    std::string add_prompt(std::string_view prompt, LLMClient &llm_client);
+    std::string add_prompt(std::string_view prompt, LLMClient &llm_client,
+                           CancelToken *cancel = nullptr);
 
     /**
      * @brief Manually populates the session with a user prompt and an AI response.
@@ -64,17 +254,123 @@ class Session {
      */
     void populate(std::string_view user_prompt, std::string_view ai_response);
 
+    /**
+     * @brief Appends prompts to the queue without waiting for the answers.
+     *
+     * All prompts are enqueued back to back, so a multi-turn script written
+     * in one call is never interleaved with another writer's prompts.
+     *
+     * @param prompts The prompts, in the order they should be sent.
+     * @param llm_client The client to use for the API calls. Must outlive
+     * the session.
+     * @return The queue tickets assigned to the prompts, in order.
+     */
+    std::vector<uint64_t> enqueue_prompts(std::vector<std::string> prompts,
+                                          LLMClient &llm_client);
+
+    /**
+     * @brief Renders the pending prompts, one per line:
+     * `<ticket>\t<running|queued>\t<age ms>\t<first line of the prompt>`.
+     */
+    std::string get_formatted_queue();
+
+    /**
+     * @brief Number of prompts waiting or in flight.
+     */
+    size_t queue_length();
+
   private:
-    std::string id_;
-    Conversation conversation_;
-    std::string latest_response_;
+    // One entry of the prompt queue. Shared between the queue, the worker
+    // and a submitter that waits for the result.
+    struct QueuedPrompt {
+        uint64_t ticket = 0;
+        std::string text;
+        std::chrono::system_clock::time_point enqueued_at;
+        LLMClient *llm_client = nullptr;
+        CancelToken cancel;
+        bool running = false;
+        std::promise<PromptResult> promise;
+    };
+
+    std::shared_ptr<QueuedPrompt> enqueue_locked(std::string text,
+                                                 LLMClient &llm_client);
+    void ensure_worker_locked();
+
+    /**
+     * @brief Cancels a prompt: a queued one is removed and completed as
+     * cancelled, a running one has its request aborted.
+     */
+    void cancel_prompt(uint64_t ticket, CancelToken::Reason reason);
+
+    // Worker loop: executes queued prompts one at a time until the queue is
+    // empty.
+    void drain_queue();
+
+    // Runs one prompt: pending user turn, LLM call, commit or roll back.
+    PromptResult execute(QueuedPrompt &prompt);
+
+    // Effective parameters of one settings version under one config epoch.
+    struct ResolvedSettings {
+        uint64_t config_epoch = 0;
+        uint64_t settings_version = 0;
+        ModelParameters params;
+    };
+
+    // The effective parameters of version `s`, from resolved_ if current.
+    std::shared_ptr<const ModelParameters>
+    resolve_settings(const SessionSnapshot &s);
+
+    /**
+     * @brief Publishes a new version derived from the current one.
+     * @param mutate Applied to a copy of the current snapshot. It may set
+     * `record->type` to None to skip logging.
+     * @param record The change to log to the store, appended under the same
+     * lock so the log order matches the version order. The call returns once
+     * the record is durable.
+     * @return The published snapshot.
+     */
+    template <typename Mutator>
+    std::shared_ptr<const SessionSnapshot>
+    update(Mutator &&mutate, SessionRecord *record = nullptr);
+
+    // Reports `s` to views_. Call with write_mtx_ held.
+    void file_in_views(const SessionSnapshot &s);
+
+    // Brings search_ from `before` to `after`, reindexing only what
+    // changed. Call with write_mtx_ held.
+    void index_history(const History &before, const History &after);
+
+    // Compresses the current history with compressor_ without holding
+    // write_mtx_, then swaps it in unless a writer changed the history
+    // meanwhile. The version stays the same, as the content does.
+    void compact_history();
+
+    const std::string id_;
+    const ConfigManager &config_;
+    SessionStore *const store_;
+    std::atomic<int64_t> *memory_counter_ = nullptr; // See track_memory()
+    SessionViews *views_ = nullptr;                  // See track_views()
+    SearchIndex *search_ = nullptr;                  // See track_search()
+    // See compress_history(). Guarded by write_mtx_.
+    std::shared_ptr<HistoryCompressor> compressor_;
+
+    // Current state; accessed only through std::atomic_load/std::atomic_store.
+    std::shared_ptr<const SessionSnapshot> state_;
+
+    // Last resolved parameters; accessed only through std::atomic_load and
+    // std::atomic_store.
+    std::shared_ptr<const ResolvedSettings> resolved_;
 
-    // Session-specific configuration overrides
-    ModelParameters session_params_;
-    std::string model_name_;
+    // Serializes writers so no update is lost. Never held across an LLM call.
+    std::mutex write_mtx_;
 
-    // A mutex to protect all read/write operations on the session's state
-    std::mutex mtx_;
+    // FIFO prompt queue; the front entry is the one being executed.
+    std::mutex queue_mtx_;
+    std::deque<std::shared_ptr<QueuedPrompt>> queue_;
+    uint64_t next_ticket_ = 1;
+    bool worker_active_ = false; // True while worker_ is draining the queue
+    bool stopping_ = false;      // Set by the destructor
+    std::thread worker_;
 };
 
 } // namespace fusellm
\ No newline at end of file
@@ -1,33 +1,614 @@
 #include "SessionManager.h"
+#include "../storage/RecordCodec.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
 
 namespace fusellm {
 
+namespace {
+
+int64_t now_tick() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// Pause between eviction passes that could not get under the budget.
+constexpr std::chrono::seconds TRIM_RETRY_INTERVAL{1};
+
+void set_error(SessionManager::Error *error, SessionManager::Error value) {
+    if (error) {
+        *error = value;
+    }
+}
+
+// A snapshot of a session that is not in memory. Only the fields a
+// checkpoint persists are filled in.
+std::shared_ptr<SessionSnapshot> snapshot_of(SessionImage image) {
+    auto snap = std::make_shared<SessionSnapshot>();
+    snap->lsn = image.lsn;
+    snap->history = History::from_messages(image.history);
+    snap->context = Rope(Blob(image.context));
+    snap->model_overridden = !image.model_name.empty();
+    snap->model_name = std::move(image.model_name);
+    snap->overrides = std::move(image.overrides);
+    return snap;
+}
+
+} // namespace
+
 SessionManager::SessionManager(const ConfigManager &config)
-    : config_manager_(config) {}
+    : config_manager_(config),
+      views_(static_cast<size_t>(config.recent_sessions_)) {}
+
+SessionManager::~SessionManager() {
+    if (store_) {
+        store_->unsubscribe();
+    }
+}
+
+SessionManager::Shard &SessionManager::shard_for(std::string_view id) {
+    return shards_[std::hash<std::string_view>{}(id) % SHARD_COUNT];
+}
+
+void SessionManager::set_store(SessionStore *store, size_t cache_capacity) {
+    store_ = store;
+    shard_capacity_ = 0;
+    if (store_ && store_->lazy()) {
+        if (cache_capacity > 0) {
+            shard_capacity_ = std::max<size_t>(
+                1, (cache_capacity + SHARD_COUNT - 1) / SHARD_COUNT);
+        }
+        store_->subscribe(
+            [this](std::string_view id, uint64_t version, bool local) {
+                apply_store_change(id, version, local);
+            });
+    }
+}
+
+void SessionManager::set_memory_budget(size_t budget_bytes,
+                                       std::unique_ptr<SpillFile> spill) {
+    spill_ = std::move(spill);
+    memory_budget_ = budget_bytes;
+    if (memory_budget_ && !spill_ && !(store_ && store_->lazy())) {
+        SPDLOG_WARN("No spill file for evicted sessions; memory budget of {} "
+                    "bytes is not enforced.",
+                    memory_budget_);
+        memory_budget_ = 0;
+    }
+    enforce_budget();
+}
+
+template <typename... Args>
+std::shared_ptr<Session> SessionManager::make_session(Args &&...args) {
+    auto session = std::make_shared<Session>(std::forward<Args>(args)...,
+                                             config_manager_, store_);
+    attach_session(*session);
+    return session;
+}
+
+void SessionManager::attach_session(Session &session) {
+    session.track_memory(&resident_bytes_);
+    session.track_views(&views_);
+    if (compressor_) {
+        session.compress_history(compressor_);
+    }
+    session.track_search(&search_);
+}
+
+SessionManager::MemoryStats SessionManager::memory_stats() const {
+    MemoryStats stats;
+    stats.budget_bytes = memory_budget_;
+    stats.resident_bytes = resident_bytes_.load(std::memory_order_relaxed);
+    for (const auto &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        stats.resident_sessions += shard.sessions.size();
+        stats.spilled_sessions += shard.spilled.size();
+    }
+    if (spill_) {
+        stats.spill = spill_->stats();
+    }
+    if (compressor_) {
+        stats.history = compressor_->stats();
+    }
+    stats.blobs = BlobStore::shared().stats();
+    return stats;
+}
+
+std::shared_ptr<Session> SessionManager::spill_locked(
+    Shard &shard, std::unordered_map<std::string_view, Entry>::iterator it) {
+    auto evicted = std::move(it->second.session);
+    if (!(store_ && store_->lazy())) {
+        // Idle, so no writer can be publishing a newer version meanwhile.
+        auto snap = evicted->snapshot();
+        std::string blob;
+        codec::encode_image(evicted->id(), snap->lsn, snap->history,
+                            snap->context, snap->persisted_model(),
+                            snap->overrides, blob);
+        SpillFile::Extent extent;
+        if (!spill_->write(blob, extent)) {
+            it->second.session = std::move(evicted);
+            return nullptr;
+        }
+        shard.spilled.emplace(evicted->id(), extent);
+    }
+    shard.sessions.erase(it);
+    SPDLOG_DEBUG("Evicted idle session '{}' ({} bytes) to stay within the "
+                 "memory budget.",
+                 evicted->id(), evicted->memory_bytes());
+    return evicted;
+}
+
+void SessionManager::enforce_budget() {
+    const auto budget = static_cast<int64_t>(memory_budget_);
+    if (budget == 0 ||
+        resident_bytes_.load(std::memory_order_relaxed) <= budget) {
+        return;
+    }
+    if (now_tick() < trim_after_.load(std::memory_order_relaxed) ||
+        trimming_.exchange(true)) {
+        return; // Gave up recently, or another thread is already on it
+    }
+
+    // Evict down to a low-water mark so the next few allocations do not
+    // each trigger a pass.
+    const int64_t target = budget / 10 * 9;
+    struct Candidate {
+        int64_t last_used;
+        size_t shard;
+        std::string id;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mtx);
+        for (const auto &pair : shards_[i].sessions) {
+            if (idle(pair.second)) {
+                candidates.push_back(
+                    {pair.second.last_used.load(std::memory_order_relaxed), i,
+                     std::string(pair.first)});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) {
+                  return a.last_used < b.last_used;
+              });
+
+    size_t evicted_count = 0;
+    for (const auto &candidate : candidates) {
+        if (resident_bytes_.load(std::memory_order_relaxed) <= target) {
+            break;
+        }
+        std::shared_ptr<Session> evicted;
+        {
+            Shard &shard = shards_[candidate.shard];
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            auto it = shard.sessions.find(candidate.id);
+            if (it == shard.sessions.end() || !idle(it->second)) {
+                continue; // Removed or picked up since the scan
+            }
+            evicted = spill_locked(shard, it);
+        }
+        // Releasing the last reference returns the session's bytes.
+        evicted_count += evicted != nullptr;
+    }
+
+    const int64_t resident = resident_bytes_.load(std::memory_order_relaxed);
+    if (resident > budget) {
+        SPDLOG_WARN("Sessions use {} bytes, over the budget of {}, but too few "
+                    "are idle to evict.",
+                    resident, budget);
+        trim_after_.store(
+            now_tick() + std::chrono::duration_cast<
+                             std::chrono::steady_clock::duration>(
+                             TRIM_RETRY_INTERVAL)
+                             .count(),
+            std::memory_order_relaxed);
+    } else {
+        SPDLOG_DEBUG("Evicted {} sessions; {} bytes resident.", evicted_count,
+                     resident);
+    }
+    trimming_.store(false);
+}
+
+std::shared_ptr<Session> SessionManager::fault_in(std::string_view id,
+                                                  Error *error) {
+    Shard &shard = shard_for(id);
+    SpillFile::Extent extent;
+    uint64_t generation;
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        if (auto it = shard.sessions.find(id); it != shard.sessions.end()) {
+            return it->second.session; // Faulted in concurrently
+        }
+        auto spilled = shard.spilled.find(std::string(id));
+        if (spilled == shard.spilled.end()) {
+            set_error(error, Error::NotFound);
+            return nullptr;
+        }
+        extent = spilled->second;
+        generation = shard.generation;
+    }
 
-std::shared_ptr<Session> SessionManager::create_session(std::string_view id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    if (sessions_.count(id.data())) {
-        return nullptr; // Session with this ID already exists
+    // Read, decompressed and decoded without holding the shard. The extent
+    // stays allocated until the session is back in the shard; a removal in
+    // the meantime bumps the generation and the result is discarded.
+    std::string blob;
+    SessionImage image;
+    const bool ok =
+        spill_->read(extent, blob) && codec::decode_image(blob, image);
+    std::shared_ptr<Session> session;
+    if (ok) {
+        session = std::make_shared<Session>(std::move(image), config_manager_,
+                                            store_);
     }
 
-    auto session = std::make_shared<Session>(id.data(), config_manager_);
-    sessions_[id.data()] = session;
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        if (auto it = shard.sessions.find(id); it != shard.sessions.end()) {
+            return it->second.session; // Faulted in concurrently
+        }
+        auto spilled = shard.spilled.find(std::string(id));
+        if (spilled == shard.spilled.end()) {
+            set_error(error, Error::NotFound);
+            return nullptr; // Removed meanwhile
+        }
+        if (shard.generation != generation) {
+            // Possibly removed, recreated and spilled again; read it anew.
+            lock.unlock();
+            return fault_in(id, error);
+        }
+        if (!ok) {
+            // The extent is kept: the session still exists, and a later
+            // lookup or a checkpoint may read it successfully.
+            SPDLOG_ERROR("Session '{}' could not be read back from the spill "
+                         "file.",
+                         id);
+            set_error(error, Error::Unavailable);
+            return nullptr;
+        }
+        spill_->release(spilled->second);
+        shard.spilled.erase(spilled);
+        attach_session(*session);
+        auto &entry =
+            shard.sessions.try_emplace(session->id(), session).first->second;
+        entry.last_used.store(now_tick(), std::memory_order_relaxed);
+    }
+    SPDLOG_DEBUG("Faulted session '{}' back in from the spill file.", id);
+    enforce_budget();
     return session;
 }
 
-std::shared_ptr<Session> SessionManager::create_session_with_auto_id() {
+bool SessionManager::idle(const Entry &entry) {
+    // Nobody outside the map holds the session and it has no queued
+    // prompts, so its state is fully described by the store.
+    return entry.session.use_count() == 1 &&
+           entry.session->queue_length() == 0;
+}
+
+std::shared_ptr<Session> SessionManager::invalidate_locked(Shard &shard,
+                                                           std::string_view id,
+                                                           uint64_t version) {
+    auto it = shard.sessions.find(id);
+    if (it == shard.sessions.end()) {
+        return nullptr;
+    }
+    Entry &entry = it->second;
+    if (version != 0 && version <= entry.version.load()) {
+        return nullptr; // Already loaded after this change
+    }
+    if (!idle(entry)) {
+        // In use: keep serving it and reload once it is released.
+        entry.stale.store(true);
+        return nullptr;
+    }
+    auto dropped = std::move(entry.session);
+    shard.sessions.erase(it);
+    return dropped;
+}
+
+void SessionManager::apply_store_change(std::string_view id, uint64_t version,
+                                        bool local) {
+    if (id.empty()) {
+        // Notifications were lost: nothing cached can be trusted.
+        std::vector<std::string> affected;
+        for (auto &shard : shards_) {
+            std::vector<std::shared_ptr<Session>> dropped;
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            shard.generation++;
+            for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+                affected.emplace_back(it->first);
+                if (idle(it->second)) {
+                    dropped.push_back(std::move(it->second.session));
+                    it = shard.sessions.erase(it);
+                } else {
+                    it->second.stale.store(true);
+                    ++it;
+                }
+            }
+        }
+        if (remote_change_callback_) {
+            for (const auto &affected_id : affected) {
+                remote_change_callback_(affected_id);
+            }
+            remote_change_callback_(std::string());
+        }
+        return;
+    }
+
+    Shard &shard = shard_for(id);
+    if (local) {
+        // Our own write: the cached copy already has it. Notifications
+        // arrive from a single thread, so a plain store cannot go backwards.
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end() && version > it->second.version.load()) {
+            it->second.version.store(version);
+        }
+        return;
+    }
+
+    std::shared_ptr<Session> dropped;
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end() && version != 0 &&
+            version <= it->second.version.load()) {
+            return;
+        }
+        shard.generation++;
+        dropped = invalidate_locked(shard, id, version);
+    }
+    SPDLOG_DEBUG("Session '{}' changed remotely (version {}).", id, version);
+    if (remote_change_callback_) {
+        remote_change_callback_(std::string(id));
+    }
+}
+
+std::shared_ptr<Session> SessionManager::refresh_session(std::string_view id,
+                                                         Error *error) {
+    Shard &shard = shard_for(id);
+    std::shared_ptr<Session> dropped;
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end()) {
+            if (!it->second.stale.load()) {
+                return it->second.session; // Refreshed concurrently
+            }
+            if (!idle(it->second)) {
+                return it->second.session; // Still in use; serve as is
+            }
+            dropped = std::move(it->second.session);
+            shard.sessions.erase(it);
+        }
+    }
+    return load_session(id, error);
+}
+
+size_t SessionManager::resident_sessions() const {
+    size_t count = 0;
+    for (const auto &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        count += shard.sessions.size();
+    }
+    return count;
+}
+
+std::shared_ptr<Session> SessionManager::evict_locked(Shard &shard) {
+    if (!caching() || shard.sessions.size() <= shard_capacity_) {
+        return nullptr;
+    }
+    auto victim = shard.sessions.end();
+    int64_t oldest = 0;
+    for (auto it = shard.sessions.begin(); it != shard.sessions.end(); ++it) {
+        const Entry &entry = it->second;
+        if (!idle(entry)) {
+            continue;
+        }
+        int64_t used = entry.last_used.load(std::memory_order_relaxed);
+        if (victim == shard.sessions.end() || used < oldest) {
+            victim = it;
+            oldest = used;
+        }
+    }
+    if (victim == shard.sessions.end()) {
+        return nullptr; // Everything is busy; stay over capacity for now
+    }
+    auto evicted = std::move(victim->second.session);
+    shard.sessions.erase(victim);
+    SPDLOG_DEBUG("Evicted idle session '{}' from the cache.", evicted->id());
+    return evicted;
+}
+
+std::shared_ptr<Session> SessionManager::load_session(std::string_view id,
+                                                      Error *error) {
+    Shard &shard = shard_for(id);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint64_t generation;
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mtx);
+            generation = shard.generation;
+        }
+        SessionImage image;
+        Lookup found = store_->load(id, image);
+        if (found != Lookup::Found) {
+            set_error(error, found == Lookup::Unavailable ? Error::Unavailable
+                                                          : Error::NotFound);
+            return nullptr;
+        }
+
+        std::shared_ptr<Session> evicted;
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end()) {
+            return it->second.session; // Loaded concurrently
+        }
+        if (shard.generation != generation) {
+            continue; // A removal may have raced with the load; reload
+        }
+        uint64_t version = image.lsn;
+        auto session = make_session(std::move(image));
+        auto &entry =
+            shard.sessions.try_emplace(session->id(), session).first->second;
+        entry.last_used.store(now_tick(), std::memory_order_relaxed);
+        entry.version.store(version);
+        list_add(session->id()); // Possibly created by another instance
+        evicted = evict_locked(shard);
+        lock.unlock();
+        evicted.reset();
+        enforce_budget();
+        return session;
+    }
+    set_error(error, Error::NotFound);
+    return nullptr;
+}
+
+std::shared_ptr<Session> SessionManager::create_session(std::string_view id,
+                                                        Error *error) {
+    return add_session(id, nullptr, error);
+}
+
+std::shared_ptr<Session> SessionManager::fork_session(std::string_view id,
+                                                      std::string_view base_id,
+                                                      Error *error) {
+    auto parent = find_session(base_id, error);
+    if (!parent) {
+        return nullptr;
+    }
+    return add_session(id, parent.get(), error);
+}
+
+std::shared_ptr<Session> SessionManager::add_session(std::string_view id,
+                                                     Session *parent,
+                                                     Error *error) {
+    // With a lazy store, the ID may belong to a session that is not loaded.
+    // Asking the store does not load it or wait for queued writes.
+    if (store_ && store_->lazy()) {
+        Lookup found = store_->contains(id);
+        if (found != Lookup::Missing) {
+            set_error(error, found == Lookup::Found ? Error::Exists
+                                                    : Error::Unavailable);
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<Session> session;
+    std::shared_ptr<Session> evicted;
+    uint64_t lsn = 0;
+    {
+        Shard &shard = shard_for(id);
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        if (shard.sessions.count(id) ||
+            (!shard.spilled.empty() && shard.spilled.count(std::string(id)))) {
+            set_error(error, Error::Exists);
+            return nullptr; // Session with this ID already exists
+        }
+
+        session = parent ? make_session(id, *parent) : make_session(id);
+        auto &entry =
+            shard.sessions.try_emplace(session->id(), session).first->second;
+        entry.last_used.store(now_tick(), std::memory_order_relaxed);
+        list_add(session->id());
+        // Logged under the shard lock so it precedes any change to the
+        // session and is ordered against a concurrent remove. A fork logs
+        // itself while reading its parent.
+        if (parent) {
+            lsn = session->snapshot()->lsn;
+        } else if (store_) {
+            SessionRecord record;
+            record.type = SessionRecord::Type::Create;
+            record.session_id = session->id();
+            lsn = store_->append(record);
+        }
+        evicted = evict_locked(shard);
+    }
+    if (lsn && !store_->sync(lsn)) {
+        SPDLOG_ERROR("Creation of session '{}' could not be persisted.", id);
+    }
+    evicted.reset();
+    enforce_budget();
+    return session;
+}
+
+std::shared_ptr<Session> SessionManager::restore_session(SessionImage image) {
+    // Keep auto-generated IDs clear of restored numeric ones, with or
+    // without a prefix ("1042", "query-1042").
+    const size_t digits = image.id.find_last_not_of("0123456789") + 1;
+    if (digits < image.id.size() &&
+        (digits == 0 || image.id[digits - 1] == '-')) {
+        long pid = std::strtol(image.id.c_str() + digits, nullptr, 10);
+        long next = next_session_pid_.load();
+        while (pid >= next &&
+               !next_session_pid_.compare_exchange_weak(next, pid + 1)) {
+        }
+    }
+
+    std::shared_ptr<Session> session;
+    {
+        Shard &shard = shard_for(image.id);
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        if (shard.sessions.count(image.id) || shard.spilled.count(image.id)) {
+            return nullptr;
+        }
+        session = make_session(std::move(image));
+        auto &entry =
+            shard.sessions.try_emplace(session->id(), session).first->second;
+        entry.last_used.store(now_tick(), std::memory_order_relaxed);
+        list_add(session->id());
+    }
+    // Restoring more than fits spills the oldest sessions right away.
+    enforce_budget();
+    return session;
+}
+
+bool SessionManager::checkpoint_snapshots(
+    std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>>
+        &snapshots) {
+    snapshots.clear();
+    for (auto &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        snapshots.reserve(snapshots.size() + shard.sessions.size());
+        for (const auto &pair : shard.sessions) {
+            snapshots.emplace_back(pair.first,
+                                   pair.second.session->stable_snapshot());
+        }
+        for (const auto &pair : shard.spilled) {
+            std::string blob;
+            SessionImage image;
+            if (!spill_->read(pair.second, blob) ||
+                !codec::decode_image(blob, image)) {
+                // A checkpoint without it would persist it as removed.
+                SPDLOG_ERROR("Spilled session '{}' is unreadable; skipping "
+                             "the checkpoint.",
+                             pair.first);
+                snapshots.clear();
+                return false;
+            }
+            snapshots.emplace_back(pair.first, snapshot_of(std::move(image)));
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<Session>
+SessionManager::create_session_with_auto_id(std::string_view prefix) {
     // This loop ensures we find a unique ID, even if a user manually creates
     // a session with a conflicting numeric name.
     while (true) {
         // Atomically fetch the current value and then increment it.
         long pid = next_session_pid_++;
-        std::string id = std::to_string(pid);
+        std::string id(prefix);
+        id += std::to_string(pid);
 
         // Attempt to create the session using the existing thread-safe method.
-        auto session = create_session(id);
+        Error error = Error::None;
+        auto session = create_session(id, &error);
 
-        if (session) {
+        if (session || error == Error::Unavailable) {
             // If create_session returns a valid pointer, we succeeded.
             return session;
         }
@@ -36,41 +617,270 @@ std::shared_ptr<Session> SessionManager::create_session_with_auto_id() {
     }
 }
 
-bool SessionManager::remove_session(std::string_view id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    if (latest_session_id_ == id) {
-        latest_session_id_.clear();
+bool SessionManager::remove_session(std::string_view id, Error *error) {
+    // Clear 'latest' if it points at the session being removed. The CAS
+    // leaves a concurrently published newer value untouched.
+    auto latest = std::atomic_load(&latest_session_id_);
+    while (latest && *latest == id) {
+        if (std::atomic_compare_exchange_weak(
+                &latest_session_id_, &latest,
+                std::shared_ptr<const std::string>())) {
+            break;
+        }
     }
-    return sessions_.erase(id.data()) > 0;
+
+    // With a lazy store the session may exist only in the store. It is
+    // looked up there without being loaded.
+    Lookup stored = Lookup::Missing;
+    if (store_ && store_->lazy()) {
+        bool resident;
+        {
+            Shard &shard = shard_for(id);
+            std::shared_lock<std::shared_mutex> lock(shard.mtx);
+            resident = shard.sessions.count(id) != 0;
+        }
+        if (!resident) {
+            stored = store_->contains(id);
+        }
+        if (stored == Lookup::Unavailable) {
+            set_error(error, Error::Unavailable);
+            return false;
+        }
+    }
+
+    uint64_t lsn = 0;
+    std::shared_ptr<Session> removed;
+    {
+        Shard &shard = shard_for(id);
+        std::unique_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        auto spilled = shard.spilled.end();
+        if (it == shard.sessions.end() && !shard.spilled.empty()) {
+            spilled = shard.spilled.find(std::string(id));
+        }
+        if (it != shard.sessions.end()) {
+            removed = std::move(it->second.session);
+            shard.sessions.erase(it);
+        } else if (spilled != shard.spilled.end()) {
+            spill_->release(spilled->second);
+            shard.spilled.erase(spilled);
+        } else if (stored != Lookup::Found) {
+            set_error(error, Error::NotFound);
+            return false;
+        }
+        shard.generation++;
+        list_remove(id);
+        views_.remove(id);
+        search_.remove(id);
+        if (store_) {
+            SessionRecord record;
+            record.type = SessionRecord::Type::Remove;
+            record.session_id = id;
+            lsn = store_->append(record);
+        }
+    }
+    if (lsn && !store_->sync(lsn)) {
+        SPDLOG_ERROR("Removal of session '{}' could not be persisted.", id);
+    }
+    return true;
 }
 
-std::shared_ptr<Session> SessionManager::find_session(std::string_view id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = sessions_.find(id.data());
-    if (it != sessions_.end()) {
-        return it->second;
+std::shared_ptr<Session> SessionManager::find_session(std::string_view id,
+                                                      Error *error) {
+    bool spilled = false;
+    {
+        Shard &shard = shard_for(id);
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end()) {
+            if (evicting()) {
+                it->second.last_used.store(now_tick(),
+                                           std::memory_order_relaxed);
+            }
+            if (!it->second.stale.load(std::memory_order_relaxed)) {
+                auto session = it->second.session;
+                lock.unlock();
+                // Sessions grow without going through the manager, so the
+                // budget is rechecked on lookups (a single atomic load).
+                enforce_budget();
+                return session;
+            }
+        } else if (!shard.spilled.empty()) {
+            spilled = shard.spilled.count(std::string(id)) != 0;
+        }
+    }
+    if (spilled) {
+        return fault_in(id, error);
     }
+    if (store_ && store_->lazy()) {
+        // Missing, or changed by another instance while it was in use.
+        return refresh_session(id, error);
+    }
+    set_error(error, Error::NotFound);
     return nullptr;
 }
 
+std::shared_ptr<const SessionSnapshot>
+SessionManager::peek_snapshot(std::string_view id) {
+    Shard &shard = shard_for(id);
+    SpillFile::Extent extent;
+    uint64_t generation;
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(id);
+        if (it != shard.sessions.end() &&
+            !it->second.stale.load(std::memory_order_relaxed)) {
+            return it->second.session->snapshot();
+        }
+        auto spilled = shard.spilled.empty()
+                           ? shard.spilled.end()
+                           : shard.spilled.find(std::string(id));
+        if (spilled == shard.spilled.end()) {
+            if (!(store_ && store_->lazy())) {
+                return nullptr;
+            }
+            lock.unlock();
+            SessionImage image;
+            if (store_->load(id, image) != Lookup::Found) {
+                return nullptr;
+            }
+            return snapshot_of(std::move(image));
+        }
+        extent = spilled->second;
+        generation = shard.generation;
+    }
+    // Read outside the shard, like fault_in(); the result only counts if
+    // the extent was not released and reused meanwhile.
+    std::string blob;
+    SessionImage image;
+    const bool ok =
+        spill_->read(extent, blob) && codec::decode_image(blob, image);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto spilled = shard.spilled.find(std::string(id));
+        if (shard.generation != generation || spilled == shard.spilled.end() ||
+            spilled->second.offset != extent.offset) {
+            lock.unlock();
+            return peek_snapshot(id); // Removed or faulted in meanwhile
+        }
+    }
+    return ok ? snapshot_of(std::move(image)) : nullptr;
+}
+
+std::shared_ptr<Session> SessionManager::find_latest_session(Error *error) {
+    auto latest = std::atomic_load(&latest_session_id_);
+    if (!latest) {
+        set_error(error, Error::NotFound);
+        return nullptr;
+    }
+    return find_session(*latest, error);
+}
+
 std::vector<std::string> SessionManager::list_sessions() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    if (store_ && store_->lazy()) {
+        refresh_listing();
+    }
     std::vector<std::string> ids;
-    ids.reserve(sessions_.size());
-    for (const auto &pair : sessions_) {
-        ids.push_back(pair.first);
+    std::shared_lock<std::shared_mutex> lock(listing_mtx_);
+    ids.reserve(listing_.size());
+    for (const auto &pair : listing_) {
+        ids.push_back(pair.second);
     }
     return ids;
 }
 
+std::vector<SessionManager::ListedSession>
+SessionManager::list_sessions_page(uint64_t cursor, size_t limit) {
+    if (cursor == 0 && store_ && store_->lazy()) {
+        refresh_listing();
+    }
+    std::vector<ListedSession> page;
+    std::shared_lock<std::shared_mutex> lock(listing_mtx_);
+    for (auto it = listing_.upper_bound(cursor);
+         it != listing_.end() && page.size() < limit; ++it) {
+        page.push_back({it->first, it->second});
+    }
+    return page;
+}
+
+void SessionManager::list_add(std::string_view id) {
+    std::unique_lock<std::shared_mutex> lock(listing_mtx_);
+    list_add_locked(id);
+}
+
+void SessionManager::list_add_locked(std::string_view id) {
+    if (listing_positions_.count(id)) {
+        return;
+    }
+    const uint64_t position = next_position_++;
+    const std::string &key = listing_.emplace(position, id).first->second;
+    listing_positions_.emplace(key, position);
+}
+
+void SessionManager::list_remove(std::string_view id) {
+    std::unique_lock<std::shared_mutex> lock(listing_mtx_);
+    auto it = listing_positions_.find(id);
+    if (it == listing_positions_.end()) {
+        return;
+    }
+    const uint64_t position = it->second;
+    listing_positions_.erase(it);
+    listing_.erase(position);
+}
+
+void SessionManager::refresh_listing() {
+    // Sessions that are not loaded live only in the store, which may have
+    // been changed by other instances.
+    auto stored = store_->list_ids();
+    std::sort(stored.begin(), stored.end());
+    const std::unordered_set<std::string_view> present(stored.begin(),
+                                                       stored.end());
+    std::vector<std::string> gone;
+    {
+        std::shared_lock<std::shared_mutex> lock(listing_mtx_);
+        for (const auto &pair : listing_) {
+            if (!present.count(pair.second)) {
+                gone.push_back(pair.second);
+            }
+        }
+    }
+    for (const auto &id : gone) {
+        bool resident;
+        {
+            // Created here but not yet visible in the store.
+            Shard &shard = shard_for(id);
+            std::shared_lock<std::shared_mutex> lock(shard.mtx);
+            resident = shard.sessions.count(id) != 0;
+        }
+        if (!resident) {
+            list_remove(id);
+        }
+    }
+    // New sessions are listed in ID order, after the known ones.
+    std::unique_lock<std::shared_mutex> lock(listing_mtx_);
+    for (const auto &id : stored) {
+        list_add_locked(id);
+    }
+}
+
 void SessionManager::set_latest_session_id(std::string_view id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    latest_session_id_ = id;
+    auto current = std::atomic_load(&latest_session_id_);
+    if (current && *current == id) {
+        return; // Hot path: repeated writes to the same session
+    }
+    views_.touch(id);
+    std::atomic_store(&latest_session_id_,
+                      std::shared_ptr<const std::string>(
+                          std::make_shared<const std::string>(id)));
 }
 
 std::string SessionManager::get_latest_session_id() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return latest_session_id_;
+    auto latest = std::atomic_load(&latest_session_id_);
+    return latest ? *latest : std::string();
+}
+
+bool SessionManager::has_latest_session() const {
+    return std::atomic_load(&latest_session_id_) != nullptr;
 }
 
-} // namespace fusellm
\ No newline at end of file
+} // namespace fusellm
@@ -1,11 +1,18 @@
 #pragma once
 
+#include "../storage/SpillFile.h"
 #include "Session.h"
+#include "SessionViews.h"
+#include <array>
 #include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
-#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace fusellm {
@@ -17,9 +24,44 @@ namespace fusellm {
  * This class creates, finds, deletes, and lists all active Session objects.
  * It also tracks the most recently used session to support the 'latest'
  * symlink.
+ *
+ * Sessions are spread over hash shards, each guarded by its own
+ * reader/writer lock, so concurrent lookups (every getattr/read/write under
+ * /conversations) never contend on a single global mutex. The 'latest' ID is
+ * published through an atomic shared pointer and read without locking.
+ *
+ * With a lazy store (see SessionStore::lazy()) the manager is only a cache:
+ * a lookup that misses loads the session from the store, and each shard
+ * evicts its least recently used idle session once it holds more than its
+ * share of the configured capacity. If the store is shared with other
+ * instances, their change notifications drop the affected cached sessions
+ * (or mark them stale while in use), so the next access reloads them.
+ *
+ * Independently of the store, the memory held by resident sessions can be
+ * capped (see set_memory_budget()). Every session reports its exact size
+ * changes to a shared counter; once the total exceeds the budget, idle
+ * sessions are evicted least recently used first until it is back below
+ * 90% of it. Evicted sessions are compressed into a local spill file (or,
+ * with a lazy store, simply dropped) and faulted back in on their next
+ * lookup, so callers never notice. Old turns of resident sessions can
+ * additionally be kept compressed (see set_history_compressor()).
+ *
+ * Listings come from a separate index of every session in creation order,
+ * so directory reads are sorted, can be resumed page by page, and never
+ * have to visit the shards.
  */
 class SessionManager {
   public:
+    /**
+     * @brief Why a lookup, creation or removal failed.
+     */
+    enum class Error : uint8_t {
+        None,
+        NotFound,    // The session (or the base of a fork) does not exist
+        Exists,      // The session to create exists already
+        Unavailable, // The store or the spill file could not be read
+    };
+
     /**
      * @brief Constructs the SessionManager.
      * @param config A reference to the global ConfigManager, needed to
@@ -27,36 +69,103 @@ class SessionManager {
      */
     explicit SessionManager(const ConfigManager &config);
 
+    /**
+     * @brief Stops change notifications from the store before the sessions
+     * go away.
+     */
+    ~SessionManager();
+
     /**
      * @brief Creates a new session with the given ID.
      * @param id The unique identifier for the new session.
+     * @param error If not null, receives the reason when nullptr is returned.
      * @return A shared pointer to the new Session, or nullptr if a session
-     * with that ID already exists.
+     * with that ID already exists or the store is unreachable.
      */
-    std::shared_ptr<Session> create_session(std::string_view id);
+    std::shared_ptr<Session> create_session(std::string_view id,
+                                            Error *error = nullptr);
+
+    /**
+     * @brief Creates session `id` as a copy-on-write fork of `base_id` (see
+     * Session's fork constructor). O(1) whatever the length of the history.
+     * @return The new Session, or nullptr if `base_id` does not exist or
+     * `id` already does; `error`, if not null, tells which.
+     */
+    std::shared_ptr<Session> fork_session(std::string_view id,
+                                          std::string_view base_id,
+                                          Error *error = nullptr);
 
     /**
      * @brief Removes a session by its ID.
      * @param id The ID of the session to remove.
+     * @param error If not null, receives the reason when false is returned.
      * @return True if the session was found and removed, false otherwise.
      */
-    bool remove_session(std::string_view id);
+    bool remove_session(std::string_view id, Error *error = nullptr);
 
     /**
      * @brief Finds a session by its ID.
      * @param id The ID of the session to find.
+     * @param error If not null, receives the reason when nullptr is returned:
+     * NotFound, or Unavailable if a lazy store could not be reached.
      * @return A shared pointer to the Session, or nullptr if not found.
      */
-    std::shared_ptr<Session> find_session(std::string_view id);
+    std::shared_ptr<Session> find_session(std::string_view id,
+                                          Error *error = nullptr);
+
+    /**
+     * @brief The current state of session `id`, without bringing it into
+     * memory: a resident session is not marked as used, a spilled one is
+     * decoded from the spill file and one of a lazy store is read from it,
+     * neither being cached. For callers that only look, like search.
+     * @return The snapshot, or nullptr if the session does not exist or
+     * could not be read.
+     */
+    std::shared_ptr<const SessionSnapshot> peek_snapshot(std::string_view id);
+
+    /**
+     * @brief Finds the most recently interacted-with session.
+     * @return A shared pointer to the Session, or nullptr if there is none.
+     */
+    std::shared_ptr<Session> find_latest_session(Error *error = nullptr);
 
     /**
      * @brief Lists the IDs of all currently active sessions.
-     * @return A vector of strings containing the session IDs.
+     * @return A vector of strings containing the session IDs, oldest first.
      */
     std::vector<std::string> list_sessions();
 
+    struct ListedSession {
+        // Stable position in the listing; never reused for another session.
+        uint64_t position;
+        std::string id;
+    };
+
+    /**
+     * @brief Lists up to `limit` sessions in creation order, starting after
+     * position `cursor` (0 for the beginning). A listing resumed from the
+     * position of the last entry seen neither repeats nor skips sessions,
+     * whatever was created or removed in between.
+     *
+     * With a lazy store, a listing from the beginning first picks up the
+     * sessions other instances created or removed.
+     */
+    std::vector<ListedSession> list_sessions_page(uint64_t cursor,
+                                                  size_t limit);
+
     /**
-     * @brief Updates the ID of the most recently interacted-with session.
+     * @brief The by-date, by-model and recent views of the sessions.
+     */
+    const SessionViews &views() const { return views_; }
+
+    /**
+     * @brief Full-text index over the messages of every session.
+     */
+    const SearchIndex &search_index() const { return search_; }
+
+    /**
+     * @brief Updates the ID of the most recently interacted-with session
+     * and moves it to the front of the recent view.
      * @param id The ID of the latest session.
      */
     void set_latest_session_id(std::string_view id);
@@ -67,6 +176,12 @@ class SessionManager {
      */
     std::string get_latest_session_id();
 
+    /**
+     * @brief Whether a 'latest' session ID is currently set. Lock-free and
+     * allocation-free.
+     */
+    bool has_latest_session() const;
+
     /**
      * @brief Creates a session with an automatically generated, PID-like ID.
      *
@@ -74,25 +189,269 @@ class SessionManager {
      * incrementing ID and retrying if a collision occurs (e.g., if a user
      * manually created a session with a conflicting numeric ID).
      *
-     * @return A shared pointer to the newly created Session.
+     * @param prefix Put before the number, e.g. "query-" for "query-1042".
+     * @return A shared pointer to the newly created Session, or nullptr if
+     * the store could not be reached.
+     */
+    std::shared_ptr<Session>
+    create_session_with_auto_id(std::string_view prefix = {});
+
+    /**
+     * @brief Logs every session change to `store` from now on. Call once at
+     * startup, before sessions are created or restored.
+     * @param cache_capacity For a lazy store, the approximate number of
+     * sessions kept in memory; 0 keeps every loaded session. Ignored for
+     * eager stores, whose sessions cannot be reloaded.
+     */
+    void set_store(SessionStore *store, size_t cache_capacity = 0);
+
+    /**
+     * @brief Caps the memory of resident sessions at `budget_bytes`; 0
+     * means unlimited. Call once at startup, after set_store().
+     * @param spill Where evicted sessions go. Required unless the store is
+     * lazy, whose sessions can simply be reloaded; without either the
+     * budget is not enforced.
+     */
+    void set_memory_budget(size_t budget_bytes,
+                           std::unique_ptr<SpillFile> spill = nullptr);
+
+    /**
+     * @brief Compresses old turns of every session with `compressor` (see
+     * Session::compress_history()). Call once at startup, before sessions
+     * are created or restored.
+     */
+    void set_history_compressor(std::shared_ptr<HistoryCompressor> compressor) {
+        compressor_ = std::move(compressor);
+    }
+
+    struct MemoryStats {
+        size_t budget_bytes = 0;
+        int64_t resident_bytes = 0; // Sum of Session::memory_bytes()
+        size_t resident_sessions = 0;
+        size_t spilled_sessions = 0;
+        SpillFile::Stats spill;
+        HistoryCompressor::Stats history; // Compressed old turns
+        BlobStore::Stats blobs; // Large texts shared across sessions
+    };
+
+    MemoryStats memory_stats() const;
+
+    /**
+     * @brief Registers a callback run (from the store's notification thread)
+     * for every session changed by another instance, e.g. to invalidate
+     * kernel caches. An empty ID means the set of sessions may have changed.
+     * When notifications were lost, it is run for every cached session and
+     * then with an empty ID. Call before set_store().
+     */
+    void on_remote_change(std::function<void(const std::string &id)> callback) {
+        remote_change_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief Applies a change notification from the store (see
+     * SessionStore::ChangeListener).
+     */
+    void apply_store_change(std::string_view id, uint64_t version, bool local);
+
+    /**
+     * @brief Number of sessions currently held in memory.
+     */
+    size_t resident_sessions() const;
+
+    /**
+     * @brief Re-creates a persisted session without logging it again.
+     * @return The restored session, or nullptr if the ID is already taken.
+     */
+    std::shared_ptr<Session> restore_session(SessionImage image);
+
+    /**
+     * @brief Collects a consistent snapshot of every session for a
+     * checkpoint. Each snapshot reflects all records its session has handed
+     * to the store so far. Spilled sessions are read back from the spill
+     * file without being faulted in.
+     * @return False, with `snapshots` empty, if a spilled session could not
+     * be read; the checkpoint must then be skipped.
      */
-    std::shared_ptr<Session> create_session_with_auto_id();
+    bool checkpoint_snapshots(
+        std::vector<std::pair<std::string,
+                              std::shared_ptr<const SessionSnapshot>>>
+            &snapshots);
 
   private:
+    // Number of hash shards. A power of two well above typical FUSE worker
+    // thread counts keeps the chance of two lookups sharing a lock low.
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct Entry {
+        explicit Entry(std::shared_ptr<Session> s) : session(std::move(s)) {}
+        std::shared_ptr<Session> session;
+        // Steady-clock tick of the last lookup. Written with a relaxed store
+        // under the shared lock, so hits never contend on a common counter.
+        std::atomic<int64_t> last_used{0};
+        // Newest version of this session in a shared store that the cached
+        // copy reflects, and whether another instance has changed it since.
+        std::atomic<uint64_t> version{0};
+        std::atomic<bool> stale{false};
+    };
+
+    // Keys are views into Session::id(), which lives as long as the mapped
+    // Session, so lookups by string_view need no temporary std::string.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<std::string_view, Entry> sessions;
+        // Sessions evicted to the spill file to stay within the budget.
+        std::unordered_map<std::string, SpillFile::Extent> spilled;
+        // Bumped by every removal or remote change, so a lazy load that
+        // raced with one can tell its image may be stale.
+        uint64_t generation = 0;
+    };
+
+    Shard &shard_for(std::string_view id);
+
+    bool caching() const { return shard_capacity_ != 0; }
+
+    // Whether lookups must record recency for an eviction policy.
+    bool evicting() const { return caching() || memory_budget_ != 0; }
+
+    /**
+     * @brief Creates a session object wired to the store and the memory
+     * counter.
+     */
+    template <typename... Args>
+    std::shared_ptr<Session> make_session(Args &&...args);
+
+    /**
+     * @brief Wires a new session to the memory counter, the views, the
+     * search index and the history compressor.
+     */
+    void attach_session(Session &session);
+
+    /**
+     * @brief Creates session `id`, empty or as a fork of `parent`.
+     */
+    std::shared_ptr<Session> add_session(std::string_view id, Session *parent,
+                                         Error *error);
+
+    /**
+     * @brief Reads a spilled session back into memory. The shard is only
+     * locked to look the extent up and to reinstall the session. If the
+     * spill file cannot be read, the session stays spilled and `error`
+     * receives Unavailable.
+     */
+    std::shared_ptr<Session> fault_in(std::string_view id, Error *error);
+
+    /**
+     * @brief Evicts idle sessions, least recently used first, while the
+     * resident size is over budget. Cheap when it is not; call without any
+     * shard lock held.
+     */
+    void enforce_budget();
+
+    /**
+     * @brief Writes an idle session to the spill file (or drops it, for a
+     * lazy store) and removes it from the shard. Call with the shard lock
+     * held exclusively.
+     * @return The evicted session, to be released after unlocking, or
+     * nullptr if it could not be spilled.
+     */
+    std::shared_ptr<Session>
+    spill_locked(Shard &shard,
+                 std::unordered_map<std::string_view, Entry>::iterator it);
+
+    /**
+     * @brief Loads a session from a lazy store and caches it.
+     */
+    std::shared_ptr<Session> load_session(std::string_view id, Error *error);
+
+    /**
+     * @brief Drops the least recently used idle session of `shard` if it is
+     * over capacity. Call with the shard lock held exclusively.
+     * @return The evicted session, to be released after unlocking.
+     */
+    std::shared_ptr<Session> evict_locked(Shard &shard);
+
+    /**
+     * @brief Drops a cached session that another instance changed, or marks
+     * it stale if it is in use. Call with the shard lock held exclusively.
+     * @return The dropped session, to be released after unlocking.
+     */
+    std::shared_ptr<Session> invalidate_locked(Shard &shard, std::string_view id,
+                                               uint64_t version);
+
+    /**
+     * @brief Replaces a stale cached session by a fresh copy if it is idle.
+     */
+    std::shared_ptr<Session> refresh_session(std::string_view id,
+                                             Error *error);
+
+    static bool idle(const Entry &entry);
+
+    /**
+     * @brief Adds `id` at the end of the listing unless it is listed
+     * already. Call after adding the session to its shard.
+     */
+    void list_add(std::string_view id);
+    void list_add_locked(std::string_view id);
+
+    void list_remove(std::string_view id);
+
+    /**
+     * @brief Brings the listing in line with the sessions of a lazy store.
+     */
+    void refresh_listing();
+
     // A reference to the global config manager to pass to new sessions
     const ConfigManager &config_manager_;
 
-    // The primary storage for sessions, mapping ID to a session object
-    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
-    std::string latest_session_id_;
+    // Durable store for session changes; null when persistence is disabled.
+    SessionStore *store_ = nullptr;
+
+    // Maximum sessions per shard when caching a lazy store; 0 = unbounded.
+    size_t shard_capacity_ = 0;
+
+    std::function<void(const std::string &id)> remote_change_callback_;
+
+    // Shared by all sessions; null when old turns are not compressed.
+    std::shared_ptr<HistoryCompressor> compressor_;
+
+    // Memory budget for resident sessions; 0 = unlimited.
+    size_t memory_budget_ = 0;
+    std::unique_ptr<SpillFile> spill_;
+    // Sum of Session::memory_bytes() over resident sessions.
+    std::atomic<int64_t> resident_bytes_{0};
+    // Set while one thread runs enforce_budget(); others skip it.
+    std::atomic<bool> trimming_{false};
+    // Steady-clock tick before which no new pass is started, after a pass
+    // that found too few idle sessions to get under the budget.
+    std::atomic<int64_t> trim_after_{0};
+
+    // Every session, resident or not, by position in creation order, so
+    // listings are sorted and can be resumed without copying the whole
+    // set. Only creation and removal take the lock exclusively. Keys of
+    // `listing_positions_` are views into the mapped strings of `listing_`.
+    mutable std::shared_mutex listing_mtx_;
+    std::map<uint64_t, std::string> listing_;
+    std::unordered_map<std::string_view, uint64_t> listing_positions_;
+    uint64_t next_position_ = 1;
+
+    // Kept up to date by every session (see Session::track_views()).
+    SessionViews views_;
+    // Kept up to date by every session (see Session::track_search()).
+    SearchIndex search_;
+
+    // The primary storage for sessions, sharded by hash of the ID. Declared
+    // after everything a session reports to: a session dropped at
+    // destruction may still be finishing a queued prompt, which updates
+    // the views and the search index.
+    std::array<Shard, SHARD_COUNT> shards_;
 
-    // A single mutex to protect both the map and the 'latest_session_id_'
-    // string from concurrent access.
-    std::mutex mtx_;
+    // ID of the most recently used session; null when unset. Accessed only
+    // through std::atomic_load/std::atomic_store.
+    std::shared_ptr<const std::string> latest_session_id_;
 
     // A thread-safe, PID-like counter for generating unique session IDs.
     // Initialized to a common starting PID number for user processes.
     std::atomic<long> next_session_pid_{1000};
 };
 
-} // namespace fusellm
\ No newline at end of file
+} // namespace fusellm
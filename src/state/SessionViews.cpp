@@ -0,0 +1,177 @@
+#include "SessionViews.h"
+#include <ctime>
+
+namespace fusellm {
+
+SessionViews::SessionViews(size_t recent_capacity)
+    : recent_capacity_(recent_capacity) {}
+
+std::string SessionViews::day_of(Clock::time_point t) {
+    const std::time_t seconds = Clock::to_time_t(t);
+    std::tm local{};
+    localtime_r(&seconds, &local);
+    char day[16];
+    std::strftime(day, sizeof(day), "%Y-%m-%d", &local);
+    return day;
+}
+
+void SessionViews::file(Buckets &buckets, const std::string &key,
+                        const std::string &id) {
+    if (!key.empty()) {
+        buckets[key].insert(id);
+    }
+}
+
+void SessionViews::unfile(Buckets &buckets, const std::string &key,
+                          const std::string &id) {
+    auto it = buckets.find(key);
+    if (it == buckets.end()) {
+        return;
+    }
+    it->second.erase(id);
+    if (it->second.empty()) {
+        buckets.erase(it); // Empty days and models disappear from the view
+    }
+}
+
+void SessionViews::update(std::string_view id, std::string_view model,
+                          std::optional<Clock::time_point> last_active) {
+    const std::string day = last_active ? day_of(*last_active) : std::string();
+    {
+        // Most changes (a new turn on the same day) move nothing.
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = placements_.find(std::string(id));
+        if (it != placements_.end() && it->second.day == day &&
+            it->second.model == model) {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    auto [it, inserted] = placements_.try_emplace(std::string(id));
+    Placement &placement = it->second;
+    if (!inserted) {
+        if (placement.day == day && placement.model == model) {
+            return;
+        }
+        unfile(by_date_, placement.day, it->first);
+        unfile(by_model_, placement.model, it->first);
+    }
+    placement.day = day;
+    placement.model = model;
+    file(by_date_, placement.day, it->first);
+    file(by_model_, placement.model, it->first);
+}
+
+void SessionViews::remove(std::string_view id) {
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        auto it = placements_.find(std::string(id));
+        if (it != placements_.end()) {
+            unfile(by_date_, it->second.day, it->first);
+            unfile(by_model_, it->second.model, it->first);
+            placements_.erase(it);
+        }
+    }
+    std::lock_guard<std::mutex> lock(recent_mtx_);
+    auto it = recent_index_.find(id);
+    if (it != recent_index_.end()) {
+        auto entry = it->second;
+        recent_index_.erase(it);
+        recent_.erase(entry);
+    }
+}
+
+void SessionViews::touch(std::string_view id) {
+    if (recent_capacity_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(recent_mtx_);
+    auto it = recent_index_.find(id);
+    if (it != recent_index_.end()) {
+        recent_.splice(recent_.begin(), recent_, it->second);
+        return;
+    }
+    recent_.emplace_front(id);
+    recent_index_.emplace(recent_.front(), recent_.begin());
+    if (recent_.size() > recent_capacity_) {
+        recent_index_.erase(recent_.back());
+        recent_.pop_back();
+    }
+}
+
+std::vector<std::string> SessionViews::keys(const Buckets &buckets) {
+    std::vector<std::string> result;
+    result.reserve(buckets.size());
+    for (const auto &pair : buckets) {
+        result.push_back(pair.first);
+    }
+    return result;
+}
+
+std::vector<std::string> SessionViews::members(const Buckets &buckets,
+                                               std::string_view key) {
+    auto it = buckets.find(key);
+    if (it == buckets.end()) {
+        return {};
+    }
+    return std::vector<std::string>(it->second.begin(), it->second.end());
+}
+
+bool SessionViews::contains(const Buckets &buckets, std::string_view key,
+                            std::string_view id) {
+    auto it = buckets.find(key);
+    return it != buckets.end() && it->second.find(id) != it->second.end();
+}
+
+std::vector<std::string> SessionViews::dates() const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return keys(by_date_);
+}
+
+std::vector<std::string> SessionViews::by_date(std::string_view day) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return members(by_date_, day);
+}
+
+std::vector<std::string> SessionViews::models() const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return keys(by_model_);
+}
+
+std::vector<std::string> SessionViews::by_model(std::string_view model) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return members(by_model_, model);
+}
+
+std::vector<std::string> SessionViews::recent() const {
+    std::lock_guard<std::mutex> lock(recent_mtx_);
+    return std::vector<std::string>(recent_.begin(), recent_.end());
+}
+
+bool SessionViews::has_date(std::string_view day) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return by_date_.find(day) != by_date_.end();
+}
+
+bool SessionViews::has_model(std::string_view model) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return by_model_.find(model) != by_model_.end();
+}
+
+bool SessionViews::in_date(std::string_view day, std::string_view id) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return contains(by_date_, day, id);
+}
+
+bool SessionViews::in_model(std::string_view model,
+                            std::string_view id) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return contains(by_model_, model, id);
+}
+
+bool SessionViews::in_recent(std::string_view id) const {
+    std::lock_guard<std::mutex> lock(recent_mtx_);
+    return recent_index_.count(id) != 0;
+}
+
+} // namespace fusellm
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class SessionViews
+ * @brief Secondary indexes behind the derived directories of
+ * /conversations: `by-date/<YYYY-MM-DD>/`, `by-model/<model>/` and
+ * `recent/`.
+ *
+ * The indexes are kept up to date as sessions change (see
+ * Session::track_views()) rather than computed when a view is listed, so
+ * listing a view takes time proportional to that view alone. A session is
+ * filed under the day of its latest message (local time; sessions without
+ * messages are in no day) and under its model. The recent list holds the
+ * last `recent_capacity` sessions written to, most recent first, and is
+ * updated in O(1).
+ *
+ * Sessions stay in the views while they are spilled or evicted, since they
+ * cannot change meanwhile. With a lazy store, sessions that were never
+ * loaded by this instance are not in the date and model views.
+ *
+ * This class is thread-safe.
+ */
+class SessionViews {
+  public:
+    using Clock = std::chrono::system_clock;
+
+    explicit SessionViews(size_t recent_capacity = 50);
+
+    /**
+     * @brief Files session `id` under `model` and the day of `last_active`
+     * (none if unset), moving it out of its previous buckets.
+     */
+    void update(std::string_view id, std::string_view model,
+                std::optional<Clock::time_point> last_active);
+
+    /**
+     * @brief Drops session `id` from every view.
+     */
+    void remove(std::string_view id);
+
+    /**
+     * @brief Moves session `id` to the front of the recent list.
+     */
+    void touch(std::string_view id);
+
+    // Days that have sessions, oldest first.
+    std::vector<std::string> dates() const;
+    std::vector<std::string> by_date(std::string_view day) const;
+
+    // Models that have sessions, by name.
+    std::vector<std::string> models() const;
+    std::vector<std::string> by_model(std::string_view model) const;
+
+    // Most recent first.
+    std::vector<std::string> recent() const;
+
+    bool has_date(std::string_view day) const;
+    bool has_model(std::string_view model) const;
+    bool in_date(std::string_view day, std::string_view id) const;
+    bool in_model(std::string_view model, std::string_view id) const;
+    bool in_recent(std::string_view id) const;
+
+    /**
+     * @brief The directory name of the day `t` falls on: YYYY-MM-DD, local
+     * time.
+     */
+    static std::string day_of(Clock::time_point t);
+
+  private:
+    using Bucket = std::set<std::string, std::less<>>;
+    using Buckets = std::map<std::string, Bucket, std::less<>>;
+
+    struct Placement {
+        std::string day; // Empty when the session has no messages
+        std::string model;
+    };
+
+    static void file(Buckets &buckets, const std::string &key,
+                     const std::string &id);
+    static void unfile(Buckets &buckets, const std::string &key,
+                       const std::string &id);
+    static std::vector<std::string> keys(const Buckets &buckets);
+    static std::vector<std::string> members(const Buckets &buckets,
+                                            std::string_view key);
+    static bool contains(const Buckets &buckets, std::string_view key,
+                         std::string_view id);
+
+    // Date and model views.
+    mutable std::shared_mutex mtx_;
+    std::unordered_map<std::string, Placement> placements_;
+    Buckets by_date_;
+    Buckets by_model_;
+
+    // Recent view: a list in recency order plus an index into it. Keys of
+    // `recent_index_` are views into the list's strings.
+    mutable std::mutex recent_mtx_;
+    const size_t recent_capacity_;
+    std::list<std::string> recent_;
+    std::unordered_map<std::string_view, std::list<std::string>::iterator>
+        recent_index_;
+};
+
+} // namespace fusellm
@@ -0,0 +1,349 @@
+#include "RecordCodec.h"
+#include <array>
+#include <cstring>
+
+namespace fusellm {
+namespace codec {
+
+namespace {
+
+// 记录格式版本号，字段或记录类型变化时递增。解码时照常读取旧版本的记录，
+// 拒绝未知的新版本
+constexpr uint8_t RECORD_FORMAT = 2;
+constexpr uint8_t IMAGE_FORMAT = 1;
+
+// ModelParameters 中各可选字段的存在位：第 i 位对应参数表的第 i 项。
+// 参数只在表尾追加，旧记录用到的低位含义不变，照常解码。
+static_assert(params::COUNT <= 8,
+              "parameter presence bits no longer fit in one byte");
+
+void put(Writer &w, double v) { w.f64(v); }
+void put(Writer &w, int64_t v) { w.i64(v); }
+void put(Writer &w, const Blob &v) { w.str(v.view()); }
+void put(Writer &w, const StopList &v) { w.strings(v); }
+
+void get(Reader &r, std::optional<double> &v) { v = r.f64(); }
+void get(Reader &r, std::optional<int64_t> &v) { v = r.i64(); }
+void get(Reader &r, std::optional<Blob> &v) { v = Blob(r.str()); }
+void get(Reader &r, std::optional<StopList> &v) { v = r.strings(); }
+
+std::array<uint32_t, 256> make_crc_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+int64_t to_nanos(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               tp.time_since_epoch())
+        .count();
+}
+
+std::chrono::system_clock::time_point from_nanos(int64_t ns) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(ns)));
+}
+
+} // namespace
+
+uint32_t crc32(const void *data, size_t size, uint32_t seed) {
+    static const std::array<uint32_t, 256> table = make_crc_table();
+    const auto *p = static_cast<const unsigned char *>(data);
+    uint32_t c = seed ^ 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        c = table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// --- Writer ---
+
+void Writer::u32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+void Writer::u64(uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+void Writer::f64(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    u64(bits);
+}
+
+void Writer::str(std::string_view v) {
+    u32(static_cast<uint32_t>(v.size()));
+    out_.append(v.data(), v.size());
+}
+
+void Writer::str(const Rope &v) {
+    u32(static_cast<uint32_t>(v.size()));
+    const size_t at = out_.size();
+    out_.resize(at + v.size());
+    v.read(0, out_.data() + at, v.size());
+}
+
+void Writer::message(const Message &msg) {
+    u8(static_cast<uint8_t>(msg.role));
+    i64(to_nanos(msg.timestamp));
+    str(msg.content);
+}
+
+void Writer::message(const History::Entry &msg) {
+    u8(static_cast<uint8_t>(msg.role));
+    i64(to_nanos(msg.timestamp));
+    str(msg.content);
+}
+
+void Writer::messages(const std::vector<Message> &msgs) {
+    u32(static_cast<uint32_t>(msgs.size()));
+    for (const auto &msg : msgs) {
+        message(msg);
+    }
+}
+
+void Writer::messages(const History &msgs) {
+    u32(static_cast<uint32_t>(msgs.size()));
+    for (const auto &msg : msgs) {
+        message(msg);
+    }
+}
+
+void Writer::strings(const std::vector<std::string> &v) {
+    u32(static_cast<uint32_t>(v.size()));
+    for (const auto &s : v) {
+        str(s);
+    }
+}
+
+void Writer::params(const ModelParameters &params) {
+    uint8_t bits = 0;
+    uint8_t bit = 1;
+    params::for_each([&](const auto &field) {
+        if (params.*field.member)
+            bits |= bit;
+        bit <<= 1;
+    });
+    u8(bits);
+    params::for_each([&](const auto &field) {
+        if (const auto &value = params.*field.member)
+            put(*this, *value);
+    });
+}
+
+// --- Reader ---
+
+bool Reader::need(size_t n) {
+    if (!ok_ || in_.size() - pos_ < n) {
+        ok_ = false;
+        return false;
+    }
+    return true;
+}
+
+uint8_t Reader::u8() {
+    if (!need(1))
+        return 0;
+    return static_cast<uint8_t>(in_[pos_++]);
+}
+
+uint32_t Reader::u32() {
+    if (!need(4))
+        return 0;
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(in_[pos_++]))
+             << (8 * i);
+    }
+    return v;
+}
+
+uint64_t Reader::u64() {
+    if (!need(8))
+        return 0;
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(in_[pos_++]))
+             << (8 * i);
+    }
+    return v;
+}
+
+double Reader::f64() {
+    uint64_t bits = u64();
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+std::string_view Reader::str() {
+    uint32_t len = u32();
+    if (!need(len))
+        return {};
+    std::string_view v = in_.substr(pos_, len);
+    pos_ += len;
+    return v;
+}
+
+Message Reader::message() {
+    Message msg;
+    uint8_t role = u8();
+    if (role > static_cast<uint8_t>(Message::Role::AI)) {
+        ok_ = false;
+    }
+    msg.role = static_cast<Message::Role>(role);
+    msg.timestamp = from_nanos(i64());
+    msg.content = std::string(str());
+    return msg;
+}
+
+std::vector<Message> Reader::messages() {
+    uint32_t count = u32();
+    std::vector<Message> msgs;
+    // Each message takes at least 13 bytes; reject absurd counts up front.
+    if (!need(static_cast<size_t>(count) * 13)) {
+        return msgs;
+    }
+    msgs.reserve(count);
+    for (uint32_t i = 0; i < count && ok_; i++) {
+        msgs.push_back(message());
+    }
+    return msgs;
+}
+
+std::vector<std::string> Reader::strings() {
+    std::vector<std::string> v;
+    uint32_t count = u32();
+    for (uint32_t i = 0; i < count && ok_; i++) {
+        v.emplace_back(str());
+    }
+    return v;
+}
+
+ModelParameters Reader::params() {
+    ModelParameters params;
+    uint8_t bits = u8();
+    uint8_t bit = 1;
+    params::for_each([&](const auto &field) {
+        if ((bits & bit) && ok_)
+            get(*this, params.*field.member);
+        bit <<= 1;
+    });
+    return params;
+}
+
+// --- Records and images ---
+
+void encode_record(const SessionRecord &record, std::string &out) {
+    Writer w(out);
+    w.u8(RECORD_FORMAT);
+    w.u8(static_cast<uint8_t>(record.type));
+    w.str(record.session_id);
+    switch (record.type) {
+    case SessionRecord::Type::AppendTurn:
+    case SessionRecord::Type::ReplaceHistory:
+        w.messages(record.messages);
+        break;
+    case SessionRecord::Type::SetContext:
+    case SessionRecord::Type::SetModel:
+    case SessionRecord::Type::Fork:
+        w.str(record.text);
+        break;
+    case SessionRecord::Type::WriteContext:
+        w.u64(record.offset);
+        w.str(record.text);
+        break;
+    case SessionRecord::Type::TruncateContext:
+        w.u64(record.offset);
+        break;
+    case SessionRecord::Type::SetSettings:
+        w.params(record.params);
+        break;
+    default:
+        break;
+    }
+}
+
+bool decode_record(std::string_view payload, SessionRecord &record) {
+    Reader r(payload);
+    const uint8_t format = r.u8();
+    if (format == 0 || format > RECORD_FORMAT) {
+        return false;
+    }
+    // 格式 2 新增了 WriteContext、TruncateContext 和 Fork
+    const auto last = format >= 2 ? SessionRecord::Type::Fork
+                                  : SessionRecord::Type::SetSettings;
+    uint8_t type = r.u8();
+    if (type > static_cast<uint8_t>(last)) {
+        return false;
+    }
+    record.type = static_cast<SessionRecord::Type>(type);
+    record.session_id = std::string(r.str());
+    switch (record.type) {
+    case SessionRecord::Type::AppendTurn:
+    case SessionRecord::Type::ReplaceHistory:
+        record.messages = r.messages();
+        break;
+    case SessionRecord::Type::SetContext:
+    case SessionRecord::Type::SetModel:
+    case SessionRecord::Type::Fork:
+        record.text = std::string(r.str());
+        break;
+    case SessionRecord::Type::WriteContext:
+        record.offset = r.u64();
+        record.text = std::string(r.str());
+        break;
+    case SessionRecord::Type::TruncateContext:
+        record.offset = r.u64();
+        break;
+    case SessionRecord::Type::SetSettings:
+        record.params = r.params();
+        break;
+    default:
+        break;
+    }
+    return r.ok() && r.at_end();
+}
+
+void encode_image(std::string_view id, uint64_t lsn,
+                  const History &history, const Rope &context,
+                  std::string_view model_name, const ModelParameters &overrides,
+                  std::string &out) {
+    Writer w(out);
+    w.u8(IMAGE_FORMAT);
+    w.str(id);
+    w.u64(lsn);
+    w.messages(history);
+    w.str(context);
+    w.str(model_name);
+    w.params(overrides);
+}
+
+bool decode_image(std::string_view payload, SessionImage &image) {
+    Reader r(payload);
+    if (r.u8() != IMAGE_FORMAT) {
+        return false;
+    }
+    image.id = std::string(r.str());
+    image.lsn = r.u64();
+    image.history = r.messages();
+    image.context = std::string(r.str());
+    image.model_name = std::string(r.str());
+    image.overrides = r.params();
+    return r.ok() && r.at_end();
+}
+
+} // namespace codec
+} // namespace fusellm
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../common/History.h"
+#include "SessionStore.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace fusellm {
+namespace codec {
+
+/**
+ * @brief CRC-32 (IEEE 802.3) of a byte range, used to detect torn or
+ * corrupted records.
+ */
+uint32_t crc32(const void *data, size_t size, uint32_t seed = 0);
+
+/**
+ * @class Writer
+ * @brief Appends little-endian, length-prefixed fields to a byte buffer.
+ */
+class Writer {
+  public:
+    explicit Writer(std::string &out) : out_(out) {}
+
+    void u8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v);
+    void u64(uint64_t v);
+    void i64(int64_t v) { u64(static_cast<uint64_t>(v)); }
+    void f64(double v);
+    void str(std::string_view v);
+    void str(const Rope &v); // Same encoding, copied piece by piece
+    void message(const Message &msg);
+    void message(const History::Entry &msg);
+    void messages(const std::vector<Message> &msgs);
+    void messages(const History &msgs);
+    void strings(const std::vector<std::string> &v);
+    void params(const ModelParameters &params);
+
+  private:
+    std::string &out_;
+};
+
+/**
+ * @class Reader
+ * @brief Reads fields written by Writer. Any out-of-bounds read puts the
+ * reader into a failed state instead of throwing.
+ */
+class Reader {
+  public:
+    explicit Reader(std::string_view in) : in_(in) {}
+
+    bool ok() const { return ok_; }
+    bool at_end() const { return pos_ == in_.size(); }
+
+    uint8_t u8();
+    uint32_t u32();
+    uint64_t u64();
+    int64_t i64() { return static_cast<int64_t>(u64()); }
+    double f64();
+    std::string_view str();
+    Message message();
+    std::vector<Message> messages();
+    std::vector<std::string> strings();
+    ModelParameters params();
+
+  private:
+    bool need(size_t n);
+
+    std::string_view in_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+/**
+ * @brief Serializes a record (without framing) and appends it to `out`.
+ */
+void encode_record(const SessionRecord &record, std::string &out);
+
+/**
+ * @brief Parses a record written by encode_record().
+ * @return False if the payload is malformed.
+ */
+bool decode_record(std::string_view payload, SessionRecord &record);
+
+/**
+ * @brief Serializes a full session image and appends it to `out`.
+ */
+void encode_image(std::string_view id, uint64_t lsn,
+                  const History &history, const Rope &context,
+                  std::string_view model_name, const ModelParameters &overrides,
+                  std::string &out);
+
+/**
+ * @brief Parses an image written by encode_image().
+ * @return False if the payload is malformed.
+ */
+bool decode_image(std::string_view payload, SessionImage &image);
+
+} // namespace codec
+} // namespace fusellm
@@ -0,0 +1,189 @@
+#include "RedisConnection.h"
+#include "spdlog/spdlog.h"
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+namespace fusellm {
+
+namespace {
+
+bool starts_with(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+} // namespace
+
+RedisConnection::RedisConnection(std::string_view url,
+                                 std::chrono::milliseconds timeout)
+    : url_(url), timeout_(timeout) {
+    std::string_view rest;
+    if (starts_with(url, "unix://")) {
+        socket_path_ = std::string(url.substr(7));
+        if (socket_path_.empty()) {
+            throw std::runtime_error("Invalid Redis URL '" + url_ +
+                                     "': missing socket path");
+        }
+        return;
+    }
+    if (starts_with(url, "redis://")) {
+        rest = url.substr(8);
+    } else if (starts_with(url, "tcp://")) {
+        rest = url.substr(6);
+    } else {
+        throw std::runtime_error("Invalid Redis URL '" + url_ +
+                                 "': expected redis://, tcp:// or unix://");
+    }
+
+    // host[:port][/db]
+    if (auto slash = rest.find('/'); slash != std::string_view::npos) {
+        std::string db(rest.substr(slash + 1));
+        char *end = nullptr;
+        db_ = static_cast<int>(std::strtol(db.c_str(), &end, 10));
+        if (db.empty() || *end != '\0' || db_ < 0) {
+            throw std::runtime_error("Invalid Redis URL '" + url_ +
+                                     "': bad database number");
+        }
+        rest = rest.substr(0, slash);
+    }
+    if (auto colon = rest.rfind(':'); colon != std::string_view::npos) {
+        std::string port(rest.substr(colon + 1));
+        char *end = nullptr;
+        port_ = static_cast<int>(std::strtol(port.c_str(), &end, 10));
+        if (port.empty() || *end != '\0' || port_ <= 0 || port_ > 65535) {
+            throw std::runtime_error("Invalid Redis URL '" + url_ +
+                                     "': bad port");
+        }
+        rest = rest.substr(0, colon);
+    }
+    host_ = rest.empty() ? "127.0.0.1" : std::string(rest);
+}
+
+RedisConnection::~RedisConnection() { disconnect(); }
+
+void RedisConnection::disconnect() {
+    if (ctx_) {
+        fd_.store(-1);
+        redisFree(ctx_);
+        ctx_ = nullptr;
+    }
+}
+
+bool RedisConnection::ensure_connected() {
+    if (ctx_) {
+        return true;
+    }
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout_.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout_.count() % 1000) * 1000);
+
+    redisContext *ctx =
+        socket_path_.empty()
+            ? redisConnectWithTimeout(host_.c_str(), port_, tv)
+            : redisConnectUnixWithTimeout(socket_path_.c_str(), tv);
+    if (!ctx || ctx->err) {
+        SPDLOG_WARN("Cannot connect to Redis at '{}': {}", url_,
+                    ctx ? ctx->errstr : "out of memory");
+        if (ctx) {
+            redisFree(ctx);
+        }
+        return false;
+    }
+    // Bound every later read/write too, so a hung server cannot stall us.
+    redisSetTimeout(ctx, tv);
+    ctx_ = ctx;
+    fd_.store(ctx->fd);
+
+    if (db_ != 0) {
+        auto reply = command({"SELECT", std::to_string(db_)});
+        if (!reply || reply->type == REDIS_REPLY_ERROR) {
+            SPDLOG_ERROR("Cannot select Redis database {} on '{}'.", db_, url_);
+            disconnect();
+            return false;
+        }
+    }
+    connections_++;
+    SPDLOG_INFO("Connected to Redis at '{}'.", url_);
+    return true;
+}
+
+bool RedisConnection::pipeline(const std::vector<Command> &commands,
+                               std::vector<RedisReply> &replies) {
+    replies.clear();
+    if (!ensure_connected()) {
+        return false;
+    }
+
+    std::vector<const char *> argv;
+    std::vector<size_t> argvlen;
+    for (const auto &cmd : commands) {
+        argv.clear();
+        argvlen.clear();
+        for (const auto &arg : cmd) {
+            argv.push_back(arg.data());
+            argvlen.push_back(arg.size());
+        }
+        if (redisAppendCommandArgv(ctx_, static_cast<int>(argv.size()),
+                                   argv.data(), argvlen.data()) != REDIS_OK) {
+            SPDLOG_ERROR("Redis command buffering failed: {}", ctx_->errstr);
+            disconnect();
+            return false;
+        }
+    }
+
+    replies.reserve(commands.size());
+    for (size_t i = 0; i < commands.size(); i++) {
+        void *raw = nullptr;
+        if (redisGetReply(ctx_, &raw) != REDIS_OK) {
+            SPDLOG_WARN("Redis connection to '{}' lost: {}", url_,
+                        ctx_->errstr);
+            disconnect();
+            return false;
+        }
+        replies.emplace_back(static_cast<redisReply *>(raw));
+    }
+    return true;
+}
+
+bool RedisConnection::subscribe(const std::string &channel) {
+    auto reply = command({"SUBSCRIBE", channel});
+    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
+        disconnect();
+        return false;
+    }
+    // A timed-out read leaves a hiredis context unusable, and a quiet
+    // channel is normal, so push reads block until data or interrupt().
+    struct timeval forever = {0, 0};
+    redisSetTimeout(ctx_, forever);
+    return true;
+}
+
+RedisReply RedisConnection::read_push() {
+    if (!ctx_) {
+        return nullptr;
+    }
+    void *raw = nullptr;
+    if (redisGetReply(ctx_, &raw) != REDIS_OK) {
+        disconnect();
+        return nullptr;
+    }
+    return RedisReply(static_cast<redisReply *>(raw));
+}
+
+void RedisConnection::interrupt() {
+    int fd = fd_.load();
+    if (fd >= 0) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+}
+
+RedisReply RedisConnection::command(const Command &cmd) {
+    std::vector<RedisReply> replies;
+    if (!pipeline({cmd}, replies)) {
+        return nullptr;
+    }
+    return std::move(replies.front());
+}
+
+} // namespace fusellm
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <hiredis/hiredis.h>
+
+namespace fusellm {
+
+struct RedisReplyDeleter {
+    void operator()(redisReply *reply) const {
+        if (reply) {
+            freeReplyObject(reply);
+        }
+    }
+};
+
+using RedisReply = std::unique_ptr<redisReply, RedisReplyDeleter>;
+
+/**
+ * @class RedisConnection
+ * @brief A single blocking hiredis connection with lazy reconnect.
+ *
+ * Accepted URLs: `redis://host[:port][/db]`, `tcp://host[:port][/db]` and
+ * `unix:///path/to/redis.sock`. The connection is (re)established on first
+ * use after a failure, so callers simply retry.
+ *
+ * Not thread-safe: each thread that talks to Redis owns its own connection.
+ * The only exception is interrupt(), which may be called from any thread.
+ */
+class RedisConnection {
+  public:
+    using Command = std::vector<std::string>;
+
+    /**
+     * @brief Parses `url`; does not connect yet.
+     * Throws std::runtime_error if the URL is malformed.
+     */
+    explicit RedisConnection(std::string_view url,
+                             std::chrono::milliseconds timeout =
+                                 std::chrono::milliseconds(2000));
+    ~RedisConnection();
+
+    RedisConnection(const RedisConnection &) = delete;
+    RedisConnection &operator=(const RedisConnection &) = delete;
+
+    /**
+     * @brief Connects if not connected.
+     * @return False if the server is unreachable.
+     */
+    bool ensure_connected();
+
+    /**
+     * @brief Sends all commands in one round trip and reads every reply.
+     * @param replies Receives one reply per command, in order. Error replies
+     * (REDIS_REPLY_ERROR) are returned as-is.
+     * @return False on a connection error; the connection is dropped and
+     * `replies` is incomplete.
+     */
+    bool pipeline(const std::vector<Command> &commands,
+                  std::vector<RedisReply> &replies);
+
+    /**
+     * @brief Runs a single command.
+     * @return The reply, or null on a connection error.
+     */
+    RedisReply command(const Command &cmd);
+
+    /**
+     * @brief Subscribes to `channel` and puts the connection in push mode:
+     * from now on only read_push() may be used, and reads block without a
+     * timeout until a message arrives or interrupt() is called.
+     * @return False on a connection error.
+     */
+    bool subscribe(const std::string &channel);
+
+    /**
+     * @brief Waits for the next message pushed by the server.
+     * @return The reply, or null on a connection error or interrupt().
+     */
+    RedisReply read_push();
+
+    /**
+     * @brief Wakes a thread blocked in read_push() by shutting the socket
+     * down. Safe to call from any thread.
+     */
+    void interrupt();
+
+    const std::string &url() const { return url_; }
+
+    /**
+     * @brief Number of times the connection has been established. Changes
+     * after every reconnect, which may have reached a restarted server.
+     */
+    uint64_t connections() const { return connections_; }
+
+  private:
+    void disconnect();
+
+    std::string url_;
+    std::string host_;
+    int port_ = 6379;
+    std::string socket_path_; // Non-empty for unix:// URLs
+    int db_ = 0;
+    std::chrono::milliseconds timeout_;
+    redisContext *ctx_ = nullptr;
+    std::atomic<int> fd_{-1}; // Socket of ctx_, for interrupt()
+    uint64_t connections_ = 0;
+};
+
+} // namespace fusellm
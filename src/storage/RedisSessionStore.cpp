@@ -0,0 +1,833 @@
+#include "RedisSessionStore.h"
+#include "RecordCodec.h"
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+
+namespace fusellm {
+
+namespace {
+
+// Records written per MULTI/EXEC round trip.
+constexpr size_t MAX_BATCH = 256;
+// How long a read waits for queued writes to reach Redis.
+constexpr std::chrono::milliseconds FLUSH_TIMEOUT{5000};
+// Lifetime of an instance's applied-LSN marker; it only has to outlive the
+// retries of one batch.
+constexpr const char *APPLIED_TTL = "86400";
+constexpr std::chrono::milliseconds MIN_BACKOFF{100};
+constexpr std::chrono::milliseconds MAX_BACKOFF{5000};
+// Attempts left for queued writes once the store is being destroyed.
+constexpr int SHUTDOWN_ATTEMPTS = 3;
+
+// Bumps a session's version and announces it in one atomic step, so the
+// published version always matches the data a reader will load.
+// KEYS: session hash, events channel. ARGV: origin, session ID.
+constexpr const char *BUMP_AND_PUBLISH = R"lua(
+local v = redis.call('HINCRBY', KEYS[1], 'version', 1)
+redis.call('PUBLISH', KEYS[2], ARGV[1] .. ' ' .. v .. ' ' .. ARGV[2])
+return v
+)lua";
+
+// Writes into or truncates a context in place, so appending to a large
+// context sends only the new bytes. A context still in the session hash
+// (older layout) is moved to its own key first.
+// KEYS: session hash, context. ARGV: "write" offset data | "truncate" size.
+constexpr const char *EDIT_CONTEXT = R"lua(
+if redis.call('EXISTS', KEYS[2]) == 0 then
+  local legacy = redis.call('HGET', KEYS[1], 'context')
+  if legacy then
+    redis.call('SET', KEYS[2], legacy)
+    redis.call('HDEL', KEYS[1], 'context')
+  end
+end
+local at = tonumber(ARGV[2])
+if ARGV[1] == 'write' then
+  return redis.call('SETRANGE', KEYS[2], at, ARGV[3])
+end
+local len = redis.call('STRLEN', KEYS[2])
+if at == 0 then
+  redis.call('SET', KEYS[2], '')
+elseif at < len then
+  redis.call('SET', KEYS[2], redis.call('GETRANGE', KEYS[2], 0, at - 1))
+elseif at > len then
+  redis.call('SETRANGE', KEYS[2], at - 1, '\0')
+end
+return at
+)lua";
+
+std::string random_origin() {
+    std::random_device rd;
+    uint64_t v = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+const char *role_name(Message::Role role) {
+    switch (role) {
+    case Message::Role::System:
+        return "system";
+    case Message::Role::User:
+        return "user";
+    default:
+        return "assistant";
+    }
+}
+
+Message::Role parse_role(std::string_view name) {
+    if (name == "system") {
+        return Message::Role::System;
+    }
+    if (name == "user") {
+        return Message::Role::User;
+    }
+    return Message::Role::AI;
+}
+
+// The text of a string, status or error reply; empty for anything else.
+std::string reply_string(const redisReply *reply) {
+    if (reply && (reply->type == REDIS_REPLY_STRING ||
+                  reply->type == REDIS_REPLY_STATUS ||
+                  reply->type == REDIS_REPLY_ERROR)) {
+        return std::string(reply->str, reply->len);
+    }
+    return {};
+}
+
+bool is_noscript(const redisReply *reply) {
+    return reply->type == REDIS_REPLY_ERROR &&
+           reply_string(reply).compare(0, 8, "NOSCRIPT") == 0;
+}
+
+std::string format_double(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", v);
+    return buf;
+}
+
+// A parameter value as stored in a `param.<name>` hash field.
+std::string format_param(double v) { return format_double(v); }
+std::string format_param(int64_t v) { return std::to_string(v); }
+std::string format_param(const Blob &v) { return v.str(); }
+// Stop sequences are a JSON array, readable with redis-cli like the rest.
+std::string format_param(const StopList &v) {
+    return nlohmann::json(v).dump(-1, ' ', false,
+                                  nlohmann::json::error_handler_t::replace);
+}
+
+void parse_value(const std::string &s, std::optional<double> &v) {
+    v = std::strtod(s.c_str(), nullptr);
+}
+void parse_value(const std::string &s, std::optional<int64_t> &v) {
+    v = std::strtoll(s.c_str(), nullptr, 10);
+}
+void parse_value(const std::string &s, std::optional<Blob> &v) { v = s; }
+void parse_value(const std::string &s, std::optional<StopList> &v) {
+    auto json = nlohmann::json::parse(s, nullptr, false);
+    if (json.is_array() &&
+        std::all_of(json.begin(), json.end(),
+                    [](const auto &item) { return item.is_string(); })) {
+        v = json.get<StopList>();
+        return;
+    }
+    // Written by older versions in the record codec's binary encoding.
+    codec::Reader reader(s);
+    auto list = reader.strings();
+    if (reader.ok() && reader.at_end()) {
+        v = std::move(list);
+    }
+}
+
+// Sets the parameter `name` from its hash field; unknown names are ignored.
+void parse_param(ModelParameters &params, std::string_view name,
+                 const std::string &value) {
+    params::for_each([&](const auto &field) {
+        if (field.name == name) {
+            parse_value(value, params.*field.member);
+        }
+    });
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+RedisSessionStore::RedisSessionStore(std::string_view url, std::string prefix)
+    : prefix_(std::move(prefix)), index_key_(prefix_ + ":sessions"),
+      events_key_(prefix_ + ":events"), origin_(random_origin()),
+      applied_key_(prefix_ + ":applied:" + origin_), writer_conn_(url), reader_conn_(url), subscriber_conn_(url) {
+    if (!reader_conn_.ensure_connected()) {
+        SPDLOG_WARN("Redis at '{}' is unreachable; session changes will be "
+                    "queued until it is back.",
+                    url);
+    }
+    writer_ = std::thread(&RedisSessionStore::write_loop, this);
+}
+
+RedisSessionStore::~RedisSessionStore() {
+    unsubscribe();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void RedisSessionStore::subscribe(ChangeListener listener) {
+    if (subscriber_.joinable()) {
+        SPDLOG_ERROR("RedisSessionStore supports a single change listener.");
+        return;
+    }
+    listener_ = std::move(listener);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        listening_ = true;
+        subscriber_done_ = false;
+    }
+    subscriber_ = std::thread(&RedisSessionStore::subscribe_loop, this);
+}
+
+void RedisSessionStore::unsubscribe() {
+    if (!subscriber_.joinable()) {
+        return;
+    }
+    // The subscriber may be between connecting and blocking in a read,
+    // so keep knocking until it has noticed.
+    std::unique_lock<std::mutex> lock(mtx_);
+    listening_ = false;
+    work_cv_.notify_all();
+    while (!subscriber_done_) {
+        subscriber_conn_.interrupt();
+        work_cv_.wait_for(lock, std::chrono::milliseconds(50));
+    }
+    lock.unlock();
+    subscriber_.join();
+    listener_ = nullptr;
+}
+
+void RedisSessionStore::subscribe_loop() {
+    std::chrono::milliseconds backoff = MIN_BACKOFF;
+    bool connected_before = false;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!listening_) {
+                break;
+            }
+        }
+        if (!subscriber_conn_.subscribe(events_key_)) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            work_cv_.wait_for(lock, backoff, [this] { return !listening_; });
+            backoff = std::min(backoff * 2, MAX_BACKOFF);
+            continue;
+        }
+        backoff = MIN_BACKOFF;
+        if (connected_before) {
+            // Notifications sent while we were away are lost.
+            SPDLOG_WARN("Resubscribed to '{}'; invalidating all cached "
+                        "sessions.",
+                        events_key_);
+            listener_({}, 0, false);
+        }
+        connected_before = true;
+
+        while (auto msg = subscriber_conn_.read_push()) {
+            // ["message", channel, payload]
+            if (msg->type == REDIS_REPLY_ARRAY && msg->elements == 3 &&
+                reply_string(msg->element[0]) == "message") {
+                dispatch_event(reply_string(msg->element[2]));
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    subscriber_done_ = true;
+    work_cv_.notify_all();
+}
+
+void RedisSessionStore::dispatch_event(std::string_view payload) {
+    // "<origin> <version> <id>"; the ID is last so it may contain spaces.
+    size_t first = payload.find(' ');
+    size_t second = first == std::string_view::npos
+                        ? first
+                        : payload.find(' ', first + 1);
+    if (second == std::string_view::npos) {
+        SPDLOG_WARN("Ignoring malformed session event '{}'.", payload);
+        return;
+    }
+    std::string_view origin = payload.substr(0, first);
+    std::string version(payload.substr(first + 1, second - first - 1));
+    std::string_view id = payload.substr(second + 1);
+    listener_(id, std::strtoull(version.c_str(), nullptr, 10),
+              origin == origin_);
+}
+
+std::string RedisSessionStore::session_key(std::string_view id) const {
+    std::string key = prefix_;
+    key += ":session:";
+    key += id;
+    return key;
+}
+
+std::string RedisSessionStore::history_key(std::string_view id) const {
+    std::string key = prefix_;
+    key += ":history:";
+    key += id;
+    return key;
+}
+
+std::string RedisSessionStore::context_key(std::string_view id) const {
+    std::string key = prefix_;
+    key += ":context:";
+    key += id;
+    return key;
+}
+
+uint64_t RedisSessionStore::append(const SessionRecord &record) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    uint64_t lsn = next_lsn_++;
+    Unflushed &unflushed = unflushed_[record.session_id];
+    unflushed.lsn = lsn;
+    if (record.type == SessionRecord::Type::Create ||
+        record.type == SessionRecord::Type::Fork) {
+        unflushed.exists = true;
+    } else if (record.type == SessionRecord::Type::Remove) {
+        unflushed.exists = false;
+    }
+    queue_.push_back(Pending{lsn, record});
+    work_cv_.notify_one();
+    return lsn;
+}
+
+bool RedisSessionStore::sync(uint64_t /*lsn*/) {
+    // Write-behind: durability is the writer thread's job. Reads flush
+    // first, so callers never observe the delay.
+    return true;
+}
+
+bool RedisSessionStore::flush(uint64_t lsn, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    return flushed_cv_.wait_for(lock, timeout,
+                                [&] { return flushed_lsn_ >= lsn; });
+}
+
+bool RedisSessionStore::flush_all(std::chrono::milliseconds timeout) {
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        target = next_lsn_ - 1;
+    }
+    return flush(target, timeout);
+}
+
+size_t RedisSessionStore::pending() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return queue_.size();
+}
+
+void RedisSessionStore::add_commands(
+    const SessionRecord &record,
+    std::vector<RedisConnection::Command> &commands) const {
+    const std::string &id = record.session_id;
+    const std::string skey = session_key(id);
+    const std::string hkey = history_key(id);
+    const std::string ckey = context_key(id);
+
+    auto add_messages = [&](const std::vector<Message> &messages) {
+        for (const auto &msg : messages) {
+            int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             msg.timestamp.time_since_epoch())
+                             .count();
+            commands.push_back({"XADD", hkey, "*", "role", role_name(msg.role),
+                                "ts", std::to_string(ts), "content",
+                                msg.content});
+        }
+    };
+
+    switch (record.type) {
+    case SessionRecord::Type::Create:
+        commands.push_back({"HSETNX", skey, "created", std::to_string(now_ns())});
+        break;
+    case SessionRecord::Type::Remove:
+        commands.push_back({"DEL", skey, hkey, ckey});
+        commands.push_back({"SREM", index_key_, id});
+        return;
+    case SessionRecord::Type::Fork:
+        // Copied server-side (COPY, Redis 6.2+); nothing is sent twice.
+        commands.push_back({"DEL", skey, hkey, ckey});
+        commands.push_back({"COPY", session_key(record.text), skey});
+        commands.push_back({"COPY", history_key(record.text), hkey});
+        commands.push_back({"COPY", context_key(record.text), ckey});
+        commands.push_back({"HSET", skey, "created", std::to_string(now_ns())});
+        break;
+    case SessionRecord::Type::AppendTurn:
+        add_messages(record.messages);
+        break;
+    case SessionRecord::Type::ReplaceHistory:
+        commands.push_back({"DEL", hkey});
+        add_messages(record.messages);
+        break;
+    case SessionRecord::Type::SetContext:
+        commands.push_back({"SET", ckey, record.text});
+        commands.push_back({"HDEL", skey, "context"});
+        break;
+    case SessionRecord::Type::WriteContext:
+        commands.push_back({"EVALSHA", edit_context_sha_, "2", skey, ckey,
+                            "write", std::to_string(record.offset),
+                            record.text});
+        break;
+    case SessionRecord::Type::TruncateContext:
+        commands.push_back({"EVALSHA", edit_context_sha_, "2", skey, ckey,
+                            "truncate", std::to_string(record.offset)});
+        break;
+    case SessionRecord::Type::SetModel:
+        commands.push_back({"HSET", skey, "model", record.text});
+        break;
+    case SessionRecord::Type::SetSettings: {
+        RedisConnection::Command hset{"HSET", skey};
+        const ModelParameters &p = record.params;
+        params::for_each([&](const auto &field) {
+            if (const auto &value = p.*field.member) {
+                hset.push_back("param." + std::string(field.name));
+                hset.push_back(format_param(*value));
+            }
+        });
+        if (hset.size() > 2) {
+            commands.push_back(std::move(hset));
+        }
+        break;
+    }
+    default:
+        return;
+    }
+    // Every surviving change keeps the session listed.
+    commands.push_back({"SADD", index_key_, id});
+}
+
+void RedisSessionStore::add_notifications(
+    const std::vector<Pending> &batch,
+    std::vector<RedisConnection::Command> &commands) const {
+    // One notification per session, reflecting its last change in the batch.
+    std::vector<const std::string *> order;
+    std::unordered_map<std::string_view, bool> removed;
+    for (const auto &pending : batch) {
+        const SessionRecord &record = pending.record;
+        if (record.type == SessionRecord::Type::None) {
+            continue;
+        }
+        auto [it, inserted] =
+            removed.try_emplace(record.session_id, false);
+        if (inserted) {
+            order.push_back(&record.session_id);
+        }
+        it->second = record.type == SessionRecord::Type::Remove;
+    }
+    for (const std::string *id : order) {
+        if (removed[*id]) {
+            commands.push_back(
+                {"PUBLISH", events_key_, origin_ + " 0 " + *id});
+        } else {
+            commands.push_back({"EVALSHA", bump_and_publish_sha_, "2",
+                                session_key(*id), events_key_, origin_, *id});
+        }
+    }
+}
+
+bool RedisSessionStore::drop_rejected(
+    std::vector<RedisConnection::Command> &commands,
+    const std::vector<RedisReply> &replies) {
+    // Each command between MULTI and EXEC was answered QUEUED or rejected.
+    std::vector<RedisConnection::Command> kept;
+    kept.reserve(commands.size());
+    for (size_t i = 0; i < commands.size(); i++) {
+        const redisReply *reply = i < replies.size() ? replies[i].get() : nullptr;
+        if (i > 0 && i + 1 < commands.size() && reply &&
+            reply->type == REDIS_REPLY_ERROR) {
+            SPDLOG_ERROR("Redis rejected {} on '{}': {}", commands[i][0],
+                         commands[i].size() > 1 ? commands[i][1] : "",
+                         reply_string(reply));
+            continue;
+        }
+        kept.push_back(std::move(commands[i]));
+    }
+    const bool dropped = kept.size() != commands.size();
+    commands = std::move(kept);
+    return dropped;
+}
+
+std::optional<uint64_t> RedisSessionStore::applied_lsn() {
+    auto reply = writer_conn_.command({"GET", applied_key_});
+    if (!reply) {
+        return std::nullopt;
+    }
+    // Nil until the first batch: nothing applied yet.
+    return std::strtoull(reply_string(reply.get()).c_str(), nullptr, 10);
+}
+
+bool RedisSessionStore::load_scripts() {
+    if (!writer_conn_.ensure_connected()) {
+        return false;
+    }
+    if (writer_conn_.connections() == scripts_connection_) {
+        return true;
+    }
+    std::vector<RedisReply> replies;
+    if (!writer_conn_.pipeline({{"SCRIPT", "LOAD", EDIT_CONTEXT},
+                                {"SCRIPT", "LOAD", BUMP_AND_PUBLISH}},
+                               replies)) {
+        return false;
+    }
+    for (const auto &reply : replies) {
+        if (reply->type != REDIS_REPLY_STRING) {
+            SPDLOG_ERROR("Cannot load Lua scripts into Redis: {}",
+                         reply_string(reply.get()));
+            return false;
+        }
+    }
+    edit_context_sha_ = reply_string(replies[0].get());
+    bump_and_publish_sha_ = reply_string(replies[1].get());
+    scripts_connection_ = writer_conn_.connections();
+    return true;
+}
+
+bool RedisSessionStore::keep_noscript(
+    std::vector<RedisConnection::Command> &commands, const redisReply *exec) {
+    // Element i of the EXEC reply answers commands[i + 1].
+    auto failed = [&](size_t i) { return is_noscript(exec->element[i - 1]); };
+    // Whether commands[j] replaced or deleted `key` outright.
+    auto overwrites = [&](size_t j, const std::string &key) {
+        const auto &cmd = commands[j];
+        if (cmd[0] == "SET") {
+            return cmd[1] == key;
+        }
+        if (cmd[0] == "DEL") {
+            return std::find(cmd.begin() + 1, cmd.end(), key) != cmd.end();
+        }
+        return cmd[0] == "COPY" && cmd[2] == key;
+    };
+
+    std::vector<RedisConnection::Command> kept{{"MULTI"}};
+    const size_t n = std::min(commands.size() - 1, exec->elements + 1);
+    for (size_t i = 1; i < n; i++) {
+        if (!failed(i)) {
+            continue;
+        }
+        // The rest of the batch did run, so a call is dropped if a later
+        // command replaced or deleted one of its keys. The others can run
+        // after it: context edits are idempotent, and a version bump only
+        // announces the change.
+        const auto &cmd = commands[i]; // EVALSHA sha numkeys key...
+        const size_t keys =
+            std::min<size_t>(std::strtoul(cmd[2].c_str(), nullptr, 10),
+                             cmd.size() - 3);
+        bool stale = false;
+        for (size_t j = i + 1; j < n && !stale; j++) {
+            if (failed(j)) {
+                continue;
+            }
+            for (size_t k = 0; k < keys && !stale; k++) {
+                stale = overwrites(j, cmd[3 + k]);
+            }
+        }
+        if (!stale) {
+            kept.push_back(std::move(commands[i]));
+        }
+    }
+    if (kept.size() == 1) {
+        return false;
+    }
+    kept.push_back({"EXEC"});
+    commands = std::move(kept);
+    return true;
+}
+
+void RedisSessionStore::write_loop() {
+    std::vector<Pending> batch;
+    std::vector<RedisConnection::Command> commands;
+    std::vector<RedisReply> replies;
+    std::chrono::milliseconds backoff = MIN_BACKOFF;
+    int shutdown_attempts = SHUTDOWN_ATTEMPTS;
+    // Set after a failed round trip, which may have run the EXEC anyway.
+    bool uncertain = false;
+    // Set while resending the scripts of a batch that hit NOSCRIPT. They
+    // can safely run twice, so no applied check is needed.
+    bool resending = false;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (batch.empty()) {
+                work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return; // Stopping and everything is written
+                }
+                size_t n = std::min(queue_.size(), MAX_BATCH);
+                batch.reserve(n);
+                for (size_t i = 0; i < n; i++) {
+                    batch.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+            }
+        }
+
+        // Built once per batch: retries resend the same commands. The
+        // scripts are called by SHA1, so they must be loaded first.
+        const bool loaded = load_scripts();
+        if (loaded && commands.empty()) {
+            commands.push_back({"MULTI"});
+            for (const auto &pending : batch) {
+                add_commands(pending.record, commands);
+            }
+            add_notifications(batch, commands);
+            commands.push_back({"SET", applied_key_,
+                                std::to_string(batch.back().lsn), "EX",
+                                APPLIED_TTL});
+            commands.push_back({"EXEC"});
+        }
+
+        // XADD and the version bumps are not idempotent, so a batch that
+        // may have gone through is checked before it is sent again.
+        std::optional<uint64_t> applied = 0;
+        if (loaded && uncertain && !resending) {
+            applied = applied_lsn();
+        }
+        const bool done =
+            !resending && applied && *applied >= batch.back().lsn;
+        if (!loaded || !applied ||
+            (!done && !writer_conn_.pipeline(commands, replies))) {
+            // Keep the batch and retry; the queue keeps absorbing changes.
+            uncertain = true;
+            std::unique_lock<std::mutex> lock(mtx_);
+            writer_failing_ = true;
+            if (stop_ && --shutdown_attempts <= 0) {
+                SPDLOG_ERROR("Giving up on Redis; {} session change(s) were "
+                             "not written.",
+                             batch.size() + queue_.size());
+                return;
+            }
+            work_cv_.wait_for(lock, backoff, [this] { return stop_; });
+            backoff = std::min(backoff * 2, MAX_BACKOFF);
+            continue;
+        }
+        uncertain = false;
+        backoff = MIN_BACKOFF;
+
+        const redisReply *exec = done ? nullptr : replies.back().get();
+        if (done) {
+            SPDLOG_DEBUG("Batch up to LSN {} was already written to Redis.",
+                         batch.back().lsn);
+        } else if (!exec || exec->type != REDIS_REPLY_ARRAY) {
+            // EXECABORT: a command was rejected while queuing and nothing
+            // ran. Send the batch again without it.
+            if (drop_rejected(commands, replies)) {
+                continue;
+            }
+            SPDLOG_ERROR("Redis rejected a batch of {} session change(s): {}",
+                         batch.size(), reply_string(exec));
+        } else {
+            bool noscript = false;
+            for (size_t i = 0; i < exec->elements; i++) {
+                if (is_noscript(exec->element[i])) {
+                    noscript = true;
+                } else if (exec->element[i]->type == REDIS_REPLY_ERROR) {
+                    SPDLOG_ERROR("Redis session write failed: {}",
+                                 reply_string(exec->element[i]));
+                }
+            }
+            // The script cache was flushed since this connection loaded the
+            // scripts. NOSCRIPT only shows up as a command runs, so the rest
+            // of the batch is written: load the scripts again and resend
+            // the calls that failed.
+            if (noscript) {
+                scripts_connection_ = 0;
+                if (keep_noscript(commands, exec)) {
+                    SPDLOG_WARN("Redis lost its Lua scripts; resending {} "
+                                "script call(s).",
+                                commands.size() - 2);
+                    resending = true;
+                    continue;
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            writer_failing_ = false;
+            flushed_lsn_ = batch.back().lsn;
+            for (const auto &pending : batch) {
+                auto it = unflushed_.find(pending.record.session_id);
+                if (it != unflushed_.end() && it->second.lsn <= flushed_lsn_) {
+                    unflushed_.erase(it);
+                }
+            }
+        }
+        flushed_cv_.notify_all();
+        batch.clear();
+        commands.clear();
+        resending = false;
+    }
+}
+
+Lookup RedisSessionStore::load(std::string_view id, SessionImage &image) {
+    // Only this session's own queued changes need to reach Redis first.
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto it = unflushed_.find(std::string(id));
+        if (it != unflushed_.end()) {
+            const uint64_t lsn = it->second.lsn;
+            if (writer_failing_ ||
+                !flushed_cv_.wait_for(lock, FLUSH_TIMEOUT,
+                                      [&] { return flushed_lsn_ >= lsn; })) {
+                SPDLOG_WARN("Changes to session '{}' are not yet written to "
+                            "Redis; cannot load it.",
+                            id);
+                return Lookup::Unavailable;
+            }
+        }
+    }
+
+    std::vector<RedisReply> replies;
+    {
+        std::lock_guard<std::mutex> lock(reader_mtx_);
+        std::string sid(id);
+        if (!reader_conn_.pipeline({{"SISMEMBER", index_key_, sid},
+                                    {"HGETALL", session_key(id)},
+                                    {"XRANGE", history_key(id), "-", "+"},
+                                    {"GET", context_key(id)}},
+                                   replies)) {
+            return Lookup::Unavailable;
+        }
+    }
+    if (replies[0]->type != REDIS_REPLY_INTEGER || replies[0]->integer == 0) {
+        return Lookup::Missing;
+    }
+
+    image = SessionImage{};
+    image.id = std::string(id);
+
+    const redisReply *fields = replies[1].get();
+    if (fields->type == REDIS_REPLY_ARRAY) {
+        for (size_t i = 0; i + 1 < fields->elements; i += 2) {
+            std::string name = reply_string(fields->element[i]);
+            std::string value = reply_string(fields->element[i + 1]);
+            if (name == "model") {
+                image.model_name = std::move(value);
+            } else if (name == "context") {
+                image.context = std::move(value);
+            } else if (name == "version") {
+                image.lsn = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (name.compare(0, 6, "param.") == 0) {
+                parse_param(image.overrides, name.substr(6), value);
+            }
+        }
+    }
+
+    // Absent for sessions whose context never left the hash.
+    if (replies[3]->type == REDIS_REPLY_STRING) {
+        image.context = reply_string(replies[3].get());
+    }
+
+    const redisReply *entries = replies[2].get();
+    if (entries->type == REDIS_REPLY_ARRAY) {
+        image.history.reserve(entries->elements);
+        for (size_t i = 0; i < entries->elements; i++) {
+            // Each entry is [stream id, [field, value, ...]]
+            const redisReply *entry = entries->element[i];
+            if (entry->type != REDIS_REPLY_ARRAY || entry->elements < 2 ||
+                entry->element[1]->type != REDIS_REPLY_ARRAY) {
+                continue;
+            }
+            const redisReply *kv = entry->element[1];
+            Message msg{Message::Role::User, "", {}};
+            for (size_t j = 0; j + 1 < kv->elements; j += 2) {
+                std::string name = reply_string(kv->element[j]);
+                if (name == "role") {
+                    msg.role = parse_role(reply_string(kv->element[j + 1]));
+                } else if (name == "ts") {
+                    msg.timestamp = std::chrono::system_clock::time_point(
+                        std::chrono::duration_cast<
+                            std::chrono::system_clock::duration>(
+                            std::chrono::nanoseconds(std::strtoll(
+                                reply_string(kv->element[j + 1]).c_str(),
+                                nullptr, 10))));
+                } else if (name == "content") {
+                    msg.content = reply_string(kv->element[j + 1]);
+                }
+            }
+            image.history.push_back(std::move(msg));
+        }
+    }
+    return Lookup::Found;
+}
+
+Lookup RedisSessionStore::contains(std::string_view id) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = unflushed_.find(std::string(id));
+        if (it != unflushed_.end() && it->second.exists) {
+            return *it->second.exists ? Lookup::Found : Lookup::Missing;
+        }
+    }
+    RedisReply reply;
+    {
+        std::lock_guard<std::mutex> lock(reader_mtx_);
+        reply = reader_conn_.command({"SISMEMBER", index_key_, std::string(id)});
+    }
+    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
+        return Lookup::Unavailable;
+    }
+    return reply->integer ? Lookup::Found : Lookup::Missing;
+}
+
+std::vector<std::string> RedisSessionStore::list_ids() {
+    // Taken before the read: a creation or removal written in between is
+    // still reported by its queued record.
+    std::unordered_map<std::string, bool> queued;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto &pair : unflushed_) {
+            if (pair.second.exists) {
+                queued.emplace(pair.first, *pair.second.exists);
+            }
+        }
+    }
+
+    RedisReply reply;
+    {
+        std::lock_guard<std::mutex> lock(reader_mtx_);
+        reply = reader_conn_.command({"SMEMBERS", index_key_});
+    }
+    std::vector<std::string> ids;
+    if (reply && reply->type == REDIS_REPLY_ARRAY) {
+        ids.reserve(reply->elements);
+        for (size_t i = 0; i < reply->elements; i++) {
+            std::string id = reply_string(reply->element[i]);
+            auto it = queued.find(id);
+            if (it == queued.end()) {
+                ids.push_back(std::move(id));
+            } else if (it->second) {
+                ids.push_back(std::move(id));
+                queued.erase(it);
+            }
+        }
+    }
+    for (const auto &pair : queued) {
+        if (pair.second) {
+            ids.push_back(pair.first);
+        }
+    }
+    return ids;
+}
+
+} // namespace fusellm
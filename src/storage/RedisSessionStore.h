@@ -0,0 +1,174 @@
+#pragma once
+
+#include "RedisConnection.h"
+#include "SessionStore.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class RedisSessionStore
+ * @brief Keeps sessions in Redis so several mounts, possibly on different
+ * hosts, share the same conversations.
+ *
+ * Layout, for a key prefix `P`:
+ *
+ *     P:sessions       SET    of session IDs
+ *     P:session:<id>   HASH   model, param.<name>, created, version
+ *     P:history:<id>   STREAM one entry per message: role, ts (ns), content
+ *     P:context:<id>   STRING the context, edited in place with SETRANGE
+ *     P:events         pub/sub channel of "<origin> <version> <id>" messages
+ *     P:applied:<origin> STRING LSN of the last batch written by an instance
+ *
+ * Sessions written before the context had a key of its own keep it in the
+ * `context` field of the hash; the first edit moves it over.
+ *
+ * Writes are write-behind: append() only queues the record, and a writer
+ * thread drains the queue in batches, each sent as one pipelined
+ * MULTI/EXEC round trip. The FUSE thread that made the change never waits
+ * for Redis. If Redis is unreachable the batch is retried with backoff;
+ * each batch also records its last LSN under `P:applied:<origin>`, so a
+ * retry after a lost EXEC reply can tell the batch was already applied
+ * instead of appending its messages twice.
+ *
+ * The store is lazy: sessions are read with load() on first access, after
+ * the queued changes to that session have been written, so a mount always
+ * reads its own writes. Creations and removals that are still queued answer
+ * contains() and list_ids() directly, without waiting for the writer.
+ *
+ * Every batch bumps the version of each session it touched and publishes
+ * the new version on `P:events`, atomically with the change. A subscriber
+ * thread forwards these notifications to the listener, so other mounts can
+ * drop exactly the sessions that changed without polling. Version 0 means
+ * the session was removed; `origin` identifies the store instance that made
+ * the change.
+ */
+class RedisSessionStore : public SessionStore {
+  public:
+    /**
+     * @param url Redis URL, see RedisConnection.
+     * @param prefix Key prefix; mounts sharing a prefix share sessions.
+     * Throws std::runtime_error if the URL is malformed. An unreachable
+     * server is not an error: writes are queued until it comes back.
+     */
+    RedisSessionStore(std::string_view url, std::string prefix);
+
+    /**
+     * @brief Flushes queued writes (bounded by a few connection timeouts)
+     * and stops the writer.
+     */
+    ~RedisSessionStore() override;
+
+    uint64_t append(const SessionRecord &record) override;
+    bool sync(uint64_t lsn) override;
+    std::vector<SessionImage> load_all() override { return {}; }
+
+    bool lazy() const override { return true; }
+    Lookup load(std::string_view id, SessionImage &image) override;
+    Lookup contains(std::string_view id) override;
+    std::vector<std::string> list_ids() override;
+    void subscribe(ChangeListener listener) override;
+    void unsubscribe() override;
+
+    /**
+     * @brief Waits until every record up to `lsn` has been written to Redis.
+     * @return False on timeout.
+     */
+    bool flush(uint64_t lsn, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Waits until every record appended so far has been written.
+     * @return False on timeout.
+     */
+    bool flush_all(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Records queued but not yet written.
+     */
+    size_t pending() const;
+
+  private:
+    struct Pending {
+        uint64_t lsn;
+        SessionRecord record;
+    };
+
+    // Changes to one session that are not yet written to Redis.
+    struct Unflushed {
+        uint64_t lsn = 0; // The last one
+        // Whether the session exists after them, if they created or removed
+        // it; unknown otherwise.
+        std::optional<bool> exists;
+    };
+
+    void write_loop();
+    void subscribe_loop();
+    void dispatch_event(std::string_view payload);
+    void add_commands(const SessionRecord &record,
+                      std::vector<RedisConnection::Command> &commands) const;
+    // Appends the version bump + notification for each session of a batch.
+    void add_notifications(const std::vector<Pending> &batch,
+                           std::vector<RedisConnection::Command> &commands) const;
+    // Drops the commands Redis rejected while queuing a MULTI (EXECABORT).
+    // Returns false if it could not tell which ones they were.
+    static bool drop_rejected(std::vector<RedisConnection::Command> &commands,
+                              const std::vector<RedisReply> &replies);
+    // LSN of the last batch this instance wrote, or nullopt if Redis is
+    // unreachable.
+    std::optional<uint64_t> applied_lsn();
+    // Loads the Lua scripts into Redis unless this connection already did,
+    // so batches can call them by SHA1. False if Redis is unreachable.
+    bool load_scripts();
+    // Keeps the commands of an executed batch that failed with NOSCRIPT
+    // (the script cache was flushed under us) so they can be sent again.
+    // Returns false if there are none.
+    static bool keep_noscript(std::vector<RedisConnection::Command> &commands,
+                              const redisReply *exec);
+
+    std::string session_key(std::string_view id) const;
+    std::string history_key(std::string_view id) const;
+    std::string context_key(std::string_view id) const;
+
+    const std::string prefix_;
+    const std::string index_key_;
+    const std::string events_key_;
+    const std::string origin_; // Random ID of this instance
+    const std::string applied_key_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable work_cv_;
+    std::condition_variable flushed_cv_;
+    std::deque<Pending> queue_;
+    std::unordered_map<std::string, Unflushed> unflushed_;
+    uint64_t next_lsn_ = 1;
+    uint64_t flushed_lsn_ = 0;
+    bool writer_failing_ = false; // The last write attempt failed
+    bool stop_ = false;
+
+    RedisConnection writer_conn_; // Used only by the writer thread
+    // SHA1 digests of the scripts, and the writer connection that loaded
+    // them. Used only by the writer thread.
+    std::string edit_context_sha_;
+    std::string bump_and_publish_sha_;
+    uint64_t scripts_connection_ = 0;
+    std::mutex reader_mtx_;
+    RedisConnection reader_conn_; // Guarded by reader_mtx_
+    std::thread writer_;
+
+    // Change notifications; the subscriber starts with the first listener.
+    ChangeListener listener_;
+    RedisConnection subscriber_conn_; // Used only by the subscriber thread
+    std::thread subscriber_;
+    bool listening_ = false;       // Guarded by mtx_
+    bool subscriber_done_ = false; // Guarded by mtx_
+};
+
+} // namespace fusellm
@@ -0,0 +1,38 @@
+#include "SessionStore.h"
+
+namespace fusellm {
+
+void SessionImage::apply(const SessionRecord &record, uint64_t record_lsn) {
+    switch (record.type) {
+    case SessionRecord::Type::AppendTurn:
+        history.insert(history.end(), record.messages.begin(),
+                       record.messages.end());
+        break;
+    case SessionRecord::Type::ReplaceHistory:
+        history = record.messages;
+        break;
+    case SessionRecord::Type::SetContext:
+        context = record.text;
+        break;
+    case SessionRecord::Type::WriteContext:
+        if (record.offset > context.size()) {
+            context.resize(record.offset, '\0');
+        }
+        context.replace(record.offset, record.text.size(), record.text);
+        break;
+    case SessionRecord::Type::TruncateContext:
+        context.resize(record.offset, '\0');
+        break;
+    case SessionRecord::Type::SetModel:
+        model_name = record.text;
+        break;
+    case SessionRecord::Type::SetSettings:
+        overrides.merge(record.params);
+        break;
+    default:
+        break; // Create/Remove/Fork are handled by the caller
+    }
+    lsn = record_lsn;
+}
+
+} // namespace fusellm
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "../common/data.h"
+#include "../config/ConfigManager.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @struct SessionRecord
+ * @brief One logged mutation of a session.
+ *
+ * Records are the unit of durability: every state change a Session or the
+ * SessionManager makes is described by exactly one record, and replaying the
+ * records of a session in order rebuilds its state.
+ */
+struct SessionRecord {
+    enum class Type : uint8_t {
+        None = 0,           // Nothing to log
+        Create = 1,         // Session created (empty)
+        Remove = 2,         // Session deleted
+        AppendTurn = 3,     // Committed user + AI turn (`messages`)
+        ReplaceHistory = 4, // History replaced by `messages` (populate)
+        SetContext = 5,     // `text` is the new context
+        SetModel = 6,       // `text` is the new model name
+        SetSettings = 7,    // `params` merged into the session overrides
+        WriteContext = 8,   // `text` written into the context at `offset`
+        TruncateContext = 9, // Context cut or zero-extended to `offset` bytes
+        Fork = 10,          // Created as a copy of session `text`
+    };
+
+    Type type = Type::None;
+    std::string session_id;
+    std::vector<Message> messages;
+    std::string text;
+    uint64_t offset = 0;
+    ModelParameters params;
+};
+
+/**
+ * @struct SessionImage
+ * @brief The persisted state of one session, as loaded at startup.
+ */
+struct SessionImage {
+    std::string id;
+    // Sequence number of the last record reflected in this image. For lazy
+    // stores, the session's version in the store (see SessionStore).
+    uint64_t lsn = 0;
+    std::vector<Message> history;
+    std::string context;
+    std::string model_name; // Empty means "use the default model"
+    // Settings written to the session, merged over the global parameters
+    // when the session is restored.
+    ModelParameters overrides;
+
+    /**
+     * @brief Applies a replayed record to this image.
+     */
+    void apply(const SessionRecord &record, uint64_t record_lsn);
+};
+
+/**
+ * @brief Outcome of looking a session up in a lazy store.
+ */
+enum class Lookup : uint8_t {
+    Found,
+    Missing,
+    Unavailable, // The store could not be reached; the session may exist
+};
+
+/**
+ * @class SessionStore
+ * @brief Durable storage for sessions.
+ *
+ * `append()` is called while the session's writer lock is held, so that
+ * records are logged in the same order as the versions they describe. It
+ * must therefore only buffer the record and never wait on I/O; callers wait
+ * for durability afterwards with `sync()`, outside the lock, which lets many
+ * concurrent mutations share one flush.
+ *
+ * A store is either eager or lazy. An eager store (the local WAL) hands every
+ * session to the SessionManager at startup through `load_all()`. A lazy
+ * store (Redis) keeps the authoritative copy elsewhere: sessions are fetched
+ * on first access with `load()`, and the SessionManager only caches the hot
+ * ones.
+ */
+class SessionStore {
+  public:
+    /**
+     * @brief Called when a stored session changes.
+     * @param id The session, or empty if notifications may have been lost
+     * and every cached session must be considered stale.
+     * @param version The session's new version in the store; 0 if it was
+     * removed.
+     * @param local True if the change was made through this store instance.
+     */
+    using ChangeListener =
+        std::function<void(std::string_view id, uint64_t version, bool local)>;
+
+    virtual ~SessionStore() = default;
+
+    /**
+     * @brief Buffers a record for writing.
+     * @return A sequence number to pass to sync(). Numbers are strictly
+     * increasing in append order.
+     */
+    virtual uint64_t append(const SessionRecord &record) = 0;
+
+    /**
+     * @brief Blocks until the record with sequence number `lsn` (and every
+     * earlier one) is durable. Write-behind stores may return as soon as the
+     * record is queued.
+     * @return False if the store failed to persist it.
+     */
+    virtual bool sync(uint64_t lsn) = 0;
+
+    /**
+     * @brief Loads every stored session. Called once, before any append.
+     * Lazy stores return nothing here.
+     */
+    virtual std::vector<SessionImage> load_all() = 0;
+
+    /**
+     * @brief Whether sessions are loaded on demand rather than all at once.
+     * Sessions of a lazy store may be evicted from memory at any time and
+     * loaded again with load().
+     */
+    virtual bool lazy() const { return false; }
+
+    /**
+     * @brief Loads one session on demand into `image`. Reflects every record
+     * appended through this store before the call (read-your-writes).
+     */
+    virtual Lookup load(std::string_view /*id*/, SessionImage & /*image*/) {
+        return Lookup::Missing;
+    }
+
+    /**
+     * @brief Tells whether a session exists without loading it, and without
+     * waiting for queued writes. Reflects every creation and removal
+     * appended before the call.
+     */
+    virtual Lookup contains(std::string_view /*id*/) { return Lookup::Missing; }
+
+    /**
+     * @brief Lists the IDs of all stored sessions, including those that are
+     * not loaded. Only meaningful for lazy stores.
+     */
+    virtual std::vector<std::string> list_ids() { return {}; }
+
+    /**
+     * @brief Registers the listener for change notifications. Stores shared
+     * by several instances call it, from a background thread, for changes
+     * made by any of them, in the order the store applied them. Stores that
+     * are not shared never call it.
+     */
+    virtual void subscribe(ChangeListener /*listener*/) {}
+
+    /**
+     * @brief Stops notifications. Returns once the listener is no longer
+     * running and will not be called again.
+     */
+    virtual void unsubscribe() {}
+};
+
+} // namespace fusellm
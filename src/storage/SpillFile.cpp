@@ -0,0 +1,168 @@
+#include "SpillFile.h"
+#include "spdlog/spdlog.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+#include <zstd.h>
+
+namespace fusellm {
+
+SpillFile::SpillFile(const std::string &dir, int compression_level)
+    : level_(compression_level) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot create spill directory '" + dir +
+                                 "': " + ec.message());
+    }
+    std::string path = dir + "/fusellm-spill-XXXXXX";
+    fd_ = ::mkostemp(path.data(), O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot create spill file in '" + dir +
+                                 "': " + strerror(errno));
+    }
+    ::unlink(path.c_str());
+    SPDLOG_INFO("Spilling cold sessions to an anonymous file in '{}'.", dir);
+}
+
+SpillFile::~SpillFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+uint64_t SpillFile::allocate_locked(uint64_t size) {
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->second >= size) {
+            uint64_t offset = it->first;
+            uint64_t rest = it->second - size;
+            free_.erase(it);
+            if (rest > 0) {
+                free_.emplace(offset + size, rest);
+            }
+            return offset;
+        }
+    }
+    uint64_t offset = end_;
+    end_ += size;
+    return offset;
+}
+
+bool SpillFile::write(std::string_view data, Extent &extent) {
+    std::string buf(ZSTD_compressBound(data.size()), '\0');
+    size_t n = ZSTD_compress(buf.data(), buf.size(), data.data(), data.size(),
+                             level_);
+    const bool compressed = !ZSTD_isError(n) && n < data.size();
+    std::string_view payload = compressed ? std::string_view(buf.data(), n)
+                                          : data;
+
+    extent.raw = static_cast<uint32_t>(data.size());
+    extent.stored = static_cast<uint32_t>(payload.size());
+    extent.compressed = compressed;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        extent.offset = allocate_locked(payload.size());
+    }
+
+    size_t done = 0;
+    while (done < payload.size()) {
+        ssize_t w = ::pwrite(fd_, payload.data() + done, payload.size() - done,
+                             static_cast<off_t>(extent.offset + done));
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            SPDLOG_ERROR("Spill file write failed: {}", strerror(errno));
+            std::lock_guard<std::mutex> lock(mtx_);
+            free_.emplace(extent.offset, extent.stored);
+            return false;
+        }
+        done += static_cast<size_t>(w);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.blobs++;
+    stats_.raw_bytes += extent.raw;
+    stats_.stored_bytes += extent.stored;
+    return true;
+}
+
+bool SpillFile::read(const Extent &extent, std::string &out) const {
+    std::string stored(extent.stored, '\0');
+    size_t done = 0;
+    while (done < stored.size()) {
+        ssize_t r = ::pread(fd_, stored.data() + done, stored.size() - done,
+                            static_cast<off_t>(extent.offset + done));
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            SPDLOG_ERROR("Spill file read failed: {}", strerror(errno));
+            return false;
+        }
+        done += static_cast<size_t>(r);
+    }
+    if (!extent.compressed) {
+        out = std::move(stored);
+        return true;
+    }
+    out.resize(extent.raw);
+    size_t n = ZSTD_decompress(out.data(), out.size(), stored.data(),
+                               stored.size());
+    if (ZSTD_isError(n) || n != extent.raw) {
+        SPDLOG_ERROR("Corrupt blob in spill file at offset {}.", extent.offset);
+        return false;
+    }
+    return true;
+}
+
+void SpillFile::release(const Extent &extent) {
+    if (extent.stored == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.blobs--;
+    stats_.raw_bytes -= extent.raw;
+    stats_.stored_bytes -= extent.stored;
+
+    uint64_t offset = extent.offset;
+    uint64_t length = extent.stored;
+    // Merge with the free ranges on either side.
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && offset + length == next->first) {
+        length += next->second;
+        next = free_.erase(next);
+    }
+    if (next != free_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            length += prev->second;
+            free_.erase(prev);
+        }
+    }
+    if (offset + length == end_) {
+        end_ = offset; // Trailing space: just shrink the file
+        if (::ftruncate(fd_, static_cast<off_t>(end_)) != 0) {
+            SPDLOG_WARN("Cannot shrink spill file: {}", strerror(errno));
+        }
+        return;
+    }
+    free_.emplace(offset, length);
+    // Give the blocks back; failure (e.g. unsupported) only costs disk space.
+    ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(extent.offset),
+                static_cast<off_t>(extent.stored));
+}
+
+SpillFile::Stats SpillFile::stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Stats s = stats_;
+    s.file_bytes = end_;
+    return s;
+}
+
+} // namespace fusellm
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace fusellm {
+
+/**
+ * @class SpillFile
+ * @brief Scratch space for blobs evicted from memory, compressed with zstd.
+ *
+ * The file is created and immediately unlinked, so it never outlives the
+ * process and needs no cleanup; its contents are a cache, not persistence.
+ * Space of released blobs is reused first-fit (adjacent free ranges are
+ * merged) and returned to the file system with FALLOC_FL_PUNCH_HOLE, so the
+ * disk usage tracks what is actually spilled.
+ *
+ * This class is thread-safe.
+ */
+class SpillFile {
+  public:
+    // Location of one blob in the file.
+    struct Extent {
+        uint64_t offset = 0;
+        uint32_t stored = 0; // Bytes in the file
+        uint32_t raw = 0;    // Bytes after decompression
+        bool compressed = false;
+    };
+
+    struct Stats {
+        uint64_t blobs = 0;
+        uint64_t raw_bytes = 0;    // Uncompressed size of live blobs
+        uint64_t stored_bytes = 0; // Compressed size of live blobs
+        uint64_t file_bytes = 0;   // Logical file size, including holes
+    };
+
+    /**
+     * @brief Creates an anonymous spill file in `dir` (created if missing).
+     * Throws std::runtime_error if that fails.
+     */
+    explicit SpillFile(const std::string &dir, int compression_level = 1);
+    ~SpillFile();
+
+    SpillFile(const SpillFile &) = delete;
+    SpillFile &operator=(const SpillFile &) = delete;
+
+    /**
+     * @brief Compresses and stores `data`.
+     * @return False on an I/O error, in which case nothing was stored.
+     */
+    bool write(std::string_view data, Extent &extent);
+
+    /**
+     * @brief Reads back and decompresses a blob; the blob stays stored.
+     * @return False if the blob cannot be read or is corrupt.
+     */
+    bool read(const Extent &extent, std::string &out) const;
+
+    /**
+     * @brief Frees a blob's space for reuse.
+     */
+    void release(const Extent &extent);
+
+    Stats stats() const;
+
+  private:
+    uint64_t allocate_locked(uint64_t size);
+
+    int fd_ = -1;
+    const int level_;
+
+    mutable std::mutex mtx_;
+    std::map<uint64_t, uint64_t> free_; // offset -> length, non-adjacent
+    uint64_t end_ = 0;                  // Logical file size
+    Stats stats_;
+};
+
+} // namespace fusellm
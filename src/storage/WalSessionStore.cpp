@@ -0,0 +1,457 @@
+#include "WalSessionStore.h"
+#include "../state/Session.h"
+#include "../state/SessionManager.h"
+#include "RecordCodec.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace fusellm {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'F', 'L', 'L', 'M', 'S', 'N', 'P', '1'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOT_HEADER = 8 + 4 + 4 + 8 + 8 + 8;
+constexpr size_t INDEX_ENTRY = 8 + 8 + 4 + 4;
+// 写快照时的缓冲区大小，攒满后一次性写入
+constexpr size_t WRITE_BUFFER = 4 << 20;
+// 每个恢复线程至少处理的会话数，避免为小数据集创建过多线程
+constexpr size_t MIN_SESSIONS_PER_THREAD = 1024;
+
+std::string snapshot_name(uint64_t cut_lsn) {
+    char name[40];
+    std::snprintf(name, sizeof(name), "snapshot-%016" PRIx64 ".bin", cut_lsn);
+    return name;
+}
+
+size_t recovery_threads(size_t work_items) {
+    size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(
+        1, std::min(hw, work_items / MIN_SESSIONS_PER_THREAD + 1));
+}
+
+// Runs fn(begin, end) over [0, count) split into `threads` ranges.
+void parallel_for(size_t count, size_t threads,
+                  const std::function<void(size_t, size_t)> &fn) {
+    if (threads <= 1 || count == 0) {
+        fn(0, count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t chunk = (count + threads - 1) / threads;
+    for (size_t begin = 0; begin < count; begin += chunk) {
+        workers.emplace_back(fn, begin, std::min(count, begin + chunk));
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+bool write_all(int fd, const std::string &data) {
+    const char *p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = ::mmap(nullptr, static_cast<size_t>(st.st_size),
+                             PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data_ = static_cast<const char *>(p);
+                size_ = static_cast<size_t>(st.st_size);
+                ::madvise(p, size_, MADV_WILLNEED);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::string_view view() const { return {data_, size_}; }
+
+  private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Decodes a snapshot into images. Returns false if the file is unusable.
+bool read_snapshot(const std::string &path, uint64_t &cut_lsn,
+                   std::vector<SessionImage> &images) {
+    MappedFile file(path);
+    std::string_view data = file.view();
+    if (data.size() < SNAPSHOT_HEADER ||
+        std::memcmp(data.data(), SNAPSHOT_MAGIC, 8) != 0) {
+        return false;
+    }
+    codec::Reader header(data.substr(8, SNAPSHOT_HEADER - 8));
+    uint32_t version = header.u32();
+    header.u32(); // reserved
+    cut_lsn = header.u64();
+    uint64_t count = header.u64();
+    uint64_t index_offset = header.u64();
+    if (version != SNAPSHOT_VERSION || index_offset > data.size() ||
+        (data.size() - index_offset) / INDEX_ENTRY < count) {
+        return false;
+    }
+
+    images.resize(count);
+    std::atomic<size_t> corrupt{0};
+    parallel_for(count, recovery_threads(count), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            codec::Reader entry(
+                data.substr(index_offset + i * INDEX_ENTRY, INDEX_ENTRY));
+            uint64_t offset = entry.u64();
+            uint64_t length = entry.u64();
+            uint32_t crc = entry.u32();
+            if (offset > index_offset || index_offset - offset < length ||
+                codec::crc32(data.data() + offset, length) != crc ||
+                !codec::decode_image(data.substr(offset, length), images[i])) {
+                images[i].id.clear();
+                corrupt++;
+            }
+        }
+    });
+    if (corrupt > 0) {
+        SPDLOG_ERROR("Snapshot '{}' has {} corrupt session(s); they are "
+                     "restored from the WAL only.",
+                     path, corrupt.load());
+    }
+    return true;
+}
+
+} // namespace
+
+WalSessionStore::WalSessionStore(std::string dir, uint64_t segment_bytes)
+    : dir_(std::move(dir)), wal_(dir_ + "/wal", segment_bytes) {}
+
+WalSessionStore::~WalSessionStore() { stop_checkpointing(); }
+
+uint64_t WalSessionStore::append(const SessionRecord &record) {
+    std::string payload;
+    codec::encode_record(record, payload);
+    return wal_.append(payload);
+}
+
+bool WalSessionStore::sync(uint64_t lsn) { return wal_.sync(lsn); }
+
+std::string WalSessionStore::latest_snapshot_path(uint64_t &cut_lsn) const {
+    std::string best;
+    cut_lsn = 0;
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        uint64_t cut = 0;
+        if (name.size() == 29 &&
+            std::sscanf(name.c_str(), "snapshot-%016" SCNx64 ".bin", &cut) == 1 &&
+            (best.empty() || cut > cut_lsn)) {
+            best = entry.path().string();
+            cut_lsn = cut;
+        }
+    }
+    return best;
+}
+
+std::vector<SessionImage> WalSessionStore::load_all() {
+    auto started = std::chrono::steady_clock::now();
+
+    // 1. Decode the newest snapshot in parallel straight from the mapping.
+    uint64_t cut_lsn = 0;
+    std::vector<SessionImage> snapshot_images;
+    std::string snapshot_path = latest_snapshot_path(cut_lsn);
+    if (!snapshot_path.empty() &&
+        !read_snapshot(snapshot_path, cut_lsn, snapshot_images)) {
+        SPDLOG_ERROR("Snapshot '{}' is unreadable; recovering from the WAL "
+                     "alone.",
+                     snapshot_path);
+        cut_lsn = 0;
+        snapshot_images.clear();
+    }
+
+    // 2. Partition sessions and the WAL tail by session, so that each
+    // partition can be replayed independently and in order.
+    const size_t partitions = std::max(1u, std::thread::hardware_concurrency());
+    std::hash<std::string> hasher;
+    std::vector<std::unordered_map<std::string, SessionImage>> states(partitions);
+    for (auto &image : snapshot_images) {
+        if (!image.id.empty()) {
+            auto &bucket = states[hasher(image.id) % partitions];
+            std::string id = image.id;
+            bucket.emplace(std::move(id), std::move(image));
+        }
+    }
+    snapshot_images.clear();
+
+    std::vector<std::vector<std::pair<uint64_t, SessionRecord>>> tails(
+        partitions);
+    // A fork copies another session, possibly from another partition, so
+    // forks are kept apart and applied between rounds of parallel replay.
+    std::vector<std::pair<uint64_t, SessionRecord>> forks;
+    size_t replayed = 0;
+    wal_.replay(cut_lsn, [&](uint64_t lsn, std::string_view payload) {
+        SessionRecord record;
+        if (!codec::decode_record(payload, record)) {
+            SPDLOG_WARN("Skipping undecodable WAL record {}.", lsn);
+            return;
+        }
+        if (record.type == SessionRecord::Type::Fork) {
+            forks.emplace_back(lsn, std::move(record));
+        } else {
+            tails[hasher(record.session_id) % partitions].emplace_back(
+                lsn, std::move(record));
+        }
+        replayed++;
+    });
+
+    // 3. Replay each partition on its own thread, up to the next fork.
+    std::vector<size_t> replayed_upto(partitions, 0);
+    auto replay_before = [&](uint64_t barrier) {
+        parallel_for(partitions, partitions, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; p++) {
+                auto &state = states[p];
+                auto &tail = tails[p];
+                size_t &next = replayed_upto[p];
+                for (; next < tail.size() && tail[next].first < barrier;
+                     next++) {
+                    auto &[lsn, record] = tail[next];
+                    auto it = state.find(record.session_id);
+                    // Skip records already reflected in the snapshot image.
+                    if (it != state.end() && it->second.lsn >= lsn) {
+                        continue;
+                    }
+                    switch (record.type) {
+                    case SessionRecord::Type::Create: {
+                        SessionImage image;
+                        image.id = record.session_id;
+                        image.lsn = lsn;
+                        state[record.session_id] = std::move(image);
+                        break;
+                    }
+                    case SessionRecord::Type::Remove:
+                        if (it != state.end()) {
+                            state.erase(it);
+                        }
+                        break;
+                    default:
+                        if (it != state.end()) {
+                            it->second.apply(record, lsn);
+                        }
+                        break;
+                    }
+                }
+            }
+        });
+    };
+    for (auto &[lsn, record] : forks) {
+        replay_before(lsn);
+        auto &state = states[hasher(record.session_id) % partitions];
+        auto it = state.find(record.session_id);
+        if (it != state.end() && it->second.lsn >= lsn) {
+            continue;
+        }
+        SessionImage image;
+        const auto &base_state = states[hasher(record.text) % partitions];
+        auto base = base_state.find(record.text);
+        if (base != base_state.end()) {
+            image = base->second;
+        }
+        image.id = record.session_id;
+        image.lsn = lsn;
+        state[record.session_id] = std::move(image);
+    }
+    replay_before(UINT64_MAX);
+    tails.clear();
+
+    std::vector<SessionImage> images;
+    for (auto &state : states) {
+        for (auto &[id, image] : state) {
+            images.push_back(std::move(image));
+        }
+    }
+    // Restored in ID order, so directory listings are stable across runs.
+    std::sort(images.begin(), images.end(),
+              [](const SessionImage &a, const SessionImage &b) {
+                  return a.id < b.id;
+              });
+    checkpointed_bytes_ = 0;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+    SPDLOG_INFO("Recovered {} session(s) from '{}' (snapshot LSN {}, {} WAL "
+                "record(s), {} thread(s)) in {} ms.",
+                images.size(), dir_, cut_lsn, replayed, partitions,
+                elapsed.count());
+    return images;
+}
+
+bool WalSessionStore::write_snapshot(const std::vector<SnapshotEntry> &sessions,
+                                     uint64_t cut_lsn) {
+    const std::string final_path = dir_ + "/" + snapshot_name(cut_lsn);
+    const std::string tmp_path = final_path + ".tmp";
+    int fd = ::open(tmp_path.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        SPDLOG_ERROR("Cannot create snapshot '{}': {}", tmp_path,
+                     strerror(errno));
+        return false;
+    }
+
+    bool ok = true;
+    std::string buffer(SNAPSHOT_HEADER, '\0'); // Header is filled in last
+    std::string index;
+    index.reserve(sessions.size() * INDEX_ENTRY);
+    codec::Writer index_writer(index);
+    uint64_t offset = 0;
+    for (const auto &[id, snap] : sessions) {
+        size_t start = buffer.size();
+        codec::encode_image(id, snap->lsn, snap->history, snap->context,
+                            snap->persisted_model(), snap->overrides, buffer);
+        size_t length = buffer.size() - start;
+        index_writer.u64(offset + start);
+        index_writer.u64(length);
+        index_writer.u32(codec::crc32(buffer.data() + start, length));
+        index_writer.u32(0);
+        if (buffer.size() >= WRITE_BUFFER) {
+            ok = ok && write_all(fd, buffer);
+            offset += buffer.size();
+            buffer.clear();
+        }
+    }
+    const uint64_t index_offset = offset + buffer.size();
+    ok = ok && write_all(fd, buffer) && write_all(fd, index);
+
+    std::string header(SNAPSHOT_MAGIC, 8);
+    codec::Writer header_writer(header);
+    header_writer.u32(SNAPSHOT_VERSION);
+    header_writer.u32(0);
+    header_writer.u64(cut_lsn);
+    header_writer.u64(sessions.size());
+    header_writer.u64(index_offset);
+    ok = ok && ::pwrite(fd, header.data(), header.size(), 0) ==
+                   static_cast<ssize_t>(header.size());
+    ok = ok && ::fdatasync(fd) == 0;
+    ::close(fd);
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(tmp_path, final_path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        SPDLOG_ERROR("Writing snapshot '{}' failed.", final_path);
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+    if (int dir_fd = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+
+    // The new snapshot supersedes older ones and the WAL up to cut_lsn.
+    for (const auto &entry : fs::directory_iterator(dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("snapshot-", 0) == 0 && entry.path() != final_path) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    wal_.truncate_through(cut_lsn);
+
+    SPDLOG_INFO("Wrote snapshot of {} session(s) at LSN {}.", sessions.size(),
+                cut_lsn);
+    return true;
+}
+
+bool WalSessionStore::checkpoint(SessionManager &sessions) {
+    std::lock_guard<std::mutex> lock(checkpoint_mtx_);
+    const uint64_t bytes = wal_.appended_bytes();
+    // Everything logged up to the cut is visible in the sessions collected
+    // below, because records are appended under the same locks that publish
+    // the state they describe.
+    const uint64_t cut_lsn = wal_.last_lsn();
+    std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>>
+        entries;
+    // Keep the WAL and the old snapshot if a session could not be collected.
+    if (!sessions.checkpoint_snapshots(entries) ||
+        !write_snapshot(entries, cut_lsn)) {
+        return false;
+    }
+    checkpointed_bytes_ = bytes;
+    return true;
+}
+
+void WalSessionStore::start_checkpointing(SessionManager &sessions,
+                                          std::chrono::seconds interval) {
+    stop_checkpointing();
+    {
+        std::lock_guard<std::mutex> lock(stop_mtx_);
+        stop_ = false;
+    }
+    checkpointer_ = std::thread(&WalSessionStore::checkpoint_loop, this,
+                                std::ref(sessions), interval);
+}
+
+void WalSessionStore::stop_checkpointing() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mtx_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (checkpointer_.joinable()) {
+        checkpointer_.join();
+    }
+}
+
+void WalSessionStore::checkpoint_loop(SessionManager &sessions,
+                                      std::chrono::seconds interval) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stop_mtx_);
+            if (stop_cv_.wait_for(lock, interval, [this] { return stop_; })) {
+                return;
+            }
+        }
+        if (wal_.appended_bytes() > checkpointed_bytes_) {
+            checkpoint(sessions);
+        }
+    }
+}
+
+} // namespace fusellm
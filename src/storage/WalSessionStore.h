@@ -0,0 +1,105 @@
+#pragma once
+
+#include "SessionStore.h"
+#include "WriteAheadLog.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fusellm {
+
+class SessionManager;
+struct SessionSnapshot;
+
+/**
+ * @class WalSessionStore
+ * @brief Local, crash-safe session storage: a write-ahead log plus periodic
+ * compacted snapshots.
+ *
+ * Every mutation is appended to a segmented WAL with group commit. A
+ * background checkpointer periodically writes all sessions to a binary
+ * snapshot file and deletes the WAL segments it covers, so the log stays
+ * short. At startup the newest snapshot is memory-mapped and decoded in
+ * parallel, then the WAL tail is replayed in parallel across sessions.
+ *
+ * Snapshot layout (all integers little-endian):
+ *
+ *     header   "FLLMSNP1" | u32 version | u32 reserved | u64 cut_lsn
+ *              | u64 session_count | u64 index_offset
+ *     blobs    one codec::encode_image() blob per session
+ *     index    session_count x { u64 offset | u64 length | u32 crc32 | u32 0 }
+ *
+ * The fixed-size index lets readers locate any session in O(1) and decode
+ * disjoint ranges of sessions on different threads straight from the
+ * mapping.
+ */
+class WalSessionStore : public SessionStore {
+  public:
+    using SnapshotEntry =
+        std::pair<std::string, std::shared_ptr<const SessionSnapshot>>;
+
+    /**
+     * @brief Opens the store in `dir` (created if missing).
+     * Throws std::runtime_error if the directory cannot be used.
+     */
+    explicit WalSessionStore(
+        std::string dir,
+        uint64_t segment_bytes = WriteAheadLog::DEFAULT_SEGMENT_BYTES);
+    ~WalSessionStore() override;
+
+    uint64_t append(const SessionRecord &record) override;
+    bool sync(uint64_t lsn) override;
+    std::vector<SessionImage> load_all() override;
+
+    /**
+     * @brief Writes a snapshot of the given sessions and drops the WAL
+     * segments it makes obsolete.
+     * @param cut_lsn Every record with LSN <= cut_lsn must be reflected in
+     * `sessions`.
+     * @return True on success.
+     */
+    bool write_snapshot(const std::vector<SnapshotEntry> &sessions,
+                        uint64_t cut_lsn);
+
+    /**
+     * @brief Takes a snapshot of every session in `sessions` now.
+     */
+    bool checkpoint(SessionManager &sessions);
+
+    /**
+     * @brief Starts the background checkpointer. A snapshot is taken every
+     * `interval` if anything was logged since the previous one.
+     */
+    void start_checkpointing(SessionManager &sessions,
+                             std::chrono::seconds interval);
+
+    /**
+     * @brief Stops the background checkpointer. Idempotent.
+     */
+    void stop_checkpointing();
+
+  private:
+    std::string latest_snapshot_path(uint64_t &cut_lsn) const;
+    void checkpoint_loop(SessionManager &sessions,
+                         std::chrono::seconds interval);
+
+    const std::string dir_;
+    WriteAheadLog wal_;
+
+    std::mutex checkpoint_mtx_; // Serializes snapshot writers
+    // WAL bytes appended as of the last snapshot.
+    std::atomic<uint64_t> checkpointed_bytes_{0};
+
+    std::thread checkpointer_;
+    std::mutex stop_mtx_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+};
+
+} // namespace fusellm
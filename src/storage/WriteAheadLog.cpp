@@ -0,0 +1,401 @@
+#include "WriteAheadLog.h"
+#include "RecordCodec.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fusellm {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t FRAME_HEADER = 4 + 4 + 8;
+
+// Delay before retrying a failed flush, doubled after each failure.
+constexpr std::chrono::milliseconds RETRY_MIN{100};
+constexpr std::chrono::milliseconds RETRY_MAX{5000};
+
+std::string segment_name(uint64_t first_lsn) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "wal-%016" PRIx64 ".log", first_lsn);
+    return name;
+}
+
+uint32_t load_u32(const char *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+uint64_t load_u64(const char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+bool read_file(const std::string &path, std::string &out) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    out.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = ::read(fd, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    out.resize(done);
+    ::close(fd);
+    return true;
+}
+
+bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void fsync_dir(const std::string &dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// Walks the framed records in `data`. Returns the offset after the last
+// intact record; `fn` is called for each one.
+template <typename Fn> size_t walk_records(std::string_view data, Fn &&fn) {
+    size_t pos = 0;
+    while (data.size() - pos >= FRAME_HEADER) {
+        const char *p = data.data() + pos;
+        uint32_t len = load_u32(p);
+        uint32_t crc = load_u32(p + 4);
+        if (data.size() - pos - FRAME_HEADER < len) {
+            break; // Torn write
+        }
+        // The CRC covers the LSN and the payload.
+        if (codec::crc32(p + 8, 8 + len) != crc) {
+            break;
+        }
+        fn(load_u64(p + 8), std::string_view(p + FRAME_HEADER, len));
+        pos += FRAME_HEADER + len;
+    }
+    return pos;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(std::string dir, uint64_t segment_bytes)
+    : dir_(std::move(dir)), segment_bytes_(segment_bytes) {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot create WAL directory '" + dir_ +
+                                 "': " + ec.message());
+    }
+
+    segments_ = list_segments();
+    uint64_t last_lsn = 0;
+    if (!segments_.empty()) {
+        // Only the last segment can have a torn tail.
+        const auto &active = segments_.back();
+        uint64_t valid = scan_segment(active.path, last_lsn);
+        if (last_lsn == 0) {
+            last_lsn = active.first_lsn - 1;
+        }
+        if (::truncate(active.path.c_str(), static_cast<off_t>(valid)) != 0) {
+            throw std::runtime_error("Cannot truncate WAL segment '" +
+                                     active.path + "': " + strerror(errno));
+        }
+        fd_ = ::open(active.path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open WAL segment '" + active.path +
+                                     "': " + strerror(errno));
+        }
+        segment_size_ = valid;
+    }
+    next_lsn_ = last_lsn + 1;
+    durable_lsn_ = last_lsn;
+    if (fd_ < 0) {
+        open_segment(next_lsn_);
+    }
+
+    SPDLOG_INFO("Opened WAL '{}' with {} segment(s), next LSN {}.", dir_,
+                segments_.size(), next_lsn_);
+    flusher_ = std::thread(&WriteAheadLog::flush_loop, this);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::vector<WriteAheadLog::Segment> WriteAheadLog::list_segments() const {
+    std::vector<Segment> segments;
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        uint64_t first = 0;
+        if (name.size() == 24 &&
+            std::sscanf(name.c_str(), "wal-%016" SCNx64 ".log", &first) == 1) {
+            segments.push_back({first, entry.path().string()});
+        }
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment &a, const Segment &b) {
+                  return a.first_lsn < b.first_lsn;
+              });
+    return segments;
+}
+
+uint64_t WriteAheadLog::scan_segment(const std::string &path,
+                                     uint64_t &last_lsn) const {
+    std::string data;
+    if (!read_file(path, data)) {
+        return 0;
+    }
+    size_t valid = walk_records(
+        data, [&](uint64_t lsn, std::string_view) { last_lsn = lsn; });
+    if (valid != data.size()) {
+        SPDLOG_WARN("WAL segment '{}' has a torn tail, dropping {} bytes.",
+                    path, data.size() - valid);
+    }
+    return valid;
+}
+
+void WriteAheadLog::open_segment(uint64_t first_lsn) {
+    std::string path = dir_ + "/" + segment_name(first_lsn);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                    0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create WAL segment '" + path +
+                                 "': " + strerror(errno));
+    }
+    fsync_dir(dir_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+    segment_size_ = 0;
+    segments_.push_back({first_lsn, std::move(path)});
+}
+
+uint64_t WriteAheadLog::append(std::string_view payload) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    uint64_t lsn = next_lsn_++;
+
+    // Frame the record directly into the pending batch; the CRC slot is
+    // patched once the LSN and payload are in place.
+    const size_t start = batch_.size();
+    codec::Writer w(batch_);
+    w.u32(static_cast<uint32_t>(payload.size()));
+    w.u32(0);
+    w.u64(lsn);
+    batch_.append(payload.data(), payload.size());
+    uint32_t crc = codec::crc32(batch_.data() + start + 8, 8 + payload.size());
+    for (int i = 0; i < 4; i++) {
+        batch_[start + 4 + i] = static_cast<char>((crc >> (8 * i)) & 0xFF);
+    }
+
+    appended_bytes_ += FRAME_HEADER + payload.size();
+    work_cv_.notify_one();
+    return lsn;
+}
+
+bool WriteAheadLog::sync(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    const uint64_t failures = failures_;
+    durable_cv_.wait(
+        lock, [&] { return durable_lsn_ >= lsn || failures_ != failures; });
+    return durable_lsn_ >= lsn;
+}
+
+uint64_t WriteAheadLog::last_lsn() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return next_lsn_ - 1;
+}
+
+uint64_t WriteAheadLog::appended_bytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return appended_bytes_;
+}
+
+bool WriteAheadLog::repair_tail(uint64_t first_lsn) {
+    if (::ftruncate(fd_, static_cast<off_t>(segment_size_)) == 0) {
+        torn_ = false;
+        return true;
+    }
+    SPDLOG_ERROR("Cannot truncate WAL segment '{}': {}", segments_.back().path,
+                 strerror(errno));
+    // Replay stops at the torn frame, so later records must not follow it.
+    if (segments_.back().first_lsn == first_lsn) {
+        return false;
+    }
+    try {
+        open_segment(first_lsn);
+    } catch (const std::exception &e) {
+        SPDLOG_ERROR("WAL segment rotation failed: {}", e.what());
+        return false;
+    }
+    torn_ = false;
+    return true;
+}
+
+void WriteAheadLog::flush_loop() {
+    std::string writing;
+    auto retry_delay = RETRY_MIN;
+    while (true) {
+        uint64_t batch_last;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            work_cv_.wait(lock, [this] { return stop_ || !batch_.empty(); });
+            if (batch_.empty()) {
+                return; // Stopping and nothing left to write
+            }
+            writing.swap(batch_);
+            batch_.clear();
+            batch_last = next_lsn_ - 1;
+        }
+        const uint64_t batch_first = load_u64(writing.data() + 8);
+
+        bool ok;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ok = !torn_ || repair_tail(batch_first);
+        }
+        ok = ok && write_all(fd_, writing.data(), writing.size()) &&
+             ::fdatasync(fd_) == 0;
+        const int err = errno;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (ok) {
+            segment_size_ += writing.size();
+            writing.clear();
+            durable_lsn_ = batch_last;
+            retry_delay = RETRY_MIN;
+            if (segment_size_ >= segment_bytes_) {
+                try {
+                    open_segment(batch_last + 1);
+                } catch (const std::exception &e) {
+                    SPDLOG_ERROR("WAL segment rotation failed: {}", e.what());
+                }
+            }
+            lock.unlock();
+            durable_cv_.notify_all();
+            continue;
+        }
+
+        // Part of the batch may have reached the file, and after a failed
+        // fdatasync the written pages may be gone. Cut the segment back to its
+        // last intact record and rewrite the whole batch, ahead of anything
+        // appended meanwhile.
+        SPDLOG_ERROR("WAL write to '{}' failed: {}; retrying in {} ms.", dir_,
+                     strerror(err), retry_delay.count());
+        torn_ = true;
+        repair_tail(batch_first);
+        writing.append(batch_);
+        batch_.swap(writing);
+        writing.clear();
+        failures_++;
+        durable_cv_.notify_all();
+        if (stop_) {
+            SPDLOG_ERROR("Dropping {} unwritten WAL byte(s) at shutdown.",
+                         batch_.size());
+            return;
+        }
+        work_cv_.wait_for(lock, retry_delay, [this] { return stop_; });
+        retry_delay = std::min(retry_delay * 2, RETRY_MAX);
+    }
+}
+
+void WriteAheadLog::replay(uint64_t after_lsn, const ReplayFn &fn) const {
+    std::vector<Segment> segments;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        segments = segments_;
+    }
+    std::string data;
+    for (size_t i = 0; i < segments.size(); i++) {
+        // Skip segments whose records all precede after_lsn.
+        if (i + 1 < segments.size() && segments[i + 1].first_lsn <= after_lsn + 1) {
+            continue;
+        }
+        if (!read_file(segments[i].path, data)) {
+            SPDLOG_ERROR("Cannot read WAL segment '{}'.", segments[i].path);
+            continue;
+        }
+        walk_records(data, [&](uint64_t lsn, std::string_view payload) {
+            if (lsn > after_lsn) {
+                fn(lsn, payload);
+            }
+        });
+    }
+}
+
+void WriteAheadLog::truncate_through(uint64_t lsn) {
+    std::vector<std::string> obsolete;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        // Segment i holds LSNs [first_i, first_{i+1}); the last one is active.
+        size_t keep_from = 0;
+        while (keep_from + 1 < segments_.size() &&
+               segments_[keep_from + 1].first_lsn <= lsn + 1) {
+            obsolete.push_back(segments_[keep_from].path);
+            keep_from++;
+        }
+        segments_.erase(segments_.begin(), segments_.begin() + keep_from);
+    }
+    for (const auto &path : obsolete) {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+    if (!obsolete.empty()) {
+        fsync_dir(dir_);
+        SPDLOG_INFO("Removed {} obsolete WAL segment(s).", obsolete.size());
+    }
+}
+
+} // namespace fusellm
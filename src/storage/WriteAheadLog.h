@@ -0,0 +1,124 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fusellm {
+
+/**
+ * @class WriteAheadLog
+ * @brief A segmented, append-only log with group commit.
+ *
+ * Each record gets a log sequence number (LSN) and is framed as
+ * `[u32 payload length][u32 crc32][u64 lsn][payload]`. Records are written to
+ * segment files named `wal-<first lsn in hex>.log`; a new segment is started
+ * once the current one exceeds the configured size, so that segments made
+ * obsolete by a snapshot can simply be deleted.
+ *
+ * append() only copies the record into an in-memory batch. A single flusher
+ * thread writes the whole batch and issues one fdatasync(), then wakes every
+ * caller waiting in sync() for an LSN in that batch. Mutations arriving while
+ * a flush is in progress form the next batch, so throughput scales with
+ * concurrency instead of being bounded by fsync latency.
+ */
+class WriteAheadLog {
+  public:
+    using ReplayFn = std::function<void(uint64_t lsn, std::string_view payload)>;
+
+    static constexpr uint64_t DEFAULT_SEGMENT_BYTES = 64ull << 20;
+
+    /**
+     * @brief Opens (or creates) the log in `dir`. A torn record at the end of
+     * the last segment, left by a crash mid-write, is truncated away.
+     * Throws std::runtime_error if the directory cannot be used.
+     */
+    explicit WriteAheadLog(std::string dir,
+                           uint64_t segment_bytes = DEFAULT_SEGMENT_BYTES);
+
+    /**
+     * @brief Flushes outstanding records and stops the flusher.
+     */
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    /**
+     * @brief Buffers a record. Never blocks on I/O.
+     * @return The record's LSN.
+     */
+    uint64_t append(std::string_view payload);
+
+    /**
+     * @brief Waits until every record up to `lsn` is on stable storage.
+     * @return False if a write or fsync failed while waiting. The records
+     * stay queued and are retried, so a later sync() can still succeed.
+     */
+    bool sync(uint64_t lsn);
+
+    /**
+     * @brief LSN of the most recently appended record (0 if none).
+     */
+    uint64_t last_lsn() const;
+
+    /**
+     * @brief Total bytes appended since the log was opened.
+     */
+    uint64_t appended_bytes() const;
+
+    /**
+     * @brief Calls `fn` for every intact record with an LSN greater than
+     * `after_lsn`, in LSN order. Must be called before the first append.
+     */
+    void replay(uint64_t after_lsn, const ReplayFn &fn) const;
+
+    /**
+     * @brief Deletes segments that only contain records with LSN <= `lsn`.
+     * The active segment is never deleted.
+     */
+    void truncate_through(uint64_t lsn);
+
+  private:
+    struct Segment {
+        uint64_t first_lsn;
+        std::string path;
+    };
+
+    std::vector<Segment> list_segments() const;
+    // Scans a segment and returns the offset after its last intact record.
+    uint64_t scan_segment(const std::string &path, uint64_t &last_lsn) const;
+    void open_segment(uint64_t first_lsn);
+    // Cuts a partly written batch off the active segment, or starts a new
+    // segment at `first_lsn` if that fails. Called with mtx_ held.
+    bool repair_tail(uint64_t first_lsn);
+    void flush_loop();
+
+    const std::string dir_;
+    const uint64_t segment_bytes_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable work_cv_;    // Wakes the flusher
+    std::condition_variable durable_cv_; // Wakes sync() callers
+    std::string batch_;                  // Framed records not yet written
+    uint64_t next_lsn_ = 1;
+    uint64_t durable_lsn_ = 0;
+    uint64_t appended_bytes_ = 0;
+    uint64_t failures_ = 0; // Failed flush attempts, wakes sync() callers
+    bool stop_ = false;
+
+    // Owned by the flusher thread after construction.
+    int fd_ = -1;
+    uint64_t segment_size_ = 0; // Bytes of intact records in the segment
+    bool torn_ = false;         // The segment ends in a partial batch
+    std::vector<Segment> segments_; // Guarded by mtx_
+
+    std::thread flusher_;
+};
+
+} // namespace fusellm
@@ -0,0 +1,94 @@
+#include "../../src/common/BlobStore.h"
+#include "../../src/common/History.h"
+#include <doctest/doctest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fusellm;
+
+TEST_CASE("BlobStore测试") {
+    SUBCASE("相同内容只存一份，引用全部释放后回收") {
+        BlobStore store;
+        const std::string doc(10000, 'd');
+        {
+            Blob a = store.intern(doc);
+            Blob b = store.intern(std::string(doc)); // 独立构造的相同内容
+            Blob c = store.intern("另一份文档");
+            CHECK(a.data() == b.data());
+            CHECK(a == b);
+            CHECK(a != c);
+            CHECK(a == doc);
+
+            auto stats = store.stats();
+            CHECK(stats.blobs == 2);
+            CHECK(stats.references == 3);
+            CHECK(stats.hits == 1);
+            CHECK(stats.misses == 2);
+            CHECK(stats.stored_bytes == doc.size() + c.size());
+            CHECK(stats.logical_bytes == 2 * doc.size() + c.size());
+            CHECK(stats.dedupe_ratio() > 1.9);
+
+            // 拷贝 Blob 不算新的引用
+            Blob copy = a;
+            CHECK(store.stats().references == 3);
+        }
+        auto stats = store.stats();
+        CHECK(stats.blobs == 0);
+        CHECK(stats.references == 0);
+        CHECK(stats.stored_bytes == 0);
+        CHECK(stats.dedupe_ratio() == doctest::Approx(1.0));
+    }
+
+    SUBCASE("短文本不进入全局存储，但拷贝共享") {
+        const auto before = BlobStore::shared().stats();
+        Blob small("短");
+        CHECK_FALSE(small.interned());
+        Blob copy = small;
+        CHECK(copy.data() == small.data());
+        CHECK(BlobStore::shared().stats().blobs == before.blobs);
+
+        Blob large(std::string(BlobStore::shared().min_bytes(), 'x'));
+        CHECK(large.interned());
+        CHECK(large == std::string(BlobStore::shared().min_bytes(), 'x'));
+        CHECK(Blob().empty());
+    }
+
+    SUBCASE("并发驻留与释放") {
+        BlobStore store;
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 2000; i++) {
+                    std::string text = "文本" + std::to_string(i % 16);
+                    Blob a = store.intern(text);
+                    Blob b = store.intern("文本" + std::to_string((i + t) % 16));
+                    if (a.view() != text || (t % 16 == 0 && a.data() != b.data())) {
+                        mismatches++;
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        CHECK(mismatches == 0);
+        CHECK(store.stats().blobs == 0);
+        CHECK(store.stats().references == 0);
+    }
+
+    SUBCASE("大消息正文在历史之间共享") {
+        const std::string doc(100 << 10, 'r');
+        const auto before = BlobStore::shared().stats();
+        auto ts = std::chrono::system_clock::now();
+        History a = History().append(Message::Role::User, doc, ts);
+        History b = History().append(Message::Role::User, doc, ts);
+        CHECK(a[0].content.data() == b[0].content.data());
+        CHECK(a[0].content == doc);
+        auto stats = BlobStore::shared().stats();
+        CHECK(stats.blobs == before.blobs + 1);
+        CHECK(stats.references == before.references + 2);
+    }
+}
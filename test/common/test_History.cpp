@@ -0,0 +1,155 @@
+#include "../../src/common/History.h"
+#include <doctest/doctest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fusellm;
+
+namespace {
+
+std::chrono::system_clock::time_point at(int seconds) {
+    return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+} // namespace
+
+TEST_CASE("History测试") {
+    SUBCASE("追加与按序遍历") {
+        History history;
+        CHECK(history.empty());
+        for (int i = 0; i < 1000; i++) {
+            history = history.append(i % 2 ? Message::Role::AI
+                                            : Message::Role::User,
+                                     "消息" + std::to_string(i), at(i));
+        }
+        REQUIRE(history.size() == 1000);
+        int i = 0;
+        for (const auto &msg : history) {
+            CHECK(msg.content == "消息" + std::to_string(i));
+            CHECK(msg.role ==
+                  (i % 2 ? Message::Role::AI : Message::Role::User));
+            CHECK(msg.timestamp == at(i));
+            i++;
+        }
+        CHECK(i == 1000);
+        CHECK(history.back().content == "消息999");
+        // 每条消息的索引开销只有几十字节，而不是一个 Message 加一次堆分配
+        CHECK(history.memory_bytes() < 1000 * 64);
+    }
+
+    SUBCASE("旧版本不受后续修改影响") {
+        History base = History().append(Message::Role::User, "a", at(1));
+        History longer = base.append(Message::Role::AI, "b", at(2));
+        CHECK(base.size() == 1);
+        CHECK(longer.size() == 2);
+        CHECK(longer[0].content == "a");
+
+        // 在旧版本上追加会分叉，而不会覆盖 longer 的第二条消息
+        History branch = base.append(Message::Role::AI, "c", at(3));
+        CHECK(branch[1].content == "c");
+        CHECK(longer[1].content == "b");
+
+        // 截断是 O(1) 的，并且与原版本共享存储
+        History prefix = longer.truncate(1);
+        CHECK(prefix.same_as(base));
+        CHECK(prefix.append(Message::Role::AI, "d", at(4))[1].content == "d");
+        CHECK(longer[1].content == "b");
+    }
+
+    SUBCASE("在旧版本上分叉只存新消息") {
+        History base;
+        for (int i = 0; i < 10000; i++) {
+            base = base.append(Message::Role::User,
+                               "第" + std::to_string(i) + "条消息", at(i));
+        }
+        History longer = base.append(Message::Role::AI, "原分支", at(1));
+        const size_t shared = base.memory_bytes();
+
+        History fork = base.append(Message::Role::AI, "新分支", at(2));
+        REQUIRE(fork.size() == 10001);
+        CHECK(fork.back().content == "新分支");
+        CHECK(longer.back().content == "原分支");
+        // 前缀与原历史共享，分叉只多出一个很小的存储
+        CHECK(fork[42].content.data() == base[42].content.data());
+        CHECK(fork.memory_bytes() - shared < 4096);
+
+        // 分叉之后可以继续追加、截断回共享前缀、再次分叉
+        History deeper = fork;
+        for (int depth = 0; depth < 20; depth++) {
+            deeper = deeper.append(Message::Role::User, "q", at(3))
+                         .truncate(deeper.size())
+                         .append(Message::Role::User,
+                                 "分叉" + std::to_string(depth), at(4));
+        }
+        CHECK(deeper.size() == 10021);
+        CHECK(deeper[10000].content == "新分支");
+        CHECK(deeper[10020].content == "分叉19");
+        CHECK(deeper[9999].content == "第9999条消息");
+        CHECK(fork.truncate(10).same_as(base.truncate(10)));
+    }
+
+    SUBCASE("删除和插入") {
+        History history;
+        for (auto text : {"a", "b", "c"}) {
+            history = history.append(Message::Role::User, text, at(0));
+        }
+        History erased = history.erase(1);
+        REQUIRE(erased.size() == 2);
+        CHECK(erased[0].content == "a");
+        CHECK(erased[1].content == "c");
+
+        History inserted = history.insert(1, {Message::Role::AI, "x", at(1)});
+        REQUIRE(inserted.size() == 4);
+        CHECK(inserted[1].content == "x");
+        CHECK(inserted[2].content == "b");
+        CHECK(history.size() == 3);
+        CHECK(history[1].content == "b");
+    }
+
+    SUBCASE("大消息、空消息与转换") {
+        std::string big(200000, 'z');
+        std::vector<Message> messages = {
+            {Message::Role::System, "", at(0)},
+            {Message::Role::User, big, at(1)},
+            {Message::Role::AI, "短回复", at(2)},
+        };
+        History history = History::from_messages(messages);
+        CHECK(history[0].content.empty());
+        CHECK(history[1].content == big);
+        CHECK(history[1].tokens == 50000);
+        CHECK(history[2].tokens == 3);
+        auto back = history.to_messages();
+        REQUIRE(back.size() == 3);
+        CHECK(back[1].content == big);
+        CHECK(back[2].timestamp == at(2));
+    }
+
+    SUBCASE("并发读取时追加") {
+        History history = History().append(Message::Role::User, "0", at(0));
+        std::atomic<bool> done{false};
+        std::shared_ptr<const History> published =
+            std::make_shared<const History>(history);
+        std::thread reader([&] {
+            while (!done.load()) {
+                auto snap = std::atomic_load(&published);
+                size_t n = 0;
+                for (const auto &msg : *snap) {
+                    CHECK(msg.content == std::to_string(n));
+                    n++;
+                }
+                CHECK(n == snap->size());
+            }
+        });
+        for (int i = 1; i < 5000; i++) {
+            history = history.append(Message::Role::User, std::to_string(i),
+                                     at(i));
+            std::atomic_store(&published,
+                              std::make_shared<const History>(history));
+        }
+        done.store(true);
+        reader.join();
+        CHECK(history.size() == 5000);
+    }
+}
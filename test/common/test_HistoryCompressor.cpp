@@ -0,0 +1,145 @@
+#include "../../src/common/History.h"
+#include "../../src/common/HistoryCompressor.h"
+#include <doctest/doctest.h>
+#include <random>
+#include <string>
+
+using namespace fusellm;
+
+namespace {
+
+// 模拟聊天内容：句式重复、措辞略有变化，与真实对话的可压缩性相近
+std::string chat_text(int i) {
+    std::string text = "第" + std::to_string(i) +
+                       " 轮：Please explain how the session store keeps the "
+                       "write-ahead log consistent after a crash, and what "
+                       "happens to snapshots taken while turn " +
+                       std::to_string(i * 7 % 13) + " is still pending.";
+    for (int k = 0; k < i % 4; k++) {
+        text += " The answer depends on whether fsync completed before the "
+                "checkpoint was published.";
+    }
+    return text;
+}
+
+History build(int turns) {
+    History history;
+    auto ts = std::chrono::system_clock::now();
+    for (int i = 0; i < turns; i++) {
+        history = history.append(Message::Role::User, chat_text(i), ts);
+        history = history.append(Message::Role::AI, chat_text(i + 1000), ts);
+    }
+    return history;
+}
+
+HistoryCompressor::Options small_options() {
+    HistoryCompressor::Options options;
+    options.keep_turns = 4;
+    options.dictionary_bytes = 4 << 10;
+    options.training_bytes = 64 << 10;
+    options.cache_bytes = 64 << 10;
+    return options;
+}
+
+} // namespace
+
+TEST_CASE("HistoryCompressor测试") {
+    SUBCASE("压缩后按需解压，统计随块释放") {
+        auto compressor =
+            std::make_shared<HistoryCompressor>(small_options());
+        std::string raw;
+        for (int i = 0; i < 50; i++) {
+            raw += chat_text(i);
+        }
+        auto frame = compressor->compress(raw);
+        REQUIRE(frame != nullptr);
+        CHECK(frame->raw_size() == raw.size());
+        CHECK(*frame->load() == raw);
+        CHECK(*frame->load() == raw); // 第二次来自缓存
+
+        auto stats = compressor->stats();
+        CHECK(stats.frames == 1);
+        CHECK(stats.raw_bytes == raw.size());
+        CHECK(stats.compressed_bytes < raw.size());
+        CHECK(stats.cache_hits == 1);
+        CHECK(stats.cache_misses == 1);
+        CHECK(stats.cache_bytes == raw.size());
+
+        frame.reset();
+        stats = compressor->stats();
+        CHECK(stats.frames == 0);
+        CHECK(stats.raw_bytes == 0);
+        CHECK(stats.cache_bytes == 0);
+    }
+
+    SUBCASE("不可压缩的数据保持原样") {
+        auto compressor =
+            std::make_shared<HistoryCompressor>(small_options());
+        std::mt19937 rng(42);
+        std::string noise(4096, '\0');
+        for (auto &c : noise) {
+            c = static_cast<char>(rng());
+        }
+        CHECK(compressor->compress(noise) == nullptr);
+        CHECK(compressor->stats().frames == 0);
+    }
+
+    SUBCASE("压缩旧轮次，内容不变且内存显著下降") {
+        auto compressor =
+            std::make_shared<HistoryCompressor>(small_options());
+        // 字典在后台训练：先用另一段历史凑齐样本，等训练完成
+        build(300).compact(*compressor);
+        compressor->wait_for_training();
+        CHECK(compressor->stats().frames == 0);
+
+        History raw = build(1000);
+        History compact = raw.compact(*compressor);
+
+        REQUIRE(compact.size() == raw.size());
+        for (size_t i = 0; i < raw.size(); i++) {
+            CHECK(compact[i].content == raw[i].content);
+            CHECK(compact[i].role == raw[i].role);
+            CHECK(compact[i].tokens == raw[i].tokens);
+        }
+        auto stats = compressor->stats();
+        CHECK(stats.dictionary_bytes > 0);
+        CHECK(stats.frames > 0);
+        CHECK(stats.raw_bytes >= 3 * stats.compressed_bytes);
+        CHECK(raw.memory_bytes() >= 3 * compact.memory_bytes());
+
+        // 最近的轮次保持原文
+        CHECK(compact.back().pin == nullptr);
+        CHECK(compact[0].pin != nullptr);
+
+        // 压缩后的版本可以继续追加，再次压缩不会重复处理已压缩的块
+        History next = compact.append(Message::Role::User, "新问题",
+                                      std::chrono::system_clock::now());
+        CHECK(next.back().content == "新问题");
+        CHECK(next[0].content == raw[0].content);
+        CHECK(next.compact(*compressor).same_as(next));
+    }
+
+    SUBCASE("只压缩最新版本") {
+        auto compressor =
+            std::make_shared<HistoryCompressor>(small_options());
+        History old = build(100);
+        History newer = old.append(Message::Role::User, "x",
+                                   std::chrono::system_clock::now());
+        CHECK(old.compact(*compressor).same_as(old));
+        CHECK_FALSE(newer.compact(*compressor).same_as(newer));
+    }
+
+    SUBCASE("解压出的内容在缓存淘汰后仍然有效") {
+        auto options = small_options();
+        options.cache_bytes = 1; // 几乎不缓存
+        auto compressor = std::make_shared<HistoryCompressor>(options);
+        History compact = build(200).compact(*compressor);
+        History::Entry first = compact[0];
+        std::string expected(first.content);
+        for (const auto &msg : compact) {
+            (void)msg; // 遍历所有块，反复淘汰缓存
+        }
+        CHECK(first.content == expected);
+        CHECK(compressor->stats().cache_bytes == 0);
+    }
+}
@@ -0,0 +1,159 @@
+#include "../../src/common/Rope.h"
+#include <doctest/doctest.h>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fusellm;
+
+namespace {
+
+// 与 pwrite/ftruncate 语义相同的参照实现
+void write_at(std::string &s, size_t offset, const std::string &data) {
+    if (data.empty()) {
+        return;
+    }
+    if (offset > s.size()) {
+        s.resize(offset, '\0');
+    }
+    s.replace(offset, data.size(), data);
+}
+
+} // namespace
+
+TEST_CASE("Rope测试") {
+    SUBCASE("追加、读取与展平") {
+        Rope rope;
+        CHECK(rope.empty());
+        std::string expected;
+        for (int i = 0; i < 1000; i++) {
+            std::string line = "第" + std::to_string(i) + "行\n";
+            rope = rope.append(line);
+            expected += line;
+        }
+        CHECK(rope.size() == expected.size());
+        CHECK(rope == expected);
+        CHECK(rope.str() == expected);
+
+        char buf[64];
+        size_t n = rope.read(100, buf, sizeof(buf));
+        CHECK(n == sizeof(buf));
+        CHECK(std::string(buf, n) == expected.substr(100, sizeof(buf)));
+        CHECK(rope.read(expected.size() - 3, buf, sizeof(buf)) == 3);
+        CHECK(rope.read(expected.size(), buf, sizeof(buf)) == 0);
+
+        // 小块追加被打包进少数几个缓冲区
+        CHECK(rope.pieces() < 10);
+    }
+
+    SUBCASE("追加大文档的开销与文档大小成线性") {
+        const std::string page(128 << 10, 'p'); // 一次 FUSE 写入
+        Rope rope;
+        for (int i = 0; i < 400; i++) { // 50 MB
+            rope = rope.append(page);
+        }
+        CHECK(rope.size() == 400 * page.size());
+        // 每个片段都是一次写入，没有任何重新拼接
+        CHECK(rope.pieces() <= 400);
+        CHECK(rope.memory_bytes() < rope.size() + (1 << 20));
+        char c = 0;
+        CHECK(rope.read(rope.size() - 1, &c, 1) == 1);
+        CHECK(c == 'p');
+    }
+
+    SUBCASE("旧版本不受后续修改影响") {
+        Rope base = Rope().append("hello");
+        Rope a = base.append(" world");
+        Rope b = base.append(" there"); // 同一位置的第二次追加另起缓冲区
+        Rope c = a.write(0, "J");
+        Rope d = a.truncate(2);
+        CHECK(base == "hello");
+        CHECK(a == "hello world");
+        CHECK(b == "hello there");
+        CHECK(c == "Jello world");
+        CHECK(d == "he");
+        CHECK(d.append("y") == "hey");
+        CHECK(a == "hello world");
+    }
+
+    SUBCASE("覆盖、截断与空洞") {
+        Rope rope = Rope().append("0123456789");
+        CHECK(rope.write(3, "abc") == "012abc6789");
+        CHECK(rope.write(8, "xyz") == "01234567xyz");
+        CHECK(rope.write(12, "z") == std::string("0123456789\0\0z", 13));
+        CHECK(rope.write(20, "").same_as(rope));
+        CHECK(rope.truncate(4) == "0123");
+        CHECK(rope.truncate(12) == std::string("0123456789\0\0", 12));
+        CHECK(rope.truncate(0).empty());
+        CHECK(rope.truncate(10).same_as(rope));
+    }
+
+    SUBCASE("随机操作与参照实现一致") {
+        std::mt19937 rng(7);
+        Rope rope;
+        std::string expected;
+        for (int i = 0; i < 2000; i++) {
+            const int op = static_cast<int>(rng() % 10);
+            if (op < 6) { // 以追加为主，偶尔写在中间或末尾之后
+                size_t offset = expected.size();
+                if (op == 5 && !expected.empty()) {
+                    offset = rng() % (expected.size() + 100);
+                }
+                std::string data(rng() % 300, static_cast<char>('a' + i % 26));
+                rope = rope.write(offset, data);
+                write_at(expected, offset, data);
+            } else if (op < 8) {
+                const size_t offset =
+                    expected.empty() ? 0 : rng() % expected.size();
+                char buf[512];
+                const size_t n = rope.read(offset, buf, rng() % sizeof(buf));
+                CHECK(std::string(buf, n) == expected.substr(offset, n));
+            } else if (op == 8) {
+                const size_t size = rng() % (expected.size() + 50);
+                rope = rope.truncate(size);
+                expected.resize(size, '\0');
+            } else {
+                CHECK(rope.size() == expected.size());
+            }
+        }
+        CHECK(rope == expected);
+    }
+
+    SUBCASE("由 Blob 构造时共享文本") {
+        const std::string doc(10000, 'd');
+        Blob blob(doc);
+        Rope rope(blob);
+        CHECK(rope == doc);
+        CHECK(rope.pieces() == 1);
+        CHECK(rope.append("!") == doc + "!");
+        CHECK(Rope(Blob()).empty());
+    }
+
+    SUBCASE("并发地从同一版本派生") {
+        const Rope base = Rope().append("base");
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&, t] {
+                const std::string tag(1, static_cast<char>('a' + t));
+                for (int i = 0; i < 500; i++) {
+                    Rope mine = base;
+                    std::string expected = "base";
+                    for (int k = 0; k < 8; k++) {
+                        mine = mine.append(tag);
+                        expected += tag;
+                    }
+                    if (!(mine == expected) || !(base == "base")) {
+                        mismatches++;
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        CHECK(mismatches == 0);
+    }
+}
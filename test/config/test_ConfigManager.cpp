@@ -1,11 +1,14 @@
 #include "../../src/config/ConfigManager.h"
 #include <doctest/doctest.h>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <toml++/toml.hpp>
 
 TEST_CASE("ConfigManager基本功能测试") {
     using fusellm::ConfigManager;
     using fusellm::ModelParameters;
+    using fusellm::StopList;
 
     SUBCASE("ModelParameters合并功能测试") {
         // 测试TOML表到ModelParameters的合并
@@ -67,6 +70,66 @@ TEST_CASE("ConfigManager基本功能测试") {
         }
     }
 
+    SUBCASE("timeout_ms参数测试") {
+        std::stringstream ss;
+        ss << "timeout_ms = 1500\n";
+        auto tbl = toml::parse(ss);
+        CHECK(ModelParameters::validate_model_params_table(tbl));
+
+        ModelParameters params;
+        params.merge(tbl);
+        REQUIRE(params.timeout_ms.has_value());
+        CHECK(*params.timeout_ms == 1500);
+
+        // 非正数的超时时间无效
+        std::stringstream bad_ss;
+        bad_ss << "timeout_ms = -1\n";
+        auto bad_tbl = toml::parse(bad_ss);
+        CHECK_FALSE(ModelParameters::validate_model_params_table(bad_tbl));
+    }
+
+    SUBCASE("由参数表驱动的其余参数") {
+        auto tbl = toml::parse("max_tokens = 256\n"
+                               "stop = [\"\\n\\n\", \"END\"]\n"
+                               "seed = 42\n"
+                               "top_p = 0.9\n"
+                               "n = 2\n");
+        CHECK(ModelParameters::validate_model_params_table(tbl));
+
+        ModelParameters params;
+        params.merge(tbl);
+        CHECK(params.max_tokens.value() == 256);
+        CHECK(params.stop.value() == StopList({"\n\n", "END"}));
+        CHECK(params.seed.value() == 42);
+        CHECK(params.top_p.value() == doctest::Approx(0.9));
+        CHECK(params.n.value() == 2);
+
+        // 单个字符串的 stop 视为只有一项的列表
+        ModelParameters single;
+        single.merge(toml::parse("stop = \"###\"\n"));
+        CHECK(single.stop.value() == StopList({"###"}));
+
+        // 分层合并逐项覆盖
+        params.merge(single);
+        CHECK(params.stop.value() == StopList({"###"}));
+        CHECK(params.seed.value() == 42);
+
+        // 渲染出的 TOML 能原样解析回来
+        params.system_prompt = "含有\"引号\"的提示";
+        ModelParameters parsed;
+        parsed.merge(toml::parse(params.to_toml()));
+        CHECK(parsed.to_toml() == params.to_toml());
+        CHECK(parsed.system_prompt.value() == "含有\"引号\"的提示");
+        CHECK(ModelParameters().to_toml().empty());
+
+        for (const char *bad : {"max_tokens = 0\n", "top_p = 1.5\n",
+                                "n = 0\n", "seed = 1.5\n", "stop = [1, 2]\n",
+                                "stop = [\"a\", \"b\", \"c\", \"d\", \"e\"]\n"}) {
+            CHECK_FALSE(
+                ModelParameters::validate_model_params_table(toml::parse(bad)));
+        }
+    }
+
     SUBCASE("ConfigManager模型参数管理测试") {
         ConfigManager config;
 
@@ -91,4 +154,87 @@ TEST_CASE("ConfigManager基本功能测试") {
         CHECK_FALSE(default_params.temperature.has_value());
         // 但根据ConfigManager的构造函数，系统提示可能有默认值
     }
+
+    SUBCASE("配置以不可变快照发布") {
+        ConfigManager config;
+        const auto before = config.snapshot();
+        CHECK(before->epoch == config.epoch());
+        CHECK(before->default_model == config.default_model());
+
+        auto tbl = toml::parse("temperature = 0.5\n");
+        CHECK(config.update_model_params("test-model", tbl));
+        const auto after = config.snapshot();
+        CHECK(after->epoch == before->epoch + 1);
+        CHECK(config.epoch() == after->epoch);
+        CHECK(after->params_for("test-model").temperature.value() ==
+              doctest::Approx(0.5));
+        // 已取得的旧快照不受影响
+        CHECK_FALSE(before->params_for("test-model").temperature.has_value());
+
+        config.set_default_model("other-model");
+        CHECK(config.epoch() == after->epoch + 1);
+        CHECK(config.default_model() == "other-model");
+        CHECK(after->default_model != "other-model");
+        // 默认模型不变时不发布新快照
+        config.set_default_model("other-model");
+        CHECK(config.epoch() == after->epoch + 1);
+    }
+
+    SUBCASE("重新加载配置文件") {
+        const auto path = (std::filesystem::temp_directory_path() /
+                           "fusellm-test-reload.toml")
+                              .string();
+        auto write = [&](const std::string &content) {
+            std::ofstream(path, std::ios::trunc) << content;
+        };
+        write("default_model = \"model-a\"\n"
+              "api_key = \"key-1\"\n"
+              "[default_config]\n"
+              "temperature = 0.5\n");
+        ConfigManager config;
+        REQUIRE(config.load_from_file(path));
+        CHECK(config.config_path_ == path);
+        auto tbl = toml::parse("timeout_ms = 700\n");
+        REQUIRE(config.update_model_params("model-b", tbl));
+        const auto before = config.snapshot();
+
+        write("default_model = \"model-b\"\n"
+              "api_key = \"key-2\"\n"
+              "base_url = \"http://localhost:8000/v1\"\n"
+              "[default_config]\n"
+              "temperature = 0.9\n");
+        CHECK(config.reload_from_file(path));
+        const auto after = config.snapshot();
+        CHECK(after->epoch == before->epoch + 1);
+        CHECK(after->default_model == "model-b");
+        CHECK(after->api_key == "key-2");
+        CHECK(after->base_url == "http://localhost:8000/v1/");
+        CHECK(after->global_params.temperature.value() ==
+              doctest::Approx(0.9));
+        // 通过 /config 写入的模型参数在重新加载后保留
+        CHECK(after->params_for("model-b").timeout_ms.value() == 700);
+        CHECK(after->params_for("model-b").temperature.value() ==
+              doctest::Approx(0.9));
+
+        // 无法解析或取值非法的文件被拒绝，当前配置保持不变
+        write("default_model = \"model-c\"\n[default_config\n");
+        CHECK_FALSE(config.reload_from_file(path));
+        write("default_model = \"model-c\"\n"
+              "[default_config]\n"
+              "temperature = 5.0\n");
+        CHECK_FALSE(config.reload_from_file(path));
+        write("default_model = 42\n");
+        CHECK_FALSE(config.reload_from_file(path));
+        CHECK(config.snapshot() == after);
+
+        // 内容未变时不发布新的纪元
+        write("default_model = \"model-b\"\n"
+              "api_key = \"key-2\"\n"
+              "base_url = \"http://localhost:8000/v1\"\n"
+              "[default_config]\n"
+              "temperature = 0.9\n");
+        CHECK(config.reload_from_file(path));
+        CHECK(config.epoch() == after->epoch);
+        std::filesystem::remove(path);
+    }
 }
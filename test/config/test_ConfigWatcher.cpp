@@ -0,0 +1,68 @@
+#include "../../src/config/ConfigWatcher.h"
+#include <doctest/doctest.h>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace fusellm;
+
+TEST_CASE("ConfigWatcher测试") {
+    const auto dir = std::filesystem::temp_directory_path() /
+                     "fusellm-test-watch";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const auto path = (dir / "settings.toml").string();
+    std::ofstream(path) << "default_model = \"model-a\"\n";
+
+    ConfigManager config;
+    REQUIRE(config.load_from_file(path));
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    int reloads = 0;
+    ConfigWatcher watcher(config, [&] {
+        std::lock_guard<std::mutex> lock(mtx);
+        reloads++;
+        cv.notify_all();
+    });
+    REQUIRE(watcher.start(path));
+    auto wait_reloads = [&](int n) {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_for(lock, std::chrono::seconds(5),
+                           [&] { return reloads >= n; });
+    };
+
+    SUBCASE("原地写入和改名覆盖都会触发重新加载") {
+        std::ofstream(path, std::ios::trunc) << "default_model = \"model-b\"\n";
+        REQUIRE(wait_reloads(1));
+        CHECK(config.default_model() == "model-b");
+
+        // 编辑器常见的保存方式：写临时文件再改名覆盖
+        const auto tmp = (dir / "settings.toml.tmp").string();
+        std::ofstream(tmp) << "default_model = \"model-c\"\n";
+        std::filesystem::rename(tmp, path);
+        REQUIRE(wait_reloads(2));
+        CHECK(config.default_model() == "model-c");
+    }
+
+    SUBCASE("非法的新文件不会替换当前配置") {
+        const auto epoch = config.epoch();
+        std::ofstream(path, std::ios::trunc) << "default_model = [\n";
+        // 同目录下其他文件的变化不触发重新加载
+        std::ofstream(dir / "other.toml") << "default_model = \"x\"\n";
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        CHECK(config.epoch() == epoch);
+        CHECK(config.default_model() == "model-a");
+
+        std::ofstream(path, std::ios::trunc) << "default_model = \"model-d\"\n";
+        REQUIRE(wait_reloads(1));
+        CHECK(config.default_model() == "model-d");
+    }
+
+    watcher.stop();
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,272 @@
+#include "../../src/config/ConfigManager.h"
+#include "../../src/handlers/ConversationsHandler.h"
+#include "../../src/state/SessionManager.h"
+#include "../mocks/MockLLMClient.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+
+using namespace fusellm;
+
+namespace {
+
+// 模拟一次 open：返回内核交给后续操作的文件信息
+fuse_file_info open_file(ConversationsHandler &handler, const char *path,
+                         int flags, int *res = nullptr) {
+    fuse_file_info fi{};
+    fi.flags = flags;
+    int r = handler.open(path, &fi);
+    if (res) {
+        *res = r;
+    }
+    return fi;
+}
+
+int write_str(ConversationsHandler &handler, const char *path,
+              const std::string &data, off_t offset, fuse_file_info *fi) {
+    return handler.write(path, data.data(), data.size(), offset, fi);
+}
+
+std::string read_str(ConversationsHandler &handler, const char *path,
+                     off_t offset, fuse_file_info *fi, int *res = nullptr) {
+    std::string buf(4096, '\0');
+    int n = handler.read(path, buf.data(), buf.size(), offset, fi);
+    if (res) {
+        *res = n;
+    }
+    buf.resize(n > 0 ? static_cast<size_t>(n) : 0);
+    return buf;
+}
+
+// `key = value` 所在节 `[section]` 中的数值
+double stat_value(const std::string &stats, const std::string &section,
+                  const std::string &key) {
+    size_t at = stats.find("[" + section + "]");
+    REQUIRE(at != std::string::npos);
+    at = stats.find("\n" + key + " = ", at);
+    REQUIRE(at != std::string::npos);
+    return std::strtod(stats.c_str() + at + key.size() + 4, nullptr);
+}
+
+} // namespace
+
+TEST_CASE("ConversationsHandler测试") {
+    ConfigManager config;
+    config.set_default_model("default-model");
+    testing::MockLLMClient client(config);
+    SessionManager sessions(config);
+    ConversationsHandler handler(sessions, client, config);
+
+    SUBCASE("每个打开的 _search/query 有自己的结果") {
+        REQUIRE(handler.mkdir("/conversations/a", 0755) == 0);
+        REQUIRE(handler.mkdir("/conversations/b", 0755) == 0);
+        sessions.find_session("a")->populate("redis 缓存", "用 redis");
+        sessions.find_session("b")->populate("今天天气", "晴天");
+
+        const char *path = "/conversations/_search/query";
+        int res = -1;
+        auto first = open_file(handler, path, O_RDWR, &res);
+        REQUIRE(res == 0);
+        CHECK(first.direct_io);
+        auto second = open_file(handler, path, O_RDWR, &res);
+        REQUIRE(res == 0);
+        CHECK(first.fh != second.fh);
+
+        // 两个用户交替查询，互不覆盖
+        const std::string redis = "redis\n";
+        const std::string weather = "天气\n";
+        CHECK(write_str(handler, path, redis, 0, &first) ==
+              static_cast<int>(redis.size()));
+        CHECK(write_str(handler, path, weather, 0, &second) ==
+              static_cast<int>(weather.size()));
+
+        // 写完后从当前位置读，与从头读得到同样的结果
+        auto result = read_str(handler, path, redis.size(), &first);
+        CHECK(result.rfind("a\t0\tUSER\t", 0) == 0);
+        CHECK(result.find("b\t") == std::string::npos);
+        CHECK(read_str(handler, path, 0, &first) == result);
+        result = read_str(handler, path, 0, &second);
+        CHECK(result.rfind("b\t0\tUSER\t", 0) == 0);
+        CHECK(result.find("a\t") == std::string::npos);
+
+        // fstat 报告本句柄结果的大小，按路径 stat 时没有结果
+        struct stat st;
+        REQUIRE(handler.getattr(path, &st, &second) == 0);
+        CHECK(st.st_size == static_cast<off_t>(result.size()));
+        REQUIRE(handler.getattr(path, &st, nullptr) == 0);
+        CHECK(st.st_size == 0);
+
+        // 同一个句柄上的下一次查询替换之前的结果
+        const off_t next = static_cast<off_t>(weather.size() + result.size());
+        CHECK(write_str(handler, path, redis, next, &second) ==
+              static_cast<int>(redis.size()));
+        CHECK(read_str(handler, path, next + redis.size(), &second)
+                  .rfind("a\t0\tUSER\t", 0) == 0);
+
+        // 关闭后句柄的结果被释放
+        handler.release(path, &first);
+        handler.release(path, &second);
+        read_str(handler, path, 0, &first, &res);
+        CHECK(res == -EBADF);
+    }
+
+    SUBCASE("_stats 报告旧轮次压缩前后的字节数") {
+        HistoryCompressor::Options options;
+        options.keep_turns = 2;
+        sessions.set_history_compressor(
+            std::make_shared<HistoryCompressor>(options));
+        SessionImage image;
+        image.id = "long";
+        auto ts = std::chrono::system_clock::now();
+        for (int i = 0; i < 500; i++) {
+            image.history.push_back({Message::Role::User,
+                                     "问题" + std::to_string(i) +
+                                         std::string(200, 'q'),
+                                     ts});
+            image.history.push_back(
+                {Message::Role::AI, "回答" + std::to_string(i), ts});
+        }
+        REQUIRE(sessions.restore_session(image) != nullptr);
+
+        const char *path = "/conversations/_stats";
+        struct stat st;
+        REQUIRE(handler.getattr(path, &st, nullptr) == 0);
+        CHECK((st.st_mode & 0777) == 0444);
+        int res = -1;
+        auto fi = open_file(handler, path, O_RDONLY, &res);
+        REQUIRE(res == 0);
+        open_file(handler, path, O_WRONLY, &res);
+        CHECK(res == -EACCES);
+
+        const auto stats = read_str(handler, path, 0, &fi);
+        CHECK(stat_value(stats, "sessions", "resident") == 1);
+        const double raw = stat_value(stats, "history", "raw_bytes");
+        const double compressed =
+            stat_value(stats, "history", "compressed_bytes");
+        CHECK(compressed > 0);
+        CHECK(compressed < raw);
+        CHECK(stat_value(stats, "history", "ratio") ==
+              doctest::Approx(raw / compressed));
+    }
+
+    SUBCASE("_stats 报告大段文本的去重比例") {
+        // 三个会话共用同一段上下文，只存一份
+        const std::string context(64 << 10, 'c');
+        for (const char *id : {"x", "y", "z"}) {
+            REQUIRE(handler.mkdir(("/conversations/" + std::string(id)).c_str(),
+                                  0755) == 0);
+            sessions.find_session(id)->set_context(context);
+        }
+
+        const char *path = "/conversations/_stats";
+        int res = -1;
+        auto fi = open_file(handler, path, O_RDONLY, &res);
+        REQUIRE(res == 0);
+        const auto stats = read_str(handler, path, 0, &fi);
+        const double stored = stat_value(stats, "blobs", "stored_bytes");
+        const double logical = stat_value(stats, "blobs", "logical_bytes");
+        CHECK(logical >= stored + 2 * context.size());
+        CHECK(stat_value(stats, "blobs", "dedupe_ratio") ==
+              doctest::Approx(logical / stored));
+    }
+
+    SUBCASE("context 支持追加、按偏移写入和截断") {
+        REQUIRE(handler.mkdir("/conversations/ctx", 0755) == 0);
+        const char *path = "/conversations/ctx/context";
+        struct stat st;
+
+        // echo abc > context
+        int res = -1;
+        auto fi = open_file(handler, path, O_WRONLY | O_TRUNC, &res);
+        REQUIRE(res == 0);
+        CHECK(write_str(handler, path, "abc\n", 0, &fi) == 4);
+
+        // cat >> context：内核按 getattr 报告的大小追加
+        REQUIRE(handler.getattr(path, &st, nullptr) == 0);
+        CHECK(st.st_size == 4);
+        fi = open_file(handler, path, O_WRONLY | O_APPEND, &res);
+        REQUIRE(res == 0);
+        CHECK(write_str(handler, path, "def\n", st.st_size, &fi) == 4);
+        CHECK(read_str(handler, path, 0, &fi) == "abc\ndef\n");
+
+        // 在中间覆盖，以及越过末尾写入时用 NUL 补齐
+        CHECK(write_str(handler, path, "XY", 1, &fi) == 2);
+        CHECK(read_str(handler, path, 0, &fi) == "aXY\ndef\n");
+        CHECK(write_str(handler, path, "!", 10, &fi) == 1);
+        CHECK(read_str(handler, path, 0, &fi) ==
+              std::string("aXY\ndef\n\0\0!", 11));
+        CHECK(read_str(handler, path, 4, &fi) ==
+              std::string("def\n\0\0!", 7));
+
+        // truncate 缩短或延长
+        CHECK(handler.truncate(path, 3, nullptr) == 0);
+        CHECK(read_str(handler, path, 0, &fi) == "aXY");
+        CHECK(handler.truncate(path, 5, nullptr) == 0);
+        CHECK(read_str(handler, path, 0, &fi) == std::string("aXY\0\0", 5));
+        REQUIRE(handler.getattr(path, &st, nullptr) == 0);
+        CHECK(st.st_size == 5);
+        CHECK(handler.truncate(path, -1, nullptr) == -EINVAL);
+
+        // 以 O_TRUNC 打开（echo > context）清空上下文
+        fi = open_file(handler, path, O_WRONLY | O_TRUNC, &res);
+        REQUIRE(res == 0);
+        REQUIRE(handler.getattr(path, &st, nullptr) == 0);
+        CHECK(st.st_size == 0);
+        CHECK(write_str(handler, path, "new", 0, &fi) == 3);
+        CHECK(read_str(handler, path, 0, &fi) == "new");
+        CHECK(sessions.find_session("ctx")->get_context() == "new");
+
+        // 其他文件只能整体替换，不能追加；history 只读
+        CHECK(write_str(handler, "/conversations/ctx/config/model", "m", 1,
+                        &fi) == -EPERM);
+        CHECK(handler.truncate("/conversations/ctx/history", 0, nullptr) ==
+              -EACCES);
+        CHECK(handler.truncate("/conversations/ctx/config/model", 0,
+                               nullptr) == 0);
+        CHECK(handler.truncate("/conversations/missing/context", 0,
+                               nullptr) == -ENOENT);
+    }
+
+    SUBCASE("mkdir new@base 派生会话") {
+        REQUIRE(handler.mkdir("/conversations/base", 0755) == 0);
+        sessions.find_session("base")->populate("问题", "回答");
+        struct stat st;
+
+        REQUIRE(handler.mkdir("/conversations/new@base", 0755) == 0);
+        auto fork = sessions.find_session("new");
+        REQUIRE(fork != nullptr);
+        CHECK(fork->get_latest_response() == "回答");
+        CHECK(sessions.find_session("new@base") == nullptr);
+
+        // 派生后两者各自发展
+        fork->populate("另一个问题", "另一个回答");
+        CHECK(sessions.find_session("base")->get_latest_response() == "回答");
+
+        // mkdir 之后内核会查找 new@base：只有派生出的目录本身应答
+        REQUIRE(handler.getattr("/conversations/new@base", &st, nullptr) == 0);
+        CHECK((st.st_mode & S_IFMT) == S_IFDIR);
+        CHECK(handler.getattr("/conversations/new@base/llm", &st, nullptr) ==
+              -ENOENT);
+        // 没有在派生的 x@y 名字不存在
+        CHECK(handler.getattr("/conversations/other@base", &st, nullptr) ==
+              -ENOENT);
+        CHECK(handler.getattr("/conversations/x@y", &st, nullptr) == -ENOENT);
+
+        // 基础会话不存在、目标已存在、名字不完整
+        CHECK(handler.mkdir("/conversations/orphan@missing", 0755) == -ENOENT);
+        CHECK(sessions.find_session("orphan") == nullptr);
+        CHECK(handler.mkdir("/conversations/new@base", 0755) == -EEXIST);
+        CHECK(handler.mkdir("/conversations/@base", 0755) == -EINVAL);
+        CHECK(handler.mkdir("/conversations/x@", 0755) == -EINVAL);
+        CHECK(handler.mkdir("/conversations/latest@base", 0755) == -EINVAL);
+
+        // base 可以是 latest
+        sessions.set_latest_session_id("base");
+        REQUIRE(handler.mkdir("/conversations/copy@latest", 0755) == 0);
+        CHECK(sessions.find_session("copy")->get_latest_response() == "回答");
+    }
+}
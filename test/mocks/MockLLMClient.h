@@ -2,7 +2,11 @@
 
 #include "../../src/services/LLMClient.h"
 #include "../../src/config/ConfigManager.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace fusellm {
@@ -24,21 +28,35 @@ public:
     explicit MockLLMClient(const fusellm::ConfigManager &config_manager)
         : fusellm::LLMClient(config_manager) {
         // 初始化模拟的模型列表
-        model_list = {"model-1", "model-2", "model-3", "test-model"};
+        set_models({"model-1", "model-2", "model-3", "test-model"});
     }
     
     /**
      * @brief 重载会话查询方法，返回固定响应
+     *
+     * hold 为真时请求一直挂起，直到 hold 被清除或令牌被取消，
+     * 用于让提示停留在队列中。被取消的请求返回空字符串。
      */
     std::string conversation_query(std::string_view model_name,
-                                   const fusellm::ConfigManager &config_manager,
-                                   const fusellm::Conversation &conversation) {
+                                   const fusellm::ModelParameters &params,
+                                   const fusellm::Conversation &conversation,
+                                   fusellm::CancelToken *cancel = nullptr) override {
+        while (hold && !(cancel && cancel->is_cancelled())) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (cancel && cancel->is_cancelled()) {
+            return "";
+        }
+        std::lock_guard<std::mutex> lock(mtx);
         last_model = std::string(model_name);
         last_conversation = conversation;
         return "这是一个模拟的AI回复";
     }
     
+    std::atomic<bool> hold{false};
+
     // 存储最后一次查询的模型名称和对话，用于验证
+    std::mutex mtx;
     std::string last_model;
     fusellm::Conversation last_conversation;
 };
@@ -1,5 +1,6 @@
 #include "../../src/config/ConfigManager.h"
 #include "../../src/services/LLMClient.h"
+#include <chrono>
 #include <doctest/doctest.h>
 #include <nlohmann/json.hpp>
 
@@ -67,6 +68,30 @@ TEST_CASE("LLMClient基本功能测试") {
         CHECK(request["messages"][1]["content"] == "用户消息");
     }
 
+    SUBCASE("构建请求时带上所有请求参数") {
+        fusellm::ModelParameters params;
+        params.max_tokens = 256;
+        params.stop = fusellm::StopList{"\n\n", "END"};
+        params.seed = 42;
+        params.top_p = 0.9;
+        params.n = 2;
+        params.timeout_ms = 1000;
+        params.system_prompt = "不进入请求体";
+
+        nlohmann::json request = TestLLMClient::public_build_request_json(
+            "test-model", params, nlohmann::json::array());
+
+        CHECK(request["max_tokens"] == 256);
+        CHECK(request["stop"] == nlohmann::json::array({"\n\n", "END"}));
+        CHECK(request["seed"] == 42);
+        CHECK(request["top_p"] == doctest::Approx(0.9));
+        CHECK(request["n"] == 2);
+        // 本地参数不发送给 API
+        CHECK_FALSE(request.contains("timeout_ms"));
+        CHECK_FALSE(request.contains("system_prompt"));
+        CHECK_FALSE(request.contains("temperature"));
+    }
+
     SUBCASE("从响应中提取内容") {
         // 创建模拟的API响应JSON
         nlohmann::json response = {
@@ -94,6 +119,26 @@ TEST_CASE("LLMClient基本功能测试") {
         CHECK(empty_content.empty());
     }
 
+    SUBCASE("取消令牌") {
+        fusellm::CancelToken token;
+        CHECK_FALSE(token.is_cancelled());
+
+        // 已过期的截止时间会以 DeadlineExceeded 触发
+        token.set_timeout(std::chrono::milliseconds(0));
+        CHECK(token.is_cancelled());
+        CHECK(token.reason() == fusellm::CancelToken::Reason::DeadlineExceeded);
+
+        // 第一个触发原因会被锁定
+        token.cancel(fusellm::CancelToken::Reason::Interrupted);
+        CHECK(token.reason() == fusellm::CancelToken::Reason::DeadlineExceeded);
+
+        // 中断探针
+        fusellm::CancelToken interrupted;
+        interrupted.set_interrupt_probe([] { return true; });
+        CHECK(interrupted.is_cancelled());
+        CHECK(interrupted.reason() == fusellm::CancelToken::Reason::Interrupted);
+    }
+
     // 注意：完整测试应当包含对简单查询和会话查询的测试
     // 但这需要模拟OpenAI API的响应，这超出了基本单元测试的范围
     // 下面是如何扩展这些测试的建议：
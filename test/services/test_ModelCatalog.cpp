@@ -0,0 +1,50 @@
+#include "../../src/services/ModelCatalog.h"
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+TEST_CASE("ModelCatalog基本功能测试") {
+    using fusellm::ModelCatalog;
+
+    SUBCASE("发布与查询快照") {
+        ModelCatalog catalog;
+        CHECK(catalog.snapshot()->names.empty());
+        CHECK_FALSE(catalog.contains("model-1"));
+
+        catalog.publish({"model-1", "model-2"});
+        auto first = catalog.snapshot();
+        CHECK(first->names.size() == 2);
+        CHECK(catalog.contains("model-1"));
+        CHECK(catalog.contains("model-2"));
+        CHECK_FALSE(catalog.contains("model-3"));
+
+        // 新的发布不会影响已持有的旧快照（写时复制）
+        catalog.publish({"model-3"});
+        CHECK(catalog.contains("model-3"));
+        CHECK_FALSE(catalog.contains("model-1"));
+        CHECK(first->contains("model-1"));
+        CHECK(catalog.snapshot()->version > first->version);
+    }
+
+    SUBCASE("缓存文件读写") {
+        auto path = (std::filesystem::temp_directory_path() /
+                     "fusellm-test-models.json")
+                        .string();
+        std::filesystem::remove(path);
+
+        CHECK_FALSE(ModelCatalog::load_cache(path, "http://a/").has_value());
+
+        std::vector<std::string> names = {"model-1", "model-2"};
+        CHECK(ModelCatalog::save_cache(path, "http://a/", names));
+
+        auto loaded = ModelCatalog::load_cache(path, "http://a/");
+        REQUIRE(loaded.has_value());
+        CHECK(*loaded == names);
+
+        // 其他服务商的缓存会被忽略
+        CHECK_FALSE(ModelCatalog::load_cache(path, "http://b/").has_value());
+
+        std::filesystem::remove(path);
+    }
+}
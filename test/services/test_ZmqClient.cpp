@@ -1,40 +1,194 @@
 #include "../../src/services/ZmqClient.h"
 #include <doctest/doctest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <string>
+#include <thread>
+#include <vector>
+#include <zmq_addon.hpp>
 
 // 注意：ZmqClient依赖ZeroMQ网络通信，和LLMClient类似，
-// 完整测试需要模拟网络行为，这里主要测试基本逻辑
+// 这里用同进程内的 ROUTER 套接字模拟服务端
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const std::string TEST_ENDPOINT = "ipc:///tmp/fusellm-test-zmq.ipc";
+
+// 模拟的服务端：ping 立即回复，其他请求回复 "<op>:<payload>"。
+// hold > 0 时先攒够 hold 个请求，再按相反顺序回复；
+// mute 为真时不回复任何消息，模拟卡死的后端。
+class TestServer {
+  public:
+    explicit TestServer(size_t hold = 0) : hold_(hold) {
+        socket_.set(zmq::sockopt::linger, 0);
+        socket_.bind(TEST_ENDPOINT);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~TestServer() {
+        stop_ = true;
+        thread_.join();
+    }
+
+    std::atomic<bool> mute{false};
+
+  private:
+    void run() {
+        std::vector<zmq::multipart_t> held;
+        while (!stop_) {
+            zmq::pollitem_t items[] = {{socket_.handle(), 0, ZMQ_POLLIN, 0}};
+            zmq::poll(items, 1, 20ms);
+            if (!(items[0].revents & ZMQ_POLLIN)) {
+                continue;
+            }
+            // [客户端身份, 关联 ID, 空帧, 操作码, 载荷]
+            zmq::multipart_t request;
+            request.recv(socket_);
+            if (mute) {
+                continue;
+            }
+            if (hold_ == 0 || request.peekstr(3) == "ping") {
+                reply(request);
+                continue;
+            }
+            held.push_back(std::move(request));
+            if (held.size() == hold_) {
+                for (auto it = held.rbegin(); it != held.rend(); ++it) {
+                    reply(*it);
+                }
+                held.clear();
+            }
+        }
+    }
+
+    void reply(zmq::multipart_t &request) {
+        zmq::multipart_t reply;
+        reply.addstr(request.popstr());
+        reply.addstr(request.popstr());
+        reply.addstr(request.popstr());
+        const std::string op = request.popstr();
+        reply.addstr(op == "ping" ? R"({"status":"ok"})"
+                                  : op + ":" + request.popstr());
+        reply.send(socket_);
+    }
+
+    zmq::context_t context_;
+    zmq::socket_t socket_{context_, zmq::socket_type::router};
+    size_t hold_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+template <typename Pred> bool wait_until(Pred pred) {
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return true;
+}
+
+// 测试用的短超时
+fusellm::ZmqClientOptions fast_options() {
+    fusellm::ZmqClientOptions options;
+    options.request_timeout = 300ms;
+    options.heartbeat_interval = 50ms;
+    options.retry_min = 50ms;
+    options.retry_max = 200ms;
+    return options;
+}
+
+} // namespace
 
 TEST_CASE("ZmqClient基本功能测试") {
     using fusellm::ZmqClient;
 
-    // 创建ZmqClient实例
-    ZmqClient client;
+    SUBCASE("未连接时返回错误") {
+        ZmqClient client;
+        CHECK_FALSE(client.available());
+        CHECK(client.send_request("list_indexes", "{}").find("error") !=
+              std::string::npos);
+    }
 
     // 测试连接方法 - 注意这不会实际建立连接，除非有服务在监听
     // 这里只是验证方法调用不会抛出异常
     SUBCASE("连接方法调用测试") {
+        ZmqClient client;
         CHECK_NOTHROW(client.connect("inproc://test"));
     }
 
-    // 注意：完整测试需要模拟ZeroMQ服务器
-    // 下面是一些可能的测试场景，但需要更复杂的设置：
-    /*
-    SUBCASE("发送请求测试 - 需要模拟服务器") {
-        // 需要设置模拟的ZMQ REP服务器
-        // 然后测试send_request方法
-        // 验证请求正确发送并处理响应
+    SUBCASE("并发请求按关联 ID 分发回复") {
+        // 服务端要等两个请求都到达才回复，且回复顺序与请求相反；
+        // 串行的客户端会在这里卡住直到超时
+        TestServer server(2);
+        ZmqClient client;
+        client.connect(TEST_ENDPOINT);
+
+        auto first = std::async(std::launch::async, [&] {
+            return client.send_request("query", "a");
+        });
+        auto second = std::async(std::launch::async, [&] {
+            return client.send_request("list_indexes", "b");
+        });
+        CHECK(first.get() == "query:a");
+        CHECK(second.get() == "list_indexes:b");
+        CHECK(client.health() == ZmqClient::Health::Up);
+    }
+
+    SUBCASE("后端失联时快速失败，恢复后自动重连") {
+        ZmqClient client(fast_options());
+        client.connect(TEST_ENDPOINT);
+        // 没有服务端：心跳得不到回复
+        REQUIRE(wait_until(
+            [&] { return client.health() == ZmqClient::Health::Down; }));
+        CHECK_FALSE(client.available());
+
+        const auto started = std::chrono::steady_clock::now();
+        CHECK(client.send_request("query", "x").find("unavailable") !=
+              std::string::npos);
+        CHECK(std::chrono::steady_clock::now() - started < 100ms);
+
+        TestServer server;
+        REQUIRE(wait_until(
+            [&] { return client.health() == ZmqClient::Health::Up; }));
+        CHECK(client.send_request("query", "y") == "query:y");
     }
 
-    SUBCASE("错误处理测试") {
-        // 测试当服务不可用时的错误处理
-        // 测试超时情况
-        // 测试无效的响应格式
+    SUBCASE("慢请求只让自己超时，心跳照常得到回复") {
+        // 单个请求一直得不到回复，但服务端照常回答心跳
+        TestServer server(2);
+        ZmqClient client(fast_options());
+        client.connect(TEST_ENDPOINT);
+        REQUIRE(wait_until(
+            [&] { return client.health() == ZmqClient::Health::Up; }));
+
+        CHECK(client.send_request("add_document", "slow").find("timed out") !=
+              std::string::npos);
+        std::this_thread::sleep_for(400ms);
+        CHECK(client.health() == ZmqClient::Health::Up);
     }
 
-    SUBCASE("并发请求测试") {
-        // 测试多线程环境下的线程安全性
-        // 验证互斥锁正确保护socket访问
+    SUBCASE("请求超时后套接字被重建，之后的请求照常工作") {
+        TestServer server;
+        ZmqClient client(fast_options());
+        client.connect(TEST_ENDPOINT);
+        CHECK(client.send_request("query", "a") == "query:a");
+
+        // 心跳也得不到回复时才判定失联
+        server.mute = true;
+        CHECK(client.send_request("add_document", "slow").find("error") !=
+              std::string::npos);
+        REQUIRE(wait_until(
+            [&] { return client.health() == ZmqClient::Health::Down; }));
+
+        server.mute = false;
+        REQUIRE(wait_until(
+            [&] { return client.health() == ZmqClient::Health::Up; }));
+        CHECK(client.send_request("query", "b") == "query:b");
     }
-    */
 }
@@ -0,0 +1,98 @@
+// SessionManager 查找吞吐量基准测试
+//
+// 模拟 FUSE 工作线程的访问模式：绝大多数操作是按 ID 查找会话
+// (getattr/read/write)，外加少量 latest 解析。输出 1~64 线程下的
+// lookups/s，用于观察分片锁的扩展性。
+//
+// 用法: fusellm_session_bench [会话数量] [每个线程的持续时间(ms)]
+
+#include "../../src/state/SessionManager.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fusellm;
+
+namespace {
+
+struct BenchResult {
+    uint64_t lookups;
+    double seconds;
+};
+
+BenchResult run(SessionManager &manager, const std::vector<std::string> &ids,
+                int threads, std::chrono::milliseconds duration) {
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            // 每个线程从不同位置开始，步长为质数，避免所有线程同步命中同一分片
+            size_t idx = static_cast<size_t>(t) * 7919 % ids.size();
+            uint64_t local = 0;
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; i++) {
+                    if ((local & 15) == 0) {
+                        manager.find_latest_session();
+                    } else {
+                        manager.find_session(ids[idx]);
+                    }
+                    idx += 104729;
+                    idx %= ids.size();
+                    local++;
+                }
+            }
+            total.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop.store(true);
+    for (auto &w : workers) {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    return {total.load(), elapsed.count()};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    size_t session_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    long duration_ms = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 1000;
+    if (session_count == 0) {
+        session_count = 1;
+    }
+
+    ConfigManager config;
+    SessionManager manager(config);
+    std::vector<std::string> ids;
+    ids.reserve(session_count);
+    for (size_t i = 0; i < session_count; i++) {
+        ids.push_back(manager.create_session_with_auto_id()->get_id());
+    }
+    manager.set_latest_session_id(ids.front());
+
+    std::printf("%zu sessions, %ld ms per run\n", session_count, duration_ms);
+    std::printf("%8s %16s %16s\n", "threads", "lookups/s", "per thread");
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        auto r = run(manager, ids, threads,
+                     std::chrono::milliseconds(duration_ms));
+        double rate = r.lookups / r.seconds;
+        std::printf("%8d %16.0f %16.0f\n", threads, rate, rate / threads);
+    }
+    return 0;
+}
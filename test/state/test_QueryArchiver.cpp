@@ -0,0 +1,127 @@
+#include "../../src/state/QueryArchiver.h"
+#include <doctest/doctest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace fusellm;
+
+TEST_CASE("QueryArchiver测试") {
+    ConfigManager config;
+
+    SUBCASE("在后台归档查询并设置latest") {
+        SessionManager manager(config);
+        ArchivePolicy policy;
+        QueryArchiver archiver(manager, policy);
+        archiver.start();
+
+        CHECK(archiver.submit("model-a", "问题", "回答"));
+        archiver.flush();
+
+        auto ids = manager.list_sessions();
+        REQUIRE(ids.size() == 1);
+        CHECK(manager.get_latest_session_id() == ids[0]);
+        auto session = manager.find_session(ids[0]);
+        REQUIRE(session != nullptr);
+        CHECK(session->get_latest_response() == "回答");
+        CHECK(session->get_model() == "model-a");
+        CHECK(archiver.archived() == 1);
+    }
+
+    SUBCASE("按数量保留最新的归档") {
+        SessionManager manager(config);
+        ArchivePolicy policy;
+        policy.max_sessions = 3;
+        QueryArchiver archiver(manager, policy);
+        archiver.start();
+
+        for (int i = 0; i < 10; i++) {
+            archiver.submit("m", "问题" + std::to_string(i),
+                            "回答" + std::to_string(i));
+        }
+        archiver.flush();
+        CHECK(archiver.archived() == 3);
+        auto ids = manager.list_sessions();
+        REQUIRE(ids.size() == 3);
+        auto latest = manager.find_latest_session();
+        REQUIRE(latest != nullptr);
+        CHECK(latest->get_latest_response() == "回答9");
+    }
+
+    SUBCASE("按时间回收，继续过的对话不回收") {
+        SessionManager manager(config);
+        auto old = std::chrono::system_clock::now() - std::chrono::hours(2);
+        auto restore = [&](const std::string &id, int turns,
+                           std::chrono::system_clock::time_point ts) {
+            SessionImage image;
+            image.id = id;
+            for (int i = 0; i < turns; i++) {
+                image.history.push_back({Message::Role::User, "问", ts});
+                image.history.push_back({Message::Role::AI, "答", ts});
+            }
+            manager.restore_session(std::move(image));
+        };
+        restore("query-1000", 1, old); // 过期的归档
+        restore("query-1001", 2, old); // 继续过的对话
+        restore("query-1002", 1, std::chrono::system_clock::now()); // 新归档
+        restore("999", 1, old); // 数字 ID 的普通会话不是归档
+
+        ArchivePolicy policy;
+        policy.max_sessions = 0;
+        policy.max_age = std::chrono::hours(1);
+        QueryArchiver archiver(manager, policy);
+        archiver.start();
+        archiver.submit("m", "问题", "回答");
+        archiver.flush();
+        archiver.stop();
+
+        CHECK(manager.find_session("query-1000") == nullptr);
+        CHECK(manager.find_session("query-1001") != nullptr);
+        CHECK(manager.find_session("query-1002") != nullptr);
+        CHECK(manager.find_session("999") != nullptr);
+        CHECK(manager.list_sessions().size() == 4);
+        CHECK(archiver.archived() == 2);
+        // 新归档的编号接在恢复的归档之后
+        CHECK(manager.get_latest_session_id() == "query-1003");
+    }
+
+    SUBCASE("重启后接管已有的归档，并保留手动创建的会话") {
+        SessionManager manager(config);
+        manager.create_session("notes")->populate("问", "答");
+        for (int i = 0; i < 5; i++) {
+            manager.create_session_with_auto_id(QueryArchiver::ARCHIVE_PREFIX)
+                ->populate("问", "答");
+        }
+        // 只有一轮对话的数字 ID 会话也不是归档
+        manager.create_session("42")->populate("问", "答");
+        manager.create_session_with_auto_id()->populate("问", "答");
+
+        ArchivePolicy policy;
+        policy.max_sessions = 2;
+        QueryArchiver archiver(manager, policy);
+        archiver.start();
+        archiver.flush();
+        archiver.stop();
+
+        CHECK(archiver.archived() == 2);
+        auto ids = manager.list_sessions();
+        CHECK(ids.size() == 5);
+        CHECK(manager.find_session("notes") != nullptr);
+        CHECK(manager.find_session("42") != nullptr);
+        // 保留的是最新的两个归档
+        CHECK(manager.find_session("query-1000") == nullptr);
+        CHECK(manager.find_session("query-1003") != nullptr);
+        CHECK(manager.find_session("query-1004") != nullptr);
+    }
+
+    SUBCASE("禁用归档") {
+        SessionManager manager(config);
+        ArchivePolicy policy;
+        policy.enabled = false;
+        QueryArchiver archiver(manager, policy);
+        archiver.start();
+        CHECK_FALSE(archiver.submit("m", "问题", "回答"));
+        archiver.flush();
+        CHECK(manager.list_sessions().empty());
+    }
+}
@@ -0,0 +1,141 @@
+#include "../../src/state/SearchIndex.h"
+#include <doctest/doctest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace fusellm;
+
+namespace {
+
+using Terms = std::vector<std::string>;
+
+History make_history(const std::vector<std::string> &contents) {
+    History history;
+    const auto now = std::chrono::system_clock::now();
+    for (size_t i = 0; i < contents.size(); i++) {
+        history = history.append(
+            i % 2 == 0 ? Message::Role::User : Message::Role::AI,
+            contents[i], now);
+    }
+    return history;
+}
+
+// 命中结果写成 "会话:位置"，便于比较
+std::vector<std::string> hits(const SearchIndex &index, std::string_view query,
+                              size_t limit = 100) {
+    std::vector<std::string> result;
+    for (const auto &match : index.search(query, limit)) {
+        result.push_back(match.session_id + ":" +
+                         std::to_string(match.message));
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("SearchIndex测试") {
+    SUBCASE("中英文混合分词") {
+        CHECK(SearchIndex::terms("Hello, hello World_2!") ==
+              Terms({"hello", "world_2"}));
+        // 中文逐字成词，标点被忽略
+        CHECK(SearchIndex::terms("缓存，失效。cache") ==
+              Terms({"缓", "存", "失", "效", "cache"}));
+        CHECK(SearchIndex::terms("  ...  ").empty());
+        CHECK(SearchIndex::terms(std::string(100, 'a')) ==
+              Terms({std::string(64, 'a')}));
+    }
+
+    SUBCASE("多个词取交集") {
+        SearchIndex index;
+        index.add("a", make_history({"Redis cache miss", "调整缓存大小",
+                                     "cache hit"}));
+        index.add("b", make_history({"no match here", "redis 缓存"}));
+
+        CHECK(hits(index, "cache") == Terms({"a:0", "a:2"}));
+        CHECK(hits(index, "REDIS cache") == Terms({"a:0"}));
+        CHECK(hits(index, "缓存") == Terms({"a:1", "b:1"}));
+        CHECK(hits(index, "缓存 redis") == Terms({"b:1"}));
+        CHECK(hits(index, "cache absent").empty());
+        CHECK(hits(index, "").empty());
+        CHECK(hits(index, "缓存", 1) == Terms({"a:1"}));
+    }
+
+    SUBCASE("只索引用户和AI消息") {
+        SearchIndex index;
+        const auto now = std::chrono::system_clock::now();
+        History history;
+        history = history.append(Message::Role::System, "system prompt", now);
+        history = history.append(Message::Role::User, "user prompt", now);
+        index.add("a", history);
+
+        // 系统消息占据位置，但不会命中，也不占用结果数量
+        CHECK(hits(index, "prompt", 1) == Terms({"a:1"}));
+        CHECK(hits(index, "system").empty());
+        CHECK(index.stats().messages == 2);
+    }
+
+    SUBCASE("增量追加、截断、替换和删除") {
+        SearchIndex index;
+        auto history = make_history({"first question", "first answer"});
+        index.add("a", history);
+        // 同样长度的历史再次加入时不重复建索引
+        index.add("a", history);
+        CHECK(index.stats().messages == 2);
+
+        auto longer = history.append(Message::Role::User, "second question",
+                                     std::chrono::system_clock::now());
+        index.append("a", longer, 2);
+        CHECK(hits(index, "question") == Terms({"a:0", "a:2"}));
+
+        index.truncate("a", 1);
+        CHECK(hits(index, "question") == Terms({"a:0"}));
+        CHECK(hits(index, "answer").empty());
+        CHECK(index.stats().messages == 1);
+
+        // 位置对不上时追加退化为替换
+        index.append("a", longer, 2);
+        CHECK(hits(index, "question") == Terms({"a:0", "a:2"}));
+        CHECK(index.stats().messages == 3);
+
+        index.replace("a", make_history({"something else"}));
+        CHECK(hits(index, "question").empty());
+        CHECK(hits(index, "else") == Terms({"a:0"}));
+
+        index.remove("a");
+        CHECK(hits(index, "else").empty());
+        const auto stats = index.stats();
+        CHECK(stats.sessions == 0);
+        CHECK(stats.messages == 0);
+        CHECK(stats.postings == 0);
+
+        // 删除后空出的位置被新会话复用
+        index.add("b", make_history({"else"}));
+        CHECK(hits(index, "else") == Terms({"b:0"}));
+    }
+
+    SUBCASE("大量消息下的查询") {
+        SearchIndex index;
+        constexpr size_t SESSIONS = 200;
+        constexpr size_t MESSAGES = 1000;
+        for (size_t s = 0; s < SESSIONS; s++) {
+            std::vector<std::string> contents;
+            for (size_t m = 0; m < MESSAGES; m++) {
+                contents.push_back("message " + std::to_string(m) +
+                                   " in session " + std::to_string(s) +
+                                   (m == 500 && s == 150 ? " 罕见词" : ""));
+            }
+            index.add("s" + std::to_string(s), make_history(contents));
+        }
+        CHECK(index.stats().messages == SESSIONS * MESSAGES);
+
+        const auto started = std::chrono::steady_clock::now();
+        CHECK(hits(index, "罕见词 session") == Terms({"s150:500"}));
+        // 第7个会话的第42条和第42个会话的第7条都含有这四个词
+        CHECK(hits(index, "message 42 session 7") ==
+              Terms({"s7:42", "s42:7"}));
+        CHECK(index.search("message", 100).size() == 100);
+        const auto elapsed = std::chrono::steady_clock::now() - started;
+        CHECK(elapsed < std::chrono::milliseconds(500));
+    }
+}
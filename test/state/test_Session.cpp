@@ -2,13 +2,18 @@
 #include "../../src/state/Session.h"
 #include "../mocks/MockLLMClient.h"
 #include <doctest/doctest.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 // 模拟ConfigManager，避免实际网络请求
 class MockConfigManager : public fusellm::ConfigManager {
   public:
     MockConfigManager() {
-        default_model_ = "deepseek-v3";
+        set_default_model("deepseek-v3");
         api_key_ = "test-key";
         base_url_ = "http://test-url/";
     }
@@ -67,6 +72,32 @@ TEST_CASE("Session基本功能测试") {
         CHECK(settings.system_prompt.value() == "测试系统提示");
     }
 
+    SUBCASE("生效参数缓存到配置或会话设置变化为止") {
+        fusellm::Session session("test-session-id", config);
+        auto first = session.settings();
+        CHECK(session.settings() == first); // 缓存命中，同一个对象
+
+        // 模型专属配置变化后，会话重新解析参数
+        auto tbl = toml::parse("temperature = 0.4\ntimeout_ms = 900\n");
+        REQUIRE(config.update_model_params(session.get_model(), tbl));
+        auto second = session.settings();
+        CHECK(second != first);
+        CHECK(second->temperature.value() == doctest::Approx(0.4));
+
+        // 会话自己的设置覆盖配置中的值
+        fusellm::ModelParameters params;
+        params.temperature = 1.2;
+        session.set_settings(params);
+        auto third = session.settings();
+        CHECK(third->temperature.value() == doctest::Approx(1.2));
+        CHECK(third->timeout_ms.value() == 900);
+
+        // 换到没有专属配置的模型时只剩会话设置
+        session.set_model("another-model");
+        CHECK_FALSE(session.settings()->timeout_ms.has_value());
+        CHECK(session.settings()->temperature.value() == doctest::Approx(1.2));
+    }
+
     SUBCASE("添加提示语并获取回复") {
         fusellm::Session session("test-session-id", config);
         fusellm::testing::MockLLMClient llm_client(config);
@@ -85,6 +116,23 @@ TEST_CASE("Session基本功能测试") {
         CHECK(history.find(response) != std::string::npos);
     }
 
+    SUBCASE("取消的请求会回滚历史") {
+        fusellm::Session session("test-session-id", config);
+        fusellm::testing::MockLLMClient llm_client(config);
+
+        // 预先取消的令牌：请求不会被发送，用户消息应被回滚
+        fusellm::CancelToken cancel;
+        cancel.cancel();
+        std::string response =
+            session.add_prompt("被取消的提示", llm_client, &cancel);
+
+        CHECK(response.empty());
+        CHECK(cancel.reason() == fusellm::CancelToken::Reason::Cancelled);
+        CHECK(session.get_formatted_history().find("被取消的提示") ==
+              std::string::npos);
+        CHECK(session.get_latest_response().empty());
+    }
+
     SUBCASE("会话历史格式化") {
         fusellm::Session session("test-session-id", config);
 
@@ -122,4 +170,128 @@ TEST_CASE("Session基本功能测试") {
         CHECK(history.find("测试用户消息") != std::string::npos);
         CHECK(history.find("测试AI回复") != std::string::npos);
     }
+
+    SUBCASE("快照是不可变的版本") {
+        fusellm::Session session("test-session-id", config);
+        session.populate("问题", "回答");
+
+        auto before = session.snapshot();
+        session.set_context("新的上下文");
+        session.set_model("another-model");
+        auto after = session.snapshot();
+
+        // 旧快照不受后续写入影响
+        CHECK(before->context.empty());
+        CHECK(before->model_name != "another-model");
+        CHECK(after->version == before->version + 2);
+        CHECK(after->context == "新的上下文");
+        CHECK(after->model_name == "another-model");
+        // 未修改的历史在版本之间共享，而不是复制
+        CHECK(after->history.same_as(before->history));
+        CHECK_FALSE(after->prompt_pending);
+    }
+
+    SUBCASE("并发提示按提交顺序处理，取消的提示被回滚") {
+        fusellm::Session session("test-session-id", config);
+        fusellm::testing::MockLLMClient llm_client(config);
+        session.populate("问题", "回答");
+
+        // 挂起模型，让所有提示都停留在队列中；逐个提交以确定顺序
+        llm_client.hold = true;
+        constexpr int N = 5;
+        std::vector<fusellm::CancelToken> tokens(N);
+        std::vector<std::string> responses(N);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < N; i++) {
+            workers.emplace_back([&, i] {
+                responses[i] = session.add_prompt(
+                    "并发提示" + std::to_string(i), llm_client, &tokens[i]);
+            });
+            while (session.queue_length() < static_cast<size_t>(i + 1)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        // 取消第 1、3 个（仍在排队中），其余放行
+        tokens[1].cancel();
+        tokens[3].cancel();
+        while (session.queue_length() > 3) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        llm_client.hold = false;
+        for (auto &w : workers) {
+            w.join();
+        }
+
+        CHECK(responses[0] == "这是一个模拟的AI回复");
+        CHECK(responses[1].empty());
+        CHECK(responses[2] == "这是一个模拟的AI回复");
+        CHECK(responses[3].empty());
+        CHECK(responses[4] == "这是一个模拟的AI回复");
+
+        // 完成的提示按提交顺序出现在历史中，每条后面紧跟它的回复
+        auto snap = session.snapshot();
+        REQUIRE(snap->history.size() == 8);
+        const char *expected[] = {"问题", "回答",
+                                  "并发提示0", "这是一个模拟的AI回复",
+                                  "并发提示2", "这是一个模拟的AI回复",
+                                  "并发提示4", "这是一个模拟的AI回复"};
+        for (size_t i = 0; i < snap->history.size(); i++) {
+            const auto entry = snap->history[i];
+            CHECK(std::string(entry.content) == expected[i]);
+            CHECK(entry.role == (i % 2 == 0 ? fusellm::Message::Role::User
+                                            : fusellm::Message::Role::AI));
+        }
+        CHECK_FALSE(snap->prompt_pending);
+        CHECK(session.queue_length() == 0);
+    }
+
+    SUBCASE("提示队列非阻塞入队并按顺序清空") {
+        fusellm::Session session("test-session-id", config);
+        fusellm::testing::MockLLMClient llm_client(config);
+        llm_client.hold = true; // 第一轮一直挂起，直到测试放行
+
+        // 入队不等待 LLM：模拟请求还挂着时就已返回
+        auto tickets =
+            session.enqueue_prompts({"第一轮", "第二轮", "第三轮"}, llm_client);
+        REQUIRE(tickets.size() == 3);
+        CHECK(tickets[0] < tickets[1]);
+        CHECK(tickets[1] < tickets[2]);
+        CHECK(session.queue_length() == 3);
+        CHECK_FALSE(session.get_formatted_queue().empty());
+
+        llm_client.hold = false;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (session.queue_length() > 0 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(session.queue_length() == 0);
+        CHECK(session.get_formatted_queue().empty());
+
+        // 三轮都按提交顺序完整写入历史
+        auto snap = session.snapshot();
+        CHECK_FALSE(snap->prompt_pending);
+        REQUIRE(snap->history.size() == 6);
+        const char *prompts[] = {"第一轮", "第二轮", "第三轮"};
+        for (size_t i = 0; i < 3; i++) {
+            CHECK(snap->history[2 * i].role == fusellm::Message::Role::User);
+            CHECK(snap->history[2 * i].content == prompts[i]);
+            CHECK(snap->history[2 * i + 1].role == fusellm::Message::Role::AI);
+            CHECK(snap->history[2 * i + 1].content == "这是一个模拟的AI回复");
+        }
+        // 最后一轮看到了前两轮的问答
+        std::lock_guard<std::mutex> lock(llm_client.mtx);
+        REQUIRE(llm_client.last_conversation.history.size() == 5);
+        CHECK(llm_client.last_conversation.history[4].content == "第三轮");
+    }
+
+    SUBCASE("销毁会话时丢弃排队的提示") {
+        fusellm::testing::MockLLMClient llm_client(config);
+        auto session =
+            std::make_unique<fusellm::Session>("test-session-id", config);
+        session->enqueue_prompts({"a", "b", "c", "d"}, llm_client);
+        session.reset(); // 不应挂起或崩溃
+        CHECK(session == nullptr);
+    }
 }
@@ -1,8 +1,15 @@
 #include "../../src/state/SessionManager.h"
 #include <doctest/doctest.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
 
 using namespace fusellm;
 
@@ -12,6 +19,59 @@ public:
     MockConfigManager() : ConfigManager() {}
 };
 
+// 按需加载的内存存储，模拟 Redis 这类惰性后端
+class MockLazyStore : public SessionStore {
+public:
+    uint64_t append(const SessionRecord &record) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (record.type == SessionRecord::Type::Create) {
+            images[record.session_id].id = record.session_id;
+        } else if (record.type == SessionRecord::Type::Remove) {
+            images.erase(record.session_id);
+        } else if (images.count(record.session_id)) {
+            images[record.session_id].apply(record, next_lsn);
+        }
+        return next_lsn++;
+    }
+    bool sync(uint64_t) override { return true; }
+    std::vector<SessionImage> load_all() override { return {}; }
+    bool lazy() const override { return true; }
+    Lookup load(std::string_view id, SessionImage &image) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!reachable) {
+            return Lookup::Unavailable;
+        }
+        loads++;
+        auto it = images.find(std::string(id));
+        if (it == images.end()) {
+            return Lookup::Missing;
+        }
+        image = it->second;
+        return Lookup::Found;
+    }
+    Lookup contains(std::string_view id) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!reachable) {
+            return Lookup::Unavailable;
+        }
+        return images.count(std::string(id)) ? Lookup::Found : Lookup::Missing;
+    }
+    std::vector<std::string> list_ids() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::string> ids;
+        for (const auto &pair : images) {
+            ids.push_back(pair.first);
+        }
+        return ids;
+    }
+
+    std::mutex mtx;
+    std::map<std::string, SessionImage> images;
+    uint64_t next_lsn = 1;
+    int loads = 0;
+    bool reachable = true;
+};
+
 TEST_CASE("SessionManager基本功能测试") {
     // 准备一个ConfigManager实例以传递给SessionManager
     MockConfigManager config;
@@ -89,6 +149,115 @@ TEST_CASE("SessionManager基本功能测试") {
         CHECK_FALSE(removed);
     }
     
+    SUBCASE("按创建顺序分页列出会话") {
+        SessionManager manager(config);
+        for (int i = 0; i < 1000; i++) {
+            manager.create_session("s" + std::to_string(999 - i));
+        }
+        auto ids = manager.list_sessions();
+        REQUIRE(ids.size() == 1000);
+        CHECK(ids.front() == "s999");
+        CHECK(ids.back() == "s0");
+
+        // 翻页途中创建和删除会话，既不重复也不遗漏仍然存在的会话
+        std::vector<std::string> listed;
+        uint64_t cursor = 0;
+        while (true) {
+            auto page = manager.list_sessions_page(cursor, 100);
+            if (page.empty()) {
+                break;
+            }
+            CHECK(page.size() <= 100);
+            for (const auto &entry : page) {
+                CHECK(entry.position > cursor);
+                listed.push_back(entry.id);
+                cursor = entry.position;
+            }
+            if (listed.size() == 300) {
+                CHECK(manager.remove_session("s999")); // 已经列出
+                CHECK(manager.remove_session("s0"));   // 还没列出
+                manager.create_session("new");
+            }
+        }
+        CHECK(listed.size() == 1000);
+        CHECK(listed.front() == "s999");
+        CHECK(listed.back() == "new");
+        CHECK(std::find(listed.begin(), listed.end(), "s0") == listed.end());
+        CHECK(manager.list_sessions_page(cursor, 100).empty());
+
+        // 其他实例在惰性存储中创建或删除的会话，从头列出时才出现或消失
+        MockLazyStore store;
+        SessionManager lazy(config);
+        lazy.set_store(&store);
+        lazy.create_session("local");
+        {
+            std::lock_guard<std::mutex> lock(store.mtx);
+            store.images["remote"].id = "remote";
+        }
+        auto page = lazy.list_sessions_page(0, 10);
+        REQUIRE(page.size() == 2);
+        CHECK(page[0].id == "local");
+        CHECK(page[1].id == "remote");
+        {
+            std::lock_guard<std::mutex> lock(store.mtx);
+            store.images.erase("local");
+        }
+        CHECK(lazy.list_sessions_page(page[0].position, 10).size() == 1);
+        // 仍在内存中的会话不会因为存储里暂时看不到而消失
+        CHECK(lazy.list_sessions().size() == 2);
+    }
+
+    SUBCASE("派生视图随会话修改增量更新") {
+        SessionManager manager(config);
+        using Ids = std::vector<std::string>;
+        auto a = manager.create_session("a");
+        auto b = manager.create_session("b");
+        const auto &views = manager.views();
+        // 新会话使用默认模型，还没有消息
+        CHECK(views.by_model(config.default_model()) == Ids({"a", "b"}));
+        CHECK(views.dates().empty());
+
+        a->set_model("model-x");
+        a->populate("问题", "回答");
+        const std::string today =
+            SessionViews::day_of(std::chrono::system_clock::now());
+        CHECK(views.by_model("model-x") == Ids({"a"}));
+        CHECK(views.by_model(config.default_model()) == Ids({"b"}));
+        CHECK(views.by_date(today) == Ids({"a"}));
+
+        manager.set_latest_session_id("b");
+        manager.set_latest_session_id("a");
+        CHECK(views.recent() == Ids({"a", "b"}));
+
+        // 分叉的会话同样出现在视图中；删除的会话从所有视图中消失
+        REQUIRE(manager.fork_session("c", "a") != nullptr);
+        CHECK(views.by_date(today) == Ids({"a", "c"}));
+        CHECK(manager.remove_session("a"));
+        CHECK(views.by_model("model-x") == Ids({"c"}));
+        CHECK(views.recent() == Ids({"b"}));
+    }
+
+    SUBCASE("全文索引随会话修改增量更新") {
+        SessionManager manager(config);
+        const auto &index = manager.search_index();
+        auto a = manager.create_session("a");
+        a->populate("如何配置 redis", "修改 settings.toml");
+        auto found = index.search("redis", 10);
+        REQUIRE(found.size() == 1);
+        CHECK(found[0].session_id == "a");
+        CHECK(found[0].message == 0);
+
+        // 分叉的会话带着历史进入索引
+        REQUIRE(manager.fork_session("b", "a") != nullptr);
+        CHECK(index.search("settings", 10).size() == 2);
+
+        a->populate("另一个问题", "另一个回答");
+        CHECK(index.search("redis", 10).size() == 1);
+        CHECK(manager.remove_session("b"));
+        CHECK(index.search("redis", 10).empty());
+        CHECK(index.search("回答", 10).size() == 1);
+    }
+
     SUBCASE("最近使用的会话管理") {
         SessionManager manager(config);
         
@@ -121,4 +290,434 @@ TEST_CASE("SessionManager基本功能测试") {
         auto sessions = manager.list_sessions();
         CHECK(sessions.size() == 5);
     }
+    
+    SUBCASE("并发创建、查找和删除") {
+        SessionManager manager(config);
+        constexpr int THREADS = 8;
+        constexpr int PER_THREAD = 200;
+        std::atomic<int> lookup_failures{0};
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; t++) {
+            workers.emplace_back([&, t] {
+                for (int i = 0; i < PER_THREAD; i++) {
+                    std::string id = "t" + std::to_string(t) + "-" + std::to_string(i);
+                    manager.create_session(id);
+                    manager.set_latest_session_id(id);
+                    if (!manager.find_session(id)) {
+                        lookup_failures++;
+                    }
+                    manager.find_latest_session();
+                    if (i % 2 == 0) {
+                        manager.remove_session(id);
+                    }
+                }
+            });
+        }
+        for (auto &w : workers) {
+            w.join();
+        }
+
+        CHECK(lookup_failures == 0);
+        CHECK(manager.list_sessions().size() == THREADS * PER_THREAD / 2);
+    }
+
+    SUBCASE("通过latest查找会话") {
+        SessionManager manager(config);
+        CHECK_FALSE(manager.has_latest_session());
+        CHECK(manager.find_latest_session() == nullptr);
+
+        auto session = manager.create_session("s1");
+        manager.set_latest_session_id("s1");
+        CHECK(manager.has_latest_session());
+        CHECK(manager.find_latest_session() == session);
+
+        // 删除其他会话不影响latest
+        manager.create_session("s2");
+        manager.remove_session("s2");
+        CHECK(manager.get_latest_session_id() == "s1");
+    }
+
+    SUBCASE("惰性存储：按需加载与LRU淘汰") {
+        MockLazyStore store;
+        SessionManager manager(config);
+        manager.set_store(&store, 1); // 每个分片最多缓存一个空闲会话
+
+        for (int i = 0; i < 300; i++) {
+            manager.create_session("s" + std::to_string(i))
+                ->set_context("c" + std::to_string(i));
+        }
+        // 空闲会话被淘汰，但仍然可以列出和访问
+        CHECK(manager.resident_sessions() <= 64);
+        CHECK(manager.list_sessions().size() == 300);
+        auto s5 = manager.find_session("s5");
+        REQUIRE(s5 != nullptr);
+        CHECK(s5->get_context() == "c5");
+
+        // 正在被持有的会话不会被淘汰
+        for (int i = 300; i < 600; i++) {
+            manager.create_session("s" + std::to_string(i));
+        }
+        CHECK(manager.find_session("s5") == s5);
+
+        // 未加载的会话也不能重复创建，并且可以删除；都不需要加载会话
+        const int loads = store.loads;
+        SessionManager::Error error = SessionManager::Error::None;
+        CHECK(manager.create_session("s100", &error) == nullptr);
+        CHECK(error == SessionManager::Error::Exists);
+        CHECK(manager.remove_session("s200"));
+        CHECK(store.loads == loads);
+        CHECK(manager.find_session("s200", &error) == nullptr);
+        CHECK(error == SessionManager::Error::NotFound);
+        CHECK_FALSE(manager.remove_session("missing", &error));
+        CHECK(error == SessionManager::Error::NotFound);
+        CHECK(manager.list_sessions().size() == 599);
+
+        // 只读查看不把会话放进缓存
+        const size_t resident = manager.resident_sessions();
+        auto peeked = manager.peek_snapshot("s7");
+        REQUIRE(peeked != nullptr);
+        CHECK(peeked->context.str() == "c7");
+        CHECK(manager.resident_sessions() == resident);
+        CHECK(manager.peek_snapshot("s200") == nullptr);
+    }
+
+    SUBCASE("惰性存储不可达时报告错误而不是不存在") {
+        MockLazyStore store;
+        SessionManager manager(config);
+        manager.set_store(&store, 1);
+        for (int i = 0; i < 100; i++) {
+            manager.create_session("s" + std::to_string(i));
+        }
+        store.reachable = false;
+
+        SessionManager::Error error = SessionManager::Error::None;
+        std::string evicted;
+        for (int i = 0; i < 100 && evicted.empty(); i++) {
+            std::string id = "s" + std::to_string(i);
+            if (!manager.find_session(id, &error)) {
+                evicted = id;
+            }
+        }
+        REQUIRE_FALSE(evicted.empty());
+        CHECK(error == SessionManager::Error::Unavailable);
+        CHECK(manager.create_session("new", &error) == nullptr);
+        CHECK(error == SessionManager::Error::Unavailable);
+        CHECK_FALSE(manager.remove_session(evicted, &error));
+        CHECK(error == SessionManager::Error::Unavailable);
+
+        store.reachable = true;
+        CHECK(manager.find_session(evicted) != nullptr);
+        CHECK(manager.create_session("new") != nullptr);
+    }
+
+    SUBCASE("其他实例的修改使缓存的会话失效") {
+        MockLazyStore store;
+        SessionManager manager(config);
+        std::vector<std::string> invalidated;
+        manager.on_remote_change(
+            [&](const std::string &id) { invalidated.push_back(id); });
+        manager.set_store(&store);
+
+        manager.create_session("a")->set_context("旧");
+        manager.apply_store_change("a", 2, true); // 自己的写入
+        CHECK(invalidated.empty());
+
+        // 另一个实例直接修改了存储中的会话
+        {
+            SessionRecord record;
+            record.type = SessionRecord::Type::SetContext;
+            record.session_id = "a";
+            record.text = "新";
+            store.append(record);
+        }
+        // 版本号不比缓存新的通知被忽略
+        manager.apply_store_change("a", 2, false);
+        CHECK(manager.find_session("a")->get_context() == "旧");
+
+        manager.apply_store_change("a", 3, false);
+        REQUIRE(invalidated.size() == 1);
+        CHECK(invalidated[0] == "a");
+        CHECK(manager.find_session("a")->get_context() == "新");
+
+        // 正在使用的会话先标记为过期，释放后再重新加载
+        auto held = manager.find_session("a");
+        {
+            SessionRecord record;
+            record.type = SessionRecord::Type::SetContext;
+            record.session_id = "a";
+            record.text = "更新";
+            store.append(record);
+        }
+        manager.apply_store_change("a", 4, false);
+        CHECK(manager.find_session("a") == held);
+        held.reset();
+        CHECK(manager.find_session("a")->get_context() == "更新");
+
+        // 通知丢失：只对缓存中的会话逐个回调，最后用空 ID 表示会话列表
+        invalidated.clear();
+        manager.apply_store_change("", 0, false);
+        REQUIRE(invalidated.size() == 2);
+        CHECK(invalidated[0] == "a");
+        CHECK(invalidated[1].empty());
+        CHECK(manager.resident_sessions() == 0);
+
+        // 删除通知
+        store.images.erase("a");
+        manager.apply_store_change("a", 0, false);
+        CHECK(manager.find_session("a") == nullptr);
+    }
+
+    SUBCASE("内存预算：冷会话溢出到磁盘并按需读回") {
+        SessionManager manager(config);
+        auto spill_dir =
+            (std::filesystem::temp_directory_path() / "fusellm-test-spill")
+                .string();
+        manager.set_memory_budget(256 << 10,
+                                  std::make_unique<SpillFile>(spill_dir));
+
+        // 逐字节统计：常驻大小等于各会话大小之和
+        auto a = manager.create_session("a");
+        const int64_t before = manager.memory_stats().resident_bytes;
+        CHECK(before == static_cast<int64_t>(a->memory_bytes()));
+        a->set_context(std::string(10000, 'x'));
+        CHECK(manager.memory_stats().resident_bytes - before >= 10000);
+        a.reset();
+
+        const std::string filler(8000, 'y');
+        for (int i = 0; i < 100; i++) {
+            auto s = manager.create_session("s" + std::to_string(i));
+            s->populate("问题" + std::to_string(i), filler);
+        }
+        // 会话在管理器之外增长，预算在下一次访问时检查
+        manager.find_session("s99");
+        auto stats = manager.memory_stats();
+        CHECK(stats.resident_bytes <= (256 << 10));
+        CHECK(stats.spilled_sessions > 0);
+        CHECK(stats.spill.stored_bytes < stats.spill.raw_bytes);
+        CHECK(manager.list_sessions().size() == 101);
+
+        // 只读查看从溢出文件解码，不读回内存
+        const size_t spilled = stats.spilled_sessions;
+        auto peeked = manager.peek_snapshot("s0");
+        REQUIRE(peeked != nullptr);
+        REQUIRE(peeked->history.size() == 2);
+        CHECK(peeked->history[1].content == filler);
+        CHECK(manager.memory_stats().spilled_sessions == spilled);
+
+        // 访问被溢出的会话时透明读回
+        auto s0 = manager.find_session("s0");
+        REQUIRE(s0 != nullptr);
+        CHECK(s0->get_latest_response() == filler);
+        CHECK(s0->get_formatted_history().find("问题0") != std::string::npos);
+        CHECK(manager.find_session("a")->get_context() ==
+              std::string(10000, 'x'));
+
+        // 溢出的会话不能重复创建，可以删除，也包含在检查点中
+        CHECK(manager.create_session("s1") == nullptr);
+        std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>>
+            snapshots;
+        CHECK(manager.checkpoint_snapshots(snapshots));
+        CHECK(snapshots.size() == 101);
+        for (int i = 1; i < 100; i++) {
+            CHECK(manager.remove_session("s" + std::to_string(i)));
+        }
+        CHECK(manager.find_session("s1") == nullptr);
+        stats = manager.memory_stats();
+        CHECK(stats.spilled_sessions + stats.resident_sessions == 2);
+        CHECK(stats.spill.blobs == stats.spilled_sessions);
+    }
+
+    SUBCASE("并发读回与删除溢出的会话") {
+        SessionManager manager(config);
+        auto spill_dir =
+            (std::filesystem::temp_directory_path() / "fusellm-test-spill-race")
+                .string();
+        manager.set_memory_budget(64 << 10,
+                                  std::make_unique<SpillFile>(spill_dir));
+        const int n = 64;
+        for (int i = 0; i < n; i++) {
+            manager.create_session("s" + std::to_string(i))
+                ->set_context(std::string(4000, 'a' + i % 26));
+        }
+
+        // 读回在锁外解码：与删除交错时要么得到完整的会话，要么找不到
+        std::atomic<int> wrong{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int round = 0; round < 200; round++) {
+                    int i = (round * 7 + t * 13) % n;
+                    auto s = manager.find_session("s" + std::to_string(i));
+                    if (s && s->get_context() !=
+                                 std::string(4000, 'a' + i % 26)) {
+                        wrong++;
+                    }
+                }
+            });
+        }
+        threads.emplace_back([&] {
+            for (int i = 0; i < n; i += 2) {
+                manager.remove_session("s" + std::to_string(i));
+            }
+        });
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        CHECK(wrong == 0);
+        for (int i = 0; i < n; i++) {
+            CHECK((manager.find_session("s" + std::to_string(i)) != nullptr) ==
+                  (i % 2 == 1));
+        }
+        auto stats = manager.memory_stats();
+        CHECK(stats.spilled_sessions + stats.resident_sessions == n / 2);
+        CHECK(stats.spill.blobs == stats.spilled_sessions);
+    }
+
+    SUBCASE("溢出文件读不出时保留会话，检查点失败") {
+        SessionManager manager(config);
+        auto spill_dir = (std::filesystem::temp_directory_path() /
+                          "fusellm-test-spill-corrupt")
+                             .string();
+        manager.set_memory_budget(64 << 10,
+                                  std::make_unique<SpillFile>(spill_dir));
+        for (int i = 0; i < 16; i++) {
+            manager.create_session("s" + std::to_string(i))
+                ->set_context(std::string(8000, 'a' + i));
+        }
+        REQUIRE(manager.memory_stats().spilled_sessions > 0);
+
+        // 溢出文件已被删除，通过 /proc/self/fd 找到它并写坏内容
+        bool corrupted = false;
+        for (const auto &fd : std::filesystem::directory_iterator("/proc/self/fd")) {
+            std::error_code ec;
+            auto target = std::filesystem::read_symlink(fd.path(), ec).string();
+            if (target.rfind(spill_dir + "/fusellm-spill-", 0) != 0) {
+                continue;
+            }
+            int out = ::open(fd.path().c_str(), O_WRONLY);
+            REQUIRE(out >= 0);
+            const std::string garbage(1 << 20, '\xff');
+            corrupted = ::pwrite(out, garbage.data(), garbage.size(), 0) ==
+                        static_cast<ssize_t>(garbage.size());
+            ::close(out);
+        }
+        REQUIRE(corrupted);
+
+        std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>>
+            snapshots;
+        CHECK_FALSE(manager.checkpoint_snapshots(snapshots));
+        CHECK(snapshots.empty());
+
+        // 读回失败报告错误，会话仍然存在，不会被当作已删除
+        int unavailable = 0;
+        for (int i = 0; i < 16; i++) {
+            SessionManager::Error error = SessionManager::Error::None;
+            if (!manager.find_session("s" + std::to_string(i), &error)) {
+                CHECK(error == SessionManager::Error::Unavailable);
+                unavailable++;
+            }
+        }
+        CHECK(unavailable > 0);
+        auto stats = manager.memory_stats();
+        CHECK(stats.spilled_sessions + stats.resident_sessions == 16);
+        CHECK(manager.list_sessions().size() == 16);
+    }
+
+    SUBCASE("压缩旧轮次：恢复的会话按需解压") {
+        SessionManager manager(config);
+        HistoryCompressor::Options options;
+        options.keep_turns = 2;
+        manager.set_history_compressor(
+            std::make_shared<HistoryCompressor>(options));
+
+        SessionImage image;
+        image.id = "long";
+        auto ts = std::chrono::system_clock::now();
+        for (int i = 0; i < 500; i++) {
+            image.history.push_back({Message::Role::User,
+                                     "问题" + std::to_string(i) +
+                                         std::string(200, 'q'),
+                                     ts});
+            image.history.push_back(
+                {Message::Role::AI, "回答" + std::to_string(i), ts});
+        }
+        auto session = manager.restore_session(image);
+        REQUIRE(session != nullptr);
+
+        auto stats = manager.memory_stats();
+        CHECK(stats.history.frames > 0);
+        CHECK(stats.history.compressed_bytes < stats.history.raw_bytes);
+        auto snap = session->snapshot();
+        REQUIRE(snap->history.size() == 1000);
+        // 压缩不改变内容，不产生新版本
+        CHECK(snap->version == 0);
+        CHECK(snap->history[0].content == image.history[0].content);
+        CHECK(session->get_formatted_history().find("问题0") !=
+              std::string::npos);
+        CHECK(session->get_latest_response() == "回答499");
+
+        // 释放会话后压缩块随之释放
+        session.reset();
+        snap.reset();
+        CHECK(manager.remove_session("long"));
+        CHECK(manager.memory_stats().history.frames == 0);
+    }
+
+    SUBCASE("分叉会话与原会话共享历史") {
+        SessionManager manager(config);
+        SessionImage image;
+        image.id = "base";
+        image.context = std::string(1000, 'c');
+        auto ts = std::chrono::system_clock::now();
+        for (int i = 0; i < 2000; i++) {
+            image.history.push_back({Message::Role::User,
+                                     "问题" + std::to_string(i) +
+                                         std::string(200, 'q'),
+                                     ts});
+            image.history.push_back(
+                {Message::Role::AI, "回答" + std::to_string(i), ts});
+        }
+        auto base = manager.restore_session(image);
+        REQUIRE(base != nullptr);
+
+        CHECK(manager.fork_session("x", "missing") == nullptr);
+        auto fork = manager.fork_session("fork", "base");
+        REQUIRE(fork != nullptr);
+        CHECK(manager.fork_session("fork", "base") == nullptr);
+        CHECK(manager.list_sessions().size() == 2);
+
+        // 分叉不拷贝历史与上下文
+        auto a = base->snapshot();
+        auto b = fork->snapshot();
+        CHECK(b->history.same_as(a->history));
+        CHECK(b->context.same_as(a->context));
+        CHECK(b->history[10].content.data() == a->history[10].content.data());
+        CHECK(fork->get_latest_response() == "回答1999");
+
+        // 之后的修改互不影响
+        fork->set_context("分叉的上下文");
+        fork->set_model("fork-model");
+        CHECK(base->get_context() == image.context);
+        CHECK(base->get_model() == config.default_model());
+        CHECK(manager.remove_session("base"));
+        CHECK(fork->snapshot()->history.size() == 4000);
+        CHECK(fork->snapshot()->history[3999].content == "回答1999");
+    }
+
+    SUBCASE("相同的大段上下文在会话之间只存一份") {
+        SessionManager manager(config);
+        const std::string doc(50000, 'c');
+        const auto before = manager.memory_stats().blobs;
+        for (int i = 0; i < 10; i++) {
+            manager.create_session("doc" + std::to_string(i))->set_context(doc);
+        }
+        auto stats = manager.memory_stats().blobs;
+        CHECK(stats.blobs == before.blobs + 1);
+        CHECK(stats.stored_bytes - before.stored_bytes == doc.size());
+        CHECK(stats.logical_bytes - before.logical_bytes == 10 * doc.size());
+        CHECK(manager.find_session("doc3")->get_context() == doc);
+        CHECK(manager.find_session("doc0")->get_context() ==
+              manager.find_session("doc9")->get_context());
+    }
 }
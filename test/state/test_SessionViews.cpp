@@ -0,0 +1,71 @@
+#include "../../src/state/SessionViews.h"
+#include <doctest/doctest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace fusellm;
+
+namespace {
+
+using Ids = std::vector<std::string>;
+
+// 本地时间某天中午的时间点
+SessionViews::Clock::time_point noon(int year, int month, int day) {
+    std::tm tm{};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    return SessionViews::Clock::from_time_t(std::mktime(&tm));
+}
+
+} // namespace
+
+TEST_CASE("SessionViews测试") {
+    SUBCASE("按日期和模型归类，修改时移动") {
+        SessionViews views;
+        CHECK(SessionViews::day_of(noon(2024, 3, 9)) == "2024-03-09");
+
+        views.update("a", "m1", noon(2024, 3, 9));
+        views.update("b", "m1", noon(2024, 3, 10));
+        views.update("c", "m2", std::nullopt); // 没有消息的会话不按日期归类
+        CHECK(views.dates() == Ids({"2024-03-09", "2024-03-10"}));
+        CHECK(views.models() == Ids({"m1", "m2"}));
+        CHECK(views.by_model("m1") == Ids({"a", "b"}));
+        CHECK(views.in_date("2024-03-09", "a"));
+        CHECK_FALSE(views.in_date("2024-03-09", "b"));
+
+        // 新的一轮对话把会话移到当天，换模型把它移到新模型下
+        views.update("a", "m2", noon(2024, 3, 10));
+        CHECK(views.dates() == Ids({"2024-03-10"}));
+        CHECK_FALSE(views.has_date("2024-03-09"));
+        CHECK(views.by_date("2024-03-10") == Ids({"a", "b"}));
+        CHECK(views.by_model("m1") == Ids({"b"}));
+        CHECK(views.by_model("m2") == Ids({"a", "c"}));
+
+        views.remove("b");
+        CHECK_FALSE(views.has_model("m1"));
+        CHECK(views.by_date("2024-03-10") == Ids({"a"}));
+        CHECK(views.by_model("missing").empty());
+    }
+
+    SUBCASE("最近使用列表有容量上限") {
+        SessionViews views(3);
+        for (const char *id : {"a", "b", "c", "d"}) {
+            views.touch(id);
+        }
+        CHECK(views.recent() == Ids({"d", "c", "b"}));
+        CHECK_FALSE(views.in_recent("a"));
+
+        views.touch("b");
+        CHECK(views.recent() == Ids({"b", "d", "c"}));
+        views.remove("d");
+        CHECK(views.recent() == Ids({"b", "c"}));
+
+        SessionViews disabled(0);
+        disabled.touch("a");
+        CHECK(disabled.recent().empty());
+    }
+}
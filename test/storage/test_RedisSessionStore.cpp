@@ -0,0 +1,223 @@
+#include "../../src/config/ConfigManager.h"
+#include "../../src/state/SessionManager.h"
+#include "../../src/storage/RecordCodec.h"
+#include "../../src/storage/RedisSessionStore.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// 这些测试需要本地运行的 redis-server。
+// 可通过 FUSELLM_TEST_REDIS_URL 指定地址，连接不上时跳过。
+
+namespace {
+
+std::string test_redis_url() {
+    const char *url = std::getenv("FUSELLM_TEST_REDIS_URL");
+    return url ? url : "redis://127.0.0.1:6379";
+}
+
+// 删除某个前缀下的所有键
+void drop_prefix(fusellm::RedisConnection &conn, const std::string &prefix) {
+    auto keys = conn.command({"KEYS", prefix + ":*"});
+    if (!keys || keys->type != REDIS_REPLY_ARRAY) {
+        return;
+    }
+    for (size_t i = 0; i < keys->elements; i++) {
+        conn.command({"DEL", std::string(keys->element[i]->str,
+                                         keys->element[i]->len)});
+    }
+}
+
+} // namespace
+
+TEST_CASE("RedisSessionStore测试") {
+    fusellm::RedisConnection conn(test_redis_url());
+    if (!conn.ensure_connected()) {
+        MESSAGE("redis-server 不可用，跳过 RedisSessionStore 测试");
+        return;
+    }
+    const std::string prefix = "fusellm-test-" + std::to_string(::getpid());
+    drop_prefix(conn, prefix);
+
+    fusellm::ConfigManager config;
+    config.set_default_model("default-model");
+
+    SUBCASE("另一个挂载点按需加载会话") {
+        {
+            fusellm::RedisSessionStore store(test_redis_url(), prefix);
+            fusellm::SessionManager manager(config);
+            manager.set_store(&store);
+
+            auto a = manager.create_session("a");
+            a->populate("问题", "回答");
+            a->set_context("上下文");
+            a->set_model("model-x");
+            fusellm::ModelParameters params;
+            params.temperature = 0.25;
+            params.timeout_ms = 1500;
+            params.stop = fusellm::StopList{"a\nb", ""};
+            a->set_settings(params);
+            manager.create_session("b");
+            manager.remove_session("b");
+            // 析构时会把写队列中剩余的修改写入 Redis
+        }
+
+        fusellm::RedisSessionStore store(test_redis_url(), prefix);
+        fusellm::SessionManager manager(config);
+        manager.set_store(&store);
+
+        CHECK(manager.resident_sessions() == 0);
+        auto ids = manager.list_sessions();
+        REQUIRE(ids.size() == 1);
+        CHECK(ids[0] == "a");
+
+        auto a = manager.find_session("a");
+        REQUIRE(a != nullptr);
+        CHECK(manager.resident_sessions() == 1);
+        CHECK(a->get_context() == "上下文");
+        CHECK(a->get_model() == "model-x");
+        CHECK(a->get_latest_response() == "回答");
+        CHECK(a->get_settings().temperature.value() == doctest::Approx(0.25));
+        CHECK(a->get_settings().timeout_ms.value() == 1500);
+        CHECK(a->get_settings().stop.value() == fusellm::StopList({"a\nb", ""}));
+        // 停止序列以 JSON 数组保存，可以直接用 redis-cli 查看
+        auto stop = conn.command({"HGET", prefix + ":session:a", "param.stop"});
+        REQUIRE(stop != nullptr);
+        CHECK(std::string(stop->str, stop->len) == "[\"a\\nb\",\"\"]");
+        // 旧版本写入的二进制编码仍然可读
+        std::string legacy;
+        fusellm::codec::Writer(legacy).strings({"x"});
+        conn.command({"HSET", prefix + ":session:a", "param.stop", legacy});
+        fusellm::SessionImage image;
+        REQUIRE(store.load("a", image) == fusellm::Lookup::Found);
+        CHECK(image.overrides.stop.value() == fusellm::StopList({"x"}));
+        REQUIRE(a->snapshot()->history.size() == 2);
+        CHECK(a->snapshot()->history[0].content == "问题");
+
+        CHECK(manager.find_session("b") == nullptr);
+        // 已存在于 Redis 中的 ID 不能再次创建
+        CHECK(manager.create_session("a") == nullptr);
+
+        // 尚未写入 Redis 的创建和删除立即可见
+        manager.create_session("c");
+        manager.remove_session("a");
+        CHECK(store.contains("c") == fusellm::Lookup::Found);
+        CHECK(store.contains("a") == fusellm::Lookup::Missing);
+        ids = store.list_ids();
+        REQUIRE(ids.size() == 1);
+        CHECK(ids[0] == "c");
+    }
+
+    SUBCASE("Redis 不可达时报告存储不可用") {
+        // 没有服务监听的端口
+        fusellm::RedisSessionStore store("redis://127.0.0.1:1", prefix);
+        fusellm::SessionImage image;
+        CHECK(store.load("a", image) == fusellm::Lookup::Unavailable);
+        CHECK(store.contains("a") == fusellm::Lookup::Unavailable);
+    }
+
+    SUBCASE("脚本缓存被清空后重新加载脚本") {
+        fusellm::RedisSessionStore store(test_redis_url(), prefix);
+        fusellm::SessionManager manager(config);
+        manager.set_store(&store);
+
+        auto a = manager.create_session("a");
+        a->write_context(0, "abc");
+        REQUIRE(store.flush_all(std::chrono::seconds(5)));
+
+        // 事务中的 EVALSHA 报 NOSCRIPT，失败的调用重新发送
+        CHECK(conn.command({"SCRIPT", "FLUSH"}) != nullptr);
+        a->write_context(3, "def");
+        a->truncate_context(5);
+        REQUIRE(store.flush_all(std::chrono::seconds(5)));
+
+        fusellm::SessionImage image;
+        REQUIRE(store.load("a", image) == fusellm::Lookup::Found);
+        CHECK(image.context == "abcde");
+    }
+
+    SUBCASE("读己之写与缓存淘汰") {
+        fusellm::RedisSessionStore store(test_redis_url(), prefix);
+        fusellm::SessionManager manager(config);
+        manager.set_store(&store, 1); // 每个分片只缓存一个会话
+
+        for (int i = 0; i < 200; i++) {
+            manager.create_session("s" + std::to_string(i))
+                ->set_context("c" + std::to_string(i));
+        }
+        CHECK(manager.resident_sessions() < 200);
+        CHECK(manager.list_sessions().size() == 200);
+
+        // 被淘汰的会话从 Redis 重新加载，包含刚刚写入的修改
+        for (int i = 0; i < 200; i++) {
+            auto s = manager.find_session("s" + std::to_string(i));
+            REQUIRE(s != nullptr);
+            CHECK(s->get_context() == "c" + std::to_string(i));
+        }
+
+        CHECK(manager.remove_session("s7"));
+        CHECK(manager.find_session("s7") == nullptr);
+        CHECK(manager.list_sessions().size() == 199);
+        CHECK(store.pending() == 0);
+    }
+
+    SUBCASE("两个实例之间的变更通知") {
+        fusellm::RedisSessionStore store_a(test_redis_url(), prefix);
+        fusellm::RedisSessionStore store_b(test_redis_url(), prefix);
+        fusellm::SessionManager a(config);
+        fusellm::SessionManager b(config);
+
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::string b_last_change;
+        b.on_remote_change([&](const std::string &id) {
+            std::lock_guard<std::mutex> lock(mtx);
+            b_last_change = id;
+            cv.notify_all();
+        });
+        std::atomic<int> a_notified{0};
+        a.on_remote_change([&](const std::string &) { a_notified++; });
+        a.set_store(&store_a);
+        b.set_store(&store_b);
+        // 等待订阅生效
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        // 通知按顺序送达：B 收到标记会话的通知时，之前的通知都已处理
+        int markers = 0;
+        auto a_changes_seen_by_b = [&] {
+            std::string marker = "marker-" + std::to_string(markers++);
+            a.create_session(marker);
+            CHECK(store_a.flush_all(std::chrono::seconds(5)));
+            std::unique_lock<std::mutex> lock(mtx);
+            return cv.wait_for(lock, std::chrono::seconds(5),
+                               [&] { return b_last_change == marker; });
+        };
+
+        a.create_session("shared")->set_context("v1");
+        REQUIRE(a_changes_seen_by_b());
+        CHECK(b.find_session("shared")->get_context() == "v1");
+
+        a.find_session("shared")->set_context("v2");
+        REQUIRE(a_changes_seen_by_b());
+        // B 无需轮询即可看到新版本
+        CHECK(b.find_session("shared")->get_context() == "v2");
+
+        // B 自己的写入立即可见
+        b.find_session("shared")->set_context("v3");
+        CHECK(b.find_session("shared")->get_context() == "v3");
+        CHECK(store_b.flush_all(std::chrono::seconds(5)));
+
+        a.remove_session("shared");
+        REQUIRE(a_changes_seen_by_b());
+        CHECK(b.find_session("shared") == nullptr);
+        CHECK(a_notified >= 1); // 来自 B 的写入
+    }
+
+    drop_prefix(conn, prefix);
+}
@@ -0,0 +1,73 @@
+#include "../../src/storage/SpillFile.h"
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+TEST_CASE("SpillFile测试") {
+    auto dir =
+        (std::filesystem::temp_directory_path() / "fusellm-test-spillfile")
+            .string();
+    fusellm::SpillFile spill(dir);
+
+    SUBCASE("写入后读回，可压缩的数据被压缩") {
+        std::string data;
+        for (int i = 0; i < 1000; i++) {
+            data += "message " + std::to_string(i % 10) + "\n";
+        }
+        fusellm::SpillFile::Extent extent;
+        REQUIRE(spill.write(data, extent));
+        CHECK(extent.compressed);
+        CHECK(extent.stored < extent.raw);
+
+        std::string out;
+        REQUIRE(spill.read(extent, out));
+        CHECK(out == data);
+        // 读取不会释放数据
+        REQUIRE(spill.read(extent, out));
+        CHECK(out == data);
+
+        auto stats = spill.stats();
+        CHECK(stats.blobs == 1);
+        CHECK(stats.raw_bytes == data.size());
+        spill.release(extent);
+        CHECK(spill.stats().blobs == 0);
+        CHECK(spill.stats().file_bytes == 0);
+    }
+
+    SUBCASE("不可压缩的数据原样存储") {
+        std::string data = "ab";
+        fusellm::SpillFile::Extent extent;
+        REQUIRE(spill.write(data, extent));
+        CHECK_FALSE(extent.compressed);
+        std::string out;
+        REQUIRE(spill.read(extent, out));
+        CHECK(out == data);
+    }
+
+    SUBCASE("释放的空间被合并并重复使用") {
+        const std::string data(4096, 'z');
+        std::vector<fusellm::SpillFile::Extent> extents(4);
+        for (auto &extent : extents) {
+            REQUIRE(spill.write(std::string(1000, 'q') + data, extent));
+        }
+        const uint64_t size = spill.stats().file_bytes;
+        spill.release(extents[1]);
+        spill.release(extents[2]);
+
+        // 两个相邻的空闲区间合并后可以容纳一个更大的块
+        std::string bigger;
+        for (int i = 0; i < 2000; i++) {
+            bigger += std::to_string(i * 7919 % 1000);
+        }
+        fusellm::SpillFile::Extent extent;
+        REQUIRE(spill.write(bigger.substr(0, extents[1].stored +
+                                                 extents[2].stored - 8),
+                            extent));
+        CHECK(spill.stats().file_bytes == size);
+
+        std::string out;
+        REQUIRE(spill.read(extents[3], out));
+        CHECK(out == std::string(1000, 'q') + data);
+    }
+}
@@ -0,0 +1,179 @@
+#include "../../src/config/ConfigManager.h"
+#include "../../src/state/SessionManager.h"
+#include "../../src/storage/WalSessionStore.h"
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <string>
+
+namespace {
+
+std::string fresh_dir(const std::string &name) {
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+// 用一个新的存储实例加载目录中的所有会话，模拟进程重启
+void restart(const std::string &dir, fusellm::SessionManager &manager) {
+    fusellm::WalSessionStore store(dir);
+    for (auto &image : store.load_all()) {
+        manager.restore_session(std::move(image));
+    }
+}
+
+} // namespace
+
+TEST_CASE("WalSessionStore持久化测试") {
+    fusellm::ConfigManager config;
+    config.set_default_model("default-model");
+
+    SUBCASE("重启后从WAL恢复会话") {
+        auto dir = fresh_dir("fusellm-test-store-wal");
+        {
+            fusellm::WalSessionStore store(dir);
+            fusellm::SessionManager manager(config);
+            manager.set_store(&store);
+
+            auto a = manager.create_session("a");
+            a->populate("问题", "回答");
+            a->set_context("上下文");
+            a->set_model("model-x");
+            fusellm::ModelParameters params;
+            params.temperature = 0.3;
+            params.max_tokens = 128;
+            params.stop = fusellm::StopList{"\n\n", "END"};
+            params.seed = 7;
+            a->set_settings(params);
+
+            manager.create_session("b");
+            manager.create_session("1500");
+            manager.remove_session("b");
+        }
+
+        fusellm::SessionManager manager(config);
+        restart(dir, manager);
+
+        auto ids = manager.list_sessions();
+        CHECK(ids.size() == 2);
+        CHECK(manager.find_session("b") == nullptr);
+
+        auto a = manager.find_session("a");
+        REQUIRE(a != nullptr);
+        CHECK(a->get_context() == "上下文");
+        CHECK(a->get_model() == "model-x");
+        CHECK(a->get_latest_response() == "回答");
+        CHECK(a->get_settings().temperature.value() == doctest::Approx(0.3));
+        CHECK(a->get_settings().max_tokens.value() == 128);
+        CHECK(a->get_settings().stop.value() ==
+              fusellm::StopList({"\n\n", "END"}));
+        CHECK(a->get_settings().seed.value() == 7);
+        CHECK_FALSE(a->get_settings().top_p.has_value());
+        CHECK(a->snapshot()->history.size() == 2);
+
+        // 自动生成的 ID 不会与恢复的数字 ID 冲突
+        CHECK(std::stol(manager.create_session_with_auto_id()->get_id()) > 1500);
+    }
+
+    SUBCASE("快照加WAL尾部恢复") {
+        auto dir = fresh_dir("fusellm-test-store-snapshot");
+        {
+            fusellm::WalSessionStore store(dir);
+            fusellm::SessionManager manager(config);
+            manager.set_store(&store);
+            for (int i = 0; i < 100; i++) {
+                manager.create_session("s" + std::to_string(i))
+                    ->populate("q" + std::to_string(i), "r" + std::to_string(i));
+            }
+            manager.find_session("s0")->set_model("chosen");
+            CHECK(store.checkpoint(manager));
+
+            // 快照之后的修改只存在于 WAL 中
+            manager.find_session("s1")->set_context("快照之后");
+            manager.remove_session("s2");
+            manager.create_session("new")->set_model("m");
+        }
+
+        // 快照只保存会话自己选择的模型，其余会话跟随新的默认模型
+        config.set_default_model("new-default");
+        fusellm::SessionManager manager(config);
+        restart(dir, manager);
+
+        CHECK(manager.list_sessions().size() == 100);
+        CHECK(manager.find_session("s0")->get_model() == "chosen");
+        CHECK(manager.find_session("s3")->get_model() == "new-default");
+        CHECK(manager.find_session("s1")->get_context() == "快照之后");
+        CHECK(manager.find_session("s2") == nullptr);
+        CHECK(manager.find_session("new")->get_model() == "m");
+        CHECK(manager.find_session("s99")->get_latest_response() == "r99");
+        // 快照中的会话不会被 WAL 尾部重复应用
+        CHECK(manager.find_session("s1")->snapshot()->history.size() == 2);
+    }
+
+    SUBCASE("分叉的会话可以重放") {
+        auto dir = fresh_dir("fusellm-test-store-fork");
+        {
+            fusellm::WalSessionStore store(dir);
+            fusellm::SessionManager manager(config);
+            manager.set_store(&store);
+            auto base = manager.create_session("base");
+            base->populate("问题", "回答");
+            base->set_context("共同的上下文");
+            REQUIRE(manager.fork_session("child", "base") != nullptr);
+            // 分叉之后两边各自修改，互不影响
+            base->set_context("基础分支");
+            manager.find_session("child")->set_model("model-c");
+            // 分叉的分叉
+            REQUIRE(manager.fork_session("grandchild", "child") != nullptr);
+            manager.find_session("grandchild")->write_context(0, "孙");
+        }
+
+        fusellm::SessionManager manager(config);
+        restart(dir, manager);
+        auto base = manager.find_session("base");
+        auto child = manager.find_session("child");
+        auto grandchild = manager.find_session("grandchild");
+        REQUIRE(base != nullptr);
+        REQUIRE(child != nullptr);
+        REQUIRE(grandchild != nullptr);
+        CHECK(base->get_context() == "基础分支");
+        CHECK(base->get_model() == "default-model");
+        CHECK(child->snapshot()->history.size() == 2);
+        CHECK(child->get_latest_response() == "回答");
+        CHECK(child->get_context() == "共同的上下文");
+        CHECK(child->get_model() == "model-c");
+        CHECK(grandchild->get_formatted_history() ==
+              child->get_formatted_history());
+        CHECK(grandchild->get_model() == "model-c");
+        CHECK(grandchild->get_context() == "孙同的上下文");
+    }
+
+    SUBCASE("上下文的追加、覆盖与截断可以重放") {
+        auto dir = fresh_dir("fusellm-test-store-context");
+        std::string expected;
+        {
+            fusellm::WalSessionStore store(dir);
+            fusellm::SessionManager manager(config);
+            manager.set_store(&store);
+            auto s = manager.create_session("doc");
+            s->set_context("开头");
+            for (int i = 0; i < 50; i++) {
+                std::string line = "第" + std::to_string(i) + "行\n";
+                s->write_context(s->get_context_size(), line);
+            }
+            CHECK(store.checkpoint(manager));
+
+            // 快照之后：覆盖、截断，再写到末尾之后留下空洞
+            s->write_context(0, "起始");
+            s->truncate_context(100);
+            s->write_context(110, "尾");
+            expected = s->get_context();
+        }
+        CHECK(expected.size() == 110 + std::string("尾").size());
+        CHECK(expected.compare(0, 6, "起始") == 0);
+        CHECK(expected.substr(100, 10) == std::string(10, '\0'));
+
+        fusellm::SessionManager manager(config);
+        restart(dir, manager);
+        CHECK(manager.find_session("doc")->get_context() == expected);
+    }
+}
@@ -0,0 +1,158 @@
+#include "../../src/storage/WriteAheadLog.h"
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <csignal>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string fresh_dir(const std::string &name) {
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+std::vector<std::pair<uint64_t, std::string>>
+read_all(const fusellm::WriteAheadLog &wal, uint64_t after = 0) {
+    std::vector<std::pair<uint64_t, std::string>> records;
+    wal.replay(after, [&](uint64_t lsn, std::string_view payload) {
+        records.emplace_back(lsn, std::string(payload));
+    });
+    return records;
+}
+
+} // namespace
+
+TEST_CASE("WriteAheadLog基本功能测试") {
+    using fusellm::WriteAheadLog;
+
+    SUBCASE("追加、同步与重新打开后回放") {
+        auto dir = fresh_dir("fusellm-test-wal-basic");
+        {
+            WriteAheadLog wal(dir);
+            CHECK(wal.last_lsn() == 0);
+            uint64_t a = wal.append("first");
+            uint64_t b = wal.append("second");
+            CHECK(b == a + 1);
+            CHECK(wal.sync(b));
+            CHECK(wal.last_lsn() == b);
+        }
+
+        WriteAheadLog reopened(dir);
+        CHECK(reopened.last_lsn() == 2);
+        auto records = read_all(reopened);
+        REQUIRE(records.size() == 2);
+        CHECK(records[0].second == "first");
+        CHECK(records[1].second == "second");
+
+        // 只回放指定 LSN 之后的记录
+        CHECK(read_all(reopened, 1).size() == 1);
+
+        // 新记录的 LSN 接续之前的日志
+        CHECK(reopened.append("third") == 3);
+    }
+
+    SUBCASE("截断写坏的尾部记录") {
+        auto dir = fresh_dir("fusellm-test-wal-torn");
+        {
+            WriteAheadLog wal(dir);
+            wal.sync(wal.append("intact"));
+        }
+        // 模拟崩溃：在段文件末尾写入半条记录
+        for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+            std::ofstream out(entry.path(), std::ios::app | std::ios::binary);
+            const char torn[] = {0x20, 0x00, 0x00, 0x00, 0x12, 0x34};
+            out.write(torn, sizeof(torn));
+        }
+
+        WriteAheadLog wal(dir);
+        auto records = read_all(wal);
+        REQUIRE(records.size() == 1);
+        CHECK(records[0].second == "intact");
+        CHECK(wal.sync(wal.append("after crash")));
+        CHECK(read_all(wal).size() == 2);
+    }
+
+    SUBCASE("写入失败后截断残缺记录并重试") {
+        auto dir = fresh_dir("fusellm-test-wal-retry");
+        WriteAheadLog wal(dir);
+        REQUIRE(wal.sync(wal.append("before")));
+        size_t size = 0;
+        for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+            size = std::filesystem::file_size(entry.path());
+        }
+
+        // 限制文件大小，让下一批只写进去一半
+        auto old_handler = std::signal(SIGXFSZ, SIG_IGN);
+        rlimit old_limit{};
+        getrlimit(RLIMIT_FSIZE, &old_limit);
+        rlimit limit = old_limit;
+        limit.rlim_cur = size + 32;
+        setrlimit(RLIMIT_FSIZE, &limit);
+        uint64_t failed = wal.append(std::string(100, 'x'));
+        CHECK_FALSE(wal.sync(failed));
+        setrlimit(RLIMIT_FSIZE, &old_limit);
+        std::signal(SIGXFSZ, old_handler);
+
+        // 失败的记录在重试时写入，排在之后追加的记录前面
+        uint64_t after = wal.append("after");
+        CHECK(wal.sync(after));
+        auto records = read_all(wal);
+        REQUIRE(records.size() == 3);
+        CHECK(records[1].first == failed);
+        CHECK(records[1].second == std::string(100, 'x'));
+        CHECK(records[2].second == "after");
+    }
+
+    SUBCASE("分段轮转与过期段清理") {
+        auto dir = fresh_dir("fusellm-test-wal-segments");
+        WriteAheadLog wal(dir, 64); // 很小的段，几乎每批都会轮转
+        uint64_t last = 0;
+        for (int i = 0; i < 20; i++) {
+            last = wal.append(std::string(40, 'a' + i % 26));
+            wal.sync(last);
+        }
+        size_t segments_before = 0;
+        for (auto &e : std::filesystem::directory_iterator(dir)) {
+            (void)e;
+            segments_before++;
+        }
+        CHECK(segments_before > 1);
+        CHECK(read_all(wal).size() == 20);
+
+        wal.truncate_through(last - 2);
+        auto remaining = read_all(wal, last - 2);
+        CHECK(remaining.size() == 2);
+        size_t segments_after = 0;
+        for (auto &e : std::filesystem::directory_iterator(dir)) {
+            (void)e;
+            segments_after++;
+        }
+        CHECK(segments_after < segments_before);
+    }
+
+    SUBCASE("并发追加的组提交") {
+        auto dir = fresh_dir("fusellm-test-wal-group");
+        WriteAheadLog wal(dir);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 8; t++) {
+            writers.emplace_back([&wal, t] {
+                for (int i = 0; i < 50; i++) {
+                    CHECK(wal.sync(wal.append("t" + std::to_string(t))));
+                }
+            });
+        }
+        for (auto &w : writers) {
+            w.join();
+        }
+        auto records = read_all(wal);
+        CHECK(records.size() == 400);
+        for (size_t i = 0; i < records.size(); i++) {
+            CHECK(records[i].first == i + 1);
+        }
+    }
+}